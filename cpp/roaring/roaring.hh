@@ -227,6 +227,19 @@ class Roaring {
         api::roaring_bitmap_add_many(&roaring, n_args, vals);
     }
 
+    /**
+     * Add n_args values from pointer vals given in any order, see
+     * `roaring_bitmap_add_many_unsorted()`. The containers are built through
+     * the executor when one is provided.
+     */
+    void addManyUnsorted(size_t n_args, const uint32_t *vals,
+                         const api::roaring_executor_t *executor = nullptr) {
+        if (!api::roaring_bitmap_add_many_unsorted(&roaring, n_args, vals,
+                                                   executor)) {
+            ROARING_TERMINATE("failed memory alloc in addManyUnsorted");
+        }
+    }
+
     /**
      * Add value val, using context from a previous insert for speed
      * optimization.
@@ -452,6 +465,39 @@ class Roaring {
         api::roaring_bitmap_range_uint32_array(&roaring, offset, limit, ans);
     }
 
+    /**
+     * Write the bits of the values in [start, start + n) to "words", which
+     * must hold at least (n + 63) / 64 words. See roaring_bitmap_to_words.
+     */
+    void toWords(uint32_t start, uint32_t n, uint64_t *words) const noexcept {
+        api::roaring_bitmap_to_words(&roaring, start, n, words);
+    }
+
+    /**
+     * Create a bitmap from a dense bitvector where bit i of "words" stands
+     * for base_offset + i. See roaring_bitmap_from_words.
+     */
+    static Roaring fromWords(const uint64_t *words, size_t nwords,
+                             uint32_t base_offset = 0) {
+        roaring_bitmap_t *r =
+            api::roaring_bitmap_from_words(words, nwords, base_offset);
+        if (r == NULL) {
+            ROARING_TERMINATE("failed memory alloc in fromWords");
+        }
+        return Roaring(r);
+    }
+
+    /**
+     * Add the values of a dense bitvector, as in fromWords.
+     */
+    void addWords(const uint64_t *words, size_t nwords,
+                  uint32_t base_offset = 0) {
+        if (!api::roaring_bitmap_or_words(&roaring, words, nwords,
+                                          base_offset)) {
+            ROARING_TERMINATE("failed memory alloc in addWords");
+        }
+    }
+
     /**
      * Return true if the two bitmaps contain the same elements.
      */
@@ -502,6 +548,24 @@ class Roaring {
         return api::roaring_bitmap_shrink_to_fit(&roaring);
     }
 
+    /**
+     * Same as removeRunCompression(), runOptimize() and shrinkToFit(), with
+     * the containers processed through the executor.
+     */
+    bool removeRunCompression(
+        const api::roaring_executor_t *executor) noexcept {
+        return api::roaring_bitmap_remove_run_compression_parallel(&roaring,
+                                                                   executor);
+    }
+
+    bool runOptimize(const api::roaring_executor_t *executor) noexcept {
+        return api::roaring_bitmap_run_optimize_parallel(&roaring, executor);
+    }
+
+    size_t shrinkToFit(const api::roaring_executor_t *executor) noexcept {
+        return api::roaring_bitmap_shrink_to_fit_parallel(&roaring, executor);
+    }
+
     /**
      * Iterate over the bitmap elements. The function iterator is called once
      * for all the values with ptr (can be NULL) as the second parameter of
@@ -1070,6 +1134,51 @@ class RoaringSetBitBiDirectionalIterator final {
               // analyzers.
 };
 
+/**
+ * Adds strictly increasing values to a Roaring faster than `Roaring::add()`,
+ * see `roaring_bitmap_appender_t`. The values are flushed to the bitmap by
+ * `flush()` and on destruction; the bitmap must not otherwise be modified
+ * while the appender holds values.
+ */
+class RoaringAppender {
+   public:
+    explicit RoaringAppender(Roaring &r)
+        : appender(api::roaring_bitmap_appender_create(&r.roaring)) {
+        if (appender == nullptr) {
+            ROARING_TERMINATE(
+                "failed memory alloc in roaring_bitmap_appender_create");
+        }
+    }
+
+    RoaringAppender(const RoaringAppender &) = delete;
+    RoaringAppender &operator=(const RoaringAppender &) = delete;
+
+    ~RoaringAppender() { api::roaring_bitmap_appender_free(appender); }
+
+    /**
+     * Add value x, ideally larger than any value added before.
+     */
+    void add(uint32_t x) {
+        if (!api::roaring_bitmap_appender_add(appender, x)) {
+            ROARING_TERMINATE(
+                "failed memory alloc in roaring_bitmap_appender_add");
+        }
+    }
+
+    /**
+     * Move the values added so far into the bitmap.
+     */
+    void flush() {
+        if (!api::roaring_bitmap_appender_flush(appender)) {
+            ROARING_TERMINATE(
+                "failed memory alloc in roaring_bitmap_appender_flush");
+        }
+    }
+
+   private:
+    api::roaring_bitmap_appender_t *appender;
+};
+
 inline RoaringSetBitBiDirectionalIterator Roaring::begin() const {
     return RoaringSetBitBiDirectionalIterator(*this);
 }
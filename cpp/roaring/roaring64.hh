@@ -11,9 +11,12 @@
 #include <cstdarg>
 #include <cstddef>
 #include <cstdint>
+#include <cstdio>
 #include <initializer_list>
 #include <iterator>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include <roaring/roaring64.h>
 
@@ -21,6 +24,29 @@
 
 namespace roaring {
 
+class Roaring64;
+
+/**
+ * A bit of context usable with the `*Bulk()` functions of Roaring64.
+ *
+ * A context may only be used with a single bitmap, and any modification to a
+ * bitmap (other than modifications performed with `Bulk()` functions with the
+ * context passed) will invalidate any contexts associated with that bitmap.
+ */
+class Roaring64BulkContext {
+   public:
+    friend class Roaring64;
+    Roaring64BulkContext() : context_{{0, 0, 0, 0, 0, 0}, nullptr} {}
+
+    Roaring64BulkContext(const Roaring64BulkContext&) = delete;
+    Roaring64BulkContext& operator=(const Roaring64BulkContext&) = delete;
+    Roaring64BulkContext(Roaring64BulkContext&&) noexcept = default;
+    Roaring64BulkContext& operator=(Roaring64BulkContext&&) noexcept = default;
+
+   private:
+    api::roaring64_bulk_context_t context_;
+};
+
 /**
  * Const bidirectional iterator over a Roaring64.
  */
@@ -115,6 +141,53 @@ class Roaring64ConstIterator {
         return orig;
     }
 
+    /**
+     * Move the iterator to the first value >= val, searching forward from the
+     * current position. Return true if there is such a value.
+     */
+    bool move_equalorlarger(uint64_t val) {
+        if (it == nullptr) {
+            it = api::roaring64_iterator_create(parent);
+        }
+        return api::roaring64_iterator_move_equalorlarger(it, val);
+    }
+
+    /**
+     * Reads up to `count` values, starting at the current one, into `buf` and
+     * moves past them. Returns the number of values read, which is smaller
+     * than `count` only when the end is reached.
+     */
+    uint64_t read(uint64_t* buf, uint64_t count) {
+        if (it == nullptr) {
+            return 0;
+        }
+        return api::roaring64_iterator_read(it, buf, count);
+    }
+
+    /**
+     * Reads up to ${count} ranges into ${buf}. Returns the number of ranges
+     * read. See roaring64_iterator_read_ranges for full semantics.
+     */
+    size_t read_ranges(api::roaring64_range_closed_t* buf, size_t count) {
+        if (it == nullptr) {
+            return 0;
+        }
+        return api::roaring64_iterator_read_ranges(it, buf, count);
+    }
+
+    /**
+     * Reads up to ${count} ranges in reverse into ${buf}. Returns the number
+     * of ranges read. See roaring64_iterator_read_prev_ranges for full
+     * semantics.
+     */
+    size_t read_prev_ranges(api::roaring64_range_closed_t* buf,
+                            size_t count) {
+        if (it == nullptr) {
+            return 0;
+        }
+        return api::roaring64_iterator_read_prev_ranges(it, buf, count);
+    }
+
     bool operator==(const Roaring64ConstIterator& o) const {
         bool a = atEnd();
         bool b = o.atEnd();
@@ -173,6 +246,22 @@ class Roaring64 {
      */
     explicit Roaring64(roaring64_bitmap_t* s) noexcept : roaring(s) {}
 
+    /**
+     * Construct a 64-bit bitmap holding the values of a 32-bit one.
+     */
+    explicit Roaring64(const Roaring& r) {
+        api::roaring_bitmap_t* copy = api::roaring_bitmap_copy(&r.roaring);
+        if (copy == nullptr) {
+            ROARING_TERMINATE("failed roaring_bitmap_copy in constructor");
+        }
+        roaring = api::roaring64_bitmap_move_from_roaring32(copy);
+        api::roaring_bitmap_free(copy);
+        if (roaring == nullptr) {
+            ROARING_TERMINATE(
+                "failed roaring64_bitmap_move_from_roaring32 in constructor");
+        }
+    }
+
     /**
      * Copy constructor.
      */
@@ -257,6 +346,29 @@ class Roaring64 {
      */
     void add(uint64_t x) noexcept { api::roaring64_bitmap_add(roaring, x); }
 
+    /**
+     * Adds value x.
+     * Returns true if a new value was added, false if the value was already
+     * present.
+     */
+    bool addChecked(uint64_t x) noexcept {
+        return api::roaring64_bitmap_add_checked(roaring, x);
+    }
+
+    /**
+     * Adds all values in the half-open interval [min, max).
+     */
+    void addRange(uint64_t min, uint64_t max) noexcept {
+        api::roaring64_bitmap_add_range(roaring, min, max);
+    }
+
+    /**
+     * Adds all values in the closed interval [min, max].
+     */
+    void addRangeClosed(uint64_t min, uint64_t max) noexcept {
+        api::roaring64_bitmap_add_range_closed(roaring, min, max);
+    }
+
     /**
      * Adds 'n_args' values from the contiguous memory range starting at 'vals'.
      */
@@ -264,6 +376,32 @@ class Roaring64 {
         api::roaring64_bitmap_add_many(roaring, n_args, vals);
     }
 
+    /**
+     * Add value x, using context from a previous insert for speed
+     * optimization.
+     *
+     * `context` will be used to store information between calls to make bulk
+     * operations faster. `context` should be default-initialized before the
+     * first call to this function.
+     */
+    void addBulk(Roaring64BulkContext& context, uint64_t x) noexcept {
+        api::roaring64_bitmap_add_bulk(roaring, &context.context_, x);
+    }
+
+    /**
+     * Check if item x is present, using context from a previous insert or
+     * search for speed optimization.
+     *
+     * `context` will be used to store information between calls to make bulk
+     * operations faster. `context` should be default-initialized before the
+     * first call to this function.
+     */
+    bool containsBulk(Roaring64BulkContext& context,
+                      uint64_t x) const noexcept {
+        return api::roaring64_bitmap_contains_bulk(roaring, &context.context_,
+                                                   x);
+    }
+
     /**
      * Removes value x.
      */
@@ -271,6 +409,44 @@ class Roaring64 {
         api::roaring64_bitmap_remove(roaring, x);
     }
 
+    /**
+     * Removes value x.
+     * Returns true if a value was removed, false if the value was not present.
+     */
+    bool removeChecked(uint64_t x) noexcept {
+        return api::roaring64_bitmap_remove_checked(roaring, x);
+    }
+
+    /**
+     * Removes 'n_args' values from the contiguous memory range starting at
+     * 'vals'.
+     */
+    void removeMany(size_t n_args, const uint64_t* vals) noexcept {
+        api::roaring64_bitmap_remove_many(roaring, n_args, vals);
+    }
+
+    /**
+     * Remove value x, using context from a previous remove for speed
+     * optimization. See addBulk().
+     */
+    void removeBulk(Roaring64BulkContext& context, uint64_t x) noexcept {
+        api::roaring64_bitmap_remove_bulk(roaring, &context.context_, x);
+    }
+
+    /**
+     * Removes all values in the half-open interval [min, max).
+     */
+    void removeRange(uint64_t min, uint64_t max) noexcept {
+        api::roaring64_bitmap_remove_range(roaring, min, max);
+    }
+
+    /**
+     * Removes all values in the closed interval [min, max].
+     */
+    void removeRangeClosed(uint64_t min, uint64_t max) noexcept {
+        api::roaring64_bitmap_remove_range_closed(roaring, min, max);
+    }
+
     /**
      * Clears the bitmap.
      */
@@ -297,6 +473,177 @@ class Roaring64 {
         return api::roaring64_bitmap_contains(roaring, x);
     }
 
+    /**
+     * Check if all values in the half-open interval [min, max) are present.
+     */
+    bool containsRange(uint64_t min, uint64_t max) const noexcept {
+        return api::roaring64_bitmap_contains_range(roaring, min, max);
+    }
+
+    /**
+     * Check if all values in the closed interval [min, max] are present.
+     */
+    bool containsRangeClosed(uint64_t min, uint64_t max) const noexcept {
+        return api::roaring64_bitmap_contains_range_closed(roaring, min, max);
+    }
+
+    /**
+     * Selects the value at index rank in the bitmap, where the smallest value
+     * is at index 0. If 'rank' < cardinality(), returns true with 'element'
+     * set to the element of the specified rank. Otherwise, returns false and
+     * the contents of 'element' are unspecified.
+     */
+    bool select(uint64_t rank, uint64_t* element) const noexcept {
+        return api::roaring64_bitmap_select(roaring, rank, element);
+    }
+
+    /**
+     * Returns the number of integers that are smaller or equal to x.
+     */
+    uint64_t rank(uint64_t x) const noexcept {
+        return api::roaring64_bitmap_rank(roaring, x);
+    }
+
+    /**
+     * Returns the index of x in the set, index start from 0.
+     * If the set doesn't contain x, this function will return -1.
+     * The difference with rank function is that this function will return -1
+     * when x isn't in the set, but the rank function will return a
+     * non-negative number.
+     */
+    int64_t getIndex(uint64_t x) const noexcept {
+        uint64_t index;
+        if (!api::roaring64_bitmap_get_index(roaring, x, &index)) {
+            return -1;
+        }
+        return int64_t(index);
+    }
+
+    /**
+     * Returns the number of values in the half-open interval [min, max).
+     */
+    uint64_t rangeCardinality(uint64_t min, uint64_t max) const noexcept {
+        return api::roaring64_bitmap_range_cardinality(roaring, min, max);
+    }
+
+    /**
+     * Computes the negation of the bitmap within the half-open interval
+     * [min, max). Areas outside the interval are unchanged.
+     */
+    void flip(uint64_t min, uint64_t max) noexcept {
+        api::roaring64_bitmap_flip_inplace(roaring, min, max);
+    }
+
+    /**
+     * Computes the negation of the bitmap within the closed interval
+     * [min, max]. Areas outside the interval are unchanged.
+     */
+    void flipClosed(uint64_t min, uint64_t max) noexcept {
+        api::roaring64_bitmap_flip_closed_inplace(roaring, min, max);
+    }
+
+    /**
+     * Remove run-length encoding even when it is more space efficient.
+     * Return whether a change was applied.
+     */
+    bool removeRunCompression() noexcept {
+        return api::roaring64_bitmap_remove_run_compression(roaring);
+    }
+
+    /**
+     * Convert array and bitmap containers to run containers when it is more
+     * efficient; also convert from run containers when more space efficient.
+     * Returns true if the result has at least one run container.
+     * Additional savings might be possible by calling shrinkToFit().
+     */
+    bool runOptimize() noexcept {
+        return api::roaring64_bitmap_run_optimize(roaring);
+    }
+
+    /**
+     * If needed, reallocate memory to shrink the memory usage. Returns
+     * the number of bytes saved.
+     */
+    size_t shrinkToFit() noexcept {
+        return api::roaring64_bitmap_shrink_to_fit(roaring);
+    }
+
+    /**
+     * Enable or disable the hot leaf cache of point operations, see
+     * roaring64_bitmap_set_leaf_cache(). Off by default; a bitmap with the
+     * cache on must not be read from several threads at once.
+     */
+    void setLeafCache(bool enabled) noexcept {
+        api::roaring64_bitmap_set_leaf_cache(roaring, enabled);
+    }
+
+    /**
+     * Whether the hot leaf cache is enabled.
+     */
+    bool getLeafCache() const noexcept {
+        return api::roaring64_bitmap_get_leaf_cache(roaring);
+    }
+
+    /**
+     * Returns true if the bitmap is subset of the other.
+     */
+    bool isSubset(const Roaring64& r) const noexcept {
+        return api::roaring64_bitmap_is_subset(roaring, r.roaring);
+    }
+
+    /**
+     * Returns true if the bitmap is strict subset of the other.
+     */
+    bool isStrictSubset(const Roaring64& r) const noexcept {
+        return api::roaring64_bitmap_is_strict_subset(roaring, r.roaring);
+    }
+
+    /**
+     * Computes the size of the intersection between two bitmaps.
+     */
+    uint64_t and_cardinality(const Roaring64& r) const noexcept {
+        return api::roaring64_bitmap_and_cardinality(roaring, r.roaring);
+    }
+
+    /**
+     * Check whether the two bitmaps intersect.
+     */
+    bool intersect(const Roaring64& r) const noexcept {
+        return api::roaring64_bitmap_intersect(roaring, r.roaring);
+    }
+
+    /**
+     * Computes the Jaccard index between two bitmaps. (Also known as the
+     * Tanimoto distance, or the Jaccard similarity coefficient)
+     *
+     * The Jaccard index is undefined if both bitmaps are empty.
+     */
+    double jaccard_index(const Roaring64& r) const noexcept {
+        return api::roaring64_bitmap_jaccard_index(roaring, r.roaring);
+    }
+
+    /**
+     * Computes the size of the union between two bitmaps.
+     */
+    uint64_t or_cardinality(const Roaring64& r) const noexcept {
+        return api::roaring64_bitmap_or_cardinality(roaring, r.roaring);
+    }
+
+    /**
+     * Computes the size of the difference (andnot) between two bitmaps.
+     */
+    uint64_t andnot_cardinality(const Roaring64& r) const noexcept {
+        return api::roaring64_bitmap_andnot_cardinality(roaring, r.roaring);
+    }
+
+    /**
+     * Computes the size of the symmetric difference (xor) between two
+     * bitmaps.
+     */
+    uint64_t xor_cardinality(const Roaring64& r) const noexcept {
+        return api::roaring64_bitmap_xor_cardinality(roaring, r.roaring);
+    }
+
     /**
      * Compute the intersection of the current bitmap and the provided bitmap,
      * writing the result in the current bitmap. The provided bitmap is not
@@ -310,10 +657,14 @@ class Roaring64 {
     /**
      * Compute the difference between the current bitmap and the provided
      * bitmap, writing the result in the current bitmap. The provided bitmap is
-     * not modified. Behavior is undefined if &r == this.
+     * not modified.
      */
     Roaring64& operator-=(const Roaring64& r) noexcept {
-        api::roaring64_bitmap_andnot_inplace(roaring, r.roaring);
+        if (&r == this) {
+            clear();
+        } else {
+            api::roaring64_bitmap_andnot_inplace(roaring, r.roaring);
+        }
         return *this;
     }
 
@@ -329,10 +680,13 @@ class Roaring64 {
     /**
      * Compute the XOR of the current bitmap and the provided bitmap, writing
      * the result in the current bitmap. The provided bitmap is not modified.
-     * Behavior is undefined if &r == this.
      */
     Roaring64& operator^=(const Roaring64& r) noexcept {
-        api::roaring64_bitmap_xor_inplace(roaring, r.roaring);
+        if (&r == this) {
+            clear();
+        } else {
+            api::roaring64_bitmap_xor_inplace(roaring, r.roaring);
+        }
         return *this;
     }
 
@@ -362,6 +716,11 @@ class Roaring64 {
         return api::roaring64_bitmap_equals(roaring, r.roaring);
     }
 
+    /**
+     * Return true if the two bitmaps do not contain the same elements.
+     */
+    bool operator!=(const Roaring64& r) const noexcept { return !(*this == r); }
+
     /**
      * Computes the intersection between two bitmaps and returns new bitmap.
      * The current bitmap and the provided bitmap are unchanged.
@@ -414,7 +773,140 @@ class Roaring64 {
         return Roaring64(result);
     }
 
+    /**
+     * Computes the logical or (union) between "n" bitmaps (referenced by a
+     * pointer).
+     * This function may throw std::runtime_error.
+     */
+    static Roaring64 fastunion(size_t n, const Roaring64** inputs) {
+        return many(n, inputs, api::roaring64_bitmap_or_many,
+                    "failed memory alloc in fastunion");
+    }
+
+    /**
+     * Computes the intersection of "n" bitmaps (referenced by a pointer).
+     * This function may throw std::runtime_error.
+     */
+    static Roaring64 fastintersection(size_t n, const Roaring64** inputs) {
+        return many(n, inputs, api::roaring64_bitmap_and_many,
+                    "failed memory alloc in fastintersection");
+    }
+
+    /**
+     * Computes the symmetric difference (xor) of "n" bitmaps (referenced by a
+     * pointer).
+     * This function may throw std::runtime_error.
+     */
+    static Roaring64 fastxor(size_t n, const Roaring64** inputs) {
+        return many(n, inputs, api::roaring64_bitmap_xor_many,
+                    "failed memory alloc in fastxor");
+    }
+
+    /**
+     * Write the bitmap to an output pointer in the portable format, which is
+     * meant to be compatible with the Java and Go versions. The buffer must
+     * hold at least getSizeInBytes() bytes. Returns how many bytes were
+     * written.
+     */
+    size_t write(char* buf) const noexcept {
+        return api::roaring64_bitmap_portable_serialize(roaring, buf);
+    }
+
+    /**
+     * How many bytes are required to serialize this bitmap with write().
+     */
+    size_t getSizeInBytes() const noexcept {
+        return api::roaring64_bitmap_portable_size_in_bytes(roaring);
+    }
+
+    /**
+     * Read a bitmap written by write(), reading no more than maxbytes bytes.
+     * The function is safe against buffer overflows, but the bitmap read is
+     * only meaningful if the input was serialized from a valid bitmap, see
+     * roaring64_bitmap_portable_deserialize_safe().
+     *
+     * The function may throw std::runtime_error if a bitmap could not be read.
+     */
+    static Roaring64 readSafe(const char* buf, size_t maxbytes) {
+        roaring64_bitmap_t* r =
+            api::roaring64_bitmap_portable_deserialize_safe(buf, maxbytes);
+        if (r == nullptr) {
+            ROARING_TERMINATE("failed alloc while reading");
+        }
+        return Roaring64(r);
+    }
+
+    /**
+     * Compute how many bytes would be read by readSafe. Returns 0 if the
+     * serialized data is invalid.
+     */
+    static size_t serializedSizeInBytesSafe(const char* buf, size_t maxbytes) {
+        return api::roaring64_bitmap_portable_deserialize_size(buf, maxbytes);
+    }
+
+    /**
+     * For advanced users. Writes the bitmap in the frozen format, see
+     * roaring64_bitmap_frozen_serialize(). shrinkToFit() must be called
+     * first, and the buffer must hold getFrozenSizeInBytes() bytes. Returns
+     * how many bytes were written.
+     */
+    size_t writeFrozen(char* buf) const noexcept {
+        return api::roaring64_bitmap_frozen_serialize(roaring, buf);
+    }
+
+    /**
+     * For advanced users. How many bytes are required by writeFrozen().
+     */
+    size_t getFrozenSizeInBytes() const noexcept {
+        return api::roaring64_bitmap_frozen_size_in_bytes(roaring);
+    }
+
+    /**
+     * For advanced users. Creates a read-only view of a buffer written by
+     * writeFrozen(), which must be 64-byte aligned and outlive the returned
+     * bitmap. The view must not be modified.
+     * This function may throw std::runtime_error.
+     */
+    static const Roaring64 frozenView(const char* buf, size_t length) {
+        roaring64_bitmap_t* r = api::roaring64_bitmap_frozen_view(buf, length);
+        if (r == nullptr) {
+            ROARING_TERMINATE("failed to read frozen bitmap");
+        }
+        return Roaring64(r);
+    }
+
+    /**
+     * Iterate over the bitmap elements in order, calling iterator(value, ptr)
+     * for each of them until it returns false. Returns true if every value
+     * was visited.
+     */
+    bool iterate(api::roaring_iterator64 iterator, void* ptr) const {
+        return api::roaring64_bitmap_iterate(roaring, iterator, ptr);
+    }
+
+    /**
+     * Print the content of the bitmap.
+     */
+    void printf() const { std::printf("%s\n", toString().c_str()); }
+
+    /**
+     * Print the content of the bitmap into a string.
+     */
+    std::string toString() const {
+        std::string result;
+        iterate(
+            [](uint64_t value, void* param) -> bool {
+                std::string* out = (std::string*)param;
+                *out += out->empty() ? "{" : ",";
+                *out += std::to_string(value);
+                return true;
+            },
+            &result);
+        return result.empty() ? "{}" : result + "}";
+    }
+
     typedef Roaring64ConstIterator const_iterator;
+    typedef Roaring64ConstIterator const_bidirectional_iterator;
 
     /**
      * Return an iterator over the bitmap values, ordered from smallest to
@@ -436,9 +928,70 @@ class Roaring64 {
     }
 
    private:
+    friend class Roaring64Appender;
+
+    template <typename ManyOp>
+    static Roaring64 many(size_t n, const Roaring64** inputs, ManyOp op,
+                          const char* error) {
+        std::vector<const roaring64_bitmap_t*> bitmaps(n);
+        for (size_t i = 0; i < n; ++i) {
+            bitmaps[i] = inputs[i]->roaring;
+        }
+        roaring64_bitmap_t* result = op(n, bitmaps.data());
+        if (result == nullptr) {
+            ROARING_TERMINATE(error);
+        }
+        return Roaring64(result);
+    }
+
     roaring64_bitmap_t* roaring;
 };
 
+/**
+ * Adds strictly increasing values to a Roaring64 faster than
+ * `Roaring64::add()`, see `roaring64_bitmap_appender_t`. The values are
+ * flushed to the bitmap by `flush()` and on destruction; the bitmap must not
+ * otherwise be modified while the appender holds values.
+ */
+class Roaring64Appender {
+   public:
+    explicit Roaring64Appender(Roaring64& r)
+        : appender(api::roaring64_bitmap_appender_create(r.roaring)) {
+        if (appender == nullptr) {
+            ROARING_TERMINATE(
+                "failed memory alloc in roaring64_bitmap_appender_create");
+        }
+    }
+
+    Roaring64Appender(const Roaring64Appender&) = delete;
+    Roaring64Appender& operator=(const Roaring64Appender&) = delete;
+
+    ~Roaring64Appender() { api::roaring64_bitmap_appender_free(appender); }
+
+    /**
+     * Add value x, ideally larger than any value added before.
+     */
+    void add(uint64_t x) {
+        if (!api::roaring64_bitmap_appender_add(appender, x)) {
+            ROARING_TERMINATE(
+                "failed memory alloc in roaring64_bitmap_appender_add");
+        }
+    }
+
+    /**
+     * Move the values added so far into the bitmap.
+     */
+    void flush() {
+        if (!api::roaring64_bitmap_appender_flush(appender)) {
+            ROARING_TERMINATE(
+                "failed memory alloc in roaring64_bitmap_appender_flush");
+        }
+    }
+
+   private:
+    api::roaring64_bitmap_appender_t* appender;
+};
+
 }  // namespace roaring
 
 #endif  // INCLUDE_ROARING_ROARING64_HH_
@@ -24,7 +24,10 @@
 #include <queue>
 #include <stdexcept>
 #include <string>
+#include <tuple>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "roaring.hh"
 
@@ -32,86 +35,280 @@ namespace roaring {
 
 using roaring::Roaring;
 
-class Roaring64MapSetBitBiDirectionalIterator;
+namespace internal {
+
+/**
+ * Minimal ordered map kept as a single sorted std::vector of (key, value)
+ * pairs. It implements the subset of the std::map interface used by
+ * BasicRoaring64Map, so it can be plugged in as its outer storage: lookups
+ * are binary searches over contiguous memory and iteration is a linear scan,
+ * at the price of O(n) insertion and erasure in the middle of the sequence.
+ *
+ * Unlike std::map, the iterators and references are invalidated by any
+ * insertion or erasure.
+ */
+template <typename Key, typename T>
+class SortedVectorMap {
+   public:
+    typedef Key key_type;
+    typedef T mapped_type;
+    typedef std::pair<Key, T> value_type;
+    typedef std::vector<value_type> container_type;
+    typedef typename container_type::size_type size_type;
+    typedef typename container_type::iterator iterator;
+    typedef typename container_type::const_iterator const_iterator;
+    typedef typename container_type::reverse_iterator reverse_iterator;
+    typedef typename container_type::const_reverse_iterator
+        const_reverse_iterator;
+
+    iterator begin() noexcept { return entries.begin(); }
+    const_iterator begin() const noexcept { return entries.begin(); }
+    const_iterator cbegin() const noexcept { return entries.cbegin(); }
+    iterator end() noexcept { return entries.end(); }
+    const_iterator end() const noexcept { return entries.end(); }
+    const_iterator cend() const noexcept { return entries.cend(); }
+    reverse_iterator rbegin() noexcept { return entries.rbegin(); }
+    const_reverse_iterator crbegin() const noexcept {
+        return entries.crbegin();
+    }
+    reverse_iterator rend() noexcept { return entries.rend(); }
+    const_reverse_iterator crend() const noexcept { return entries.crend(); }
+
+    bool empty() const noexcept { return entries.empty(); }
+    size_type size() const noexcept { return entries.size(); }
+    void clear() noexcept { entries.clear(); }
+    void reserve(size_type n) { entries.reserve(n); }
+    void swap(SortedVectorMap &other) noexcept { entries.swap(other.entries); }
+
+    iterator lower_bound(const Key &key) {
+        return std::lower_bound(entries.begin(), entries.end(), key,
+                                KeyLess());
+    }
+    const_iterator lower_bound(const Key &key) const {
+        return std::lower_bound(entries.begin(), entries.end(), key,
+                                KeyLess());
+    }
+
+    iterator find(const Key &key) {
+        auto iter = lower_bound(key);
+        return iter != entries.end() && iter->first == key ? iter
+                                                           : entries.end();
+    }
+    const_iterator find(const Key &key) const {
+        auto iter = lower_bound(key);
+        return iter != entries.end() && iter->first == key ? iter
+                                                           : entries.end();
+    }
+
+    T &operator[](const Key &key) {
+        auto iter = lower_bound(key);
+        if (iter == entries.end() || iter->first != key) {
+            iter = entries.emplace(iter, std::piecewise_construct,
+                                   std::forward_as_tuple(key),
+                                   std::forward_as_tuple());
+        }
+        return iter->second;
+    }
+
+    /**
+     * As with std::map, an existing entry with the same key is left
+     * untouched and the returned flag is false.
+     */
+    std::pair<iterator, bool> insert(const value_type &value) {
+        auto position = lower_bound(value.first);
+        if (position != entries.end() && position->first == value.first) {
+            return std::make_pair(position, false);
+        }
+        return std::make_pair(entries.insert(position, value), true);
+    }
+    std::pair<iterator, bool> insert(value_type &&value) {
+        auto position = lower_bound(value.first);
+        return insertAt(position, std::move(value));
+    }
+    iterator insert(const_iterator hint, const value_type &value) {
+        return emplace_hint(hint, value);
+    }
+    iterator insert(const_iterator hint, value_type &&value) {
+        return emplace_hint(hint, std::move(value));
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args &&...args) {
+        value_type value(std::forward<Args>(args)...);
+        auto position = lower_bound(value.first);
+        return insertAt(position, std::move(value));
+    }
+
+    /**
+     * Inserts at 'hint' when it is the right position, which makes appending
+     * keys in increasing order amortized O(1); otherwise falls back to a
+     * binary search.
+     */
+    template <typename... Args>
+    iterator emplace_hint(const_iterator hint, Args &&...args) {
+        value_type value(std::forward<Args>(args)...);
+        auto position = entries.begin() + (hint - entries.cbegin());
+        if ((position != entries.begin() &&
+             !(std::prev(position)->first < value.first)) ||
+            (position != entries.end() &&
+             !(value.first < position->first))) {
+            position = lower_bound(value.first);
+        }
+        return insertAt(position, std::move(value)).first;
+    }
+
+    iterator erase(const_iterator position) { return entries.erase(position); }
+    iterator erase(const_iterator first, const_iterator last) {
+        return entries.erase(first, last);
+    }
+
+   private:
+    struct KeyLess {
+        bool operator()(const value_type &entry, const Key &key) const {
+            return entry.first < key;
+        }
+    };
+
+    std::pair<iterator, bool> insertAt(iterator position, value_type &&value) {
+        if (position != entries.end() && position->first == value.first) {
+            return std::make_pair(position, false);
+        }
+        return std::make_pair(entries.insert(position, std::move(value)),
+                              true);
+    }
+
+    container_type entries;
+};
+
+template <typename Storage>
+struct IsSortedVectorMap : std::false_type {};
+
+template <typename Key, typename T>
+struct IsSortedVectorMap<SortedVectorMap<Key, T>> : std::true_type {};
+
+}  // namespace internal
+
+template <typename Storage>
+class BasicRoaring64Map;
+
+template <typename Storage>
+class BasicRoaring64MapSetBitBiDirectionalIterator;
+
+/**
+ * The 64-bit bitmap, keeping its 32-bit Roaring bitmaps in a std::map keyed
+ * by the high 32 bits.
+ */
+typedef BasicRoaring64Map<std::map<uint32_t, Roaring>> Roaring64Map;
+
+/**
+ * Same interface as Roaring64Map, but the 32-bit bitmaps are kept in one
+ * sorted vector. It avoids a heap allocation per high 32-bit word, and
+ * searching, iterating and combining the outer keys walks contiguous memory
+ * (set operations merge both key sequences in one pass). Adding a value with
+ * a new high word in the middle of the map is O(number of high words), so it
+ * suits bitmaps that are built in order or read much more than updated.
+ */
+typedef BasicRoaring64Map<internal::SortedVectorMap<uint32_t, Roaring>>
+    Roaring64FlatMap;
+
+typedef BasicRoaring64MapSetBitBiDirectionalIterator<
+    std::map<uint32_t, Roaring>>
+    Roaring64MapSetBitBiDirectionalIterator;
 
 // For backwards compatibility; there used to be two kinds of iterators
 // (forward and bidirectional) and now there's only one.
 typedef Roaring64MapSetBitBiDirectionalIterator
     Roaring64MapSetBitForwardIterator;
 
-class Roaring64Map {
+template <typename Storage>
+class BasicRoaring64Map {
     typedef api::roaring_bitmap_t roaring_bitmap_t;
 
    public:
     /**
      * Create an empty bitmap
      */
-    Roaring64Map() = default;
+    BasicRoaring64Map() = default;
 
     /**
      * Construct a bitmap from a list of 32-bit integer values.
      */
-    Roaring64Map(size_t n, const uint32_t *data) { addMany(n, data); }
+    BasicRoaring64Map(size_t n, const uint32_t *data) { addMany(n, data); }
 
     /**
      * Construct a bitmap from a list of 64-bit integer values.
      */
-    Roaring64Map(size_t n, const uint64_t *data) { addMany(n, data); }
+    BasicRoaring64Map(size_t n, const uint64_t *data) { addMany(n, data); }
 
     /**
      * Construct a bitmap from an initializer list.
      */
-    Roaring64Map(std::initializer_list<uint64_t> l) {
+    BasicRoaring64Map(std::initializer_list<uint64_t> l) {
         addMany(l.size(), l.begin());
     }
 
     /**
      * Construct a 64-bit map from a 32-bit one
      */
-    explicit Roaring64Map(const Roaring &r) { emplaceOrInsert(0, r); }
+    explicit BasicRoaring64Map(const Roaring &r) { emplaceOrInsert(0, r); }
 
     /**
      * Construct a 64-bit map from a 32-bit rvalue
      */
-    explicit Roaring64Map(Roaring &&r) { emplaceOrInsert(0, std::move(r)); }
+    explicit BasicRoaring64Map(Roaring &&r) {
+        emplaceOrInsert(0, std::move(r));
+    }
 
     /**
      * Construct a roaring object from the C struct.
      *
      * Passing a NULL point is unsafe.
      */
-    explicit Roaring64Map(roaring_bitmap_t *s) {
+    explicit BasicRoaring64Map(roaring_bitmap_t *s) {
         emplaceOrInsert(0, Roaring(s));
     }
 
-    Roaring64Map(const Roaring64Map &r) = default;
+    BasicRoaring64Map(const BasicRoaring64Map &r) = default;
+
+    BasicRoaring64Map(BasicRoaring64Map &&r) noexcept = default;
 
-    Roaring64Map(Roaring64Map &&r) noexcept = default;
+    /**
+     * Construct a copy of a 64-bit bitmap that uses another storage, e.g. a
+     * Roaring64FlatMap from a Roaring64Map.
+     */
+    template <typename OtherStorage>
+    explicit BasicRoaring64Map(const BasicRoaring64Map<OtherStorage> &r)
+        : copyOnWrite(r.copyOnWrite) {
+        for (const auto &map_entry : r.roarings) {
+            roarings.emplace_hint(roarings.end(), map_entry.first,
+                                  map_entry.second);
+        }
+    }
 
     /**
      * Copy assignment operator.
      */
-    Roaring64Map &operator=(const Roaring64Map &r) = default;
+    BasicRoaring64Map &operator=(const BasicRoaring64Map &r) = default;
 
     /**
      * Move assignment operator.
      */
-    Roaring64Map &operator=(Roaring64Map &&r) noexcept = default;
+    BasicRoaring64Map &operator=(BasicRoaring64Map &&r) noexcept = default;
 
     /**
      * Assignment from an initializer list.
      */
-    Roaring64Map &operator=(std::initializer_list<uint64_t> l) {
+    BasicRoaring64Map &operator=(std::initializer_list<uint64_t> l) {
         // Delegate to move assignment operator
-        *this = Roaring64Map(l);
+        *this = BasicRoaring64Map(l);
         return *this;
     }
 
     /**
      * Construct a bitmap from a list of uint64_t values.
      */
-    static Roaring64Map bitmapOf(size_t n...) {
-        Roaring64Map ans;
+    static BasicRoaring64Map bitmapOf(size_t n...) {
+        BasicRoaring64Map ans;
         va_list vl;
         va_start(vl, n);
         for (size_t i = 0; i < n; i++) {
@@ -125,8 +322,8 @@ class Roaring64Map {
      * Construct a bitmap from a list of uint64_t values.
      * E.g., bitmapOfList({1,2,3}).
      */
-    static Roaring64Map bitmapOfList(std::initializer_list<uint64_t> l) {
-        Roaring64Map ans;
+    static BasicRoaring64Map bitmapOfList(std::initializer_list<uint64_t> l) {
+        BasicRoaring64Map ans;
         ans.addMany(l.size(), l.begin());
         return ans;
     }
@@ -388,9 +585,6 @@ class Roaring64Map {
         // iterator will not be equal to end()) because start_high <= the last
         // key in the map (thanks to the above if statement).
         auto start_iter = roarings.lower_bound(start_high);
-        // end_iter points to the first entry in the outer map with
-        // key >= end_high, if such a key exists. Otherwise, it equals end().
-        auto end_iter = roarings.lower_bound(end_high);
 
         // Note that the 'lower_bound' method will find the start and end slots,
         // if they exist; otherwise it will find the next-higher slots.
@@ -414,7 +608,7 @@ class Roaring64Map {
         if (start_iter->first == start_high) {
             auto &start_inner = start_iter->second;
             // 1a. if the end point falls on that same entry...
-            if (start_iter == end_iter) {
+            if (start_high == end_high) {
                 start_inner.removeRangeClosed(start_low, end_low);
                 eraseIfEmpty(start_iter);
                 return;
@@ -422,14 +616,18 @@ class Roaring64Map {
 
             // 1b. Otherwise, remove the closed range [start_low, uint32_max]...
             start_inner.removeRangeClosed(start_low, uint32_max);
-            // Advance start_iter, but keep the old value so we can check the
-            // bitmap we just modified for emptiness and erase if it necessary.
-            auto temp = start_iter++;
-            eraseIfEmpty(temp);
+            // Erase the bitmap we just modified if it became empty, and
+            // advance start_iter.
+            start_iter = eraseIfEmpty(start_iter);
         }
 
-        // 2. Completely erase all slots in the half-open interval...
-        roarings.erase(start_iter, end_iter);
+        // 2. Completely erase all slots in the half-open interval
+        // [start_iter, end_iter), where end_iter points to the first entry in
+        // the outer map with key >= end_high, if such a key exists. Otherwise,
+        // it equals end(). It is looked up only now because the erasure in
+        // step 1b invalidates the iterators of a sorted vector storage.
+        auto end_iter =
+            roarings.erase(start_iter, roarings.lower_bound(end_high));
 
         // 3. If the end point falls on an existing entry...
         if (end_iter != roarings.end() && end_iter->first == end_high) {
@@ -579,7 +777,7 @@ class Roaring64Map {
      * Performance hint: if you are computing the intersection between several
      * bitmaps, two-by-two, it is best to start with the smallest bitmap.
      */
-    Roaring64Map &operator&=(const Roaring64Map &other) {
+    BasicRoaring64Map &operator&=(const BasicRoaring64Map &other) {
         if (this == &other) {
             // ANDing *this with itself is a no-op.
             return *this;
@@ -599,6 +797,14 @@ class Roaring64Map {
         // Because there is only work to do when a key is present in 'self', the
         // main for loop iterates over entries in 'self'.
 
+        if (sortedVectorStorage()) {
+            mergeSorted(other, false, false,
+                        [](Roaring &self_bitmap, const Roaring &other_bitmap) {
+                            self_bitmap &= other_bitmap;
+                        });
+            return *this;
+        }
+
         decltype(roarings.begin()) self_next;
         for (auto self_iter = roarings.begin(); self_iter != roarings.end();
              self_iter = self_next) {
@@ -636,7 +842,7 @@ class Roaring64Map {
      * bitmap, writing the result in the current bitmap. The provided bitmap
      * is not modified.
      */
-    Roaring64Map &operator-=(const Roaring64Map &other) {
+    BasicRoaring64Map &operator-=(const BasicRoaring64Map &other) {
         if (this == &other) {
             // Subtracting *this from itself results in the empty map.
             roarings.clear();
@@ -658,6 +864,14 @@ class Roaring64Map {
         // and 'other', the main while loop ping-pongs back and forth until it
         // finds the next key that is the same on both sides.
 
+        if (sortedVectorStorage()) {
+            mergeSorted(other, true, false,
+                        [](Roaring &self_bitmap, const Roaring &other_bitmap) {
+                            self_bitmap -= other_bitmap;
+                        });
+            return *this;
+        }
+
         auto self_iter = roarings.begin();
         auto other_iter = other.roarings.cbegin();
 
@@ -704,7 +918,7 @@ class Roaring64Map {
      *
      * See also the fastunion function to aggregate many bitmaps more quickly.
      */
-    Roaring64Map &operator|=(const Roaring64Map &other) {
+    BasicRoaring64Map &operator|=(const BasicRoaring64Map &other) {
         if (this == &other) {
             // ORing *this with itself is a no-op.
             return *this;
@@ -723,6 +937,14 @@ class Roaring64Map {
         // Because there is only work to do when a key is present in 'other',
         // the main for loop iterates over entries in 'other'.
 
+        if (sortedVectorStorage()) {
+            mergeSorted(other, true, true,
+                        [](Roaring &self_bitmap, const Roaring &other_bitmap) {
+                            self_bitmap |= other_bitmap;
+                        });
+            return *this;
+        }
+
         for (const auto &other_entry : other.roarings) {
             const auto &other_bitmap = other_entry.second;
 
@@ -756,7 +978,7 @@ class Roaring64Map {
      * Compute the XOR of the current bitmap and the provided bitmap, writing
      * the result in the current bitmap. The provided bitmap is not modified.
      */
-    Roaring64Map &operator^=(const Roaring64Map &other) {
+    BasicRoaring64Map &operator^=(const BasicRoaring64Map &other) {
         if (this == &other) {
             // XORing *this with itself results in the empty map.
             roarings.clear();
@@ -777,6 +999,14 @@ class Roaring64Map {
         // Because there is only work to do when a key is present in 'other',
         // the main for loop iterates over entries in 'other'.
 
+        if (sortedVectorStorage()) {
+            mergeSorted(other, true, true,
+                        [](Roaring &self_bitmap, const Roaring &other_bitmap) {
+                            self_bitmap ^= other_bitmap;
+                        });
+            return *this;
+        }
+
         for (const auto &other_entry : other.roarings) {
             const auto &other_bitmap = other_entry.second;
 
@@ -811,10 +1041,55 @@ class Roaring64Map {
         return *this;
     }
 
+    /**
+     * Same as operator|=, operator&= and operator^=, except that the inner
+     * bitmaps sharing a high 32-bit key are combined through the executor
+     * (see roaring_executor_t) when one is provided. The outer map is updated
+     * on the calling thread before and after. Worthwhile for large maps, where
+     * the inner bitmaps hold most of the work. The executor is ignored if an
+     * inner bitmap has an allocator or lives in an arena.
+     */
+    BasicRoaring64Map &orInplace(const BasicRoaring64Map &other,
+                                 const api::roaring_executor_t *executor) {
+        if (executor == nullptr || this == &other) {
+            return *this |= other;
+        }
+        // operator|= only drops the empty results with a sorted vector
+        return combineInplace(other, false, sortedVectorStorage(), executor,
+                              [](Roaring &self_bitmap,
+                                 const Roaring &other_bitmap) {
+                                  self_bitmap |= other_bitmap;
+                              });
+    }
+
+    BasicRoaring64Map &andInplace(const BasicRoaring64Map &other,
+                                  const api::roaring_executor_t *executor) {
+        if (executor == nullptr || this == &other) {
+            return *this &= other;
+        }
+        return combineInplace(other, true, true, executor,
+                              [](Roaring &self_bitmap,
+                                 const Roaring &other_bitmap) {
+                                  self_bitmap &= other_bitmap;
+                              });
+    }
+
+    BasicRoaring64Map &xorInplace(const BasicRoaring64Map &other,
+                                  const api::roaring_executor_t *executor) {
+        if (executor == nullptr || this == &other) {
+            return *this ^= other;
+        }
+        return combineInplace(other, false, true, executor,
+                              [](Roaring &self_bitmap,
+                                 const Roaring &other_bitmap) {
+                                  self_bitmap ^= other_bitmap;
+                              });
+    }
+
     /**
      * Exchange the content of this bitmap with another.
      */
-    void swap(Roaring64Map &r) { roarings.swap(r.roarings); }
+    void swap(BasicRoaring64Map &r) { roarings.swap(r.roarings); }
 
     /**
      * Get the cardinality of the bitmap (number of elements).
@@ -837,7 +1112,7 @@ class Roaring64Map {
         return std::accumulate(
             roarings.cbegin(), roarings.cend(), (uint64_t)0,
             [](uint64_t previous,
-               const std::pair<const uint32_t, Roaring> &map_entry) {
+               const typename roarings_t::value_type &map_entry) {
                 return previous + map_entry.second.cardinality();
             });
     }
@@ -848,7 +1123,7 @@ class Roaring64Map {
     bool isEmpty() const {
         return std::all_of(
             roarings.cbegin(), roarings.cend(),
-            [](const std::pair<const uint32_t, Roaring> &map_entry) {
+            [](const typename roarings_t::value_type &map_entry) {
                 return map_entry.second.isEmpty();
             });
     }
@@ -867,7 +1142,7 @@ class Roaring64Map {
         return roarings.size() ==
                        ((uint64_t)(std::numeric_limits<uint32_t>::max)()) + 1
                    ? std::all_of(roarings.cbegin(), roarings.cend(),
-                                 [](const std::pair<const uint32_t, Roaring>
+                                 [](const typename roarings_t::value_type
                                         &roaring_map_entry) {
                                      return roaring_map_entry.second.isFull();
                                  })
@@ -882,7 +1157,7 @@ class Roaring64Map {
     /**
      * Returns true if the bitmap is subset of the other.
      */
-    bool isSubset(const Roaring64Map &r) const {
+    bool isSubset(const BasicRoaring64Map &r) const {
         for (const auto &map_entry : roarings) {
             if (map_entry.second.isEmpty()) {
                 continue;
@@ -902,7 +1177,7 @@ class Roaring64Map {
      * (cardinality() == 2^64). Check isFull() before calling to avoid
      * exception.
      */
-    bool isStrictSubset(const Roaring64Map &r) const {
+    bool isStrictSubset(const BasicRoaring64Map &r) const {
         return isSubset(r) && cardinality() != r.cardinality();
     }
 
@@ -916,7 +1191,7 @@ class Roaring64Map {
         (void)std::accumulate(
             roarings.cbegin(), roarings.cend(), ans,
             [](uint64_t *previous,
-               const std::pair<const uint32_t, Roaring> &map_entry) {
+               const typename roarings_t::value_type &map_entry) {
                 for (uint32_t low_bits : map_entry.second)
                     *previous++ = uniteBytes(map_entry.first, low_bits);
                 return previous;
@@ -926,7 +1201,7 @@ class Roaring64Map {
     /**
      * Return true if the two bitmaps contain the same elements.
      */
-    bool operator==(const Roaring64Map &r) const {
+    bool operator==(const BasicRoaring64Map &r) const {
         // we cannot use operator == on the map because either side may contain
         // empty Roaring Bitmaps
         auto lhs_iter = roarings.cbegin();
@@ -1045,16 +1320,14 @@ class Roaring64Map {
         {
             auto &bitmap = current_iter->second;
             bitmap.flipClosed(start_low, uint32_max);
-            auto temp = current_iter++;
-            eraseIfEmpty(temp);
+            current_iter = eraseIfEmpty(current_iter);
         }
 
         // 2. Flip intermediate bitmaps completely.
         for (uint32_t i = 0; i != num_intermediate_bitmaps; ++i) {
             auto &bitmap = current_iter->second;
             bitmap.flipClosed(0, uint32_max);
-            auto temp = current_iter++;
-            eraseIfEmpty(temp);
+            current_iter = eraseIfEmpty(current_iter);
         }
 
         // 3. Partially flip the last bitmap.
@@ -1070,7 +1343,7 @@ class Roaring64Map {
     bool removeRunCompression() {
         return std::accumulate(
             roarings.begin(), roarings.end(), true,
-            [](bool previous, std::pair<const uint32_t, Roaring> &map_entry) {
+            [](bool previous, typename roarings_t::value_type &map_entry) {
                 return map_entry.second.removeRunCompression() && previous;
             });
     }
@@ -1084,7 +1357,7 @@ class Roaring64Map {
     bool runOptimize() {
         return std::accumulate(
             roarings.begin(), roarings.end(), true,
-            [](bool previous, std::pair<const uint32_t, Roaring> &map_entry) {
+            [](bool previous, typename roarings_t::value_type &map_entry) {
                 return map_entry.second.runOptimize() && previous;
             });
     }
@@ -1100,7 +1373,7 @@ class Roaring64Map {
             if (iter->second.isEmpty()) {
                 // empty Roarings are 84 bytes
                 savedBytes += 88;
-                roarings.erase(iter++);
+                iter = roarings.erase(iter);
             } else {
                 savedBytes += iter->second.shrinkToFit();
                 iter++;
@@ -1220,7 +1493,7 @@ class Roaring64Map {
         buf += sizeof(uint64_t);
         std::for_each(roarings.cbegin(), roarings.cend(),
                       [&buf, portable](
-                          const std::pair<const uint32_t, Roaring> &map_entry) {
+                          const typename roarings_t::value_type &map_entry) {
                           // push map key
                           uint32_t key_le = croaring_htole32(map_entry.first);
                           std::memcpy(buf, &key_le, sizeof(uint32_t));
@@ -1246,8 +1519,8 @@ class Roaring64Map {
      * bytes could be read, possibly causing a buffer overflow. See also
      * readSafe.
      */
-    static Roaring64Map read(const char *buf, bool portable = true) {
-        Roaring64Map result;
+    static BasicRoaring64Map read(const char *buf, bool portable = true) {
+        BasicRoaring64Map result;
         // get map size
         uint64_t map_size;
         std::memcpy(&map_size, buf, sizeof(uint64_t));
@@ -1265,7 +1538,7 @@ class Roaring64Map {
             Roaring read_var = Roaring::read(buf, portable);
             // forward buffer past the last Roaring Bitmap
             buf += read_var.getSizeInBytes(portable);
-            result.emplaceOrInsert(key, std::move(read_var));
+            result.appendOrInsert(key, std::move(read_var));
         }
         return result;
     }
@@ -1277,11 +1550,11 @@ class Roaring64Map {
      * Setting the portable flag to false enable a custom format that can save
      * space compared to the portable format (e.g., for very sparse bitmaps).
      */
-    static Roaring64Map readSafe(const char *buf, size_t maxbytes) {
+    static BasicRoaring64Map readSafe(const char *buf, size_t maxbytes) {
         if (maxbytes < sizeof(uint64_t)) {
             ROARING_TERMINATE("ran out of bytes");
         }
-        Roaring64Map result;
+        BasicRoaring64Map result;
         if (maxbytes < sizeof(uint64_t)) {
             ROARING_TERMINATE("ran out of bytes");
         }
@@ -1311,7 +1584,7 @@ class Roaring64Map {
             // forward buffer past the last Roaring Bitmap
             buf += needed_bytes;
             maxbytes -= needed_bytes;
-            result.emplaceOrInsert(key, std::move(read_var));
+            result.appendOrInsert(key, std::move(read_var));
         }
         return result;
     }
@@ -1330,7 +1603,7 @@ class Roaring64Map {
             roarings.cbegin(), roarings.cend(),
             sizeof(uint64_t) + roarings.size() * sizeof(uint32_t),
             [=](size_t previous,
-                const std::pair<const uint32_t, Roaring> &map_entry) {
+                const typename roarings_t::value_type &map_entry) {
                 // add in bytes used by each Roaring
                 return previous + map_entry.second.getSizeInBytes(portable);
             });
@@ -1338,23 +1611,48 @@ class Roaring64Map {
 
     /**
      * For advanced users only. This function is unsafe. You must ensure that
-     * the provided buffer is 32-byte aligned.
+     * the provided buffer is 32-byte aligned. See also frozenView(buf, length).
      */
-    static Roaring64Map frozenView(const char *buf) {
-        // We do not check that buf is 32-byte aligned. Caller is responsible.
+    static BasicRoaring64Map frozenView(const char *buf) {
+        return frozenView(buf, std::numeric_limits<size_t>::max());
+    }
+
+    /**
+     * For advanced users only. Creates a view of a buffer written by
+     * writeFrozen(), reading no more than 'length' bytes. Each inner bitmap is
+     * a roaring_bitmap_frozen_view() into the buffer, so the containers are
+     * neither copied nor decoded: the buffer must be 32-byte aligned, must
+     * outlive the returned bitmap, and the bitmap must not be modified.
+     *
+     * The function may throw std::runtime_error if the buffer is too short or
+     * otherwise malformed.
+     */
+    static BasicRoaring64Map frozenView(const char *buf, size_t length) {
         // size of bitmap buffer and key
         const size_t metadata_size = sizeof(size_t) + sizeof(uint32_t);
 
-        Roaring64Map result;
+        BasicRoaring64Map result;
 
         // get map size
+        if (length < sizeof(uint64_t)) {
+            ROARING_TERMINATE("ran out of bytes");
+        }
         uint64_t map_size;
         memcpy(&map_size, buf, sizeof(uint64_t));
         buf += sizeof(uint64_t);
+        length -= sizeof(uint64_t);
+        reserveStorage(result.roarings,
+                       (size_t)std::min<uint64_t>(map_size,
+                                                  length / metadata_size));
 
         for (uint64_t lcv = 0; lcv < map_size; lcv++) {
             // pad to 32 bytes minus the metadata size
-            while (((uintptr_t)buf + metadata_size) % 32 != 0) buf++;
+            size_t padding = (32 - ((uintptr_t)buf + metadata_size) % 32) % 32;
+            if (length < padding + metadata_size) {
+                ROARING_TERMINATE("ran out of bytes");
+            }
+            buf += padding;
+            length -= padding + metadata_size;
 
             // get bitmap size
             size_t len;
@@ -1366,12 +1664,21 @@ class Roaring64Map {
             memcpy(&key, buf, sizeof(uint32_t));
             buf += sizeof(uint32_t);
 
+            // writeFrozen() emits the keys in increasing order, which lets
+            // every inner bitmap be appended at the end of the map.
+            if (len > length || (!result.roarings.empty() &&
+                                 key <= result.roarings.crbegin()->first)) {
+                ROARING_TERMINATE("invalid frozen data");
+            }
+
             // read map value Roaring
-            Roaring read = Roaring::frozenView(buf, len);
-            result.emplaceOrInsert(key, std::move(read));
+            result.roarings.insert(
+                result.roarings.end(),
+                std::make_pair(key, Roaring::frozenView(buf, len)));
 
             // forward buffer past the last Roaring Bitmap
             buf += len;
+            length -= len;
         }
         return result;
     }
@@ -1380,8 +1687,8 @@ class Roaring64Map {
      * For advanced users only. This function is unsafe in the sense that
      * that it may trigger unaligned memory access. Use with caution.
      */
-    static Roaring64Map portableDeserializeFrozen(const char *buf) {
-        Roaring64Map result;
+    static BasicRoaring64Map portableDeserializeFrozen(const char *buf) {
+        BasicRoaring64Map result;
         // get map size
         uint64_t map_size;
         std::memcpy(&map_size, buf, sizeof(uint64_t));
@@ -1395,7 +1702,7 @@ class Roaring64Map {
             Roaring read_var = Roaring::portableDeserializeFrozen(buf);
             // forward buffer past the last Roaring bitmap
             buf += read_var.getSizeInBytes(true);
-            result.emplaceOrInsert(key, std::move(read_var));
+            result.appendOrInsert(key, std::move(read_var));
         }
         return result;
     }
@@ -1415,11 +1722,13 @@ class Roaring64Map {
     // buffer size (size_t), and the map key (uint32_t). The padding is used to
     // ensure 32-byte alignment, but since it is followed by the buffer size and
     // map key, it actually pads to `(x - sizeof(size_t) + sizeof(uint32_t)) mod
-    // 32` to leave room for the metadata.
-    void writeFrozen(char *buf) const {
+    // 32` to leave room for the metadata. Returns the number of bytes written,
+    // which is getFrozenSizeInBytes() for a 32-byte aligned buffer.
+    size_t writeFrozen(char *buf) const {
         // We do not check that buf is 32-byte aligned. Caller is responsible.
         // size of bitmap buffer and key
         const size_t metadata_size = sizeof(size_t) + sizeof(uint32_t);
+        const char *orig = buf;
 
         // push map size
         uint64_t map_size = roarings.size();
@@ -1442,8 +1751,9 @@ class Roaring64Map {
 
             // push map value Roaring
             map_entry.second.writeFrozen(buf);
-            buf += map_entry.second.getFrozenSizeInBytes();
+            buf += frozenSizeInBytes;
         }
+        return buf - orig;
     }
 
     /**
@@ -1477,32 +1787,32 @@ class Roaring64Map {
      * Consider also using the operator &= to avoid needlessly creating
      * many temporary bitmaps.
      */
-    Roaring64Map operator&(const Roaring64Map &o) const {
-        return Roaring64Map(*this) &= o;
+    BasicRoaring64Map operator&(const BasicRoaring64Map &o) const {
+        return BasicRoaring64Map(*this) &= o;
     }
 
     /**
      * Computes the difference between two bitmaps and returns new bitmap.
      * The current bitmap and the provided bitmap are unchanged.
      */
-    Roaring64Map operator-(const Roaring64Map &o) const {
-        return Roaring64Map(*this) -= o;
+    BasicRoaring64Map operator-(const BasicRoaring64Map &o) const {
+        return BasicRoaring64Map(*this) -= o;
     }
 
     /**
      * Computes the union between two bitmaps and returns new bitmap.
      * The current bitmap and the provided bitmap are unchanged.
      */
-    Roaring64Map operator|(const Roaring64Map &o) const {
-        return Roaring64Map(*this) |= o;
+    BasicRoaring64Map operator|(const BasicRoaring64Map &o) const {
+        return BasicRoaring64Map(*this) |= o;
     }
 
     /**
      * Computes the symmetric union between two bitmaps and returns new bitmap.
      * The current bitmap and the provided bitmap are unchanged.
      */
-    Roaring64Map operator^(const Roaring64Map &o) const {
-        return Roaring64Map(*this) ^= o;
+    BasicRoaring64Map operator^(const BasicRoaring64Map &o) const {
+        return BasicRoaring64Map(*this) ^= o;
     }
 
     /**
@@ -1512,7 +1822,7 @@ class Roaring64Map {
         if (copyOnWrite == val) return;
         copyOnWrite = val;
         std::for_each(roarings.begin(), roarings.end(),
-                      [=](std::pair<const uint32_t, Roaring> &map_entry) {
+                      [=](typename roarings_t::value_type &map_entry) {
                           map_entry.second.setCopyOnWrite(val);
                       });
     }
@@ -1544,9 +1854,14 @@ class Roaring64Map {
 
     /**
      * Computes the logical or (union) between "n" bitmaps (referenced by a
-     * pointer).
-     */
-    static Roaring64Map fastunion(size_t n, const Roaring64Map **inputs) {
+     * pointer). The unions of the inner bitmaps sharing a high 32-bit key
+     * are independent of each other, and are run through the executor (see
+     * roaring_executor_t) when one is provided, unless an inner bitmap has an
+     * allocator or lives in an arena.
+     */
+    static BasicRoaring64Map fastunion(
+        size_t n, const BasicRoaring64Map **inputs,
+        const api::roaring_executor_t *executor = nullptr) {
         // The strategy here is to basically do a "group by" operation.
         // We group the input roarings by key, do a 32-bit
         // roaring_bitmap_or_many on each group, and collect the results.
@@ -1557,7 +1872,7 @@ class Roaring64Map {
         // current_iter on all the affected entries and then repeats.
 
         // There is an entry in our priority queue for each of the 'n' inputs.
-        // For a given Roaring64Map, we look at its underlying 'roarings'
+        // For a given input bitmap, we look at its underlying 'roarings'
         // std::map, and take its begin() and end(). This forms our half-open
         // interval [current_iter, end_iter), which we keep in the priority
         // queue as a pq_entry. These entries are updated (removed and then
@@ -1566,8 +1881,8 @@ class Roaring64Map {
         // (i.e. pq_entry.iterator == pq_entry.end) it is not returned to the
         // priority queue.
         struct pq_entry {
-            roarings_t::const_iterator iterator;
-            roarings_t::const_iterator end;
+            typename roarings_t::const_iterator iterator;
+            typename roarings_t::const_iterator end;
         };
 
         // Custom comparator for the priority queue.
@@ -1609,8 +1924,11 @@ class Roaring64Map {
         //          end()).
         //       4. If current_iter != end_iter, reinsert the pair into the
         //          priority queue.
-        //    C. Invoke the 32-bit roaring_bitmap_or_many() and add to result
-        Roaring64Map result;
+        //    C. Record the group, and the range of 'group_bitmaps' it covers.
+        // 2. Invoke the 32-bit roaring_bitmap_or_many() on every group,
+        //    possibly in parallel, and add the results to the result map.
+        std::vector<uint32_t> group_keys;
+        std::vector<size_t> group_starts;
         while (!pq.empty()) {
             // Find the next key (the lowest key) in the priority queue.
             auto group_key = pq.top().iterator->first;
@@ -1620,7 +1938,8 @@ class Roaring64Map {
             // fed to roaring_bitmap_or_many(). While we are doing this, we
             // advance those iterators to their next value and reinsert them
             // into the priority queue (unless they reach their end).
-            group_bitmaps.clear();
+            group_keys.push_back(group_key);
+            group_starts.push_back(group_bitmaps.size());
             while (!pq.empty()) {
                 auto candidate_current_iter = pq.top().iterator;
                 auto candidate_end_iter = pq.top().end;
@@ -1643,6 +1962,9 @@ class Roaring64Map {
                 }
 
                 group_bitmaps.push_back(&candidate_bitmap.roaring);
+                if (hasAllocator(candidate_bitmap)) {
+                    executor = nullptr;
+                }
                 // Remove this entry from the priority queue. Note this
                 // invalidates pq.top() so make sure you don't have any dangling
                 // references to it.
@@ -1657,21 +1979,41 @@ class Roaring64Map {
                 }
             }
 
-            // Use the fast inner union to combine these.
-            auto *inner_result = roaring_bitmap_or_many(group_bitmaps.size(),
-                                                        group_bitmaps.data());
-            // Insert the 32-bit result at end of the 'roarings' map of the
-            // result we are building.
-            result.roarings.insert(
-                result.roarings.end(),
-                std::make_pair(group_key, Roaring(inner_result)));
+        }
+        group_starts.push_back(group_bitmaps.size());
+
+        // Use the fast inner union to combine each group.
+        std::vector<roaring_bitmap_t *> inner_results(group_keys.size());
+        auto union_group = [&](size_t i) {
+            size_t start = group_starts[i];
+            inner_results[i] = roaring_bitmap_or_many(
+                group_starts[i + 1] - start, group_bitmaps.data() + start);
+        };
+        parallelFor(group_keys.size(), executor, union_group);
+        if (std::find(inner_results.begin(), inner_results.end(), nullptr) !=
+            inner_results.end()) {
+            for (auto *inner_result : inner_results) {
+                if (inner_result != nullptr) {
+                    roaring_bitmap_free(inner_result);
+                }
+            }
+            ROARING_TERMINATE("failed memory alloc in fastunion");
+        }
+
+        // Insert the 32-bit results at end of the 'roarings' map of the
+        // result we are building.
+        BasicRoaring64Map result;
+        for (size_t i = 0; i < group_keys.size(); ++i) {
+            result.roarings.emplace_hint(result.roarings.end(), group_keys[i],
+                                         Roaring(inner_results[i]));
         }
         return result;
     }
 
-    friend class Roaring64MapSetBitBiDirectionalIterator;
-    typedef Roaring64MapSetBitBiDirectionalIterator const_iterator;
-    typedef Roaring64MapSetBitBiDirectionalIterator
+    friend class BasicRoaring64MapSetBitBiDirectionalIterator<Storage>;
+    typedef BasicRoaring64MapSetBitBiDirectionalIterator<Storage>
+        const_iterator;
+    typedef BasicRoaring64MapSetBitBiDirectionalIterator<Storage>
         const_bidirectional_iterator;
 
     /**
@@ -1692,7 +2034,10 @@ class Roaring64Map {
     const_iterator end() const;
 
    private:
-    typedef std::map<uint32_t, Roaring> roarings_t;
+    template <typename>
+    friend class BasicRoaring64Map;
+
+    typedef Storage roarings_t;
     roarings_t roarings{};  // The empty constructor silences warnings from
                             // pedantic static analyzers.
     bool copyOnWrite{false};
@@ -1724,6 +2069,15 @@ class Roaring64Map {
 #endif
     }
 
+    /*
+     * Same as emplaceOrInsert(), hinting that 'key' goes after every key of
+     * the map, as is the case when reading serialized bitmaps: the insertion
+     * is then amortized constant time.
+     */
+    void appendOrInsert(const uint32_t key, Roaring &&value) {
+        roarings.insert(roarings.end(), std::make_pair(key, std::move(value)));
+    }
+
     /*
      * Look up 'key' in the 'roarings' map. If it does not exist, create it.
      * Also, set its copyOnWrite flag to 'copyOnWrite'. Then return a reference
@@ -1769,7 +2123,7 @@ class Roaring64Map {
      * Roaring bitmaps if necessary. The interval must be valid and non-empty.
      * Returns an iterator to the bitmap at start_high.
      */
-    roarings_t::iterator ensureRangePopulated(uint32_t start_high,
+    typename roarings_t::iterator ensureRangePopulated(uint32_t start_high,
                                               uint32_t end_high) {
         if (start_high > end_high) {
             ROARING_TERMINATE("Logic error: start_high > end_high");
@@ -1779,9 +2133,8 @@ class Roaring64Map {
         auto next_populated_iter = roarings.lower_bound(start_high);
 
         // Use uint64_t to avoid an infinite loop when end_high == uint32_max.
-        roarings_t::iterator start_iter{};  // Definitely assigned in loop.
+        typename roarings_t::iterator slot_iter{};  // Definitely assigned.
         for (uint64_t slot = start_high; slot <= end_high; ++slot) {
-            roarings_t::iterator slot_iter;
             if (next_populated_iter != roarings.end() &&
                 next_populated_iter->first == slot) {
                 // 'slot' index has caught up to next_populated_iter.
@@ -1799,26 +2152,274 @@ class Roaring64Map {
                     std::forward_as_tuple());
                 auto &bitmap = slot_iter->second;
                 bitmap.setCopyOnWrite(copyOnWrite);
+                // The insertion may have invalidated next_populated_iter (it
+                // does with a sorted vector storage), so take it again.
+                next_populated_iter = std::next(slot_iter);
             }
+        }
+        // The slots [start_high, end_high] are now consecutive entries ending
+        // at slot_iter. Earlier iterators may have been invalidated by later
+        // insertions, so walk back to the starting slot.
+        return std::prev(slot_iter, end_high - start_high);
+    }
+
+    /**
+     * Whether 'roarings' is a SortedVectorMap, where inserting or erasing an
+     * entry in the middle shifts all the entries after it.
+     */
+    static constexpr bool sortedVectorStorage() {
+        return internal::IsSortedVectorMap<roarings_t>::value;
+    }
 
-            // Make a note of the iterator of the starting slot. It will be
-            // needed for the return value.
-            if (slot == start_high) {
-                start_iter = slot_iter;
+    /**
+     * Combines 'other' into this bitmap in a single merge pass over the keys
+     * of both sides, moving the surviving entries into a new outer container
+     * which then replaces 'roarings'. Each entry is moved at most once, where
+     * inserting or erasing the entries one by one would cost O(n) each with
+     * a sorted vector storage.
+     *
+     * 'op' combines two bitmaps that share a key. Keys present only in this
+     * bitmap are kept if 'keep_self_only' is set, keys present only in
+     * 'other' are copied if 'copy_other_only' is set. Entries that 'op' leaves
+     * empty are dropped.
+     */
+    template <typename Op>
+    void mergeSorted(const BasicRoaring64Map &other, bool keep_self_only,
+                     bool copy_other_only, Op op) {
+        roarings_t merged;
+        auto self_iter = roarings.begin();
+        auto self_end = roarings.end();
+        auto other_iter = other.roarings.cbegin();
+        auto other_end = other.roarings.cend();
+        while (self_iter != self_end || other_iter != other_end) {
+            if (other_iter == other_end ||
+                (self_iter != self_end &&
+                 self_iter->first < other_iter->first)) {
+                if (keep_self_only) {
+                    merged.emplace_hint(merged.end(), self_iter->first,
+                                        std::move(self_iter->second));
+                }
+                ++self_iter;
+            } else if (self_iter == self_end ||
+                       other_iter->first < self_iter->first) {
+                if (copy_other_only) {
+                    auto iter = merged.emplace_hint(merged.end(), *other_iter);
+                    iter->second.setCopyOnWrite(copyOnWrite);
+                }
+                ++other_iter;
+            } else {
+                auto &self_bitmap = self_iter->second;
+                op(self_bitmap, other_iter->second);
+                if (!self_bitmap.isEmpty()) {
+                    merged.emplace_hint(merged.end(), self_iter->first,
+                                        std::move(self_bitmap));
+                }
+                ++self_iter;
+                ++other_iter;
             }
         }
-        return start_iter;
+        roarings.swap(merged);
+    }
+
+    /**
+     * Reserves room for 'n' entries in an outer container that supports it.
+     */
+    template <typename Map>
+    static void reserveStorage(Map &, size_t) {}
+
+    static void reserveStorage(
+        internal::SortedVectorMap<uint32_t, Roaring> &map, size_t n) {
+        map.reserve(n);
+    }
+
+    /**
+     * Whether the bitmap allocates through an allocator or an arena (see
+     * roaring_allocator_t). These need not be thread safe, so such bitmaps
+     * must not be handed to an executor.
+     */
+    static bool hasAllocator(const Roaring &bitmap) {
+        return bitmap.roaring.high_low_container.allocator != nullptr;
+    }
+
+    /**
+     * Calls fn(i) for every i in [0, n), splitting the indexes into chunks
+     * that go through the executor when one is provided. 'fn' must not
+     * throw, and calls with distinct indexes must not touch the same memory.
+     */
+    template <typename Fn>
+    static void parallelFor(size_t n, const api::roaring_executor_t *executor,
+                            Fn &fn) {
+        struct state_t {
+            Fn *fn;
+            size_t n;
+            size_t chunk;
+        };
+        state_t state = {&fn, n, internal::roaring_task_chunk_size(n, 1)};
+        internal::roaring_execute_tasks(
+            executor, (n + state.chunk - 1) / state.chunk,
+            [](void *arg, size_t task_index) {
+                state_t *s = (state_t *)arg;
+                size_t end = std::min(s->n, (task_index + 1) * s->chunk);
+                for (size_t i = task_index * s->chunk; i < end; ++i) {
+                    (*s->fn)(i);
+                }
+            },
+            &state);
+    }
+
+    /**
+     * Shared implementation of orInplace(), andInplace() and xorInplace().
+     * Three passes: the outer map first gets the keys of the result (the
+     * intersection of the keys of both sides if 'is_and' is set, their union
+     * otherwise, new entries starting empty), then 'op' combines every inner
+     * bitmap with its counterpart in 'other' through the executor, and
+     * finally, if 'erase_empty' is set, the entries that were in both maps
+     * and that 'op' left empty are erased. Entries 'op' did not combine, and
+     * those it filled from 'other', are kept even if empty, as the operators
+     * do. Only the middle pass runs in parallel; it does not change the outer
+     * map, so the references it works on stay valid for both storages.
+     */
+    template <typename Op>
+    BasicRoaring64Map &combineInplace(const BasicRoaring64Map &other,
+                                      bool is_and, bool erase_empty,
+                                      const api::roaring_executor_t *executor,
+                                      Op op) {
+        // 1. Set the keys, recording those that only 'other' has.
+        std::vector<uint32_t> other_only_keys;
+        if (sortedVectorStorage()) {
+            roarings_t aligned;
+            reserveStorage(aligned,
+                           is_and ? roarings.size()
+                                  : roarings.size() + other.roarings.size());
+            auto self_iter = roarings.begin();
+            auto other_iter = other.roarings.cbegin();
+            while (self_iter != roarings.end() ||
+                   other_iter != other.roarings.cend()) {
+                if (other_iter == other.roarings.cend() ||
+                    (self_iter != roarings.end() &&
+                     self_iter->first < other_iter->first)) {
+                    if (!is_and) {
+                        aligned.emplace_hint(aligned.end(), self_iter->first,
+                                             std::move(self_iter->second));
+                    }
+                    ++self_iter;
+                } else if (self_iter == roarings.end() ||
+                           other_iter->first < self_iter->first) {
+                    if (!is_and) {
+                        auto iter = aligned.emplace_hint(
+                            aligned.end(), other_iter->first, Roaring());
+                        iter->second.setCopyOnWrite(copyOnWrite);
+                        other_only_keys.push_back(other_iter->first);
+                    }
+                    ++other_iter;
+                } else {
+                    aligned.emplace_hint(aligned.end(), self_iter->first,
+                                         std::move(self_iter->second));
+                    ++self_iter;
+                    ++other_iter;
+                }
+            }
+            roarings.swap(aligned);
+        } else if (is_and) {
+            for (auto self_iter = roarings.begin();
+                 self_iter != roarings.end();) {
+                if (other.roarings.find(self_iter->first) ==
+                    other.roarings.cend()) {
+                    self_iter = roarings.erase(self_iter);
+                } else {
+                    ++self_iter;
+                }
+            }
+        } else {
+            for (const auto &other_entry : other.roarings) {
+                auto insert_result =
+                    roarings.emplace(other_entry.first, Roaring());
+                if (insert_result.second) {
+                    insert_result.first->second.setCopyOnWrite(copyOnWrite);
+                    other_only_keys.push_back(other_entry.first);
+                }
+            }
+        }
+
+        // 2. Combine the inner bitmaps sharing a key. Every key of the
+        // smaller of the two key sets is now in the other one.
+        std::vector<std::pair<Roaring *, const Roaring *>> pairs;
+        std::vector<std::pair<uint32_t, const Roaring *>> combined;
+        auto other_only_iter = other_only_keys.cbegin();
+        auto other_iter = other.roarings.cbegin();
+        for (auto &self_entry : roarings) {
+            while (other_iter != other.roarings.cend() &&
+                   other_iter->first < self_entry.first) {
+                ++other_iter;
+            }
+            if (other_iter == other.roarings.cend()) {
+                break;
+            }
+            if (other_iter->first == self_entry.first) {
+                pairs.emplace_back(&self_entry.second, &other_iter->second);
+                if (hasAllocator(self_entry.second) ||
+                    hasAllocator(other_iter->second)) {
+                    executor = nullptr;
+                }
+                // the keys only 'other' had come in the same order
+                if (other_only_iter != other_only_keys.cend() &&
+                    *other_only_iter == self_entry.first) {
+                    ++other_only_iter;
+                } else {
+                    combined.emplace_back(self_entry.first, &self_entry.second);
+                }
+            }
+        }
+        auto combine = [&](size_t i) { op(*pairs[i].first, *pairs[i].second); };
+        parallelFor(pairs.size(), executor, combine);
+
+        // 3. Erase the entries of both maps that 'op' left empty.
+        if (!erase_empty) {
+            return *this;
+        }
+        std::vector<uint32_t> emptied;
+        for (const auto &entry : combined) {
+            if (entry.second->isEmpty()) {
+                emptied.push_back(entry.first);
+            }
+        }
+        if (emptied.empty()) {
+            return *this;
+        }
+        if (sortedVectorStorage()) {
+            roarings_t kept;
+            reserveStorage(kept, roarings.size() - emptied.size());
+            auto emptied_iter = emptied.cbegin();
+            for (auto &entry : roarings) {
+                if (emptied_iter != emptied.cend() &&
+                    *emptied_iter == entry.first) {
+                    ++emptied_iter;
+                    continue;
+                }
+                kept.emplace_hint(kept.end(), entry.first,
+                                  std::move(entry.second));
+            }
+            roarings.swap(kept);
+        } else {
+            for (uint32_t key : emptied) {
+                roarings.erase(roarings.find(key));
+            }
+        }
+        return *this;
     }
 
     /**
-     * Erases the entry pointed to by 'iter' from the 'roarings' map. Warning:
-     * this invalidates 'iter'.
+     * Erases the entry pointed to by 'iter' from the 'roarings' map if its
+     * bitmap is empty. Warning: this invalidates 'iter'. Returns an iterator
+     * to the entry that follows it.
      */
-    void eraseIfEmpty(roarings_t::iterator iter) {
+    typename roarings_t::iterator eraseIfEmpty(
+        typename roarings_t::iterator iter) {
         const auto &bitmap = iter->second;
         if (bitmap.isEmpty()) {
-            roarings.erase(iter);
+            return roarings.erase(iter);
         }
+        return std::next(iter);
     }
 };
 
@@ -1827,17 +2428,19 @@ class Roaring64Map {
  *
  * Recommend to explicitly construct this iterator.
  */
-class Roaring64MapSetBitBiDirectionalIterator {
+template <typename Storage>
+class BasicRoaring64MapSetBitBiDirectionalIterator {
    public:
     typedef std::bidirectional_iterator_tag iterator_category;
     typedef uint64_t *pointer;
     typedef uint64_t &reference;
     typedef uint64_t value_type;
     typedef int64_t difference_type;
-    typedef Roaring64MapSetBitBiDirectionalIterator type_of_iterator;
+    typedef BasicRoaring64MapSetBitBiDirectionalIterator type_of_iterator;
+    typedef BasicRoaring64Map<Storage> map_type;
 
-    Roaring64MapSetBitBiDirectionalIterator(const Roaring64Map &parent,
-                                            bool exhausted = false)
+    BasicRoaring64MapSetBitBiDirectionalIterator(const map_type &parent,
+                                                 bool exhausted = false)
         : p(&parent.roarings) {
         if (exhausted || parent.roarings.empty()) {
             map_iter = p->cend();
@@ -1856,7 +2459,7 @@ class Roaring64MapSetBitBiDirectionalIterator {
      * Provides the location of the set bit.
      */
     value_type operator*() const {
-        return Roaring64Map::uniteBytes(map_iter->first, i.current_value);
+        return map_type::uniteBytes(map_iter->first, i.current_value);
     }
 
     bool operator<(const type_of_iterator &o) const {
@@ -1894,7 +2497,7 @@ class Roaring64MapSetBitBiDirectionalIterator {
     }
 
     type_of_iterator operator++(int) {  // i++, must return orig. value
-        Roaring64MapSetBitBiDirectionalIterator orig(*this);
+        type_of_iterator orig(*this);
         roaring_uint32_iterator_advance(&i);
         while (!i.has_value) {
             ++map_iter;
@@ -1909,12 +2512,12 @@ class Roaring64MapSetBitBiDirectionalIterator {
      * Return true if there is such a value.
      */
     bool move_equalorlarger(const value_type &x) {
-        map_iter = p->lower_bound(Roaring64Map::highBytes(x));
+        map_iter = p->lower_bound(map_type::highBytes(x));
         if (map_iter != p->cend()) {
             roaring_iterator_init(&map_iter->second.roaring, &i);
-            if (map_iter->first == Roaring64Map::highBytes(x)) {
+            if (map_iter->first == map_type::highBytes(x)) {
                 if (roaring_uint32_iterator_move_equalorlarger(
-                        &i, Roaring64Map::lowBytes(x)))
+                        &i, map_type::lowBytes(x)))
                     return true;
                 ++map_iter;
                 if (map_iter == p->cend()) return false;
@@ -1947,7 +2550,7 @@ class Roaring64MapSetBitBiDirectionalIterator {
     }
 
     type_of_iterator operator--(int) {  // i--, must return orig. value
-        Roaring64MapSetBitBiDirectionalIterator orig(*this);
+        type_of_iterator orig(*this);
         if (map_iter == p->cend()) {
             --map_iter;
             roaring_iterator_init_last(&map_iter->second.roaring, &i);
@@ -1963,21 +2566,21 @@ class Roaring64MapSetBitBiDirectionalIterator {
         return orig;
     }
 
-    bool operator==(const Roaring64MapSetBitBiDirectionalIterator &o) const {
+    bool operator==(const type_of_iterator &o) const {
         if (map_iter == p->cend() && o.map_iter == o.p->cend()) return true;
         if (o.map_iter == o.p->cend()) return false;
         return **this == *o;
     }
 
-    bool operator!=(const Roaring64MapSetBitBiDirectionalIterator &o) const {
+    bool operator!=(const type_of_iterator &o) const {
         if (map_iter == p->cend() && o.map_iter == o.p->cend()) return false;
         if (o.map_iter == o.p->cend()) return true;
         return **this != *o;
     }
 
    private:
-    const std::map<uint32_t, Roaring> *p{nullptr};
-    std::map<uint32_t, Roaring>::const_iterator
+    const Storage *p{nullptr};
+    typename Storage::const_iterator
         map_iter{};  // The empty constructor silences warnings from pedantic
                      // static analyzers.
     api::roaring_uint32_iterator_t
@@ -1985,12 +2588,16 @@ class Roaring64MapSetBitBiDirectionalIterator {
               // analyzers.
 };
 
-inline Roaring64MapSetBitBiDirectionalIterator Roaring64Map::begin() const {
-    return Roaring64MapSetBitBiDirectionalIterator(*this);
+template <typename Storage>
+inline BasicRoaring64MapSetBitBiDirectionalIterator<Storage>
+BasicRoaring64Map<Storage>::begin() const {
+    return BasicRoaring64MapSetBitBiDirectionalIterator<Storage>(*this);
 }
 
-inline Roaring64MapSetBitBiDirectionalIterator Roaring64Map::end() const {
-    return Roaring64MapSetBitBiDirectionalIterator(*this, true);
+template <typename Storage>
+inline BasicRoaring64MapSetBitBiDirectionalIterator<Storage>
+BasicRoaring64Map<Storage>::end() const {
+    return BasicRoaring64MapSetBitBiDirectionalIterator<Storage>(*this, true);
 }
 
 }  // namespace roaring
@@ -57,6 +57,10 @@ typedef struct art_s {
     uint64_t first_free[6];
     uint64_t capacities[6];
     art_node_t *nodes[6];
+
+    // Incremented whenever leaves may have moved or been freed. Pointers to
+    // values returned by the ART stay valid while this does not change.
+    uint64_t leaf_version;
 } art_t;
 
 typedef uint64_t art_val_t;
@@ -81,6 +85,16 @@ void art_init_cleared(art_t *art);
  */
 art_val_t *art_insert(art_t *art, const art_key_chunk_t *key, art_val_t val);
 
+/**
+ * Inserts `count` keys and their values into an empty ART. `keys` holds the
+ * keys back to back, `ART_KEY_BYTES` each, and they must be unique and sorted
+ * in increasing order. Faster than inserting the keys one by one, as the tree
+ * is built top-down in a single pass over the keys, each inner node being
+ * created at its final size before its children are filled in.
+ */
+void art_bulk_load(art_t *art, const art_key_chunk_t *keys,
+                   const art_val_t *vals, size_t count);
+
 /**
  * Returns true if a value was erased. Sets `*erased_val` to the value erased,
  * if any.
@@ -222,6 +236,14 @@ size_t art_size_in_bytes(const art_t *art);
  */
 size_t art_serialize(const art_t *art, char *buf);
 
+/**
+ * Like `art_serialize`, but writes `map(val, context)` in place of each value
+ * `val`. The values are mapped in storage order, not in key order.
+ */
+size_t art_serialize_mapped(const art_t *art, char *buf,
+                            art_val_t (*map)(art_val_t val, void *context),
+                            void *context);
+
 /**
  * Deserializes the ART from a serialized buffer, reading up to `maxbytes`
  * bytes. Returns 0 on error. Requires `buf` to be 8 byte aligned.
@@ -31,6 +31,7 @@
 #include <string.h>
 
 #include <roaring/portability.h>
+#include <roaring/roaring_types.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -142,6 +143,24 @@ inline bool bitset_get(const bitset_t *bitset, size_t i) {
     return (bitset->array[shiftedi] & (((uint64_t)1) << (i % 64))) != 0;
 }
 
+/* Set the bits at the n_args indexes, growing the bitset once for the
+ * largest of them. Returns false, having set nothing, if the bitset could not
+ * grow. */
+bool bitset_set_many(bitset_t *bitset, size_t n_args, const size_t *indexes);
+
+/* Clear the bits at the n_args indexes, those past the end being ignored. */
+void bitset_clear_many(bitset_t *bitset, size_t n_args, const size_t *indexes);
+
+/* Flip the bits at the n_args indexes, growing the bitset once for the
+ * largest of them: an index given twice flips its bit back. Returns false,
+ * having flipped nothing, if the bitset could not grow. */
+bool bitset_flip_many(bitset_t *bitset, size_t n_args, const size_t *indexes);
+
+/* Get the values of the bits at the n_args indexes into results, unless it is
+ * NULL, and return how many are set. */
+size_t bitset_test_many(const bitset_t *bitset, size_t n_args,
+                        const size_t *indexes, bool *results);
+
 /* Count number of bits set.  */
 size_t bitset_count(const bitset_t *bitset);
 
@@ -204,6 +223,45 @@ size_t bitset_symmetric_difference_count(
     const bitset_t *CROARING_CBITSET_RESTRICT b1,
     const bitset_t *CROARING_CBITSET_RESTRICT b2);
 
+/* Same as the functions above, but the words are split in chunks aligned on
+ * cache lines which go through the executor (see roaring_executor_t), the
+ * counts of the chunks being summed. Worth it for bitsets of many millions of
+ * bits, whose operations are bound by the memory bandwidth of one core. A
+ * NULL executor processes everything on the calling thread. */
+size_t bitset_count_parallel(const bitset_t *bitset,
+                             const roaring_executor_t *executor);
+bool bitset_inplace_union_parallel(bitset_t *CROARING_CBITSET_RESTRICT b1,
+                                   const bitset_t *CROARING_CBITSET_RESTRICT b2,
+                                   const roaring_executor_t *executor);
+size_t bitset_union_count_parallel(
+    const bitset_t *CROARING_CBITSET_RESTRICT b1,
+    const bitset_t *CROARING_CBITSET_RESTRICT b2,
+    const roaring_executor_t *executor);
+void bitset_inplace_intersection_parallel(
+    bitset_t *CROARING_CBITSET_RESTRICT b1,
+    const bitset_t *CROARING_CBITSET_RESTRICT b2,
+    const roaring_executor_t *executor);
+size_t bitset_intersection_count_parallel(
+    const bitset_t *CROARING_CBITSET_RESTRICT b1,
+    const bitset_t *CROARING_CBITSET_RESTRICT b2,
+    const roaring_executor_t *executor);
+void bitset_inplace_difference_parallel(
+    bitset_t *CROARING_CBITSET_RESTRICT b1,
+    const bitset_t *CROARING_CBITSET_RESTRICT b2,
+    const roaring_executor_t *executor);
+size_t bitset_difference_count_parallel(
+    const bitset_t *CROARING_CBITSET_RESTRICT b1,
+    const bitset_t *CROARING_CBITSET_RESTRICT b2,
+    const roaring_executor_t *executor);
+bool bitset_inplace_symmetric_difference_parallel(
+    bitset_t *CROARING_CBITSET_RESTRICT b1,
+    const bitset_t *CROARING_CBITSET_RESTRICT b2,
+    const roaring_executor_t *executor);
+size_t bitset_symmetric_difference_count_parallel(
+    const bitset_t *CROARING_CBITSET_RESTRICT b1,
+    const bitset_t *CROARING_CBITSET_RESTRICT b2,
+    const roaring_executor_t *executor);
+
 /* iterate over the set bits
  like so :
   for(size_t i = 0; bitset_next_set_bit(b,&i) ; i++) {
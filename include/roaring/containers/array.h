@@ -37,20 +37,35 @@ namespace internal {
 /* Containers with DEFAULT_MAX_SIZE or less integers should be arrays */
 enum { DEFAULT_MAX_SIZE = 4096 };
 
+/* Arrays of up to ARRAY_CONTAINER_INLINE_SIZE integers are kept inside the
+ * container struct itself, so that tiny containers cost a single allocation.
+ * The inline slots fill what would otherwise be allocator padding. */
+enum { ARRAY_CONTAINER_INLINE_SIZE = 4 };
+
 /* struct array_container - sparse representation of a bitmap
  *
- * @cardinality: number of indices in `array` (and the bitmap)
- * @capacity:    allocated size of `array`
- * @array:       sorted list of integers
+ * @cardinality:  number of indices in `array` (and the bitmap)
+ * @capacity:     allocated size of `array`
+ * @array:        sorted list of integers, either allocated separately or
+ *                pointing at `inline_array`
+ * @inline_array: storage for `array` when capacity is at most
+ *                ARRAY_CONTAINER_INLINE_SIZE
  */
 STRUCT_CONTAINER(array_container_s) {
     int32_t cardinality;
     int32_t capacity;
     uint16_t *array;
+    uint16_t inline_array[ARRAY_CONTAINER_INLINE_SIZE];
 };
 
 typedef struct array_container_s array_container_t;
 
+/* Whether the values of `arr' are stored in the container struct itself.
+ * Such a container must not be copied by value. */
+static inline bool array_container_is_inline(const array_container_t *arr) {
+    return arr->array == arr->inline_array;
+}
+
 #define CAST_array(c) CAST(array_container_t *, c)  // safer downcast
 #define const_CAST_array(c) CAST(const array_container_t *, c)
 #define movable_CAST_array(c) movable_CAST(array_container_t **, c)
@@ -53,6 +53,28 @@ typedef struct bitset_container_s bitset_container_t;
 #define const_CAST_bitset(c) CAST(const bitset_container_t *, c)
 #define movable_CAST_bitset(c) movable_CAST(bitset_container_t **, c)
 
+/*
+ * Bitsets freed while a pool is entered on the calling thread are kept in it,
+ * up to its capacity, and handed out again by bitset_container_create and
+ * bitset_container_clone: operations creating many temporary bitsets then
+ * rarely reach the allocator. All the bitsets of a pool must come from the
+ * allocator current when it is entered.
+ */
+typedef struct bitset_container_pool_s {
+    bitset_container_t **bitsets;
+    int32_t size;
+    int32_t capacity;
+} bitset_container_pool_t;
+
+/* Routes the bitsets of the calling thread to `pool` (none if NULL), returns
+ * the previous pool to pass to bitset_container_pool_leave. */
+bitset_container_pool_t *bitset_container_pool_enter(
+    bitset_container_pool_t *pool);
+void bitset_container_pool_leave(bitset_container_pool_t *previous);
+
+/* Frees the bitsets of the pool, which must not be entered. */
+void bitset_container_pool_clear(bitset_container_pool_t *pool);
+
 /* Create a new bitset. Return NULL in case of failure. */
 bitset_container_t *bitset_container_create(void);
 
@@ -514,6 +536,16 @@ int bitset_container_get_index(const bitset_container_t *container, uint16_t x);
 int bitset_container_index_equalorlarger(const bitset_container_t *container,
                                          uint16_t x);
 
+/* Returns the first position at or after pos (in [0, 1 << 16)) whose bit is
+ * set, or 1 << 16 if there is none. Empty words are skipped several at a time
+ * (AVX2 when available). */
+uint32_t bitset_container_next_set_bit(const bitset_container_t *container,
+                                       uint32_t pos);
+
+/* Same as bitset_container_next_set_bit, looking for a cleared bit. */
+uint32_t bitset_container_next_clear_bit(const bitset_container_t *container,
+                                         uint32_t pos);
+
 #ifdef __cplusplus
 }
 }
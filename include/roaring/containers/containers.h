@@ -415,6 +415,48 @@ static inline int32_t container_size_in_bytes(const container_t *c,
     return 0;  // unreached
 }
 
+#ifdef __cplusplus
+using api::roaring_conversion_t;
+using api::roaring_kernel_counters_t;
+using api::roaring_kernel_op_t;
+using api::ROARING_CONVERSION_ARRAY_TO_BITSET;
+using api::ROARING_CONVERSION_ARRAY_TO_RUN;
+using api::ROARING_CONVERSION_BITSET_TO_ARRAY;
+using api::ROARING_CONVERSION_BITSET_TO_RUN;
+using api::ROARING_CONVERSION_RUN_TO_ARRAY;
+using api::ROARING_CONVERSION_RUN_TO_BITSET;
+using api::ROARING_KERNEL_AND;
+using api::ROARING_KERNEL_ANDNOT;
+using api::ROARING_KERNEL_OR;
+using api::ROARING_KERNEL_XOR;
+#endif
+
+/**
+ * Count a call to the kernel computing `op` on the two (unwrapped) containers,
+ * and a conversion of a container of `bytes` bytes, for
+ * roaring_kernel_counters. Without ROARING_KERNEL_COUNTERS, the macros expand
+ * to nothing.
+ */
+void container_count_pair(roaring_kernel_op_t op, const container_t *c1,
+                          uint8_t type1, const container_t *c2, uint8_t type2);
+void container_count_conversion(roaring_conversion_t conversion, int32_t bytes);
+
+/**
+ * Snapshot and reset of the counters, see roaring_kernel_counters.
+ */
+bool container_kernel_counters(roaring_kernel_counters_t *counters);
+void container_kernel_counters_reset(void);
+
+#if ROARING_KERNEL_COUNTERS
+#define COUNT_CONTAINER_PAIR(op, c1, type1, c2, type2) \
+    container_count_pair(op, c1, type1, c2, type2)
+#define COUNT_CONTAINER_CONVERSION(conversion, bytes) \
+    container_count_conversion(conversion, bytes)
+#else
+#define COUNT_CONTAINER_PAIR(op, c1, type1, c2, type2) ((void)0)
+#define COUNT_CONTAINER_CONVERSION(conversion, bytes) ((void)0)
+#endif
+
 /**
  * print the container (useful for debugging), requires a  typecode
  */
@@ -728,6 +770,7 @@ static inline container_t *container_and(const container_t *c1, uint8_t type1,
                                          uint8_t *result_type) {
     c1 = container_unwrap_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
+    COUNT_CONTAINER_PAIR(ROARING_KERNEL_AND, c1, type1, c2, type2);
     container_t *result = NULL;
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET, BITSET):
@@ -814,6 +857,7 @@ static inline int container_and_cardinality(const container_t *c1,
                                             uint8_t type2) {
     c1 = container_unwrap_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
+    COUNT_CONTAINER_PAIR(ROARING_KERNEL_AND, c1, type1, c2, type2);
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET, BITSET):
             return bitset_container_and_justcard(const_CAST_bitset(c1),
@@ -865,6 +909,7 @@ static inline bool container_intersect(const container_t *c1, uint8_t type1,
                                        const container_t *c2, uint8_t type2) {
     c1 = container_unwrap_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
+    COUNT_CONTAINER_PAIR(ROARING_KERNEL_AND, c1, type1, c2, type2);
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET, BITSET):
             return bitset_container_intersect(const_CAST_bitset(c1),
@@ -923,6 +968,7 @@ static inline container_t *container_iand(container_t *c1, uint8_t type1,
                                           uint8_t *result_type) {
     c1 = get_writable_copy_if_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
+    COUNT_CONTAINER_PAIR(ROARING_KERNEL_AND, c1, type1, c2, type2);
     container_t *result = NULL;
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET, BITSET):
@@ -1010,6 +1056,7 @@ static inline container_t *container_or(const container_t *c1, uint8_t type1,
                                         uint8_t *result_type) {
     c1 = container_unwrap_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
+    COUNT_CONTAINER_PAIR(ROARING_KERNEL_OR, c1, type1, c2, type2);
     container_t *result = NULL;
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET, BITSET):
@@ -1117,6 +1164,7 @@ static inline container_t *container_lazy_or(const container_t *c1,
                                              uint8_t *result_type) {
     c1 = container_unwrap_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
+    COUNT_CONTAINER_PAIR(ROARING_KERNEL_OR, c1, type1, c2, type2);
     container_t *result = NULL;
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET, BITSET):
@@ -1228,6 +1276,7 @@ static inline container_t *container_ior(container_t *c1, uint8_t type1,
                                          uint8_t *result_type) {
     c1 = get_writable_copy_if_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
+    COUNT_CONTAINER_PAIR(ROARING_KERNEL_OR, c1, type1, c2, type2);
     container_t *result = NULL;
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET, BITSET):
@@ -1337,6 +1386,7 @@ static inline container_t *container_lazy_ior(container_t *c1, uint8_t type1,
     assert(type1 != SHARED_CONTAINER_TYPE);
     // c1 = get_writable_copy_if_shared(c1,&type1);
     c2 = container_unwrap_shared(c2, &type2);
+    COUNT_CONTAINER_PAIR(ROARING_KERNEL_OR, c1, type1, c2, type2);
     container_t *result = NULL;
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET, BITSET):
@@ -1451,6 +1501,7 @@ static inline container_t *container_xor(const container_t *c1, uint8_t type1,
                                          uint8_t *result_type) {
     c1 = container_unwrap_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
+    COUNT_CONTAINER_PAIR(ROARING_KERNEL_XOR, c1, type1, c2, type2);
     container_t *result = NULL;
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET, BITSET):
@@ -1574,6 +1625,7 @@ static inline container_t *container_lazy_xor(const container_t *c1,
                                               uint8_t *result_type) {
     c1 = container_unwrap_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
+    COUNT_CONTAINER_PAIR(ROARING_KERNEL_XOR, c1, type1, c2, type2);
     container_t *result = NULL;
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET, BITSET):
@@ -1667,6 +1719,7 @@ static inline container_t *container_ixor(container_t *c1, uint8_t type1,
                                           uint8_t *result_type) {
     c1 = get_writable_copy_if_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
+    COUNT_CONTAINER_PAIR(ROARING_KERNEL_XOR, c1, type1, c2, type2);
     container_t *result = NULL;
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET, BITSET):
@@ -1755,6 +1808,8 @@ static inline container_t *container_lazy_ixor(container_t *c1, uint8_t type1,
     c2 = container_unwrap_shared(c2, &type2);
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET, BITSET):
+            // the other cases are counted by container_ixor
+            COUNT_CONTAINER_PAIR(ROARING_KERNEL_XOR, c1, type1, c2, type2);
             bitset_container_xor_nocard(CAST_bitset(c1), const_CAST_bitset(c2),
                                         CAST_bitset(c1));  // is lazy
             *result_type = BITSET_CONTAINER_TYPE;
@@ -1787,6 +1842,7 @@ static inline container_t *container_andnot(const container_t *c1,
                                             uint8_t *result_type) {
     c1 = container_unwrap_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
+    COUNT_CONTAINER_PAIR(ROARING_KERNEL_ANDNOT, c1, type1, c2, type2);
     container_t *result = NULL;
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET, BITSET):
@@ -1891,6 +1947,7 @@ static inline container_t *container_iandnot(container_t *c1, uint8_t type1,
                                              uint8_t *result_type) {
     c1 = get_writable_copy_if_shared(c1, &type1);
     c2 = container_unwrap_shared(c2, &type2);
+    COUNT_CONTAINER_PAIR(ROARING_KERNEL_ANDNOT, c1, type1, c2, type2);
     container_t *result = NULL;
     switch (PAIR_CONTAINER_TYPES(type1, type2)) {
         case CONTAINER_PAIR(BITSET, BITSET):
@@ -2699,6 +2756,68 @@ uint16_t container_iterator_find_run_start(const container_t *c,
                                            roaring_container_iterator_t *it,
                                            uint16_t *value, bool *has_more);
 
+/**
+ * Accumulates strictly increasing 16-bit values in an uncompressed scratch
+ * buffer (a sorted array, then a bitset past DEFAULT_MAX_SIZE values) and
+ * turns them into a right-sized container once complete. The number of runs
+ * is tracked as values come in so the final choice between array, bitset and
+ * run container costs no extra pass unless a run container wins.
+ */
+typedef struct container_builder_s {
+    int32_t cardinality;
+    int32_t n_runs;
+    uint16_t last;    // last appended value, meaningless if cardinality == 0
+    uint64_t *words;  // BITSET_CONTAINER_SIZE_IN_WORDS words once allocated
+    bool is_bitset;   // whether the values are in words rather than values
+    uint16_t values[DEFAULT_MAX_SIZE];
+} container_builder_t;
+
+/**
+ * Prepares an empty builder.
+ */
+void container_builder_init(container_builder_t *b);
+
+/**
+ * Releases the scratch memory of the builder (not the built containers).
+ */
+void container_builder_clear(container_builder_t *b);
+
+/**
+ * Switches the builder from its array to its bitset scratch buffer. Returns
+ * false if memory allocation failed.
+ */
+bool container_builder_to_bitset(container_builder_t *b);
+
+/**
+ * Appends val, which must be larger than any value appended since the last
+ * container_builder_finish. Returns false, leaving the builder unchanged, if
+ * memory allocation failed.
+ */
+static inline bool container_builder_append(container_builder_t *b,
+                                            uint16_t val) {
+    assert(b->cardinality == 0 || val > b->last);
+    if (!b->is_bitset && b->cardinality >= DEFAULT_MAX_SIZE &&
+        !container_builder_to_bitset(b)) {
+        return false;
+    }
+    b->n_runs += (b->cardinality == 0 || val != b->last + 1);
+    b->last = val;
+    if (!b->is_bitset) {
+        b->values[b->cardinality++] = val;
+        return true;
+    }
+    b->words[val >> 6] |= UINT64_C(1) << (val & 63);
+    b->cardinality++;
+    return true;
+}
+
+/**
+ * Returns a new container holding the appended values, or NULL if none were
+ * appended or memory allocation failed, and resets the builder for reuse.
+ */
+container_t *container_builder_finish(container_builder_t *b,
+                                      uint8_t *typecode);
+
 #ifdef __cplusplus
 }
 }
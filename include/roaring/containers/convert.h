@@ -54,6 +54,12 @@ container_t *convert_to_bitset_or_array_container(run_container_t *rc,
 container_t *convert_run_optimize(container_t *c, uint8_t typecode_original,
                                   uint8_t *typecode_after);
 
+/* Creates the most space-efficient container (array, bitset or run) holding
+ * the set bits of the BITSET_CONTAINER_SIZE_IN_WORDS words, which must not all
+ * be zero. The words are copied as they are into a bitset container. Returns
+ * NULL on allocation failure. */
+container_t *container_from_words(const uint64_t *words, uint8_t *typecode);
+
 /* converts a run container to either an array or a bitset, IF it saves space.
  */
 /* If a conversion occurs, the caller is responsible to free the original
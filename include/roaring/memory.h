@@ -13,7 +13,9 @@
 #ifndef INCLUDE_ROARING_MEMORY_H_
 #define INCLUDE_ROARING_MEMORY_H_
 
+#include <stdbool.h>
 #include <stddef.h>  // for size_t
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -44,6 +46,166 @@ void roaring_free(void*);
 void* roaring_aligned_malloc(size_t, size_t);
 void roaring_aligned_free(void*);
 
+/**
+ * What the library allocates memory for, as told apart by the allocation
+ * statistics.
+ */
+typedef enum roaring_allocation_site_e {
+    // container structs and their arrays, bitsets and runs
+    ROARING_ALLOCATION_CONTAINERS,
+    // keys, container pointers and typecodes of 32-bit bitmaps
+    ROARING_ALLOCATION_ROARING_ARRAY,
+    // radix tree nodes and container tables of 64-bit bitmaps
+    ROARING_ALLOCATION_ART,
+    // bitmap structs, iterators, bitset_t and the rest
+    ROARING_ALLOCATION_OTHER,
+    ROARING_ALLOCATION_SITE_COUNT
+} roaring_allocation_site_t;
+
+/**
+ * For internal use. Same as roaring_malloc and co, allocations being counted
+ * for `site`. A block keeps its site when reallocated.
+ */
+void* roaring_malloc_at(roaring_allocation_site_t site, size_t size);
+void* roaring_realloc_at(roaring_allocation_site_t site, void* p, size_t size);
+void* roaring_calloc_at(roaring_allocation_site_t site, size_t n_elements,
+                        size_t element_size);
+void* roaring_aligned_malloc_at(roaring_allocation_site_t site,
+                                size_t alignment, size_t size);
+
+/**
+ * Bytes requested by the library through roaring_malloc and co, per site.
+ * Allocations served by an arena are not counted: see
+ * roaring_arena_size_in_bytes.
+ */
+typedef struct roaring_allocation_stats_s {
+    uint64_t bytes[ROARING_ALLOCATION_SITE_COUNT];        // live
+    uint64_t peak_bytes[ROARING_ALLOCATION_SITE_COUNT];   // high-water marks
+    uint64_t allocations[ROARING_ALLOCATION_SITE_COUNT];  // so far
+    uint64_t total_bytes;                                 // live, all sites
+    uint64_t peak_total_bytes;
+} roaring_allocation_stats_t;
+
+/**
+ * Fills `stats` with the allocation statistics of the process and returns
+ * true, or zeroes it and returns false when the library was not built with
+ * ROARING_ALLOCATION_STATS (CMake option of the same name). The counters are
+ * updated atomically when the compiler supports atomics.
+ *
+ * With the statistics, each block is preceded by a 16-byte header (or the
+ * alignment, if larger) recording what it was counted for.
+ */
+bool roaring_allocation_stats(roaring_allocation_stats_t* stats);
+
+/**
+ * Restarts the high-water marks from the live bytes.
+ */
+void roaring_allocation_stats_reset_peaks(void);
+
+/**
+ * An allocator attached to bitmaps, unlike the memory hooks which serve the
+ * whole process: see roaring_bitmap_create_with_allocator and
+ * roaring64_bitmap_create_with_allocator. The containers of such a bitmap
+ * come from the allocator, and so do those of the bitmaps computed from it
+ * (copies, unions, intersections...), which use the allocator of their first
+ * operand.
+ *
+ * Every function receives `context`. The allocator, which is referenced and
+ * not copied, must outlive the bitmaps using it. It is called from the threads
+ * modifying these bitmaps, which never happens from several threads at once
+ * for a given bitmap. For this reason, functions given a roaring_executor_t
+ * ignore it for such bitmaps and run all of their tasks on the calling thread.
+ */
+typedef struct roaring_allocator_s {
+    void* (*malloc)(void* context, size_t size);
+    void* (*realloc)(void* context, void* p, size_t size);
+    void (*free)(void* context, void* p);
+    void* (*aligned_malloc)(void* context, size_t alignment, size_t size);
+    void (*aligned_free)(void* context, void* p);
+    void* context;
+} roaring_allocator_t;
+
+/**
+ * An arena serves allocations from large slabs obtained through the memory
+ * hooks and gives them back all at once. Bitmaps created in an arena (see
+ * roaring_bitmap_create_in_arena) take their containers from it, so that
+ * growing them rarely reaches the memory hooks and freeing them is O(1).
+ * Memory released by a bitmap of an arena is only reused once the bitmap is
+ * compacted (see roaring_bitmap_shrink_to_fit) or the arena is freed.
+ *
+ * An arena is not thread safe: its bitmaps must not be modified concurrently,
+ * though they may be read concurrently as usual.
+ */
+typedef struct roaring_arena_s roaring_arena_t;
+
+/**
+ * Creates an arena allocating slabs of `slab_size` bytes, or of a default
+ * size if `slab_size` is zero. Larger allocations get a slab of their own.
+ * Returns NULL on failure.
+ */
+roaring_arena_t* roaring_arena_create(size_t slab_size);
+
+/**
+ * Releases the arena. Its slabs are given back once the bitmaps created in it
+ * are freed too: the bitmaps may be freed before or after the arena.
+ */
+void roaring_arena_free(roaring_arena_t* arena);
+
+/**
+ * Returns the number of bytes the arena obtained through the memory hooks.
+ */
+size_t roaring_arena_size_in_bytes(const roaring_arena_t* arena);
+
+/**
+ * Returns the allocator of the arena, which lives as long as the arena. The
+ * bitmaps created with it are bitmaps of the arena.
+ */
+const roaring_allocator_t* roaring_arena_allocator(roaring_arena_t* arena);
+
+/**
+ * For internal use. Returns the arena whose allocator is `allocator`, NULL if
+ * it is not the allocator of an arena.
+ */
+roaring_arena_t* roaring_allocator_arena(const roaring_allocator_t* allocator);
+
+/**
+ * For internal use. Routes the allocations of the calling thread to
+ * `allocator`, or to the memory hooks when NULL, and returns the previous
+ * allocator to be passed to roaring_allocator_leave.
+ */
+const roaring_allocator_t* roaring_allocator_enter(
+    const roaring_allocator_t* allocator);
+void roaring_allocator_leave(const roaring_allocator_t* previous);
+
+/**
+ * For internal use. Returns the allocator allocations of the calling thread
+ * are routed to, NULL if none.
+ */
+const roaring_allocator_t* roaring_allocator_current(void);
+
+/**
+ * For internal use. Allocates from the memory hooks whatever the allocator of
+ * the calling thread.
+ */
+void* roaring_hooks_malloc(size_t);
+void roaring_hooks_free(void*);
+
+/**
+ * For internal use. Counts the bitmaps of the arena, which is only dropped
+ * once it has been freed and has no bitmap left.
+ */
+void roaring_arena_add_bitmap(roaring_arena_t* arena);
+void roaring_arena_remove_bitmap(roaring_arena_t* arena);
+size_t roaring_arena_bitmap_count(const roaring_arena_t* arena);
+
+/**
+ * For internal use. Calls `copy(context)` with the arena emptied, so that
+ * the copy takes fresh slabs, and drops the former slabs if it returns true.
+ * On failure the former slabs are kept. Returns the bytes given back.
+ */
+size_t roaring_arena_compact(roaring_arena_t* arena, bool (*copy)(void*),
+                             void* context);
+
 #ifdef __cplusplus
 }
 #endif
@@ -645,6 +645,94 @@ static inline uint32_t croaring_refcount_get(const croaring_refcount_t *val) {
 #error "Unknown atomic implementation"
 #endif
 
+// 64-bit counters for statistics, whose updates order nothing.
+#if CROARING_ATOMIC_IMPL == CROARING_ATOMIC_IMPL_C
+typedef _Atomic(uint64_t) croaring_counter_t;
+
+static inline uint64_t croaring_counter_load(croaring_counter_t *c) {
+    return atomic_load_explicit(c, memory_order_relaxed);
+}
+
+static inline void croaring_counter_store(croaring_counter_t *c,
+                                          uint64_t value) {
+    atomic_store_explicit(c, value, memory_order_relaxed);
+}
+
+// Returns the new value.
+static inline uint64_t croaring_counter_add(croaring_counter_t *c,
+                                            uint64_t n) {
+    return atomic_fetch_add_explicit(c, n, memory_order_relaxed) + n;
+}
+
+static inline void croaring_counter_sub(croaring_counter_t *c, uint64_t n) {
+    atomic_fetch_sub_explicit(c, n, memory_order_relaxed);
+}
+
+static inline void croaring_counter_max(croaring_counter_t *c,
+                                        uint64_t value) {
+    uint64_t old = atomic_load_explicit(c, memory_order_relaxed);
+    while (old < value &&
+           !atomic_compare_exchange_weak_explicit(
+               c, &old, value, memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+#elif CROARING_ATOMIC_IMPL == CROARING_ATOMIC_IMPL_CPP
+typedef std::atomic<uint64_t> croaring_counter_t;
+
+static inline uint64_t croaring_counter_load(croaring_counter_t *c) {
+    return c->load(std::memory_order_relaxed);
+}
+
+static inline void croaring_counter_store(croaring_counter_t *c,
+                                          uint64_t value) {
+    c->store(value, std::memory_order_relaxed);
+}
+
+static inline uint64_t croaring_counter_add(croaring_counter_t *c,
+                                            uint64_t n) {
+    return c->fetch_add(n, std::memory_order_relaxed) + n;
+}
+
+static inline void croaring_counter_sub(croaring_counter_t *c, uint64_t n) {
+    c->fetch_sub(n, std::memory_order_relaxed);
+}
+
+static inline void croaring_counter_max(croaring_counter_t *c,
+                                        uint64_t value) {
+    uint64_t old = c->load(std::memory_order_relaxed);
+    while (old < value &&
+           !c->compare_exchange_weak(old, value, std::memory_order_relaxed)) {
+    }
+}
+#else
+// Without atomics, the counters are only exact if a single thread updates
+// them.
+typedef uint64_t croaring_counter_t;
+
+static inline uint64_t croaring_counter_load(croaring_counter_t *c) {
+    return *c;
+}
+
+static inline void croaring_counter_store(croaring_counter_t *c,
+                                          uint64_t value) {
+    *c = value;
+}
+
+static inline uint64_t croaring_counter_add(croaring_counter_t *c,
+                                            uint64_t n) {
+    return *c += n;
+}
+
+static inline void croaring_counter_sub(croaring_counter_t *c, uint64_t n) {
+    *c -= n;
+}
+
+static inline void croaring_counter_max(croaring_counter_t *c,
+                                        uint64_t value) {
+    if (*c < value) *c = value;
+}
+#endif
+
 #if defined(__GNUC__) || defined(__clang__)
 #define CROARING_DEPRECATED __attribute__((deprecated))
 #elif defined(_MSC_VER)
@@ -669,6 +757,14 @@ static inline uint32_t croaring_refcount_get(const croaring_refcount_t *val) {
 #define CROARING_STATIC_ASSERT(x, y) _Static_assert(x, y)
 #endif
 
+#if defined(__cplusplus)
+#define CROARING_THREAD_LOCAL thread_local
+#elif defined(_MSC_VER)
+#define CROARING_THREAD_LOCAL __declspec(thread)
+#else
+#define CROARING_THREAD_LOCAL _Thread_local
+#endif
+
 // We need portability.h to be included first,
 // but we also always want isadetection.h to be
 // included (right after).
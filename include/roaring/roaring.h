@@ -57,6 +57,26 @@ inline roaring_bitmap_t *roaring_bitmap_create(void) {
     return roaring_bitmap_create_with_capacity(0);
 }
 
+/**
+ * Dynamically allocates a new bitmap (initially empty) whose containers are
+ * allocated with `allocator` rather than the memory hooks (see
+ * roaring_allocator_t). The bitmaps computed from it, such as its copies or
+ * the results of `roaring_bitmap_or(r, x)`, use the same allocator.
+ *
+ * Copy-on-write sharing only happens between bitmaps with the same allocator.
+ * Returns NULL if the allocation fails.
+ */
+roaring_bitmap_t *roaring_bitmap_create_with_allocator(
+    const roaring_allocator_t *allocator);
+
+/**
+ * Same as `roaring_bitmap_create_with_allocator()` with the allocator of the
+ * arena (see roaring_arena_t), which several bitmaps may share.
+ * `roaring_bitmap_free()` then only releases the bitmap itself, in constant
+ * time, and the containers go when the arena goes.
+ */
+roaring_bitmap_t *roaring_bitmap_create_in_arena(roaring_arena_t *arena);
+
 /**
  * Initialize a roaring bitmap structure in memory controlled by client.
  * Capacity is a performance hint for how many "containers" the data will need.
@@ -348,6 +368,76 @@ roaring_bitmap_t *roaring_bitmap_andnot(const roaring_bitmap_t *r1,
 void roaring_bitmap_andnot_inplace(roaring_bitmap_t *r1,
                                    const roaring_bitmap_t *r2);
 
+/**
+ * A workspace keeps the bitset containers (8 KB each) that set operations
+ * create and drop along the way, such as intersections of bitsets yielding
+ * arrays or the bitsets of lazy unions, so that the next operations reuse
+ * them instead of allocating again. It is passed to the `_ex` variants of the
+ * operations, which are otherwise the same.
+ *
+ * The pooled bitsets come from the allocator of the bitmaps computed, which
+ * must outlive the workspace unless they are all heap bitmaps: when the
+ * allocator changes, the pooled bitsets are given back first. Bitmaps of an
+ * arena do without the workspace.
+ *
+ * A workspace holds no global state, but it must not be used by several
+ * threads at once: use one per thread.
+ */
+typedef struct roaring_workspace_s roaring_workspace_t;
+
+/**
+ * Creates a workspace keeping up to `max_bitsets` bitsets, or a default number
+ * if zero. Returns NULL if the allocation fails.
+ */
+roaring_workspace_t *roaring_workspace_create(size_t max_bitsets);
+
+/**
+ * Frees the workspace along with the bitsets it keeps.
+ */
+void roaring_workspace_free(roaring_workspace_t *workspace);
+
+/**
+ * Same as `roaring_bitmap_and()`, with a workspace (which may be NULL).
+ */
+roaring_bitmap_t *roaring_bitmap_and_ex(const roaring_bitmap_t *r1,
+                                        const roaring_bitmap_t *r2,
+                                        roaring_workspace_t *workspace);
+
+/**
+ * Same as `roaring_bitmap_or()`, with a workspace (which may be NULL).
+ */
+roaring_bitmap_t *roaring_bitmap_or_ex(const roaring_bitmap_t *r1,
+                                       const roaring_bitmap_t *r2,
+                                       roaring_workspace_t *workspace);
+
+/**
+ * Same as `roaring_bitmap_xor()`, with a workspace (which may be NULL).
+ */
+roaring_bitmap_t *roaring_bitmap_xor_ex(const roaring_bitmap_t *r1,
+                                        const roaring_bitmap_t *r2,
+                                        roaring_workspace_t *workspace);
+
+/**
+ * Same as `roaring_bitmap_andnot()`, with a workspace (which may be NULL).
+ */
+roaring_bitmap_t *roaring_bitmap_andnot_ex(const roaring_bitmap_t *r1,
+                                           const roaring_bitmap_t *r2,
+                                           roaring_workspace_t *workspace);
+
+/**
+ * Same as `roaring_bitmap_or_many()`, with a workspace (which may be NULL).
+ */
+roaring_bitmap_t *roaring_bitmap_or_many_ex(size_t number,
+                                            const roaring_bitmap_t **rs,
+                                            roaring_workspace_t *workspace);
+
+/**
+ * Same as `roaring_bitmap_xor_many()`, with a workspace (which may be NULL).
+ */
+roaring_bitmap_t *roaring_bitmap_xor_many_ex(size_t number,
+                                             const roaring_bitmap_t **rs,
+                                             roaring_workspace_t *workspace);
+
 /**
  * TODO: consider implementing:
  *
@@ -410,11 +500,82 @@ void roaring_bitmap_add_bulk(roaring_bitmap_t *r,
 void roaring_bitmap_add_many(roaring_bitmap_t *r, size_t n_args,
                              const uint32_t *vals);
 
+/**
+ * Add value n_args from pointer vals, in any order. This is meant for large
+ * unsorted batches (e.g., event streams) for which `roaring_bitmap_add_many()`
+ * keeps switching between containers: the values are first partitioned by
+ * their high 16 bits into a scratch buffer of n_args 16-bit words, then each
+ * container is built once from its partition.
+ *
+ * The containers are independent and may be built concurrently by passing an
+ * executor (see roaring_executor_t); NULL builds them on the calling thread,
+ * and so does a bitmap with an allocator or in an arena, for which the
+ * executor is ignored. Small batches are simply forwarded to
+ * `roaring_bitmap_add_many()`.
+ *
+ * Returns false, leaving r unchanged, if memory allocation failed while
+ * building the containers. When r is not empty, they are then merged into it
+ * as by `roaring_bitmap_or_inplace()`, which does not report allocation
+ * failures, and neither does `roaring_bitmap_add_many()` for small batches.
+ */
+bool roaring_bitmap_add_many_unsorted(roaring_bitmap_t *r, size_t n_args,
+                                      const uint32_t *vals,
+                                      const roaring_executor_t *executor);
+
+/**
+ * Creates a new bitmap from a pointer of uint32_t integers given in any order,
+ * see `roaring_bitmap_add_many_unsorted()`.
+ * The returned pointer may be NULL in case of errors.
+ */
+roaring_bitmap_t *roaring_bitmap_of_unsorted(
+    size_t n_args, const uint32_t *vals, const roaring_executor_t *executor);
+
 /**
  * Add value x
  */
 void roaring_bitmap_add(roaring_bitmap_t *r, uint32_t x);
 
+/**
+ * (For advanced users.)
+ * An appender adds strictly increasing values (e.g., row ids) to a bitmap
+ * faster than `roaring_bitmap_add()`: the values sharing their high 16 bits
+ * are kept in an uncompressed scratch buffer, and only turned into a
+ * right-sized container (array, bitset or run) once a larger key comes in.
+ *
+ * Values that are not larger than the previous one are still added, but
+ * slowly. The appended values may not be visible in the bitmap until
+ * `roaring_bitmap_appender_flush()` or `roaring_bitmap_appender_free()` is
+ * called, and the bitmap must not otherwise be modified in between.
+ */
+typedef struct roaring_bitmap_appender_s roaring_bitmap_appender_t;
+
+/**
+ * Creates an appender adding values to r.
+ * The returned pointer may be NULL in case of errors.
+ */
+roaring_bitmap_appender_t *roaring_bitmap_appender_create(roaring_bitmap_t *r);
+
+/**
+ * Add value val, see `roaring_bitmap_appender_t`.
+ * Returns false if memory allocation failed, in which case val, or values
+ * appended before it and not yet flushed, are missing from the bitmap.
+ */
+bool roaring_bitmap_appender_add(roaring_bitmap_appender_t *a, uint32_t val);
+
+/**
+ * Moves all the values appended so far into the bitmap.
+ * Returns false if memory allocation failed, in which case the values
+ * appended since the previous flush are missing from the bitmap.
+ */
+bool roaring_bitmap_appender_flush(roaring_bitmap_appender_t *a);
+
+/**
+ * Flushes the appender, then frees it. The bitmap is not freed. Allocation
+ * failures while flushing are not reported: call
+ * `roaring_bitmap_appender_flush()` first to check for them.
+ */
+void roaring_bitmap_appender_free(roaring_bitmap_appender_t *a);
+
 /**
  * Add value x
  * Returns true if a new value was added, false if the value already existed.
@@ -588,6 +749,46 @@ void roaring_bitmap_to_uint32_array(const roaring_bitmap_t *r, uint32_t *ans);
  */
 bool roaring_bitmap_to_bitset(const roaring_bitmap_t *r, bitset_t *bitset);
 
+/**
+ * Writes the bits of the values in [start, start + n) to the caller-provided
+ * ${words}, which must hold at least (n + 63) / 64 words: value start + i is
+ * stored as bit i % 64 of words[i / 64]. All the words are overwritten, and
+ * the bits past n in the last word are cleared. Values above UINT32_MAX read
+ * as absent.
+ *
+ * Nothing is allocated. Bitset containers are copied word by word (memcpy
+ * when start is a multiple of 64), run containers are filled range by range,
+ * and array containers set their values one by one.
+ *
+ * See `roaring_uint32_iterator_read_words()` to export consecutive windows.
+ */
+void roaring_bitmap_to_words(const roaring_bitmap_t *r, uint32_t start,
+                             uint32_t n, uint64_t *words);
+
+/**
+ * Creates a bitmap from a dense bitvector: bit i % 64 of words[i / 64] stands
+ * for the value base_offset + i. Bits for values above UINT32_MAX are
+ * ignored. This is the inverse of `roaring_bitmap_to_words()`.
+ *
+ * Each 65536-bit chunk becomes an array, bitset or run container depending
+ * on its cardinality and number of runs. When base_offset is a multiple of
+ * 65536, full chunks are read in place and bitset containers are copied with
+ * memcpy.
+ *
+ * Returns NULL on allocation failure.
+ */
+roaring_bitmap_t *roaring_bitmap_from_words(const uint64_t *words,
+                                            size_t nwords,
+                                            uint32_t base_offset);
+
+/**
+ * Same as `roaring_bitmap_from_words()`, but adds the values to the existing
+ * bitmap r. Returns false on allocation failure, in which case r holds some
+ * of the values.
+ */
+bool roaring_bitmap_or_words(roaring_bitmap_t *r, const uint64_t *words,
+                             size_t nwords, uint32_t base_offset);
+
 /**
  * Convert the bitmap to a sorted array from `offset` by `limit`, output in
  * `ans`.
@@ -623,9 +824,28 @@ bool roaring_bitmap_run_optimize(roaring_bitmap_t *r);
 /**
  * If needed, reallocate memory to shrink the memory usage.
  * Returns the number of bytes saved.
+ *
+ * A bitmap created in an arena is compacted instead: when it is the only bitmap
+ * left in the arena, its containers are copied to fresh slabs and the former
+ * slabs are released. Returns the number of bytes the arena gave back.
  */
 size_t roaring_bitmap_shrink_to_fit(roaring_bitmap_t *r);
 
+/**
+ * Same as `roaring_bitmap_remove_run_compression()`,
+ * `roaring_bitmap_run_optimize()` and `roaring_bitmap_shrink_to_fit()`, but
+ * the containers, which are independent, are processed in chunks through the
+ * executor (see roaring_executor_t). A NULL executor processes them on the
+ * calling thread, as does a bitmap with an allocator or in an arena, for
+ * which the executor is ignored.
+ */
+bool roaring_bitmap_remove_run_compression_parallel(
+    roaring_bitmap_t *r, const roaring_executor_t *executor);
+bool roaring_bitmap_run_optimize_parallel(roaring_bitmap_t *r,
+                                          const roaring_executor_t *executor);
+size_t roaring_bitmap_shrink_to_fit_parallel(
+    roaring_bitmap_t *r, const roaring_executor_t *executor);
+
 /**
  * Write the bitmap to an output pointer, this output buffer should refer to
  * at least `roaring_bitmap_size_in_bytes(r)` allocated bytes.
@@ -746,6 +966,15 @@ roaring_bitmap_t *roaring_bitmap_portable_deserialize(const char *buf);
 roaring_bitmap_t *roaring_bitmap_portable_deserialize_safe(const char *buf,
                                                            size_t maxbytes);
 
+/**
+ * Same as `roaring_bitmap_portable_deserialize_safe()`, but the containers
+ * are decoded in ranges handed to the executor (see roaring_executor_t). The
+ * header is parsed and bounds-checked once on the calling thread. A NULL
+ * executor decodes everything on the calling thread.
+ */
+roaring_bitmap_t *roaring_bitmap_portable_deserialize_safe_parallel(
+    const char *buf, size_t maxbytes, const roaring_executor_t *executor);
+
 /**
  * Read bitmap from a serialized buffer.
  * In case of failure, NULL is returned.
@@ -805,6 +1034,15 @@ size_t roaring_bitmap_portable_size_in_bytes(const roaring_bitmap_t *r);
  */
 size_t roaring_bitmap_portable_serialize(const roaring_bitmap_t *r, char *buf);
 
+/**
+ * Same as `roaring_bitmap_portable_serialize()`, and produces the same bytes,
+ * but the containers are written in ranges handed to the executor (see
+ * roaring_executor_t). A NULL executor writes everything on the calling
+ * thread.
+ */
+size_t roaring_bitmap_portable_serialize_parallel(
+    const roaring_bitmap_t *r, char *buf, const roaring_executor_t *executor);
+
 /*
  * "Frozen" serialization format imitates memory layout of roaring_bitmap_t.
  * Deserialized bitmap is a constant view of the underlying buffer.
@@ -944,6 +1182,19 @@ void roaring_bitmap_lazy_or_inplace(roaring_bitmap_t *r1,
                                     const roaring_bitmap_t *r2,
                                     const bool bitsetconversion);
 
+/**
+ * Same as `roaring_bitmap_lazy_or()` and `roaring_bitmap_lazy_or_inplace()`,
+ * with a workspace (which may be NULL, see roaring_workspace_t).
+ */
+roaring_bitmap_t *roaring_bitmap_lazy_or_ex(const roaring_bitmap_t *r1,
+                                            const roaring_bitmap_t *r2,
+                                            const bool bitsetconversion,
+                                            roaring_workspace_t *workspace);
+void roaring_bitmap_lazy_or_inplace_ex(roaring_bitmap_t *r1,
+                                       const roaring_bitmap_t *r2,
+                                       const bool bitsetconversion,
+                                       roaring_workspace_t *workspace);
+
 /**
  * (For expert users who seek high performance.)
  *
@@ -952,6 +1203,13 @@ void roaring_bitmap_lazy_or_inplace(roaring_bitmap_t *r1,
  */
 void roaring_bitmap_repair_after_lazy(roaring_bitmap_t *r1);
 
+/**
+ * Same as `roaring_bitmap_repair_after_lazy()`, with a workspace (which may be
+ * NULL): the bitsets turned into arrays are kept in it.
+ */
+void roaring_bitmap_repair_after_lazy_ex(roaring_bitmap_t *r1,
+                                         roaring_workspace_t *workspace);
+
 /**
  * Computes the symmetric difference between two bitmaps and returns new bitmap.
  * The caller is responsible for memory management.
@@ -976,6 +1234,17 @@ roaring_bitmap_t *roaring_bitmap_lazy_xor(const roaring_bitmap_t *r1,
 void roaring_bitmap_lazy_xor_inplace(roaring_bitmap_t *r1,
                                      const roaring_bitmap_t *r2);
 
+/**
+ * Same as `roaring_bitmap_lazy_xor()` and `roaring_bitmap_lazy_xor_inplace()`,
+ * with a workspace (which may be NULL).
+ */
+roaring_bitmap_t *roaring_bitmap_lazy_xor_ex(const roaring_bitmap_t *r1,
+                                             const roaring_bitmap_t *r2,
+                                             roaring_workspace_t *workspace);
+void roaring_bitmap_lazy_xor_inplace_ex(roaring_bitmap_t *r1,
+                                        const roaring_bitmap_t *r2,
+                                        roaring_workspace_t *workspace);
+
 /**
  * Compute the negation of the bitmap in the interval [range_start, range_end).
  * The number of negated values is range_end - range_start.
@@ -1074,6 +1343,26 @@ uint32_t roaring_bitmap_maximum(const roaring_bitmap_t *r);
 void roaring_bitmap_statistics(const roaring_bitmap_t *r,
                                roaring_statistics_t *stat);
 
+/**
+ * (For advanced users.)
+ *
+ * Fills `counters` with the number of calls to the container kernels of the
+ * process, and the bytes they were given, per operation and pair of container
+ * types, as well as the conversions between containers, and returns true. Or
+ * zeroes it and returns false when the library was not built with
+ * ROARING_KERNEL_COUNTERS (CMake option of the same name): the counters cost
+ * nothing otherwise. Meant to tune thresholds such as DEFAULT_MAX_SIZE against
+ * an actual workload.
+ */
+bool roaring_kernel_counters(roaring_kernel_counters_t *counters);
+
+/**
+ * (For advanced users.)
+ *
+ * Sets the kernel counters back to zero.
+ */
+void roaring_kernel_counters_reset(void);
+
 /**
  * Perform internal consistency checks. Returns true if the bitmap is
  * consistent. It may be useful to call this after deserializing bitmaps from
@@ -1356,6 +1645,35 @@ size_t roaring_uint32_iterator_read_prev_ranges(
     roaring_uint32_iterator_t *it, roaring_uint32_range_closed_t *buf,
     size_t count);
 
+/**
+ * Writes the ranges of the bitmap within [range_start, range_end) to
+ * ${ranges}, as maximal intervals of consecutive values clipped to
+ * [range_start, range_end), in increasing order. Intervals spanning several
+ * containers are merged. Run containers are read run by run, and bitset
+ * containers skip over empty and full words several at a time.
+ *
+ * Returns the number of ranges written, at most ${max_ranges}. When it
+ * returns ${max_ranges} there may be more: call again with range_start set to
+ * two past the max of the last range.
+ */
+size_t roaring_bitmap_range_runs(const roaring_bitmap_t *r,
+                                 uint64_t range_start, uint64_t range_end,
+                                 roaring_uint32_range_closed_t *ranges,
+                                 size_t max_ranges);
+
+/**
+ * Same as `roaring_bitmap_to_words()` for the iterated bitmap, but only the
+ * values at or after the iterator's current value are written, and the
+ * iterator is moved to the first value at or after start + n. Reading
+ * consecutive windows ([0, n), then [n, 2n) and so on) with one iterator thus
+ * avoids searching the bitmap for each window.
+ *
+ * Returns true if the iterator has a value after the call.
+ */
+bool roaring_uint32_iterator_read_words(roaring_uint32_iterator_t *it,
+                                        uint32_t start, uint32_t n,
+                                        uint64_t *words);
+
 #ifdef __cplusplus
 }
 }
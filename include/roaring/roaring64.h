@@ -59,6 +59,23 @@ typedef struct roaring64_bulk_context_s {
 roaring64_bitmap_t *roaring64_bitmap_create(void);
 void roaring64_bitmap_free(roaring64_bitmap_t *r);
 
+/**
+ * Dynamically allocates a new bitmap (initially empty) whose containers and
+ * internal tree are allocated with `allocator` rather than the memory hooks
+ * (see roaring_allocator_t). The bitmaps computed from it, such as its copies
+ * or the results of `roaring64_bitmap_or(r, x)`, use the same allocator.
+ * The returned pointer may be NULL in case of errors.
+ */
+roaring64_bitmap_t *roaring64_bitmap_create_with_allocator(
+    const roaring_allocator_t *allocator);
+
+/**
+ * Same as `roaring64_bitmap_create_with_allocator()` with the allocator of the
+ * arena (see roaring_arena_t). `roaring64_bitmap_free()` then only releases
+ * the bitmap itself, in constant time.
+ */
+roaring64_bitmap_t *roaring64_bitmap_create_in_arena(roaring_arena_t *arena);
+
 /**
  * Returns a copy of a bitmap.
  * The returned pointer may be NULL in case of errors.
@@ -77,6 +94,21 @@ roaring64_bitmap_t *roaring64_bitmap_copy(const roaring64_bitmap_t *r);
 void roaring64_bitmap_overwrite(roaring64_bitmap_t *dest,
                                 const roaring64_bitmap_t *src);
 
+/**
+ * Whether the bitmap keeps a "hot leaf" cache: the container of the most
+ * recently used 65536-value block is remembered, so that
+ * `roaring64_bitmap_contains()`, `roaring64_bitmap_add()`,
+ * `roaring64_bitmap_remove()` and their `_checked` variants skip the search of
+ * the high 48 bits when consecutive calls fall in the same block.
+ *
+ * The cache is disabled by default. While it is enabled, even read-only calls
+ * such as `roaring64_bitmap_contains()` update the bitmap, so a bitmap with
+ * the cache enabled must not be read from several threads at once. Copies
+ * made with `roaring64_bitmap_copy()` inherit the setting.
+ */
+bool roaring64_bitmap_get_leaf_cache(const roaring64_bitmap_t *r);
+void roaring64_bitmap_set_leaf_cache(roaring64_bitmap_t *r, bool enabled);
+
 /**
  * Creates a new bitmap of a pointer to N 64-bit integers.
  */
@@ -177,6 +209,48 @@ void roaring64_bitmap_add_bulk(roaring64_bitmap_t *r,
 void roaring64_bitmap_add_many(roaring64_bitmap_t *r, size_t n_args,
                                const uint64_t *vals);
 
+/**
+ * (For advanced users.)
+ * An appender adds strictly increasing values to a bitmap faster than
+ * `roaring64_bitmap_add()`, see `roaring_bitmap_appender_t`: values sharing
+ * their high 48 bits are kept in a scratch buffer and inserted in the bitmap
+ * as a single right-sized container once a larger key comes in.
+ *
+ * The appended values may not be visible in the bitmap until
+ * `roaring64_bitmap_appender_flush()` or `roaring64_bitmap_appender_free()` is
+ * called, and the bitmap must not otherwise be modified in between.
+ */
+typedef struct roaring64_bitmap_appender_s roaring64_bitmap_appender_t;
+
+/**
+ * Creates an appender adding values to r.
+ * The returned pointer may be NULL in case of errors.
+ */
+roaring64_bitmap_appender_t *roaring64_bitmap_appender_create(
+    roaring64_bitmap_t *r);
+
+/**
+ * Add value val, see `roaring64_bitmap_appender_t`.
+ * Returns false if memory allocation failed, in which case val, or values
+ * appended before it and not yet flushed, are missing from the bitmap.
+ */
+bool roaring64_bitmap_appender_add(roaring64_bitmap_appender_t *a,
+                                   uint64_t val);
+
+/**
+ * Moves all the values appended so far into the bitmap.
+ * Returns false if memory allocation failed, in which case the values
+ * appended since the previous flush are missing from the bitmap.
+ */
+bool roaring64_bitmap_appender_flush(roaring64_bitmap_appender_t *a);
+
+/**
+ * Flushes the appender, then frees it. The bitmap is not freed. Allocation
+ * failures while flushing are not reported: call
+ * `roaring64_bitmap_appender_flush()` first to check for them.
+ */
+void roaring64_bitmap_appender_free(roaring64_bitmap_appender_t *a);
+
 /**
  * Add all values in range [min, max).
  */
@@ -360,6 +434,21 @@ bool roaring64_bitmap_run_optimize(roaring64_bitmap_t *r);
  */
 size_t roaring64_bitmap_shrink_to_fit(roaring64_bitmap_t *r);
 
+/**
+ * Same as `roaring64_bitmap_remove_run_compression()`,
+ * `roaring64_bitmap_run_optimize()` and `roaring64_bitmap_shrink_to_fit()`,
+ * but the containers are processed in chunks through the executor (see
+ * roaring_executor_t). A NULL executor processes them on the calling thread,
+ * as does a bitmap with an allocator or in an arena, for which the executor
+ * is ignored.
+ */
+bool roaring64_bitmap_remove_run_compression_parallel(
+    roaring64_bitmap_t *r, const roaring_executor_t *executor);
+bool roaring64_bitmap_run_optimize_parallel(roaring64_bitmap_t *r,
+                                            const roaring_executor_t *executor);
+size_t roaring64_bitmap_shrink_to_fit_parallel(
+    roaring64_bitmap_t *r, const roaring_executor_t *executor);
+
 /**
  *  (For advanced users.)
  * Collect statistics about the bitmap
@@ -451,6 +540,14 @@ bool roaring64_bitmap_intersect_with_range(const roaring64_bitmap_t *r,
 double roaring64_bitmap_jaccard_index(const roaring64_bitmap_t *r1,
                                       const roaring64_bitmap_t *r2);
 
+/**
+ * Computes the intersection of `number` bitmaps and returns a new bitmap. The
+ * caller is responsible for free-ing the result.
+ * The returned pointer may be NULL in case of errors.
+ */
+roaring64_bitmap_t *roaring64_bitmap_and_many(size_t number,
+                                              const roaring64_bitmap_t **rs);
+
 /**
  * Computes the union between two bitmaps and returns new bitmap. The caller is
  * responsible for free-ing the result.
@@ -471,6 +568,19 @@ uint64_t roaring64_bitmap_or_cardinality(const roaring64_bitmap_t *r1,
 void roaring64_bitmap_or_inplace(roaring64_bitmap_t *r1,
                                  const roaring64_bitmap_t *r2);
 
+/**
+ * Computes the union of `number` bitmaps and returns a new bitmap. The caller
+ * is responsible for free-ing the result.
+ *
+ * The inputs are merged in a single pass in key order, which is faster than
+ * repeated calls to `roaring64_bitmap_or_inplace()` when there are many of
+ * them.
+ *
+ * The returned pointer may be NULL in case of errors.
+ */
+roaring64_bitmap_t *roaring64_bitmap_or_many(size_t number,
+                                             const roaring64_bitmap_t **rs);
+
 /**
  * Computes the symmetric difference (xor) between two bitmaps and returns a new
  * bitmap. The caller is responsible for free-ing the result.
@@ -492,6 +602,14 @@ uint64_t roaring64_bitmap_xor_cardinality(const roaring64_bitmap_t *r1,
 void roaring64_bitmap_xor_inplace(roaring64_bitmap_t *r1,
                                   const roaring64_bitmap_t *r2);
 
+/**
+ * Computes the symmetric difference (xor) of `number` bitmaps and returns a
+ * new bitmap. The caller is responsible for free-ing the result.
+ * The returned pointer may be NULL in case of errors.
+ */
+roaring64_bitmap_t *roaring64_bitmap_xor_many(size_t number,
+                                              const roaring64_bitmap_t **rs);
+
 /**
  * Computes the difference (andnot) between two bitmaps and returns a new
  * bitmap. The caller is responsible for free-ing the result.
@@ -888,6 +1006,28 @@ size_t roaring64_iterator_read_prev_ranges(roaring64_iterator_t *it,
                                            roaring64_range_closed_t *buf,
                                            size_t count);
 
+/**
+ * Writes the ranges of the bitmap within [min, max) to ${ranges}, as maximal
+ * intervals of consecutive values clipped to [min, max), in increasing order.
+ * Intervals spanning several containers are merged.
+ *
+ * Returns the number of ranges written, at most ${max_ranges}. When it
+ * returns ${max_ranges} there may be more: call again with min set to two
+ * past the max of the last range.
+ */
+size_t roaring64_bitmap_range_runs(const roaring64_bitmap_t *r, uint64_t min,
+                                   uint64_t max,
+                                   roaring64_range_closed_t *ranges,
+                                   size_t max_ranges);
+
+/**
+ * Same as `roaring64_bitmap_range_runs()`, for the range [min, max].
+ */
+size_t roaring64_bitmap_range_closed_runs(const roaring64_bitmap_t *r,
+                                          uint64_t min, uint64_t max,
+                                          roaring64_range_closed_t *ranges,
+                                          size_t max_ranges);
+
 #ifdef __cplusplus
 }  // extern "C"
 }  // namespace roaring
@@ -21,6 +21,7 @@
 
 #include <roaring/array_util.h>
 #include <roaring/containers/containers.h>  // get_writable_copy_if_shared()
+#include <roaring/memory.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -28,6 +29,8 @@ namespace roaring {
 
 // Note: in pure C++ code, you should avoid putting `using` in header files
 using api::roaring_array_t;
+using api::roaring_executor_t;
+using api::roaring_task_fn;
 
 namespace internal {
 #endif
@@ -242,6 +245,18 @@ bool ra_portable_deserialize(roaring_array_t *ra, const char *buf,
  */
 size_t ra_portable_deserialize_size(const char *buf, const size_t maxbytes);
 
+/**
+ * Same output as ra_portable_serialize, and same result as
+ * ra_portable_deserialize, but the container payloads are written or decoded
+ * in ranges handed to the executor. A NULL executor falls back to the serial
+ * functions.
+ */
+size_t ra_portable_serialize_parallel(const roaring_array_t *ra, char *buf,
+                                      const roaring_executor_t *executor);
+bool ra_portable_deserialize_parallel(roaring_array_t *ra, const char *buf,
+                                      const size_t maxbytes, size_t *readbytes,
+                                      const roaring_executor_t *executor);
+
 /**
  * How many bytes are required to serialize this bitmap (meant to be
  * compatible
@@ -307,6 +322,46 @@ void ra_copy_range(roaring_array_t *ra, uint32_t begin, uint32_t end,
  */
 void ra_shift_tail(roaring_array_t *ra, int32_t count, int32_t distance);
 
+/**
+ * Work split across an executor is cut in at most this many tasks, so that
+ * per-task results can live in fixed-size arrays.
+ */
+enum { ROARING_MAX_TASKS = 64 };
+
+/**
+ * Fewer containers than this per task are not worth handing to an executor.
+ */
+enum { ROARING_MIN_CONTAINERS_PER_TASK = 64 };
+
+/**
+ * Returns the number of items per task when splitting n items into at most
+ * ROARING_MAX_TASKS tasks of at least min_chunk items each.
+ */
+static inline size_t roaring_task_chunk_size(size_t n, size_t min_chunk) {
+    size_t chunk = (n + ROARING_MAX_TASKS - 1) / ROARING_MAX_TASKS;
+    return chunk < min_chunk ? min_chunk : chunk;
+}
+
+/**
+ * Calls task(task_arg, i) for every i in [0, num_tasks). The calls go through
+ * the executor when one is provided, otherwise they run on the calling thread.
+ * They also run on the calling thread while its allocations go to the
+ * allocator of a bitmap, which is routed per thread and need not be thread
+ * safe.
+ */
+static inline void roaring_execute_tasks(const roaring_executor_t *executor,
+                                         size_t num_tasks, roaring_task_fn task,
+                                         void *task_arg) {
+    if (executor != NULL && executor->run != NULL && num_tasks > 1 &&
+        roaring_allocator_current() == NULL) {
+        executor->run(executor->context, num_tasks, task, task_arg);
+        return;
+    }
+    for (size_t i = 0; i < num_tasks; i++) {
+        task(task_arg, i);
+    }
+}
+
 #ifdef __cplusplus
 }  // namespace internal
 }
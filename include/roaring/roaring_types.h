@@ -12,6 +12,7 @@
 #define ROARING_TYPES_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include <roaring/portability.h>
@@ -63,11 +64,34 @@ typedef struct roaring_array_s {
     uint16_t *keys;
     uint8_t *typecodes;
     uint8_t flags;
+    // where the containers come from, NULL for the memory hooks
+    const struct roaring_allocator_s *allocator;
 } roaring_array_t;
 
 typedef bool (*roaring_iterator)(uint32_t value, void *param);
 typedef bool (*roaring_iterator64)(uint64_t value, void *param);
 
+/**
+ *  (For advanced users.)
+ * The library does not create threads. Functions that can split their work
+ * into independent tasks accept an optional roaring_executor_t: `run` must
+ * call `task(task_arg, i)` exactly once for every i in [0, num_tasks), in any
+ * order and on any thread, and return only once all calls have completed.
+ * Distinct task indexes never touch the same memory, so no synchronization is
+ * needed beyond the final join. Passing a NULL executor runs all tasks on the
+ * calling thread. So do bitmaps with an allocator or in an arena (see
+ * roaring_allocator_t), whose allocator need not be thread safe: the
+ * executor is ignored for them.
+ */
+typedef void (*roaring_task_fn)(void *task_arg, size_t task_index);
+typedef void (*roaring_executor_fn)(void *context, size_t num_tasks,
+                                    roaring_task_fn task, void *task_arg);
+
+typedef struct roaring_executor_s {
+    roaring_executor_fn run;
+    void *context; /* passed as the first argument of run */
+} roaring_executor_t;
+
 /**
  *  (For advanced users.)
  * The roaring_statistics_t can be used to collect detailed statistics about
@@ -141,6 +165,50 @@ typedef struct roaring64_statistics_s {
     // and n_values_arrays, n_values_rle, n_values_bitmap
 } roaring64_statistics_t;
 
+/**
+ * (For advanced users.)
+ * The set operations on containers counted by roaring_kernel_counters.
+ * Intersection cardinalities and intersection tests count as intersections.
+ */
+typedef enum roaring_kernel_op_e {
+    ROARING_KERNEL_AND,
+    ROARING_KERNEL_OR,
+    ROARING_KERNEL_XOR,
+    ROARING_KERNEL_ANDNOT,
+    ROARING_KERNEL_OP_COUNT
+} roaring_kernel_op_t;
+
+/**
+ * (For advanced users.)
+ * The conversions between containers counted by roaring_kernel_counters.
+ */
+typedef enum roaring_conversion_e {
+    ROARING_CONVERSION_ARRAY_TO_BITSET,
+    ROARING_CONVERSION_BITSET_TO_ARRAY,
+    ROARING_CONVERSION_RUN_TO_BITSET,
+    ROARING_CONVERSION_RUN_TO_ARRAY,
+    ROARING_CONVERSION_ARRAY_TO_RUN,
+    ROARING_CONVERSION_BITSET_TO_RUN,
+    ROARING_CONVERSION_COUNT
+} roaring_conversion_t;
+
+typedef struct roaring_kernel_count_s {
+    uint64_t calls;
+    uint64_t bytes;  // serialized sizes of the input containers
+} roaring_kernel_count_t;
+
+/**
+ * (For advanced users.)
+ * Counts of the container kernels run by the library, see
+ * roaring_kernel_counters.
+ */
+typedef struct roaring_kernel_counters_s {
+    // indexed by operation, then by the type of each container: 0 for
+    // bitsets, 1 for arrays and 2 for runs
+    roaring_kernel_count_t pairs[ROARING_KERNEL_OP_COUNT][3][3];
+    roaring_kernel_count_t conversions[ROARING_CONVERSION_COUNT];
+} roaring_kernel_counters_t;
+
 /**
  * Roaring-internal type used to iterate within a roaring container.
  */
@@ -249,6 +249,34 @@ struct many_union_heap {
 auto TotalUnionHeap = BasicBench<many_union_heap>;
 BENCHMARK(TotalUnionHeap);
 
+struct many_union64 {
+    static uint64_t run() {
+        uint64_t marker = 0;
+        roaring64_bitmap_t *totalorbitmap = roaring64_bitmap_or_many(
+            count, (const roaring64_bitmap_t **)bitmaps64);
+        marker = roaring64_bitmap_get_cardinality(totalorbitmap);
+        roaring64_bitmap_free(totalorbitmap);
+        return marker;
+    }
+};
+auto TotalUnion64 = BasicBench<many_union64>;
+BENCHMARK(TotalUnion64);
+
+struct many_union64_inplace {
+    static uint64_t run() {
+        uint64_t marker = 0;
+        roaring64_bitmap_t *totalorbitmap = roaring64_bitmap_create();
+        for (size_t i = 0; i < count; ++i) {
+            roaring64_bitmap_or_inplace(totalorbitmap, bitmaps64[i]);
+        }
+        marker = roaring64_bitmap_get_cardinality(totalorbitmap);
+        roaring64_bitmap_free(totalorbitmap);
+        return marker;
+    }
+};
+auto TotalUnion64Inplace = BasicBench<many_union64_inplace>;
+BENCHMARK(TotalUnion64Inplace);
+
 struct random_access {
     static uint64_t run() {
         uint64_t marker = 0;
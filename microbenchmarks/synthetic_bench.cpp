@@ -2,8 +2,10 @@
 #include <benchmark/benchmark.h>
 #include <random>
 #include <set>
+#include <vector>
 
 #include "performancecounters/event_counter.h"
+#include "roaring/bitset/bitset.h"
 #include "roaring/roaring64.h"
 #include "roaring/roaring64map.hh"
 
@@ -165,6 +167,59 @@ static void r64ContainsRandom(benchmark::State& state) {
 }
 BENCHMARK(r64ContainsRandom)->DenseRange(0, kBitmasks.size() - 1, 1);
 
+// Sparse 64-bit ids: every id lands in its own container, so lookups are
+// dominated by the descent through the ART rather than by container search.
+static std::vector<uint64_t> sparseIds(size_t count, uint64_t bitmask) {
+    std::vector<uint64_t> ids(count);
+    for (auto& id : ids) {
+        id = randUint64() & bitmask;
+    }
+    return ids;
+}
+
+static void r64ContainsSparseIds(benchmark::State& state) {
+    size_t count = state.range(0);
+    uint64_t bitmask = kBitmasks[state.range(1)];
+    std::vector<uint64_t> ids = sparseIds(count, bitmask);
+    roaring64_bitmap_t* r = roaring64_bitmap_create();
+    roaring64_bitmap_add_many(r, ids.size(), ids.data());
+    std::vector<uint64_t> probes = sparseIds(count, bitmask);
+    // Half of the probes hit, half are (most likely) misses.
+    for (size_t i = 0; i < count; i += 2) {
+        probes[i] = ids[i];
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(roaring64_bitmap_contains(r, probes[i]));
+        i = (i + 1) % count;
+    }
+    roaring64_bitmap_free(r);
+}
+BENCHMARK(r64ContainsSparseIds)
+    ->ArgsProduct({benchmark::CreateRange(1000, 1000000, /*multi=*/10),
+                   {7, 8, 9}});
+
+static void r64MoveEqualOrLargerSparseIds(benchmark::State& state) {
+    size_t count = state.range(0);
+    uint64_t bitmask = kBitmasks[state.range(1)];
+    std::vector<uint64_t> ids = sparseIds(count, bitmask);
+    roaring64_bitmap_t* r = roaring64_bitmap_create();
+    roaring64_bitmap_add_many(r, ids.size(), ids.data());
+    std::vector<uint64_t> probes = sparseIds(count, bitmask);
+    roaring64_iterator_t* it = roaring64_iterator_create(r);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            roaring64_iterator_move_equalorlarger(it, probes[i]));
+        i = (i + 1) % count;
+    }
+    roaring64_iterator_free(it);
+    roaring64_bitmap_free(r);
+}
+BENCHMARK(r64MoveEqualOrLargerSparseIds)
+    ->ArgsProduct({benchmark::CreateRange(1000, 1000000, /*multi=*/10),
+                   {7, 8, 9}});
+
 static void cppContainsRandom(benchmark::State& state) {
     uint64_t bitmask = kBitmasks[state.range(0)];
     Roaring64Map r;
@@ -517,6 +572,178 @@ static void cppFrozenDeserialize(benchmark::State& state) {
 }
 BENCHMARK(cppFrozenDeserialize)->ArgsProduct({kCountAndDensityRange});
 
+// Roaring64Map (std::map storage) against Roaring64FlatMap (sorted vector
+// storage). The ids spread over 'high_words' high 32-bit words (e.g. 256 words
+// for ids below 2^40), taking one word every 'stride'.
+template <typename Map>
+static Map highWordIds(size_t high_words, uint64_t stride = 1) {
+    Map r;
+    for (size_t i = 0; i < (1 << 18); ++i) {
+        uint64_t high = (randUint64() % high_words) * stride;
+        r.add((high << 32) | (randUint64() & 0xFFFFF));
+    }
+    return r;
+}
+
+template <typename Map>
+static void cppStorageContains(benchmark::State& state) {
+    size_t high_words = state.range(0);
+    Map r = highWordIds<Map>(high_words);
+    for (auto _ : state) {
+        uint64_t high = randUint64() % high_words;
+        benchmark::DoNotOptimize(
+            r.contains((high << 32) | (randUint64() & 0xFFFFF)));
+    }
+}
+BENCHMARK_TEMPLATE(cppStorageContains, Roaring64Map)
+    ->RangeMultiplier(16)
+    ->Range(16, 65536);
+BENCHMARK_TEMPLATE(cppStorageContains, Roaring64FlatMap)
+    ->RangeMultiplier(16)
+    ->Range(16, 65536);
+
+template <typename Map>
+static void cppStorageIterate(benchmark::State& state) {
+    Map r = highWordIds<Map>(state.range(0));
+    for (auto _ : state) {
+        uint64_t sum = 0;
+        for (uint64_t v : r) {
+            sum += v;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * r.cardinality());
+}
+BENCHMARK_TEMPLATE(cppStorageIterate, Roaring64Map)
+    ->RangeMultiplier(16)
+    ->Range(16, 65536);
+BENCHMARK_TEMPLATE(cppStorageIterate, Roaring64FlatMap)
+    ->RangeMultiplier(16)
+    ->Range(16, 65536);
+
+template <typename Map>
+static void cppStorageUnion(benchmark::State& state) {
+    // The two sides share one high word in six, so most outer keys of the
+    // result come from one side only and interleave with the other side's.
+    size_t high_words = state.range(0);
+    Map r1 = highWordIds<Map>(high_words, 2);
+    Map r2 = highWordIds<Map>(high_words, 3);
+    for (auto _ : state) {
+        Map r = r1 | r2;
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK_TEMPLATE(cppStorageUnion, Roaring64Map)
+    ->RangeMultiplier(16)
+    ->Range(16, 65536);
+BENCHMARK_TEMPLATE(cppStorageUnion, Roaring64FlatMap)
+    ->RangeMultiplier(16)
+    ->Range(16, 65536);
+
+template <typename Map>
+static void cppStorageIntersect(benchmark::State& state) {
+    size_t high_words = state.range(0);
+    Map r1 = highWordIds<Map>(high_words);
+    Map r2 = highWordIds<Map>(high_words / 2);
+    for (auto _ : state) {
+        Map r = r1 & r2;
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK_TEMPLATE(cppStorageIntersect, Roaring64Map)
+    ->RangeMultiplier(16)
+    ->Range(16, 65536);
+BENCHMARK_TEMPLATE(cppStorageIntersect, Roaring64FlatMap)
+    ->RangeMultiplier(16)
+    ->Range(16, 65536);
+
+// Dense bitset_t of `bits` bits, half of them set at random.
+static bitset_t* randomBitset(size_t bits) {
+    bitset_t* b = bitset_create_with_capacity(bits);
+    for (size_t k = 0; k < b->arraysize; ++k) {
+        b->array[k] = randUint64();
+    }
+    return b;
+}
+
+static void bitsetCount(benchmark::State& state) {
+    bitset_t* b = randomBitset(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bitset_count(b));
+    }
+    state.SetBytesProcessed(state.iterations() * bitset_size_in_bytes(b));
+    bitset_free(b);
+}
+BENCHMARK(bitsetCount)->RangeMultiplier(16)->Range(1 << 16, 1 << 28);
+
+static void bitsetInplaceUnion(benchmark::State& state) {
+    bitset_t* b1 = randomBitset(state.range(0));
+    bitset_t* b2 = randomBitset(state.range(0));
+    for (auto _ : state) {
+        bitset_inplace_union(b1, b2);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * 2 * bitset_size_in_bytes(b1));
+    bitset_free(b1);
+    bitset_free(b2);
+}
+BENCHMARK(bitsetInplaceUnion)->RangeMultiplier(16)->Range(1 << 16, 1 << 28);
+
+static void bitsetInplaceIntersection(benchmark::State& state) {
+    bitset_t* b1 = randomBitset(state.range(0));
+    bitset_t* b2 = randomBitset(state.range(0));
+    for (auto _ : state) {
+        bitset_inplace_intersection(b1, b2);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * 2 * bitset_size_in_bytes(b1));
+    bitset_free(b1);
+    bitset_free(b2);
+}
+BENCHMARK(bitsetInplaceIntersection)
+    ->RangeMultiplier(16)
+    ->Range(1 << 16, 1 << 28);
+
+static void bitsetIntersectionCount(benchmark::State& state) {
+    bitset_t* b1 = randomBitset(state.range(0));
+    bitset_t* b2 = randomBitset(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bitset_intersection_count(b1, b2));
+    }
+    state.SetBytesProcessed(state.iterations() * 2 * bitset_size_in_bytes(b1));
+    bitset_free(b1);
+    bitset_free(b2);
+}
+BENCHMARK(bitsetIntersectionCount)
+    ->RangeMultiplier(16)
+    ->Range(1 << 16, 1 << 28);
+
+static void bitsetUnionCount(benchmark::State& state) {
+    bitset_t* b1 = randomBitset(state.range(0));
+    bitset_t* b2 = randomBitset(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bitset_union_count(b1, b2));
+    }
+    state.SetBytesProcessed(state.iterations() * 2 * bitset_size_in_bytes(b1));
+    bitset_free(b1);
+    bitset_free(b2);
+}
+BENCHMARK(bitsetUnionCount)->RangeMultiplier(16)->Range(1 << 16, 1 << 28);
+
+static void bitsetShift(benchmark::State& state) {
+    bitset_t* b = randomBitset(state.range(0));
+    size_t words = b->arraysize;
+    for (auto _ : state) {
+        bitset_shift_left(b, 13);  // takes one more word
+        bitset_shift_right(b, 13);
+        bitset_resize(b, words, false);
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * 2 * bitset_size_in_bytes(b));
+    bitset_free(b);
+}
+BENCHMARK(bitsetShift)->RangeMultiplier(16)->Range(1 << 16, 1 << 28);
+
 }  // namespace roaring
 
 BENCHMARK_MAIN();
@@ -25,6 +25,13 @@
     (char *)(((uintptr_t)(buf) + ((alignment)-1)) & \
              (ptrdiff_t)(~((alignment)-1)))
 
+// Hints the processor to start loading the node at the given address.
+#if defined(__GNUC__) || defined(__clang__)
+#define CROARING_ART_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define CROARING_ART_PREFETCH(addr) ((void)(addr))
+#endif
+
 // Gives the byte difference needed to align the current buffer to the
 // alignment, relative to the start of the buffer.
 #define CROARING_ART_ALIGN_SIZE_RELATIVE(buf_cur, buf_start, alignment) \
@@ -469,25 +476,97 @@ static art_node16_t *art_node16_create(art_t *art,
     return node;
 }
 
-static inline art_ref_t art_node16_find_child(const art_node16_t *node,
-                                              art_key_chunk_t key) {
-    for (size_t i = 0; i < node->count; ++i) {
+// Returns the index of the key equal to `key` in the node, or node->count if
+// there is no such key. The keys array is always 16 bytes long, so it can be
+// loaded into a single vector register whatever the count; lanes beyond the
+// count are masked out.
+static inline uint8_t art_node16_find_index(const art_node16_t *node,
+                                            art_key_chunk_t key) {
+#if CROARING_IS_X64
+    __m128i keys = _mm_loadu_si128((const __m128i *)node->keys);
+    __m128i matches = _mm_cmpeq_epi8(keys, _mm_set1_epi8((char)key));
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(matches) &
+                    ((UINT32_C(1) << node->count) - 1);
+    if (mask == 0) {
+        return node->count;
+    }
+    return (uint8_t)roaring_trailing_zeroes(mask);
+#elif defined(CROARING_USENEON)
+    uint8x16_t matches = vceqq_u8(vld1q_u8(node->keys), vdupq_n_u8(key));
+    // Narrow each 8-bit lane to 4 bits, giving a 64-bit mask.
+    uint64_t mask = vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+    if (node->count < 16) {
+        mask &= (UINT64_C(1) << (4 * node->count)) - 1;
+    }
+    if (mask == 0) {
+        return node->count;
+    }
+    return (uint8_t)(roaring_trailing_zeroes(mask) >> 2);
+#else
+    uint8_t i = 0;
+    for (; i < node->count; ++i) {
         if (node->keys[i] == key) {
-            return node->children[i];
+            break;
         }
     }
+    return i;
+#endif
+}
+
+// Returns the index of the first key greater than or equal to `key` in the
+// node, or node->count if all keys are smaller.
+static inline uint8_t art_node16_lower_bound_index(const art_node16_t *node,
+                                                   art_key_chunk_t key) {
+#if CROARING_IS_X64
+    __m128i keys = _mm_loadu_si128((const __m128i *)node->keys);
+    // There is no unsigned byte comparison in SSE2, but keys[i] >= key exactly
+    // when max(keys[i], key) == keys[i].
+    __m128i ge = _mm_cmpeq_epi8(
+        _mm_max_epu8(keys, _mm_set1_epi8((char)key)), keys);
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(ge) &
+                    ((UINT32_C(1) << node->count) - 1);
+    if (mask == 0) {
+        return node->count;
+    }
+    return (uint8_t)roaring_trailing_zeroes(mask);
+#elif defined(CROARING_USENEON)
+    uint8x16_t ge = vcgeq_u8(vld1q_u8(node->keys), vdupq_n_u8(key));
+    uint64_t mask = vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(ge), 4)), 0);
+    if (node->count < 16) {
+        mask &= (UINT64_C(1) << (4 * node->count)) - 1;
+    }
+    if (mask == 0) {
+        return node->count;
+    }
+    return (uint8_t)(roaring_trailing_zeroes(mask) >> 2);
+#else
+    uint8_t i = 0;
+    for (; i < node->count; ++i) {
+        if (node->keys[i] >= key) {
+            break;
+        }
+    }
+    return i;
+#endif
+}
+
+static inline art_ref_t art_node16_find_child(const art_node16_t *node,
+                                              art_key_chunk_t key) {
+    uint8_t index = art_node16_find_index(node, key);
+    if (index < node->count) {
+        return node->children[index];
+    }
     return CROARING_ART_NULL_REF;
 }
 
 static art_ref_t art_node16_insert(art_t *art, art_node16_t *node,
                                    art_ref_t child, uint8_t key) {
     if (node->count < 16) {
-        size_t idx = 0;
-        for (; idx < node->count; ++idx) {
-            if (node->keys[idx] > key) {
-                break;
-            }
-        }
+        // The key is not present yet, so the first larger key is also the
+        // first key greater than or equal to it.
+        size_t idx = art_node16_lower_bound_index(node, key);
         size_t after = node->count - idx;
         // Shift other keys to maintain sorted order.
         memmove(node->keys + idx + 1, node->keys + idx,
@@ -511,17 +590,15 @@ static art_ref_t art_node16_insert(art_t *art, art_node16_t *node,
 
 static inline art_ref_t art_node16_erase(art_t *art, art_node16_t *node,
                                          uint8_t key_chunk) {
-    for (size_t i = 0; i < node->count; ++i) {
-        if (node->keys[i] == key_chunk) {
-            // Shift other keys to maintain sorted order.
-            size_t after_next = node->count - i - 1;
-            memmove(node->keys + i, node->keys + i + 1,
-                    after_next * sizeof(key_chunk));
-            memmove(node->children + i, node->children + i + 1,
-                    after_next * sizeof(art_ref_t));
-            node->count--;
-            break;
-        }
+    size_t index = art_node16_find_index(node, key_chunk);
+    if (index < node->count) {
+        // Shift other keys to maintain sorted order.
+        size_t after_next = node->count - index - 1;
+        memmove(node->keys + index, node->keys + index + 1,
+                after_next * sizeof(key_chunk));
+        memmove(node->children + index, node->children + index + 1,
+                after_next * sizeof(art_ref_t));
+        node->count--;
     }
     if (node->count > 4) {
         return art_get_ref(art, (art_node_t *)node, CROARING_ART_NODE16_TYPE);
@@ -540,11 +617,9 @@ static inline art_ref_t art_node16_erase(art_t *art, art_node16_t *node,
 static inline void art_node16_replace(art_node16_t *node,
                                       art_key_chunk_t key_chunk,
                                       art_ref_t new_child) {
-    for (uint8_t i = 0; i < node->count; ++i) {
-        if (node->keys[i] == key_chunk) {
-            node->children[i] = new_child;
-            return;
-        }
+    uint8_t index = art_node16_find_index(node, key_chunk);
+    if (index < node->count) {
+        node->children[index] = new_child;
     }
 }
 
@@ -595,13 +670,12 @@ static inline art_indexed_child_t art_node16_child_at(const art_node16_t *node,
 static inline art_indexed_child_t art_node16_lower_bound(
     art_node16_t *node, art_key_chunk_t key_chunk) {
     art_indexed_child_t indexed_child;
-    for (size_t i = 0; i < node->count; ++i) {
-        if (node->keys[i] >= key_chunk) {
-            indexed_child.index = i;
-            indexed_child.child = node->children[i];
-            indexed_child.key_chunk = node->keys[i];
-            return indexed_child;
-        }
+    uint8_t index = art_node16_lower_bound_index(node, key_chunk);
+    if (index < node->count) {
+        indexed_child.index = index;
+        indexed_child.child = node->children[index];
+        indexed_child.key_chunk = node->keys[index];
+        return indexed_child;
     }
     indexed_child.child = CROARING_ART_NULL_REF;
     return indexed_child;
@@ -1126,6 +1200,9 @@ static void art_node_free(art_t *art, art_node_t *node,
     uint64_t next_free = art->first_free[typecode];
     art_node_set_next_free(node, typecode, next_free);
     art->first_free[typecode] = index;
+    if (typecode == CROARING_ART_LEAF_TYPE) {
+        art->leaf_version++;
+    }
 }
 
 // Returns the next child in key order, or NULL if called on a leaf.
@@ -1271,6 +1348,30 @@ static uint8_t art_common_prefix(const art_key_chunk_t key1[],
     return offset;
 }
 
+/**
+ * Grows the array of nodes of the given typecode to `new_capacity`, adding the
+ * new nodes to the free list. Requires the free list to be empty. Invalidates
+ * pointers into the array obtained by `art_deref`.
+ */
+static void art_grow(art_t *art, art_typecode_t typecode,
+                     uint64_t new_capacity) {
+    uint64_t capacity = art->capacities[typecode];
+    assert(art->first_free[typecode] == capacity);
+    art->capacities[typecode] = new_capacity;
+    if (typecode == CROARING_ART_LEAF_TYPE) {
+        art->leaf_version++;
+    }
+    art->nodes[typecode] =
+        roaring_realloc_at(ROARING_ALLOCATION_ART, art->nodes[typecode],
+                           new_capacity * ART_NODE_SIZES[typecode]);
+    uint64_t increase = new_capacity - capacity;
+    memset(art_get_node(art, capacity, typecode), 0,
+           increase * ART_NODE_SIZES[typecode]);
+    for (uint64_t i = capacity; i < new_capacity; ++i) {
+        art_node_set_next_free(art_get_node(art, i, typecode), typecode, i + 1);
+    }
+}
+
 /**
  * Extends the array of nodes of the given typecode. Invalidates pointers into
  * the array obtained by `art_deref`.
@@ -1289,15 +1390,7 @@ static void art_extend(art_t *art, art_typecode_t typecode) {
     } else {
         new_capacity = 5 * capacity / 4;
     }
-    art->capacities[typecode] = new_capacity;
-    art->nodes[typecode] = roaring_realloc(
-        art->nodes[typecode], new_capacity * ART_NODE_SIZES[typecode]);
-    uint64_t increase = new_capacity - capacity;
-    memset(art_get_node(art, capacity, typecode), 0,
-           increase * ART_NODE_SIZES[typecode]);
-    for (uint64_t i = capacity; i < new_capacity; ++i) {
-        art_node_set_next_free(art_get_node(art, i, typecode), typecode, i + 1);
-    }
+    art_grow(art, typecode, new_capacity);
 }
 
 /**
@@ -1359,8 +1452,8 @@ static art_ref_t art_insert_at(art_t *art, art_ref_t ref,
         // prefix.
         // We create a copy of the node's prefix as the creation of a new
         // node may invalidate the prefix pointer.
-        art_key_chunk_t *prefix_copy = (art_key_chunk_t *)roaring_malloc(
-            common_prefix * sizeof(art_key_chunk_t));
+        art_key_chunk_t *prefix_copy = (art_key_chunk_t *)roaring_malloc_at(
+            ROARING_ALLOCATION_ART, common_prefix * sizeof(art_key_chunk_t));
         memcpy(prefix_copy, inner_node->prefix,
                common_prefix * sizeof(art_key_chunk_t));
         art_node4_t *node4 = art_node4_create(art, prefix_copy, common_prefix);
@@ -1492,17 +1585,20 @@ static art_val_t *art_find_at(const art_t *art, art_ref_t ref,
                               const art_key_chunk_t *key, uint8_t depth) {
     while (!art_is_leaf(ref)) {
         art_inner_node_t *inner_node = (art_inner_node_t *)art_deref(art, ref);
+        // The child lookup does not depend on the prefix, so look it up first
+        // and start loading the next level while the prefix is compared.
+        art_ref_t child = art_find_child(inner_node, art_ref_typecode(ref),
+                                         key[depth + inner_node->prefix_size]);
+        if (child == CROARING_ART_NULL_REF) {
+            return NULL;
+        }
+        CROARING_ART_PREFETCH(art_deref(art, child));
         uint8_t common_prefix =
             art_common_prefix(inner_node->prefix, 0, inner_node->prefix_size,
                               key, depth, ART_KEY_BYTES);
         if (common_prefix != inner_node->prefix_size) {
             return NULL;
         }
-        art_ref_t child = art_find_child(inner_node, art_ref_typecode(ref),
-                                         key[depth + inner_node->prefix_size]);
-        if (child == CROARING_ART_NULL_REF) {
-            return NULL;
-        }
         ref = child;
         // Include both the prefix and the child key chunk in the depth.
         depth += inner_node->prefix_size + 1;
@@ -1676,8 +1772,8 @@ static art_ref_t art_move_node_to_shrink(art_t *art, art_ref_t ref) {
 static void art_sort_free_lists(art_t *art) {
     for (art_typecode_t type = CROARING_ART_LEAF_TYPE;
          type <= CROARING_ART_NODE256_TYPE; ++type) {
-        bool *free_indices =
-            (bool *)roaring_calloc(art->capacities[type], sizeof(bool));
+        bool *free_indices = (bool *)roaring_calloc_at(
+            ROARING_ALLOCATION_ART, art->capacities[type], sizeof(bool));
 
         for (uint64_t i = art->first_free[type]; i < art->capacities[type];
              i = art_node_get_next_free(art, art_to_ref(i, type))) {
@@ -1708,8 +1804,9 @@ static size_t art_shrink_node_arrays(art_t *art) {
          ++t) {
         if (art->first_free[t] < art->capacities[t]) {
             uint64_t new_capacity = art->first_free[t];
-            art->nodes[t] = roaring_realloc(art->nodes[t],
-                                            new_capacity * ART_NODE_SIZES[t]);
+            art->nodes[t] =
+                roaring_realloc_at(ROARING_ALLOCATION_ART, art->nodes[t],
+                                   new_capacity * ART_NODE_SIZES[t]);
             freed += (art->capacities[t] - new_capacity) * ART_NODE_SIZES[t];
             art->capacities[t] = new_capacity;
         }
@@ -1777,12 +1874,14 @@ void art_init_cleared(art_t *art) {
          ++t) {
         art->nodes[t] = NULL;
     }
+    art->leaf_version = 0;
 }
 
 size_t art_shrink_to_fit(art_t *art) {
     if (art_is_shrunken(art)) {
         return 0;
     }
+    art->leaf_version++;
     if (art->root != CROARING_ART_NULL_REF) {
         art_sort_free_lists(art);
         art->root = art_move_node_to_shrink(art, art->root);
@@ -1811,6 +1910,80 @@ art_val_t *art_insert(art_t *art, const art_key_chunk_t *key, art_val_t val) {
     return &((art_leaf_t *)art_deref(art, leaf))->val;
 }
 
+// Builds the subtree holding `count` sorted, unique keys which share their
+// first `depth` bytes, and returns its root. Each inner node is created with
+// the type fitting its final number of children, so no node is ever grown.
+static art_ref_t art_bulk_load_at(art_t *art, const art_key_chunk_t *keys,
+                                  const art_val_t *vals, size_t count,
+                                  uint8_t depth) {
+    if (count == 1) {
+        return art_leaf_create(art, keys, vals[0]);
+    }
+    // The keys are sorted, so the prefix of the first and last keys is shared
+    // by all of them.
+    const art_key_chunk_t *last = keys + (count - 1) * ART_KEY_BYTES;
+    uint8_t prefix_size = art_common_prefix(keys, depth, ART_KEY_BYTES, last,
+                                            depth, ART_KEY_BYTES);
+    assert(depth + prefix_size < ART_KEY_BYTES);
+    uint8_t chunk_depth = depth + prefix_size;
+    size_t num_children = 1;
+    for (size_t i = 1; i < count; ++i) {
+        if (keys[i * ART_KEY_BYTES + chunk_depth] !=
+            keys[(i - 1) * ART_KEY_BYTES + chunk_depth]) {
+            num_children++;
+        }
+    }
+    art_typecode_t typecode;
+    art_node_t *node;
+    if (num_children <= 4) {
+        typecode = CROARING_ART_NODE4_TYPE;
+        node = (art_node_t *)art_node4_create(art, keys + depth, prefix_size);
+    } else if (num_children <= 16) {
+        typecode = CROARING_ART_NODE16_TYPE;
+        node = (art_node_t *)art_node16_create(art, keys + depth, prefix_size);
+    } else if (num_children <= 48) {
+        typecode = CROARING_ART_NODE48_TYPE;
+        node = (art_node_t *)art_node48_create(art, keys + depth, prefix_size);
+    } else {
+        typecode = CROARING_ART_NODE256_TYPE;
+        node =
+            (art_node_t *)art_node256_create(art, keys + depth, prefix_size);
+    }
+    art_ref_t ref = art_get_ref(art, node, typecode);
+    size_t start = 0;
+    while (start < count) {
+        art_key_chunk_t key_chunk = keys[start * ART_KEY_BYTES + chunk_depth];
+        size_t end = start + 1;
+        while (end < count &&
+               keys[end * ART_KEY_BYTES + chunk_depth] == key_chunk) {
+            end++;
+        }
+        art_ref_t child =
+            art_bulk_load_at(art, keys + start * ART_KEY_BYTES, vals + start,
+                             end - start, chunk_depth + 1);
+        // Creating the child may have moved the node.
+        node = art_deref(art, ref);
+        art_node_insert_leaf(art, (art_inner_node_t *)node, typecode, key_chunk,
+                             child);
+        start = end;
+    }
+    return ref;
+}
+
+void art_bulk_load(art_t *art, const art_key_chunk_t *keys,
+                   const art_val_t *vals, size_t count) {
+    assert(art->root == CROARING_ART_NULL_REF);
+    if (count == 0) {
+        return;
+    }
+    // Allocate all leaves at once when there are no free ones to reuse.
+    uint64_t leaf_capacity = art->capacities[CROARING_ART_LEAF_TYPE];
+    if (art->first_free[CROARING_ART_LEAF_TYPE] == leaf_capacity) {
+        art_grow(art, CROARING_ART_LEAF_TYPE, leaf_capacity + count);
+    }
+    art->root = art_bulk_load_at(art, keys, vals, count, 0);
+}
+
 bool art_erase(art_t *art, const art_key_chunk_t *key, art_val_t *erased_val) {
     art_val_t erased_val_local;
     if (erased_val == NULL) {
@@ -2022,6 +2195,7 @@ static bool art_node_iterator_lower_bound(art_ref_t ref,
             return art_node_init_iterator(indexed_child.child, iterator, true);
         }
         // We found a child with an equal prefix.
+        CROARING_ART_PREFETCH(art_deref(iterator->art, indexed_child.child));
         art_iterator_down(iterator, ref, indexed_child.index);
         ref = indexed_child.child;
     }
@@ -2311,6 +2485,12 @@ size_t art_size_in_bytes(const art_t *art) {
 }
 
 size_t art_serialize(const art_t *art, char *buf) {
+    return art_serialize_mapped(art, buf, NULL, NULL);
+}
+
+size_t art_serialize_mapped(const art_t *art, char *buf,
+                            art_val_t (*map)(art_val_t val, void *context),
+                            void *context) {
     if (buf == NULL) {
         return 0;
     }
@@ -2335,7 +2515,15 @@ size_t art_serialize(const art_t *art, char *buf) {
 
     for (art_typecode_t t = CROARING_ART_MIN_TYPE; t <= CROARING_ART_MAX_TYPE;
          ++t) {
-        if (art->capacities[t] > 0) {
+        if (map != NULL && t == CROARING_ART_LEAF_TYPE) {
+            const art_leaf_t *leaves = (const art_leaf_t *)art->nodes[t];
+            for (uint64_t i = 0; i < art->capacities[t]; ++i) {
+                art_leaf_t leaf = leaves[i];
+                leaf.val = map(leaf.val, context);
+                memcpy(buf, &leaf, sizeof(leaf));
+                buf += sizeof(leaf);
+            }
+        } else if (art->capacities[t] > 0) {
             size_t size = art->capacities[t] * ART_NODE_SIZES[t];
             memcpy(buf, art->nodes[t], size);
             buf += size;
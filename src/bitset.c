@@ -5,8 +5,11 @@
 #include <string.h>
 
 #include <roaring/bitset/bitset.h>
+#include <roaring/bitset_util.h>
+#include <roaring/isadetection.h>
 #include <roaring/memory.h>
 #include <roaring/portability.h>
+#include <roaring/roaring_array.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -86,25 +89,265 @@ void bitset_fill(bitset_t *bitset) {
     memset(bitset->array, 0xff, sizeof(uint64_t) * bitset->arraysize);
 }
 
+/*
+ * Word kernels shared by the operations below, with AVX2 and AVX-512
+ * versions selected at runtime like those of the bitset containers. They
+ * work on any number of words, finishing with scalar code.
+ */
+static size_t _scalar_bitset_words_count(const uint64_t *words, size_t n) {
+    size_t card = 0;
+    size_t k = 0;
+    for (; k + 7 < n; k += 8) {
+        card += roaring_hamming(words[k]);
+        card += roaring_hamming(words[k + 1]);
+        card += roaring_hamming(words[k + 2]);
+        card += roaring_hamming(words[k + 3]);
+        card += roaring_hamming(words[k + 4]);
+        card += roaring_hamming(words[k + 5]);
+        card += roaring_hamming(words[k + 6]);
+        card += roaring_hamming(words[k + 7]);
+    }
+    for (; k < n; k++) {
+        card += roaring_hamming(words[k]);
+    }
+    return card;
+}
+
+/* out[j] = in[j] << s | in[j - 1] >> (64 - s) for j from n - 1 down to 0,
+ * with 0 < s < 64, reading in[-1] too: out may overlap in, at higher
+ * addresses. */
+static void _scalar_bitset_words_shift_up(uint64_t *out, const uint64_t *in,
+                                          size_t n, int s) {
+    for (size_t j = n; j > 0; j--) {
+        out[j - 1] = (in[j - 1] << s) | (in[j - 2] >> (64 - s));
+    }
+}
+
+/* out[j] = in[j] >> s | in[j + 1] << (64 - s) for j from 0 to n - 1, with
+ * 0 < s < 64, reading in[n] too: out may overlap in, at lower addresses. */
+static void _scalar_bitset_words_shift_down(uint64_t *out, const uint64_t *in,
+                                            size_t n, int s) {
+    for (size_t j = 0; j < n; j++) {
+        out[j] = (in[j] >> s) | (in[j + 1] << (64 - s));
+    }
+}
+
+#define CROARING_SCALAR_BITSET_WORDS_FN(opname, opsymbol)                     \
+    static size_t _scalar_bitset_words_##opname##_count(                      \
+        const uint64_t *w1, const uint64_t *w2, size_t n) {                   \
+        size_t card = 0;                                                      \
+        size_t k = 0;                                                         \
+        for (; k + 3 < n; k += 4) {                                           \
+            card += roaring_hamming(w1[k] opsymbol w2[k]);                    \
+            card += roaring_hamming(w1[k + 1] opsymbol w2[k + 1]);            \
+            card += roaring_hamming(w1[k + 2] opsymbol w2[k + 2]);            \
+            card += roaring_hamming(w1[k + 3] opsymbol w2[k + 3]);            \
+        }                                                                     \
+        for (; k < n; k++) {                                                  \
+            card += roaring_hamming(w1[k] opsymbol w2[k]);                    \
+        }                                                                     \
+        return card;                                                          \
+    }                                                                         \
+    static void _scalar_bitset_words_inplace_##opname(                        \
+        uint64_t *w1, const uint64_t *w2, size_t n) {                         \
+        for (size_t k = 0; k < n; k++) {                                      \
+            w1[k] = w1[k] opsymbol w2[k];                                     \
+        }                                                                     \
+    }
+
+CROARING_SCALAR_BITSET_WORDS_FN(or, |)
+CROARING_SCALAR_BITSET_WORDS_FN(and, &)
+CROARING_SCALAR_BITSET_WORDS_FN(xor, ^)
+CROARING_SCALAR_BITSET_WORDS_FN(andnot, &~)
+
+#if CROARING_IS_X64
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+CROARING_TARGET_AVX2
+static size_t _avx2_bitset_words_count(const uint64_t *words, size_t n) {
+    size_t vectors = n / 4;
+    size_t card = (size_t)avx2_harley_seal_popcount256(
+        (const __m256i *)words, vectors);
+    return card + _scalar_bitset_words_count(words + 4 * vectors, n % 4);
+}
+
+static void _avx2_bitset_words_shift_up(uint64_t *out, const uint64_t *in,
+                                        size_t n, int s) {
+    const __m128i left = _mm_cvtsi32_si128(s);
+    const __m128i right = _mm_cvtsi32_si128(64 - s);
+    size_t j = n;
+    for (; j >= 4; j -= 4) {
+        __m256i hi = _mm256_loadu_si256((const __m256i *)(in + j - 4));
+        __m256i lo = _mm256_loadu_si256((const __m256i *)(in + j - 5));
+        _mm256_storeu_si256(
+            (__m256i *)(out + j - 4),
+            _mm256_or_si256(_mm256_sll_epi64(hi, left),
+                            _mm256_srl_epi64(lo, right)));
+    }
+    _scalar_bitset_words_shift_up(out, in, j, s);
+}
+
+static void _avx2_bitset_words_shift_down(uint64_t *out, const uint64_t *in,
+                                          size_t n, int s) {
+    const __m128i right = _mm_cvtsi32_si128(s);
+    const __m128i left = _mm_cvtsi32_si128(64 - s);
+    size_t j = 0;
+    for (; j + 4 <= n; j += 4) {
+        __m256i lo = _mm256_loadu_si256((const __m256i *)(in + j));
+        __m256i hi = _mm256_loadu_si256((const __m256i *)(in + j + 1));
+        _mm256_storeu_si256(
+            (__m256i *)(out + j),
+            _mm256_or_si256(_mm256_srl_epi64(lo, right),
+                            _mm256_sll_epi64(hi, left)));
+    }
+    _scalar_bitset_words_shift_down(out + j, in + j, n - j, s);
+}
+CROARING_UNTARGET_AVX2
+
+// The Harley-Seal functions compute avx_intrinsic(data1, data2), hence the
+// swapped operands for andnot.
+#define CROARING_AVX2_BITSET_WORDS_FN(opname, opsymbol, avx_intrinsic)       \
+    static size_t _avx2_bitset_words_##opname##_count(                        \
+        const uint64_t *w1, const uint64_t *w2, size_t n) {                   \
+        size_t vectors = n / 4;                                               \
+        size_t card = (size_t)avx2_harley_seal_popcount256_##opname(          \
+            (const __m256i *)w2, (const __m256i *)w1, vectors);               \
+        return card + _scalar_bitset_words_##opname##_count(                  \
+                          w1 + 4 * vectors, w2 + 4 * vectors, n % 4);         \
+    }                                                                         \
+    static void _avx2_bitset_words_inplace_##opname(                          \
+        uint64_t *w1, const uint64_t *w2, size_t n) {                         \
+        size_t k = 0;                                                         \
+        for (; k + 4 <= n; k += 4) {                                          \
+            __m256i a = _mm256_loadu_si256((const __m256i *)(w1 + k));        \
+            __m256i b = _mm256_loadu_si256((const __m256i *)(w2 + k));        \
+            _mm256_storeu_si256((__m256i *)(w1 + k), avx_intrinsic(b, a));    \
+        }                                                                     \
+        _scalar_bitset_words_inplace_##opname(w1 + k, w2 + k, n - k);         \
+    }
+
+CROARING_TARGET_AVX2
+CROARING_AVX2_BITSET_WORDS_FN(or, |, _mm256_or_si256)
+CROARING_AVX2_BITSET_WORDS_FN(and, &, _mm256_and_si256)
+CROARING_AVX2_BITSET_WORDS_FN(xor, ^, _mm256_xor_si256)
+CROARING_AVX2_BITSET_WORDS_FN(andnot, &~, _mm256_andnot_si256)
+CROARING_UNTARGET_AVX2
+
+#if CROARING_COMPILER_SUPPORTS_AVX512
+CROARING_TARGET_AVX512
+static size_t _avx512_bitset_words_count(const uint64_t *words, size_t n) {
+    size_t vectors = n / 8;
+    size_t card = (size_t)avx512_vpopcount((const __m512i *)words, vectors);
+    return card + _scalar_bitset_words_count(words + 8 * vectors, n % 8);
+}
+
+static void _avx512_bitset_words_shift_up(uint64_t *out, const uint64_t *in,
+                                          size_t n, int s) {
+    const __m128i left = _mm_cvtsi32_si128(s);
+    const __m128i right = _mm_cvtsi32_si128(64 - s);
+    size_t j = n;
+    for (; j >= 8; j -= 8) {
+        __m512i hi = _mm512_loadu_si512((const __m512i *)(in + j - 8));
+        __m512i lo = _mm512_loadu_si512((const __m512i *)(in + j - 9));
+        _mm512_storeu_si512(
+            (__m512i *)(out + j - 8),
+            _mm512_or_si512(_mm512_sll_epi64(hi, left),
+                            _mm512_srl_epi64(lo, right)));
+    }
+    _scalar_bitset_words_shift_up(out, in, j, s);
+}
+
+static void _avx512_bitset_words_shift_down(uint64_t *out, const uint64_t *in,
+                                            size_t n, int s) {
+    const __m128i right = _mm_cvtsi32_si128(s);
+    const __m128i left = _mm_cvtsi32_si128(64 - s);
+    size_t j = 0;
+    for (; j + 8 <= n; j += 8) {
+        __m512i lo = _mm512_loadu_si512((const __m512i *)(in + j));
+        __m512i hi = _mm512_loadu_si512((const __m512i *)(in + j + 1));
+        _mm512_storeu_si512(
+            (__m512i *)(out + j),
+            _mm512_or_si512(_mm512_srl_epi64(lo, right),
+                            _mm512_sll_epi64(hi, left)));
+    }
+    _scalar_bitset_words_shift_down(out + j, in + j, n - j, s);
+}
+CROARING_UNTARGET_AVX512
+
+#define CROARING_AVX512_BITSET_WORDS_FN(opname, opsymbol, avx_intrinsic)     \
+    static size_t _avx512_bitset_words_##opname##_count(                      \
+        const uint64_t *w1, const uint64_t *w2, size_t n) {                   \
+        size_t vectors = n / 8;                                               \
+        size_t card = (size_t)avx512_harley_seal_popcount512_##opname(        \
+            (const __m512i *)w2, (const __m512i *)w1, vectors);               \
+        return card + _scalar_bitset_words_##opname##_count(                  \
+                          w1 + 8 * vectors, w2 + 8 * vectors, n % 8);         \
+    }                                                                         \
+    static void _avx512_bitset_words_inplace_##opname(                        \
+        uint64_t *w1, const uint64_t *w2, size_t n) {                         \
+        size_t k = 0;                                                         \
+        for (; k + 8 <= n; k += 8) {                                          \
+            __m512i a = _mm512_loadu_si512((const __m512i *)(w1 + k));        \
+            __m512i b = _mm512_loadu_si512((const __m512i *)(w2 + k));        \
+            _mm512_storeu_si512((__m512i *)(w1 + k), avx_intrinsic(b, a));    \
+        }                                                                     \
+        _scalar_bitset_words_inplace_##opname(w1 + k, w2 + k, n - k);         \
+    }
+
+CROARING_TARGET_AVX512
+CROARING_AVX512_BITSET_WORDS_FN(or, |, _mm512_or_si512)
+CROARING_AVX512_BITSET_WORDS_FN(and, &, _mm512_and_si512)
+CROARING_AVX512_BITSET_WORDS_FN(xor, ^, _mm512_xor_si512)
+CROARING_AVX512_BITSET_WORDS_FN(andnot, &~, _mm512_andnot_si512)
+CROARING_UNTARGET_AVX512
+
+// picks the AVX-512, AVX2 or scalar version of the kernel
+#define CROARING_BITSET_WORDS_KERNEL(name)                           \
+    ((croaring_hardware_support() & ROARING_SUPPORTS_AVX512)         \
+         ? _avx512_bitset_words_##name                               \
+         : (croaring_hardware_support() & ROARING_SUPPORTS_AVX2)     \
+               ? _avx2_bitset_words_##name                           \
+               : _scalar_bitset_words_##name)
+
+#else  // CROARING_COMPILER_SUPPORTS_AVX512
+
+#define CROARING_BITSET_WORDS_KERNEL(name)                     \
+    ((croaring_hardware_support() & ROARING_SUPPORTS_AVX2)     \
+         ? _avx2_bitset_words_##name                           \
+         : _scalar_bitset_words_##name)
+
+#endif  // CROARING_COMPILER_SUPPORTS_AVX512
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#else  // CROARING_IS_X64
+
+#define CROARING_BITSET_WORDS_KERNEL(name) _scalar_bitset_words_##name
+
+#endif  // CROARING_IS_X64
+
 void bitset_shift_left(bitset_t *bitset, size_t s) {
     size_t extra_words = s / 64;
     int inword_shift = s % 64;
     size_t as = bitset->arraysize;
     if (inword_shift == 0) {
         bitset_resize(bitset, as + extra_words, false);
-        // could be done with a memmove
-        for (size_t i = as + extra_words; i > extra_words; i--) {
-            bitset->array[i - 1] = bitset->array[i - 1 - extra_words];
+        if (as > 0) {
+            memmove(bitset->array + extra_words, bitset->array,
+                    sizeof(uint64_t) * as);
         }
     } else {
         bitset_resize(bitset, as + extra_words + 1, true);
         bitset->array[as + extra_words] =
             bitset->array[as - 1] >> (64 - inword_shift);
-        for (size_t i = as + extra_words; i >= extra_words + 2; i--) {
-            bitset->array[i - 1] =
-                (bitset->array[i - 1 - extra_words] << inword_shift) |
-                (bitset->array[i - 2 - extra_words] >> (64 - inword_shift));
-        }
+        CROARING_BITSET_WORDS_KERNEL(shift_up)
+        (bitset->array + extra_words + 1, bitset->array + 1, as - 1,
+         inword_shift);
         bitset->array[extra_words] = bitset->array[0] << inword_shift;
     }
     for (size_t i = 0; i < extra_words; i++) {
@@ -117,18 +360,16 @@ void bitset_shift_right(bitset_t *bitset, size_t s) {
     int inword_shift = s % 64;
     size_t as = bitset->arraysize;
     if (inword_shift == 0) {
-        // could be done with a memmove
-        for (size_t i = 0; i < as - extra_words; i++) {
-            bitset->array[i] = bitset->array[i + extra_words];
+        if (as > extra_words) {
+            memmove(bitset->array, bitset->array + extra_words,
+                    sizeof(uint64_t) * (as - extra_words));
         }
         bitset_resize(bitset, as - extra_words, false);
 
     } else {
-        for (size_t i = 0; i + extra_words + 1 < as; i++) {
-            bitset->array[i] =
-                (bitset->array[i + extra_words] >> inword_shift) |
-                (bitset->array[i + extra_words + 1] << (64 - inword_shift));
-        }
+        CROARING_BITSET_WORDS_KERNEL(shift_down)
+        (bitset->array, bitset->array + extra_words, as - extra_words - 1,
+         inword_shift);
         bitset->array[as - extra_words - 1] =
             (bitset->array[as - 1] >> inword_shift);
         bitset_resize(bitset, as - extra_words, false);
@@ -175,38 +416,192 @@ bool bitset_resize(bitset_t *bitset, size_t newarraysize, bool padwithzeroes) {
     return true;  // success!
 }
 
-size_t bitset_count(const bitset_t *bitset) {
-    size_t card = 0;
-    size_t k = 0;
-    for (; k + 7 < bitset->arraysize; k += 8) {
-        card += roaring_hamming(bitset->array[k]);
-        card += roaring_hamming(bitset->array[k + 1]);
-        card += roaring_hamming(bitset->array[k + 2]);
-        card += roaring_hamming(bitset->array[k + 3]);
-        card += roaring_hamming(bitset->array[k + 4]);
-        card += roaring_hamming(bitset->array[k + 5]);
-        card += roaring_hamming(bitset->array[k + 6]);
-        card += roaring_hamming(bitset->array[k + 7]);
-    }
-    for (; k + 3 < bitset->arraysize; k += 4) {
-        card += roaring_hamming(bitset->array[k]);
-        card += roaring_hamming(bitset->array[k + 1]);
-        card += roaring_hamming(bitset->array[k + 2]);
-        card += roaring_hamming(bitset->array[k + 3]);
-    }
-    for (; k < bitset->arraysize; k++) {
-        card += roaring_hamming(bitset->array[k]);
+/* Grows the bitset, at most once, so that it holds all of the indexes. */
+static bool bitset_grow_for_indexes(bitset_t *bitset, size_t n_args,
+                                    const size_t *indexes) {
+    if (n_args == 0) return true;
+    size_t largest = 0;
+    for (size_t k = 0; k < n_args; k++) {
+        if (indexes[k] > largest) largest = indexes[k];
     }
-    return card;
+    size_t words = largest / 64 + 1;
+    return words <= bitset->arraysize || bitset_grow(bitset, words);
+}
+
+bool bitset_set_many(bitset_t *bitset, size_t n_args, const size_t *indexes) {
+    if (!bitset_grow_for_indexes(bitset, n_args, indexes)) return false;
+    uint64_t *words = bitset->array;
+    for (size_t k = 0; k < n_args; k++) {
+        size_t i = indexes[k];
+        words[i / 64] |= ((uint64_t)1) << (i % 64);
+    }
+    return true;
+}
+
+void bitset_clear_many(bitset_t *bitset, size_t n_args, const size_t *indexes) {
+    uint64_t *words = bitset->array;
+    size_t arraysize = bitset->arraysize;
+    for (size_t k = 0; k < n_args; k++) {
+        size_t i = indexes[k];
+        if (i / 64 < arraysize) words[i / 64] &= ~(((uint64_t)1) << (i % 64));
+    }
+}
+
+bool bitset_flip_many(bitset_t *bitset, size_t n_args, const size_t *indexes) {
+    if (!bitset_grow_for_indexes(bitset, n_args, indexes)) return false;
+    uint64_t *words = bitset->array;
+    for (size_t k = 0; k < n_args; k++) {
+        size_t i = indexes[k];
+        words[i / 64] ^= ((uint64_t)1) << (i % 64);
+    }
+    return true;
+}
+
+size_t bitset_test_many(const bitset_t *bitset, size_t n_args,
+                        const size_t *indexes, bool *results) {
+    const uint64_t *words = bitset->array;
+    size_t arraysize = bitset->arraysize;
+    size_t answer = 0;
+    for (size_t k = 0; k < n_args; k++) {
+        size_t i = indexes[k];
+        bool set = i / 64 < arraysize && ((words[i / 64] >> (i % 64)) & 1);
+        answer += set;
+        if (results != NULL) results[k] = set;
+    }
+    return answer;
+}
+
+typedef size_t (*bitset_words_count_fn)(const uint64_t *words, size_t n);
+typedef size_t (*bitset_words_count2_fn)(const uint64_t *w1,
+                                         const uint64_t *w2, size_t n);
+typedef void (*bitset_words_inplace_fn)(uint64_t *w1, const uint64_t *w2,
+                                        size_t n);
+
+/* Fewer words than this (256 KiB) per task are not worth handing to an
+ * executor. */
+enum { BITSET_MIN_WORDS_PER_TASK = 1 << 15 };
+
+/* The words of one or two bitsets split in chunks whose bounds fall on cache
+ * lines of w1, so that tasks writing neighbouring chunks never share one. */
+typedef struct bitset_chunks_s {
+    bitset_words_count_fn count;
+    bitset_words_count2_fn count2;
+    bitset_words_inplace_fn inplace;
+    uint64_t *out;  // w1, for the in-place kernels
+    const uint64_t *w1;
+    const uint64_t *w2;
+    size_t n;
+    size_t chunk_size;  // a multiple of the words in a cache line
+    size_t skew;        // words of w1 before its first cache line
+    size_t results[ROARING_MAX_TASKS];
+} bitset_chunks_t;
+
+/* Returns the number of tasks. */
+static size_t bitset_chunks_init(bitset_chunks_t *chunks, const uint64_t *w1,
+                                 const uint64_t *w2, size_t n) {
+    chunks->w1 = w1;
+    chunks->w2 = w2;
+    chunks->n = n;
+    chunks->skew = (8 - ((uintptr_t)w1 / sizeof(uint64_t)) % 8) % 8;
+    size_t chunk_size = roaring_task_chunk_size(n, BITSET_MIN_WORDS_PER_TASK);
+    chunks->chunk_size = (chunk_size + 7) / 8 * 8;
+    if (n <= chunks->skew + chunks->chunk_size) return 1;
+    return (n - chunks->skew + chunks->chunk_size - 1) / chunks->chunk_size;
+}
+
+/* The first chunk also takes the words before the first cache line. */
+static void bitset_chunk_bounds(const bitset_chunks_t *chunks, size_t task,
+                                size_t *begin, size_t *end) {
+    *begin = task == 0 ? 0 : chunks->skew + task * chunks->chunk_size;
+    *end = chunks->skew + (task + 1) * chunks->chunk_size;
+    if (*end > chunks->n) *end = chunks->n;
+}
+
+static void bitset_count_task(void *arg, size_t task) {
+    bitset_chunks_t *chunks = (bitset_chunks_t *)arg;
+    size_t begin, end;
+    bitset_chunk_bounds(chunks, task, &begin, &end);
+    chunks->results[task] = chunks->count(chunks->w1 + begin, end - begin);
+}
+
+static void bitset_count2_task(void *arg, size_t task) {
+    bitset_chunks_t *chunks = (bitset_chunks_t *)arg;
+    size_t begin, end;
+    bitset_chunk_bounds(chunks, task, &begin, &end);
+    chunks->results[task] = chunks->count2(chunks->w1 + begin,
+                                           chunks->w2 + begin, end - begin);
+}
+
+static void bitset_inplace_task(void *arg, size_t task) {
+    bitset_chunks_t *chunks = (bitset_chunks_t *)arg;
+    size_t begin, end;
+    bitset_chunk_bounds(chunks, task, &begin, &end);
+    chunks->inplace(chunks->out + begin, chunks->w2 + begin, end - begin);
+}
+
+static size_t bitset_words_count(bitset_words_count_fn kernel,
+                                 const uint64_t *words, size_t n,
+                                 const roaring_executor_t *executor) {
+    if (executor == NULL) return kernel(words, n);
+    bitset_chunks_t chunks;
+    chunks.count = kernel;
+    size_t num_tasks = bitset_chunks_init(&chunks, words, NULL, n);
+    roaring_execute_tasks(executor, num_tasks, bitset_count_task, &chunks);
+    size_t answer = 0;
+    for (size_t t = 0; t < num_tasks; t++) answer += chunks.results[t];
+    return answer;
+}
+
+static size_t bitset_words_count2(bitset_words_count2_fn kernel,
+                                  const uint64_t *w1, const uint64_t *w2,
+                                  size_t n,
+                                  const roaring_executor_t *executor) {
+    if (executor == NULL) return kernel(w1, w2, n);
+    bitset_chunks_t chunks;
+    chunks.count2 = kernel;
+    size_t num_tasks = bitset_chunks_init(&chunks, w1, w2, n);
+    roaring_execute_tasks(executor, num_tasks, bitset_count2_task, &chunks);
+    size_t answer = 0;
+    for (size_t t = 0; t < num_tasks; t++) answer += chunks.results[t];
+    return answer;
+}
+
+static void bitset_words_inplace(bitset_words_inplace_fn kernel, uint64_t *w1,
+                                 const uint64_t *w2, size_t n,
+                                 const roaring_executor_t *executor) {
+    if (executor == NULL) {
+        kernel(w1, w2, n);
+        return;
+    }
+    bitset_chunks_t chunks;
+    chunks.inplace = kernel;
+    chunks.out = w1;
+    size_t num_tasks = bitset_chunks_init(&chunks, w1, w2, n);
+    roaring_execute_tasks(executor, num_tasks, bitset_inplace_task, &chunks);
+}
+
+size_t bitset_count(const bitset_t *bitset) {
+    return bitset_count_parallel(bitset, NULL);
+}
+
+size_t bitset_count_parallel(const bitset_t *bitset,
+                             const roaring_executor_t *executor) {
+    return bitset_words_count(CROARING_BITSET_WORDS_KERNEL(count),
+                              bitset->array, bitset->arraysize, executor);
 }
 
 bool bitset_inplace_union(bitset_t *CROARING_CBITSET_RESTRICT b1,
                           const bitset_t *CROARING_CBITSET_RESTRICT b2) {
+    return bitset_inplace_union_parallel(b1, b2, NULL);
+}
+
+bool bitset_inplace_union_parallel(bitset_t *CROARING_CBITSET_RESTRICT b1,
+                                   const bitset_t *CROARING_CBITSET_RESTRICT b2,
+                                   const roaring_executor_t *executor) {
     size_t minlength =
         b1->arraysize < b2->arraysize ? b1->arraysize : b2->arraysize;
-    for (size_t k = 0; k < minlength; ++k) {
-        b1->array[k] |= b2->array[k];
-    }
+    bitset_words_inplace(CROARING_BITSET_WORDS_KERNEL(inplace_or), b1->array,
+                         b2->array, minlength, executor);
     if (b2->arraysize > b1->arraysize) {
         size_t oldsize = b1->arraysize;
         if (!bitset_resize(b1, b2->arraysize, false)) return false;
@@ -336,103 +731,107 @@ bool bitset_contains_all(const bitset_t *CROARING_CBITSET_RESTRICT b1,
 
 size_t bitset_union_count(const bitset_t *CROARING_CBITSET_RESTRICT b1,
                           const bitset_t *CROARING_CBITSET_RESTRICT b2) {
-    size_t answer = 0;
+    return bitset_union_count_parallel(b1, b2, NULL);
+}
+
+size_t bitset_union_count_parallel(
+    const bitset_t *CROARING_CBITSET_RESTRICT b1,
+    const bitset_t *CROARING_CBITSET_RESTRICT b2,
+    const roaring_executor_t *executor) {
     size_t minlength =
         b1->arraysize < b2->arraysize ? b1->arraysize : b2->arraysize;
-    size_t k = 0;
-    for (; k + 3 < minlength; k += 4) {
-        answer += roaring_hamming(b1->array[k] | b2->array[k]);
-        answer += roaring_hamming(b1->array[k + 1] | b2->array[k + 1]);
-        answer += roaring_hamming(b1->array[k + 2] | b2->array[k + 2]);
-        answer += roaring_hamming(b1->array[k + 3] | b2->array[k + 3]);
-    }
-    for (; k < minlength; ++k) {
-        answer += roaring_hamming(b1->array[k] | b2->array[k]);
-    }
-    if (b2->arraysize > b1->arraysize) {
-        // k is equal to b1->arraysize
-        for (; k + 3 < b2->arraysize; k += 4) {
-            answer += roaring_hamming(b2->array[k]);
-            answer += roaring_hamming(b2->array[k + 1]);
-            answer += roaring_hamming(b2->array[k + 2]);
-            answer += roaring_hamming(b2->array[k + 3]);
-        }
-        for (; k < b2->arraysize; ++k) {
-            answer += roaring_hamming(b2->array[k]);
-        }
-    } else {
-        // k is equal to b2->arraysize
-        for (; k + 3 < b1->arraysize; k += 4) {
-            answer += roaring_hamming(b1->array[k]);
-            answer += roaring_hamming(b1->array[k + 1]);
-            answer += roaring_hamming(b1->array[k + 2]);
-            answer += roaring_hamming(b1->array[k + 3]);
-        }
-        for (; k < b1->arraysize; ++k) {
-            answer += roaring_hamming(b1->array[k]);
-        }
-    }
-    return answer;
+    size_t answer =
+        bitset_words_count2(CROARING_BITSET_WORDS_KERNEL(or_count), b1->array,
+                            b2->array, minlength, executor);
+    const bitset_t *longest = b2->arraysize > b1->arraysize ? b2 : b1;
+    return answer + bitset_words_count(CROARING_BITSET_WORDS_KERNEL(count),
+                                       longest->array + minlength,
+                                       longest->arraysize - minlength,
+                                       executor);
 }
 
 void bitset_inplace_intersection(bitset_t *CROARING_CBITSET_RESTRICT b1,
                                  const bitset_t *CROARING_CBITSET_RESTRICT b2) {
+    bitset_inplace_intersection_parallel(b1, b2, NULL);
+}
+
+void bitset_inplace_intersection_parallel(
+    bitset_t *CROARING_CBITSET_RESTRICT b1,
+    const bitset_t *CROARING_CBITSET_RESTRICT b2,
+    const roaring_executor_t *executor) {
     size_t minlength =
         b1->arraysize < b2->arraysize ? b1->arraysize : b2->arraysize;
-    size_t k = 0;
-    for (; k < minlength; ++k) {
-        b1->array[k] &= b2->array[k];
-    }
-    for (; k < b1->arraysize; ++k) {
-        b1->array[k] = 0;  // memset could, maybe, be a tiny bit faster
+    bitset_words_inplace(CROARING_BITSET_WORDS_KERNEL(inplace_and), b1->array,
+                         b2->array, minlength, executor);
+    if (b1->arraysize > minlength) {
+        memset(b1->array + minlength, 0,
+               sizeof(uint64_t) * (b1->arraysize - minlength));
     }
 }
 
 size_t bitset_intersection_count(const bitset_t *CROARING_CBITSET_RESTRICT b1,
                                  const bitset_t *CROARING_CBITSET_RESTRICT b2) {
-    size_t answer = 0;
+    return bitset_intersection_count_parallel(b1, b2, NULL);
+}
+
+size_t bitset_intersection_count_parallel(
+    const bitset_t *CROARING_CBITSET_RESTRICT b1,
+    const bitset_t *CROARING_CBITSET_RESTRICT b2,
+    const roaring_executor_t *executor) {
     size_t minlength =
         b1->arraysize < b2->arraysize ? b1->arraysize : b2->arraysize;
-    for (size_t k = 0; k < minlength; ++k) {
-        answer += roaring_hamming(b1->array[k] & b2->array[k]);
-    }
-    return answer;
+    return bitset_words_count2(CROARING_BITSET_WORDS_KERNEL(and_count),
+                               b1->array, b2->array, minlength, executor);
 }
 
 void bitset_inplace_difference(bitset_t *CROARING_CBITSET_RESTRICT b1,
                                const bitset_t *CROARING_CBITSET_RESTRICT b2) {
+    bitset_inplace_difference_parallel(b1, b2, NULL);
+}
+
+void bitset_inplace_difference_parallel(
+    bitset_t *CROARING_CBITSET_RESTRICT b1,
+    const bitset_t *CROARING_CBITSET_RESTRICT b2,
+    const roaring_executor_t *executor) {
     size_t minlength =
         b1->arraysize < b2->arraysize ? b1->arraysize : b2->arraysize;
-    size_t k = 0;
-    for (; k < minlength; ++k) {
-        b1->array[k] &= ~(b2->array[k]);
-    }
+    bitset_words_inplace(CROARING_BITSET_WORDS_KERNEL(inplace_andnot),
+                         b1->array, b2->array, minlength, executor);
 }
 
 size_t bitset_difference_count(const bitset_t *CROARING_CBITSET_RESTRICT b1,
                                const bitset_t *CROARING_CBITSET_RESTRICT b2) {
+    return bitset_difference_count_parallel(b1, b2, NULL);
+}
+
+size_t bitset_difference_count_parallel(
+    const bitset_t *CROARING_CBITSET_RESTRICT b1,
+    const bitset_t *CROARING_CBITSET_RESTRICT b2,
+    const roaring_executor_t *executor) {
     size_t minlength =
         b1->arraysize < b2->arraysize ? b1->arraysize : b2->arraysize;
-    size_t k = 0;
-    size_t answer = 0;
-    for (; k < minlength; ++k) {
-        answer += roaring_hamming(b1->array[k] & ~(b2->array[k]));
-    }
-    for (; k < b1->arraysize; ++k) {
-        answer += roaring_hamming(b1->array[k]);
-    }
-    return answer;
+    size_t answer =
+        bitset_words_count2(CROARING_BITSET_WORDS_KERNEL(andnot_count),
+                            b1->array, b2->array, minlength, executor);
+    return answer + bitset_words_count(CROARING_BITSET_WORDS_KERNEL(count),
+                                       b1->array + minlength,
+                                       b1->arraysize - minlength, executor);
 }
 
 bool bitset_inplace_symmetric_difference(
     bitset_t *CROARING_CBITSET_RESTRICT b1,
     const bitset_t *CROARING_CBITSET_RESTRICT b2) {
+    return bitset_inplace_symmetric_difference_parallel(b1, b2, NULL);
+}
+
+bool bitset_inplace_symmetric_difference_parallel(
+    bitset_t *CROARING_CBITSET_RESTRICT b1,
+    const bitset_t *CROARING_CBITSET_RESTRICT b2,
+    const roaring_executor_t *executor) {
     size_t minlength =
         b1->arraysize < b2->arraysize ? b1->arraysize : b2->arraysize;
-    size_t k = 0;
-    for (; k < minlength; ++k) {
-        b1->array[k] ^= b2->array[k];
-    }
+    bitset_words_inplace(CROARING_BITSET_WORDS_KERNEL(inplace_xor), b1->array,
+                         b2->array, minlength, executor);
     if (b2->arraysize > b1->arraysize) {
         size_t oldsize = b1->arraysize;
         if (!bitset_resize(b1, b2->arraysize, false)) return false;
@@ -445,23 +844,23 @@ bool bitset_inplace_symmetric_difference(
 size_t bitset_symmetric_difference_count(
     const bitset_t *CROARING_CBITSET_RESTRICT b1,
     const bitset_t *CROARING_CBITSET_RESTRICT b2) {
+    return bitset_symmetric_difference_count_parallel(b1, b2, NULL);
+}
+
+size_t bitset_symmetric_difference_count_parallel(
+    const bitset_t *CROARING_CBITSET_RESTRICT b1,
+    const bitset_t *CROARING_CBITSET_RESTRICT b2,
+    const roaring_executor_t *executor) {
     size_t minlength =
         b1->arraysize < b2->arraysize ? b1->arraysize : b2->arraysize;
-    size_t k = 0;
-    size_t answer = 0;
-    for (; k < minlength; ++k) {
-        answer += roaring_hamming(b1->array[k] ^ b2->array[k]);
-    }
-    if (b2->arraysize > b1->arraysize) {
-        for (; k < b2->arraysize; ++k) {
-            answer += roaring_hamming(b2->array[k]);
-        }
-    } else {
-        for (; k < b1->arraysize; ++k) {
-            answer += roaring_hamming(b1->array[k]);
-        }
-    }
-    return answer;
+    size_t answer =
+        bitset_words_count2(CROARING_BITSET_WORDS_KERNEL(xor_count), b1->array,
+                            b2->array, minlength, executor);
+    const bitset_t *longest = b2->arraysize > b1->arraysize ? b2 : b1;
+    return answer + bitset_words_count(CROARING_BITSET_WORDS_KERNEL(count),
+                                       longest->array + minlength,
+                                       longest->arraysize - minlength,
+                                       executor);
 }
 
 bool bitset_trim(bitset_t *bitset) {
@@ -49,15 +49,18 @@ extern inline bool array_container_full(const array_container_t *array);
 array_container_t *array_container_create_given_capacity(int32_t size) {
     array_container_t *container;
 
-    if ((container = (array_container_t *)roaring_malloc(
-             sizeof(array_container_t))) == NULL) {
+    if ((container = (array_container_t *)roaring_malloc_at(
+             ROARING_ALLOCATION_CONTAINERS, sizeof(array_container_t))) ==
+        NULL) {
         return NULL;
     }
 
-    if (size <= 0) {  // we don't want to rely on malloc(0)
-        container->array = NULL;
-    } else if ((container->array = (uint16_t *)roaring_malloc(sizeof(uint16_t) *
-                                                              size)) == NULL) {
+    if (size <= ARRAY_CONTAINER_INLINE_SIZE) {
+        container->array = container->inline_array;
+        size = ARRAY_CONTAINER_INLINE_SIZE;
+    } else if ((container->array = (uint16_t *)roaring_malloc_at(
+                    ROARING_ALLOCATION_CONTAINERS, sizeof(uint16_t) * size)) ==
+               NULL) {
         roaring_free(container);
         return NULL;
     }
@@ -129,26 +132,32 @@ void array_container_offset(const array_container_t *c, container_t **loc,
 }
 
 int array_container_shrink_to_fit(array_container_t *src) {
+    if (array_container_is_inline(src)) return 0;  // nothing to do
+    uint16_t *oldarray = src->array;
+    if (src->cardinality <= ARRAY_CONTAINER_INLINE_SIZE) {
+        // move the values into the struct and drop the separate allocation
+        int savings = src->capacity;
+        memcpy(src->inline_array, oldarray,
+               src->cardinality * sizeof(uint16_t));
+        roaring_free(oldarray);
+        src->array = src->inline_array;
+        src->capacity = ARRAY_CONTAINER_INLINE_SIZE;
+        return savings;
+    }
     if (src->cardinality == src->capacity) return 0;  // nothing to do
     int savings = src->capacity - src->cardinality;
     src->capacity = src->cardinality;
-    if (src->capacity ==
-        0) {  // we do not want to rely on realloc for zero allocs
-        roaring_free(src->array);
-        src->array = NULL;
-    } else {
-        uint16_t *oldarray = src->array;
-        src->array = (uint16_t *)roaring_realloc(
-            oldarray, src->capacity * sizeof(uint16_t));
-        if (src->array == NULL) roaring_free(oldarray);  // should never happen?
-    }
+    src->array = (uint16_t *)roaring_realloc_at(
+        ROARING_ALLOCATION_CONTAINERS, oldarray,
+        src->capacity * sizeof(uint16_t));
+    if (src->array == NULL) roaring_free(oldarray);  // should never happen?
     return savings;
 }
 
 /* Free memory. */
 void array_container_free(array_container_t *arr) {
     if (arr == NULL) return;
-    roaring_free(arr->array);
+    if (!array_container_is_inline(arr)) roaring_free(arr->array);
     roaring_free(arr);
 }
 
@@ -171,14 +180,23 @@ void array_container_grow(array_container_t *container, int32_t min,
     container->capacity = new_capacity;
     uint16_t *array = container->array;
 
-    if (preserve) {
-        container->array =
-            (uint16_t *)roaring_realloc(array, new_capacity * sizeof(uint16_t));
+    if (array_container_is_inline(container)) {
+        // new_capacity > ARRAY_CONTAINER_INLINE_SIZE, move out of the struct
+        container->array = (uint16_t *)roaring_malloc_at(
+            ROARING_ALLOCATION_CONTAINERS, new_capacity * sizeof(uint16_t));
+        if (preserve && container->array != NULL) {
+            memcpy(container->array, array,
+                   ARRAY_CONTAINER_INLINE_SIZE * sizeof(uint16_t));
+        }
+    } else if (preserve) {
+        container->array = (uint16_t *)roaring_realloc_at(
+            ROARING_ALLOCATION_CONTAINERS, array,
+            new_capacity * sizeof(uint16_t));
         if (container->array == NULL) roaring_free(array);
     } else {
         roaring_free(array);
-        container->array =
-            (uint16_t *)roaring_malloc(new_capacity * sizeof(uint16_t));
+        container->array = (uint16_t *)roaring_malloc_at(
+            ROARING_ALLOCATION_CONTAINERS, new_capacity * sizeof(uint16_t));
     }
 
     // if realloc fails, we have container->array == NULL.
@@ -59,10 +59,49 @@ void bitset_container_set_all(bitset_container_t *bitset) {
     bitset->cardinality = (1 << 16);
 }
 
+static CROARING_THREAD_LOCAL bitset_container_pool_t *current_bitset_pool =
+    NULL;
+
+bitset_container_pool_t *bitset_container_pool_enter(
+    bitset_container_pool_t *pool) {
+    bitset_container_pool_t *previous = current_bitset_pool;
+    current_bitset_pool = pool;
+    return previous;
+}
+
+void bitset_container_pool_leave(bitset_container_pool_t *previous) {
+    current_bitset_pool = previous;
+}
+
+static inline void release_bitset(bitset_container_t *bitset) {
+    roaring_aligned_free(bitset->words);
+    roaring_free(bitset);
+}
+
+void bitset_container_pool_clear(bitset_container_pool_t *pool) {
+    while (pool->size > 0) {
+        release_bitset(pool->bitsets[--pool->size]);
+    }
+}
+
+// Returns a pooled bitset whose content is junk, NULL if there is none.
+static inline bitset_container_t *take_pooled_bitset(void) {
+    bitset_container_pool_t *pool = current_bitset_pool;
+    if (pool == NULL || pool->size == 0) {
+        return NULL;
+    }
+    return pool->bitsets[--pool->size];
+}
+
 /* Create a new bitset. Return NULL in case of failure. */
 bitset_container_t *bitset_container_create(void) {
-    bitset_container_t *bitset =
-        (bitset_container_t *)roaring_malloc(sizeof(bitset_container_t));
+    bitset_container_t *bitset = take_pooled_bitset();
+    if (bitset != NULL) {
+        bitset_container_clear(bitset);
+        return bitset;
+    }
+    bitset = (bitset_container_t *)roaring_malloc_at(
+        ROARING_ALLOCATION_CONTAINERS, sizeof(bitset_container_t));
 
     if (!bitset) {
         return NULL;
@@ -79,8 +118,9 @@ bitset_container_t *bitset_container_create(void) {
         align_size = 32;
     }
 #endif
-    bitset->words = (uint64_t *)roaring_aligned_malloc(
-        align_size, sizeof(uint64_t) * BITSET_CONTAINER_SIZE_IN_WORDS);
+    bitset->words = (uint64_t *)roaring_aligned_malloc_at(
+        ROARING_ALLOCATION_CONTAINERS, align_size,
+        sizeof(uint64_t) * BITSET_CONTAINER_SIZE_IN_WORDS);
     if (!bitset->words) {
         roaring_free(bitset);
         return NULL;
@@ -128,15 +168,24 @@ void bitset_container_add_from_range(bitset_container_t *bitset, uint32_t min,
 /* Free memory. */
 void bitset_container_free(bitset_container_t *bitset) {
     if (bitset == NULL) return;
-    roaring_aligned_free(bitset->words);
-    roaring_free(bitset);
+    bitset_container_pool_t *pool = current_bitset_pool;
+    if (pool != NULL && pool->size < pool->capacity) {
+        pool->bitsets[pool->size++] = bitset;
+        return;
+    }
+    release_bitset(bitset);
 }
 
 /* duplicate container. */
 CROARING_ALLOW_UNALIGNED
 bitset_container_t *bitset_container_clone(const bitset_container_t *src) {
-    bitset_container_t *bitset =
-        (bitset_container_t *)roaring_malloc(sizeof(bitset_container_t));
+    bitset_container_t *bitset = take_pooled_bitset();
+    if (bitset != NULL) {
+        bitset_container_copy(src, bitset);
+        return bitset;
+    }
+    bitset = (bitset_container_t *)roaring_malloc_at(
+        ROARING_ALLOCATION_CONTAINERS, sizeof(bitset_container_t));
 
     if (!bitset) {
         return NULL;
@@ -152,8 +201,9 @@ bitset_container_t *bitset_container_clone(const bitset_container_t *src) {
         align_size = 32;
     }
 #endif
-    bitset->words = (uint64_t *)roaring_aligned_malloc(
-        align_size, sizeof(uint64_t) * BITSET_CONTAINER_SIZE_IN_WORDS);
+    bitset->words = (uint64_t *)roaring_aligned_malloc_at(
+        ROARING_ALLOCATION_CONTAINERS, align_size,
+        sizeof(uint64_t) * BITSET_CONTAINER_SIZE_IN_WORDS);
     if (!bitset->words) {
         roaring_free(bitset);
         return NULL;
@@ -1310,6 +1360,68 @@ int bitset_container_index_equalorlarger(const bitset_container_t *container, ui
   return k * 64 + roaring_trailing_zeroes(word);
 }
 
+/* Returns the index of the first word at or after i that differs from fill,
+ * or BITSET_CONTAINER_SIZE_IN_WORDS. Long stretches of empty or full words
+ * are where runs begin and end, so this is the hot loop when walking the
+ * runs of a bitset. */
+static inline uint32_t _scalar_bitset_skip_words(const uint64_t *words,
+                                                 uint32_t i, uint64_t fill) {
+  while (i < BITSET_CONTAINER_SIZE_IN_WORDS && words[i] == fill) i++;
+  return i;
+}
+
+#if CROARING_IS_X64
+CROARING_TARGET_AVX2
+static uint32_t _avx2_bitset_skip_words(const uint64_t *words, uint32_t i,
+                                        uint64_t fill) {
+  const __m256i f = _mm256_set1_epi64x((long long)fill);
+  for (; i + CROARING_WORDS_IN_AVX2_REG <= BITSET_CONTAINER_SIZE_IN_WORDS;
+       i += CROARING_WORDS_IN_AVX2_REG) {
+    __m256i w = _mm256_loadu_si256((const __m256i *)(words + i));
+    uint32_t equal = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi64(w, f));
+    if (equal != UINT32_MAX) {
+      return i + roaring_trailing_zeroes(~equal) / 8;
+    }
+  }
+  return _scalar_bitset_skip_words(words, i, fill);
+}
+CROARING_UNTARGET_AVX2
+#endif
+
+static inline uint32_t bitset_skip_words(const uint64_t *words, uint32_t i,
+                                         uint64_t fill) {
+#if CROARING_IS_X64
+  if (croaring_hardware_support() & ROARING_SUPPORTS_AVX2) {
+    return _avx2_bitset_skip_words(words, i, fill);
+  }
+#endif
+  return _scalar_bitset_skip_words(words, i, fill);
+}
+
+/* Returns the first position at or after pos whose bit differs from the bits
+ * of fill, or 1 << 16 if there is none. */
+static inline uint32_t bitset_find_transition(const uint64_t *words,
+                                              uint32_t pos, uint64_t fill) {
+  uint32_t k = pos / 64;
+  uint64_t word = (words[k] ^ fill) & (UINT64_MAX << (pos % 64));
+  if (word == 0) {
+    k = bitset_skip_words(words, k + 1, fill);
+    if (k == BITSET_CONTAINER_SIZE_IN_WORDS) return 1 << 16;
+    word = words[k] ^ fill;
+  }
+  return k * 64 + roaring_trailing_zeroes(word);
+}
+
+uint32_t bitset_container_next_set_bit(const bitset_container_t *container,
+                                       uint32_t pos) {
+  return bitset_find_transition(container->words, pos, 0);
+}
+
+uint32_t bitset_container_next_clear_bit(const bitset_container_t *container,
+                                         uint32_t pos) {
+  return bitset_find_transition(container->words, pos, UINT64_MAX);
+}
+
 #ifdef __cplusplus
 } } }  // extern "C" { namespace roaring { namespace internal {
 #endif
@@ -177,6 +177,71 @@ extern inline container_t *container_xor(const container_t *c1, uint8_t type1,
                                          const container_t *c2, uint8_t type2,
                                          uint8_t *result_type);
 
+void container_builder_init(container_builder_t *b) {
+    b->cardinality = 0;
+    b->n_runs = 0;
+    b->last = 0;
+    b->words = NULL;
+    b->is_bitset = false;
+}
+
+void container_builder_clear(container_builder_t *b) {
+    roaring_aligned_free(b->words);
+    container_builder_init(b);
+}
+
+bool container_builder_to_bitset(container_builder_t *b) {
+    if (b->words == NULL) {
+        b->words = (uint64_t *)roaring_aligned_malloc_at(
+            ROARING_ALLOCATION_CONTAINERS, 32,
+            BITSET_CONTAINER_SIZE_IN_WORDS * sizeof(uint64_t));
+        if (b->words == NULL) {
+            return false;
+        }
+        memset(b->words, 0, BITSET_CONTAINER_SIZE_IN_WORDS * sizeof(uint64_t));
+    }
+    bitset_set_list(b->words, b->values, b->cardinality);
+    b->is_bitset = true;
+    return true;
+}
+
+container_t *container_builder_finish(container_builder_t *b,
+                                      uint8_t *typecode) {
+    container_t *c = NULL;
+    int32_t card = b->cardinality;
+    if (card == 0) {
+        return NULL;
+    }
+    if (b->is_bitset) {
+        bitset_container_t *bitset = bitset_container_create();
+        if (bitset != NULL) {
+            memcpy(bitset->words, b->words,
+                   BITSET_CONTAINER_SIZE_IN_WORDS * sizeof(uint64_t));
+            bitset->cardinality = card;
+            c = bitset;
+            *typecode = BITSET_CONTAINER_TYPE;
+        }
+        // the scratch bitset is kept for the next container
+        memset(b->words, 0, BITSET_CONTAINER_SIZE_IN_WORDS * sizeof(uint64_t));
+    } else {
+        array_container_t *array = array_container_create_given_capacity(card);
+        if (array != NULL) {
+            memcpy(array->array, b->values, card * sizeof(uint16_t));
+            array->cardinality = card;
+            c = array;
+            *typecode = ARRAY_CONTAINER_TYPE;
+        }
+    }
+    if (c != NULL && run_container_serialized_size_in_bytes(b->n_runs) <
+                         container_size_in_bytes(c, *typecode)) {
+        c = convert_run_optimize(c, *typecode, typecode);
+    }
+    b->cardinality = 0;
+    b->n_runs = 0;
+    b->is_bitset = false;
+    return c;
+}
+
 container_t *get_copy_of_container(container_t *c, uint8_t *typecode,
                                    bool copy_on_write) {
     if (copy_on_write) {
@@ -188,8 +253,9 @@ container_t *get_copy_of_container(container_t *c, uint8_t *typecode,
         }
         assert(*typecode != SHARED_CONTAINER_TYPE);
 
-        if ((shared_container = (shared_container_t *)roaring_malloc(
-                 sizeof(shared_container_t))) == NULL) {
+        if ((shared_container = (shared_container_t *)roaring_malloc_at(
+                 ROARING_ALLOCATION_CONTAINERS, sizeof(shared_container_t))) ==
+            NULL) {
             return NULL;
         }
 
@@ -1005,44 +1071,22 @@ uint16_t container_iterator_find_run_end(const container_t *c, uint8_t typecode,
         case BITSET_CONTAINER_TYPE: {
             const bitset_container_t *bc = const_CAST_bitset(c);
             uint32_t pos = (uint32_t)*value + 1;
-            uint16_t run_end;
-            if (pos >= (1 << 16)) {
-                *has_more = false;
-                return UINT16_MAX;
+            uint32_t next_clear = pos;
+            if (next_clear < (1 << 16)) {
+                next_clear = bitset_container_next_clear_bit(bc, next_clear);
             }
-            uint32_t wordindex = pos / 64;
-            uint64_t word = ~bc->words[wordindex] & (UINT64_MAX << (pos % 64));
-            while (word == 0 &&
-                   wordindex + 1 < BITSET_CONTAINER_SIZE_IN_WORDS) {
-                wordindex++;
-                word = ~bc->words[wordindex];
+            uint32_t next_set = next_clear;
+            if (next_set < (1 << 16)) {
+                next_set = bitset_container_next_set_bit(bc, next_set);
             }
-            if (word != 0) {
-                run_end = (uint16_t)(wordindex * 64 +
-                                     roaring_trailing_zeroes(word) - 1);
+            if (next_set < (1 << 16)) {
+                *has_more = true;
+                it->index = (int32_t)next_set;
+                *value = (uint16_t)next_set;
             } else {
-                run_end = UINT16_MAX;
-            }
-            uint32_t next_pos = (uint32_t)run_end + 1;
-            if (next_pos >= (1 << 16)) {
                 *has_more = false;
-            } else {
-                wordindex = next_pos / 64;
-                word = bc->words[wordindex] & (UINT64_MAX << (next_pos % 64));
-                while (word == 0 &&
-                       wordindex + 1 < BITSET_CONTAINER_SIZE_IN_WORDS) {
-                    wordindex++;
-                    word = bc->words[wordindex];
-                }
-                if (word != 0) {
-                    *has_more = true;
-                    it->index = wordindex * 64 + roaring_trailing_zeroes(word);
-                    *value = (uint16_t)it->index;
-                } else {
-                    *has_more = false;
-                }
             }
-            return run_end;
+            return (uint16_t)(next_clear - 1);
         }
         default:
             assert(false);
@@ -1133,6 +1177,84 @@ uint16_t container_iterator_find_run_start(const container_t *c,
     }
 }
 
+#if ROARING_KERNEL_COUNTERS
+
+typedef struct kernel_counter_s {
+    croaring_counter_t calls;
+    croaring_counter_t bytes;
+} kernel_counter_t;
+
+static kernel_counter_t pair_counters[ROARING_KERNEL_OP_COUNT][3][3];
+static kernel_counter_t conversion_counters[ROARING_CONVERSION_COUNT];
+
+static void count_kernel(kernel_counter_t *counter, int32_t bytes) {
+    croaring_counter_add(&counter->calls, 1);
+    croaring_counter_add(&counter->bytes, (uint64_t)bytes);
+}
+
+static void load_kernel_count(kernel_counter_t *counter,
+                              roaring_kernel_count_t *count) {
+    count->calls = croaring_counter_load(&counter->calls);
+    count->bytes = croaring_counter_load(&counter->bytes);
+}
+
+static void reset_kernel_count(kernel_counter_t *counter) {
+    croaring_counter_store(&counter->calls, 0);
+    croaring_counter_store(&counter->bytes, 0);
+}
+
+void container_count_pair(roaring_kernel_op_t op, const container_t *c1,
+                          uint8_t type1, const container_t *c2, uint8_t type2) {
+    assert(type1 != SHARED_CONTAINER_TYPE && type2 != SHARED_CONTAINER_TYPE);
+    count_kernel(&pair_counters[op][type1 - 1][type2 - 1],
+                 container_size_in_bytes(c1, type1) +
+                     container_size_in_bytes(c2, type2));
+}
+
+void container_count_conversion(roaring_conversion_t conversion,
+                                int32_t bytes) {
+    count_kernel(&conversion_counters[conversion], bytes);
+}
+
+bool container_kernel_counters(roaring_kernel_counters_t *counters) {
+    for (int op = 0; op < ROARING_KERNEL_OP_COUNT; op++) {
+        for (int t1 = 0; t1 < 3; t1++) {
+            for (int t2 = 0; t2 < 3; t2++) {
+                load_kernel_count(&pair_counters[op][t1][t2],
+                                  &counters->pairs[op][t1][t2]);
+            }
+        }
+    }
+    for (int i = 0; i < ROARING_CONVERSION_COUNT; i++) {
+        load_kernel_count(&conversion_counters[i], &counters->conversions[i]);
+    }
+    return true;
+}
+
+void container_kernel_counters_reset(void) {
+    for (int op = 0; op < ROARING_KERNEL_OP_COUNT; op++) {
+        for (int t1 = 0; t1 < 3; t1++) {
+            for (int t2 = 0; t2 < 3; t2++) {
+                reset_kernel_count(&pair_counters[op][t1][t2]);
+            }
+        }
+    }
+    for (int i = 0; i < ROARING_CONVERSION_COUNT; i++) {
+        reset_kernel_count(&conversion_counters[i]);
+    }
+}
+
+#else  // ROARING_KERNEL_COUNTERS
+
+bool container_kernel_counters(roaring_kernel_counters_t *counters) {
+    memset(counters, 0, sizeof(*counters));
+    return false;
+}
+
+void container_kernel_counters_reset(void) {}
+
+#endif  // ROARING_KERNEL_COUNTERS
+
 #ifdef __cplusplus
 }
 }
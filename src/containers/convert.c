@@ -20,6 +20,8 @@ namespace internal {
 // file contains grubby stuff that must know impl. details of all container
 // types.
 bitset_container_t *bitset_container_from_array(const array_container_t *ac) {
+    COUNT_CONTAINER_CONVERSION(ROARING_CONVERSION_ARRAY_TO_BITSET,
+                               array_container_size_in_bytes(ac));
     bitset_container_t *ans = bitset_container_create();
     int limit = array_container_cardinality(ac);
     for (int i = 0; i < limit; ++i) bitset_container_set(ans, ac->array[i]);
@@ -27,6 +29,8 @@ bitset_container_t *bitset_container_from_array(const array_container_t *ac) {
 }
 
 bitset_container_t *bitset_container_from_run(const run_container_t *arr) {
+    COUNT_CONTAINER_CONVERSION(ROARING_CONVERSION_RUN_TO_BITSET,
+                               run_container_size_in_bytes(arr));
     int card = run_container_cardinality(arr);
     bitset_container_t *answer = bitset_container_create();
     for (int rlepos = 0; rlepos < arr->n_runs; ++rlepos) {
@@ -38,6 +42,8 @@ bitset_container_t *bitset_container_from_run(const run_container_t *arr) {
 }
 
 array_container_t *array_container_from_run(const run_container_t *arr) {
+    COUNT_CONTAINER_CONVERSION(ROARING_CONVERSION_RUN_TO_ARRAY,
+                               run_container_size_in_bytes(arr));
     array_container_t *answer =
         array_container_create_given_capacity(run_container_cardinality(arr));
     answer->cardinality = 0;
@@ -53,6 +59,8 @@ array_container_t *array_container_from_run(const run_container_t *arr) {
 }
 
 array_container_t *array_container_from_bitset(const bitset_container_t *bits) {
+    COUNT_CONTAINER_CONVERSION(ROARING_CONVERSION_BITSET_TO_ARRAY,
+                               bitset_container_size_in_bytes(bits));
     array_container_t *result =
         array_container_create_given_capacity(bits->cardinality);
     result->cardinality = bits->cardinality;
@@ -88,6 +96,8 @@ static void add_run(run_container_t *rc, int s, int e) {
 }
 
 run_container_t *run_container_from_array(const array_container_t *c) {
+    COUNT_CONTAINER_CONVERSION(ROARING_CONVERSION_ARRAY_TO_RUN,
+                               array_container_size_in_bytes(c));
     int32_t n_runs = array_container_number_of_runs(c);
     run_container_t *answer = run_container_create_given_capacity(n_runs);
     int prev = -2;
@@ -119,6 +129,8 @@ container_t *convert_to_bitset_or_array_container(run_container_t *rc,
                                                   int32_t card,
                                                   uint8_t *resulttype) {
     if (card <= DEFAULT_MAX_SIZE) {
+        COUNT_CONTAINER_CONVERSION(ROARING_CONVERSION_RUN_TO_ARRAY,
+                                   run_container_size_in_bytes(rc));
         array_container_t *answer = array_container_create_given_capacity(card);
         answer->cardinality = 0;
         for (int rlepos = 0; rlepos < rc->n_runs; ++rlepos) {
@@ -135,6 +147,8 @@ container_t *convert_to_bitset_or_array_container(run_container_t *rc,
         // run_container_free(r);
         return answer;
     }
+    COUNT_CONTAINER_CONVERSION(ROARING_CONVERSION_RUN_TO_BITSET,
+                               run_container_size_in_bytes(rc));
     bitset_container_t *answer = bitset_container_create();
     for (int rlepos = 0; rlepos < rc->n_runs; ++rlepos) {
         uint16_t run_start = rc->runs[rlepos].value;
@@ -172,6 +186,8 @@ container_t *convert_run_to_efficient_container(run_container_t *c,
     }
     if (card <= DEFAULT_MAX_SIZE) {
         // to array
+        COUNT_CONTAINER_CONVERSION(ROARING_CONVERSION_RUN_TO_ARRAY,
+                                   size_as_run_container);
         array_container_t *answer = array_container_create_given_capacity(card);
         answer->cardinality = 0;
         for (int rlepos = 0; rlepos < c->n_runs; ++rlepos) {
@@ -187,6 +203,8 @@ container_t *convert_run_to_efficient_container(run_container_t *c,
     }
 
     // else to bitset
+    COUNT_CONTAINER_CONVERSION(ROARING_CONVERSION_RUN_TO_BITSET,
+                               size_as_run_container);
     bitset_container_t *answer = bitset_container_create();
 
     for (int rlepos = 0; rlepos < c->n_runs; ++rlepos) {
@@ -214,6 +232,42 @@ container_t *convert_run_to_efficient_container_and_free(
 // TODO: split into run-  array-  and bitset-  subfunctions for sanity;
 // a few function calls won't really matter.
 
+/* assumes that container has adequate space. Appends the runs of the
+ * BITSET_CONTAINER_SIZE_IN_WORDS words, which must not all be zero. */
+static void add_runs_from_words(run_container_t *answer,
+                                const uint64_t *words) {
+    int long_ctr = 0;
+    uint64_t cur_word = words[0];
+    while (true) {
+        while (cur_word == UINT64_C(0) &&
+               long_ctr < BITSET_CONTAINER_SIZE_IN_WORDS - 1)
+            cur_word = words[++long_ctr];
+
+        if (cur_word == UINT64_C(0)) {
+            return;
+        }
+
+        int local_run_start = roaring_trailing_zeroes(cur_word);
+        int run_start = local_run_start + 64 * long_ctr;
+        uint64_t cur_word_with_1s = cur_word | (cur_word - 1);
+
+        int run_end = 0;
+        while (cur_word_with_1s == UINT64_C(0xFFFFFFFFFFFFFFFF) &&
+               long_ctr < BITSET_CONTAINER_SIZE_IN_WORDS - 1)
+            cur_word_with_1s = words[++long_ctr];
+
+        if (cur_word_with_1s == UINT64_C(0xFFFFFFFFFFFFFFFF)) {
+            run_end = 64 + long_ctr * 64;  // exclusive, I guess
+            add_run(answer, run_start, run_end - 1);
+            return;
+        }
+        int local_run_end = roaring_trailing_zeroes(~cur_word_with_1s);
+        run_end = local_run_end + long_ctr * 64;
+        add_run(answer, run_start, run_end - 1);
+        cur_word = cur_word_with_1s & (cur_word_with_1s + 1);
+    }
+}
+
 container_t *convert_run_optimize(container_t *c, uint8_t typecode_original,
                                   uint8_t *typecode_after) {
     if (typecode_original == RUN_CONTAINER_TYPE) {
@@ -238,6 +292,8 @@ container_t *convert_run_optimize(container_t *c, uint8_t typecode_original,
             return c;
         }
         // else convert array to run container
+        COUNT_CONTAINER_CONVERSION(ROARING_CONVERSION_ARRAY_TO_RUN,
+                                   size_as_array_container);
         run_container_t *answer = run_container_create_given_capacity(n_runs);
         int prev = -2;
         int run_start = -1;
@@ -276,42 +332,12 @@ container_t *convert_run_optimize(container_t *c, uint8_t typecode_original,
         // bitset to runcontainer (ported from Java  RunContainer(
         // BitmapContainer bc, int nbrRuns))
         assert(n_runs > 0);  // no empty bitmaps
+        COUNT_CONTAINER_CONVERSION(ROARING_CONVERSION_BITSET_TO_RUN,
+                                   size_as_bitset_container);
         run_container_t *answer = run_container_create_given_capacity(n_runs);
-
-        int long_ctr = 0;
-        uint64_t cur_word = c_qua_bitset->words[0];
-        while (true) {
-            while (cur_word == UINT64_C(0) &&
-                   long_ctr < BITSET_CONTAINER_SIZE_IN_WORDS - 1)
-                cur_word = c_qua_bitset->words[++long_ctr];
-
-            if (cur_word == UINT64_C(0)) {
-                bitset_container_free(c_qua_bitset);
-                *typecode_after = RUN_CONTAINER_TYPE;
-                return answer;
-            }
-
-            int local_run_start = roaring_trailing_zeroes(cur_word);
-            int run_start = local_run_start + 64 * long_ctr;
-            uint64_t cur_word_with_1s = cur_word | (cur_word - 1);
-
-            int run_end = 0;
-            while (cur_word_with_1s == UINT64_C(0xFFFFFFFFFFFFFFFF) &&
-                   long_ctr < BITSET_CONTAINER_SIZE_IN_WORDS - 1)
-                cur_word_with_1s = c_qua_bitset->words[++long_ctr];
-
-            if (cur_word_with_1s == UINT64_C(0xFFFFFFFFFFFFFFFF)) {
-                run_end = 64 + long_ctr * 64;  // exclusive, I guess
-                add_run(answer, run_start, run_end - 1);
-                bitset_container_free(c_qua_bitset);
-                *typecode_after = RUN_CONTAINER_TYPE;
-                return answer;
-            }
-            int local_run_end = roaring_trailing_zeroes(~cur_word_with_1s);
-            run_end = local_run_end + long_ctr * 64;
-            add_run(answer, run_start, run_end - 1);
-            cur_word = cur_word_with_1s & (cur_word_with_1s + 1);
-        }
+        add_runs_from_words(answer, c_qua_bitset->words);
+        bitset_container_free(c_qua_bitset);
+        *typecode_after = RUN_CONTAINER_TYPE;
         return answer;
     } else {
         assert(false);
@@ -320,6 +346,45 @@ container_t *convert_run_optimize(container_t *c, uint8_t typecode_original,
     }
 }
 
+container_t *container_from_words(const uint64_t *words, uint8_t *typecode) {
+    // one pass for the cardinality and the number of runs (rising edges)
+    int32_t card = 0, n_runs = 0;
+    uint64_t carry = 0;
+    for (int i = 0; i < BITSET_CONTAINER_SIZE_IN_WORDS; i++) {
+        uint64_t w = words[i];
+        card += roaring_hamming(w);
+        n_runs += roaring_hamming(w & ~((w << 1) | carry));
+        carry = w >> 63;
+    }
+    assert(card > 0);
+    int32_t size_as_run_container =
+        run_container_serialized_size_in_bytes(n_runs);
+    int32_t size_otherwise =
+        card <= DEFAULT_MAX_SIZE
+            ? array_container_serialized_size_in_bytes(card)
+            : bitset_container_serialized_size_in_bytes();
+    if (size_as_run_container < size_otherwise) {
+        run_container_t *answer = run_container_create_given_capacity(n_runs);
+        if (answer == NULL) return NULL;
+        add_runs_from_words(answer, words);
+        *typecode = RUN_CONTAINER_TYPE;
+        return answer;
+    }
+    // array_container_from_bitset only reads the words and the cardinality
+    bitset_container_t view;
+    view.cardinality = card;
+    view.words = (uint64_t *)words;
+    if (card <= DEFAULT_MAX_SIZE) {
+        *typecode = ARRAY_CONTAINER_TYPE;
+        return array_container_from_bitset(&view);
+    }
+    bitset_container_t *answer = bitset_container_create();
+    if (answer == NULL) return NULL;
+    bitset_container_copy(&view, answer);
+    *typecode = BITSET_CONTAINER_TYPE;
+    return answer;
+}
+
 container_t *container_from_run_range(const run_container_t *run, uint32_t min,
                                       uint32_t max, uint8_t *typecode_after) {
     // We expect most of the time to end up with a bitset container
@@ -89,14 +89,15 @@ bool run_container_add(run_container_t *run, uint16_t pos) {
 run_container_t *run_container_create_given_capacity(int32_t size) {
     run_container_t *run;
     /* Allocate the run container itself. */
-    if ((run = (run_container_t *)roaring_malloc(sizeof(run_container_t))) ==
-        NULL) {
+    if ((run = (run_container_t *)roaring_malloc_at(
+             ROARING_ALLOCATION_CONTAINERS, sizeof(run_container_t))) == NULL) {
         return NULL;
     }
     if (size <= 0) {  // we don't want to rely on malloc(0)
         run->runs = NULL;
-    } else if ((run->runs = (rle16_t *)roaring_malloc(sizeof(rle16_t) *
-                                                      size)) == NULL) {
+    } else if ((run->runs = (rle16_t *)roaring_malloc_at(
+                    ROARING_ALLOCATION_CONTAINERS, sizeof(rle16_t) * size)) ==
+               NULL) {
         roaring_free(run);
         return NULL;
     }
@@ -110,8 +111,9 @@ int run_container_shrink_to_fit(run_container_t *src) {
     int savings = src->capacity - src->n_runs;
     src->capacity = src->n_runs;
     rle16_t *oldruns = src->runs;
-    src->runs =
-        (rle16_t *)roaring_realloc(oldruns, src->capacity * sizeof(rle16_t));
+    src->runs = (rle16_t *)roaring_realloc_at(ROARING_ALLOCATION_CONTAINERS,
+                                              oldruns,
+                                              src->capacity * sizeof(rle16_t));
     if (src->runs == NULL) roaring_free(oldruns);  // should never happen?
     return savings;
 }
@@ -206,12 +208,14 @@ void run_container_grow(run_container_t *run, int32_t min, bool copy) {
     assert(run->capacity >= min);
     if (copy) {
         rle16_t *oldruns = run->runs;
-        run->runs = (rle16_t *)roaring_realloc(oldruns,
-                                               run->capacity * sizeof(rle16_t));
+        run->runs = (rle16_t *)roaring_realloc_at(
+            ROARING_ALLOCATION_CONTAINERS, oldruns,
+            run->capacity * sizeof(rle16_t));
         if (run->runs == NULL) roaring_free(oldruns);
     } else {
         roaring_free(run->runs);
-        run->runs = (rle16_t *)roaring_malloc(run->capacity * sizeof(rle16_t));
+        run->runs = (rle16_t *)roaring_malloc_at(
+            ROARING_ALLOCATION_CONTAINERS, run->capacity * sizeof(rle16_t));
     }
     // We may have run->runs == NULL.
 }
@@ -1,6 +1,9 @@
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <roaring/memory.h>
+#include <roaring/portability.h>
 
 // without the following, we get lots of warnings about posix_memalign
 #ifndef __cplusplus
@@ -45,20 +48,451 @@ void roaring_init_memory_hook(roaring_memory_t memory_hook) {
     global_memory_hook = memory_hook;
 }
 
-void* roaring_malloc(size_t n) { return global_memory_hook.malloc(n); }
+// Slabs are chained, the slab being filled first. The data of a slab follows
+// its header.
+typedef struct roaring_arena_slab_s {
+    struct roaring_arena_slab_s* next;
+    size_t size;  // bytes obtained from the hooks, header included
+} roaring_arena_slab_t;
 
-void* roaring_realloc(void* p, size_t new_sz) {
+struct roaring_arena_s {
+    roaring_allocator_t allocator;  // whose context is the arena
+    roaring_arena_slab_t* slabs;
+    char* top;  // first free byte of the first slab
+    char* end;  // end of the first slab
+    size_t slab_size;
+    size_t size_in_bytes;
+    size_t bitmaps;
+    bool released;
+};
+
+// Each block is preceded by its size, which realloc needs.
+enum { ARENA_ALIGNMENT = 8, ARENA_DEFAULT_SLAB_SIZE = 64 * 1024 };
+
+static CROARING_THREAD_LOCAL const roaring_allocator_t* current_allocator =
+    NULL;
+
+static inline uintptr_t arena_align(uintptr_t p, size_t alignment) {
+    return (p + alignment - 1) & ~(uintptr_t)(alignment - 1);
+}
+
+static void* arena_bump(roaring_arena_t* arena, size_t alignment,
+                        size_t size) {
+    uintptr_t p = arena_align((uintptr_t)arena->top + sizeof(size_t),
+                              alignment);
+    if (arena->top == NULL || p + size > (uintptr_t)arena->end) {
+        size_t needed = sizeof(roaring_arena_slab_t) + sizeof(size_t) +
+                        alignment + size;
+        size_t slab_size =
+            needed > arena->slab_size ? needed : arena->slab_size;
+        roaring_arena_slab_t* slab =
+            (roaring_arena_slab_t*)global_memory_hook.malloc(slab_size);
+        if (slab == NULL) return NULL;
+        slab->next = arena->slabs;
+        slab->size = slab_size;
+        arena->slabs = slab;
+        arena->top = (char*)(slab + 1);
+        arena->end = (char*)slab + slab_size;
+        arena->size_in_bytes += slab_size;
+        p = arena_align((uintptr_t)arena->top + sizeof(size_t), alignment);
+    }
+    ((size_t*)p)[-1] = size;
+    arena->top = (char*)(p + size);
+    return (void*)p;
+}
+
+// Only the last block of the current slab is given back: the others stay
+// until compaction.
+static void arena_release(roaring_arena_t* arena, void* p) {
+    if (p != NULL && (char*)p + ((size_t*)p)[-1] == arena->top) {
+        arena->top = (char*)p - sizeof(size_t);
+    }
+}
+
+static void* arena_resize(roaring_arena_t* arena, void* p, size_t size) {
+    if (p == NULL) return arena_bump(arena, ARENA_ALIGNMENT, size);
+    size_t old_size = ((size_t*)p)[-1];
+    if ((char*)p + old_size == arena->top && (char*)p + size <= arena->end) {
+        ((size_t*)p)[-1] = size;
+        arena->top = (char*)p + size;
+        return p;
+    }
+    if (size <= old_size) return p;  // nothing to gain from moving it
+    void* q = arena_bump(arena, ARENA_ALIGNMENT, size);
+    if (q != NULL) {
+        memcpy(q, p, old_size < size ? old_size : size);
+    }
+    return q;
+}
+
+static void arena_free_slabs(roaring_arena_slab_t* slab) {
+    while (slab != NULL) {
+        roaring_arena_slab_t* next = slab->next;
+        global_memory_hook.free(slab);
+        slab = next;
+    }
+}
+
+static void* arena_malloc(void* context, size_t size) {
+    return arena_bump((roaring_arena_t*)context, ARENA_ALIGNMENT, size);
+}
+
+static void* arena_realloc(void* context, void* p, size_t size) {
+    return arena_resize((roaring_arena_t*)context, p, size);
+}
+
+static void arena_free(void* context, void* p) {
+    arena_release((roaring_arena_t*)context, p);
+}
+
+static void* arena_aligned_malloc(void* context, size_t alignment,
+                                  size_t size) {
+    return arena_bump((roaring_arena_t*)context,
+                      alignment < ARENA_ALIGNMENT ? ARENA_ALIGNMENT : alignment,
+                      size);
+}
+
+roaring_arena_t* roaring_arena_create(size_t slab_size) {
+    roaring_arena_t* arena =
+        (roaring_arena_t*)global_memory_hook.malloc(sizeof(roaring_arena_t));
+    if (arena == NULL) return NULL;
+    memset(arena, 0, sizeof(*arena));
+    arena->allocator.malloc = arena_malloc;
+    arena->allocator.realloc = arena_realloc;
+    arena->allocator.free = arena_free;
+    arena->allocator.aligned_malloc = arena_aligned_malloc;
+    arena->allocator.aligned_free = arena_free;
+    arena->allocator.context = arena;
+    arena->slab_size = slab_size == 0 ? ARENA_DEFAULT_SLAB_SIZE : slab_size;
+    return arena;
+}
+
+static void arena_drop(roaring_arena_t* arena) {
+    arena_free_slabs(arena->slabs);
+    global_memory_hook.free(arena);
+}
+
+void roaring_arena_free(roaring_arena_t* arena) {
+    if (arena == NULL) return;
+    arena->released = true;
+    if (arena->bitmaps == 0) arena_drop(arena);
+}
+
+size_t roaring_arena_size_in_bytes(const roaring_arena_t* arena) {
+    return arena->size_in_bytes;
+}
+
+const roaring_allocator_t* roaring_arena_allocator(roaring_arena_t* arena) {
+    return &arena->allocator;
+}
+
+roaring_arena_t* roaring_allocator_arena(const roaring_allocator_t* allocator) {
+    if (allocator == NULL || allocator->malloc != arena_malloc) return NULL;
+    return (roaring_arena_t*)allocator->context;
+}
+
+const roaring_allocator_t* roaring_allocator_enter(
+    const roaring_allocator_t* allocator) {
+    const roaring_allocator_t* previous = current_allocator;
+    current_allocator = allocator;
+    return previous;
+}
+
+void roaring_allocator_leave(const roaring_allocator_t* previous) {
+    current_allocator = previous;
+}
+
+const roaring_allocator_t* roaring_allocator_current(void) {
+    return current_allocator;
+}
+
+void roaring_arena_add_bitmap(roaring_arena_t* arena) { arena->bitmaps++; }
+
+void roaring_arena_remove_bitmap(roaring_arena_t* arena) {
+    arena->bitmaps--;
+    if (arena->bitmaps == 0 && arena->released) arena_drop(arena);
+}
+
+size_t roaring_arena_bitmap_count(const roaring_arena_t* arena) {
+    return arena->bitmaps;
+}
+
+size_t roaring_arena_compact(roaring_arena_t* arena, bool (*copy)(void*),
+                             void* context) {
+    roaring_arena_slab_t* slabs = arena->slabs;
+    char* top = arena->top;
+    char* end = arena->end;
+    size_t size_in_bytes = arena->size_in_bytes;
+    arena->slabs = NULL;
+    arena->top = arena->end = NULL;
+    arena->size_in_bytes = 0;
+    if (!copy(context)) {
+        // keep filling the fresh slabs, the former ones stay in use
+        roaring_arena_slab_t** last = &arena->slabs;
+        while (*last != NULL) last = &(*last)->next;
+        *last = slabs;
+        if (arena->slabs == slabs) {
+            arena->top = top;
+            arena->end = end;
+        }
+        arena->size_in_bytes += size_in_bytes;
+        return 0;
+    }
+    arena_free_slabs(slabs);
+    return size_in_bytes > arena->size_in_bytes
+               ? size_in_bytes - arena->size_in_bytes
+               : 0;
+}
+
+// The allocator `a` serves the allocations, the memory hooks if NULL.
+static inline void* dispatch_malloc(const roaring_allocator_t* a, size_t n) {
+    if (a != NULL) return a->malloc(a->context, n);
+    return global_memory_hook.malloc(n);
+}
+
+static inline void* dispatch_realloc(const roaring_allocator_t* a, void* p,
+                                     size_t new_sz) {
+    if (a != NULL) return a->realloc(a->context, p, new_sz);
     return global_memory_hook.realloc(p, new_sz);
 }
 
-void* roaring_calloc(size_t n_elements, size_t element_size) {
+static inline void* dispatch_calloc(const roaring_allocator_t* a,
+                                    size_t n_elements, size_t element_size) {
+    if (a != NULL) {
+        size_t size = n_elements * element_size;
+        void* p = a->malloc(a->context, size);
+        if (p != NULL) memset(p, 0, size);
+        return p;
+    }
     return global_memory_hook.calloc(n_elements, element_size);
 }
 
-void roaring_free(void* p) { global_memory_hook.free(p); }
+static inline void dispatch_free(const roaring_allocator_t* a, void* p) {
+    if (a != NULL) {
+        a->free(a->context, p);
+        return;
+    }
+    global_memory_hook.free(p);
+}
 
-void* roaring_aligned_malloc(size_t alignment, size_t size) {
+static inline void* dispatch_aligned_malloc(const roaring_allocator_t* a,
+                                            size_t alignment, size_t size) {
+    if (a != NULL) return a->aligned_malloc(a->context, alignment, size);
     return global_memory_hook.aligned_malloc(alignment, size);
 }
 
-void roaring_aligned_free(void* p) { global_memory_hook.aligned_free(p); }
+static inline void dispatch_aligned_free(const roaring_allocator_t* a,
+                                         void* p) {
+    if (a != NULL) {
+        a->aligned_free(a->context, p);
+        return;
+    }
+    global_memory_hook.aligned_free(p);
+}
+
+#if ROARING_ALLOCATION_STATS
+
+static croaring_counter_t live_bytes[ROARING_ALLOCATION_SITE_COUNT];
+static croaring_counter_t peak_bytes[ROARING_ALLOCATION_SITE_COUNT];
+static croaring_counter_t allocation_count[ROARING_ALLOCATION_SITE_COUNT];
+static croaring_counter_t live_total_bytes;
+static croaring_counter_t peak_total_bytes;
+
+// Precedes the blocks handed out, ALLOCATION_HEADER_SIZE or the alignment
+// after the start of the block obtained.
+typedef struct allocation_header_s {
+    size_t size;      // as requested
+    uint32_t site;    // roaring_allocation_site_t
+    uint32_t offset;  // from the block obtained
+} allocation_header_t;
+
+enum { ALLOCATION_HEADER_SIZE = 16 };
+
+// The arenas account for themselves, their blocks carry no header.
+static inline bool is_tracked(const roaring_allocator_t* a) {
+    return a == NULL || a->malloc != arena_malloc;
+}
+
+static inline allocation_header_t* header_of(void* p) {
+    return (allocation_header_t*)p - 1;
+}
+
+static void* track(void* block, size_t offset, uint32_t site, size_t size) {
+    if (block == NULL) return NULL;
+    void* p = (char*)block + offset;
+    allocation_header_t* header = header_of(p);
+    header->size = size;
+    header->site = site;
+    header->offset = (uint32_t)offset;
+    croaring_counter_max(&peak_bytes[site],
+                         croaring_counter_add(&live_bytes[site], size));
+    croaring_counter_max(&peak_total_bytes,
+                         croaring_counter_add(&live_total_bytes, size));
+    croaring_counter_add(&allocation_count[site], 1);
+    return p;
+}
+
+// Returns the block obtained for `p`.
+static void* untrack(void* p) {
+    allocation_header_t* header = header_of(p);
+    croaring_counter_sub(&live_bytes[header->site], header->size);
+    croaring_counter_sub(&live_total_bytes, header->size);
+    return (char*)p - header->offset;
+}
+
+static void* malloc_with(const roaring_allocator_t* a, uint32_t site,
+                         size_t n) {
+    if (!is_tracked(a)) return dispatch_malloc(a, n);
+    if (n > SIZE_MAX - ALLOCATION_HEADER_SIZE) return NULL;
+    void* block = dispatch_malloc(a, n + ALLOCATION_HEADER_SIZE);
+    return track(block, ALLOCATION_HEADER_SIZE, site, n);
+}
+
+static void free_with(const roaring_allocator_t* a, void* p) {
+    if (p == NULL || !is_tracked(a)) {
+        dispatch_free(a, p);
+        return;
+    }
+    dispatch_free(a, untrack(p));
+}
+
+void* roaring_malloc_at(roaring_allocation_site_t site, size_t n) {
+    return malloc_with(current_allocator, (uint32_t)site, n);
+}
+
+void* roaring_realloc_at(roaring_allocation_site_t site, void* p,
+                         size_t new_sz) {
+    const roaring_allocator_t* a = current_allocator;
+    if (!is_tracked(a)) return dispatch_realloc(a, p, new_sz);
+    if (p == NULL) return malloc_with(a, (uint32_t)site, new_sz);
+    if (new_sz > SIZE_MAX - ALLOCATION_HEADER_SIZE) return NULL;
+    allocation_header_t header = *header_of(p);
+    void* block = dispatch_realloc(a, (char*)p - ALLOCATION_HEADER_SIZE,
+                                   new_sz + ALLOCATION_HEADER_SIZE);
+    if (block == NULL) return NULL;
+    croaring_counter_sub(&live_bytes[header.site], header.size);
+    croaring_counter_sub(&live_total_bytes, header.size);
+    return track(block, ALLOCATION_HEADER_SIZE, header.site, new_sz);
+}
+
+void* roaring_calloc_at(roaring_allocation_site_t site, size_t n_elements,
+                        size_t element_size) {
+    const roaring_allocator_t* a = current_allocator;
+    if (!is_tracked(a)) return dispatch_calloc(a, n_elements, element_size);
+    if (element_size != 0 &&
+        n_elements > (SIZE_MAX - ALLOCATION_HEADER_SIZE) / element_size) {
+        return NULL;
+    }
+    size_t size = n_elements * element_size;
+    void* block = dispatch_calloc(a, 1, size + ALLOCATION_HEADER_SIZE);
+    return track(block, ALLOCATION_HEADER_SIZE, (uint32_t)site, size);
+}
+
+void* roaring_aligned_malloc_at(roaring_allocation_site_t site,
+                                size_t alignment, size_t size) {
+    const roaring_allocator_t* a = current_allocator;
+    if (!is_tracked(a)) return dispatch_aligned_malloc(a, alignment, size);
+    size_t offset =
+        alignment < ALLOCATION_HEADER_SIZE ? ALLOCATION_HEADER_SIZE : alignment;
+    if (size > SIZE_MAX - offset) return NULL;
+    void* block = dispatch_aligned_malloc(a, alignment, size + offset);
+    return track(block, offset, (uint32_t)site, size);
+}
+
+void roaring_free(void* p) { free_with(current_allocator, p); }
+
+void roaring_aligned_free(void* p) {
+    const roaring_allocator_t* a = current_allocator;
+    if (p == NULL || !is_tracked(a)) {
+        dispatch_aligned_free(a, p);
+        return;
+    }
+    dispatch_aligned_free(a, untrack(p));
+}
+
+void* roaring_hooks_malloc(size_t n) {
+    return malloc_with(NULL, ROARING_ALLOCATION_OTHER, n);
+}
+
+void roaring_hooks_free(void* p) { free_with(NULL, p); }
+
+bool roaring_allocation_stats(roaring_allocation_stats_t* stats) {
+    for (int i = 0; i < ROARING_ALLOCATION_SITE_COUNT; i++) {
+        stats->bytes[i] = croaring_counter_load(&live_bytes[i]);
+        stats->peak_bytes[i] = croaring_counter_load(&peak_bytes[i]);
+        stats->allocations[i] = croaring_counter_load(&allocation_count[i]);
+    }
+    stats->total_bytes = croaring_counter_load(&live_total_bytes);
+    stats->peak_total_bytes = croaring_counter_load(&peak_total_bytes);
+    return true;
+}
+
+void roaring_allocation_stats_reset_peaks(void) {
+    for (int i = 0; i < ROARING_ALLOCATION_SITE_COUNT; i++) {
+        croaring_counter_store(&peak_bytes[i],
+                               croaring_counter_load(&live_bytes[i]));
+    }
+    croaring_counter_store(&peak_total_bytes,
+                           croaring_counter_load(&live_total_bytes));
+}
+
+#else  // ROARING_ALLOCATION_STATS
+
+void* roaring_malloc_at(roaring_allocation_site_t site, size_t n) {
+    (void)site;
+    return dispatch_malloc(current_allocator, n);
+}
+
+void* roaring_realloc_at(roaring_allocation_site_t site, void* p,
+                         size_t new_sz) {
+    (void)site;
+    return dispatch_realloc(current_allocator, p, new_sz);
+}
+
+void* roaring_calloc_at(roaring_allocation_site_t site, size_t n_elements,
+                        size_t element_size) {
+    (void)site;
+    return dispatch_calloc(current_allocator, n_elements, element_size);
+}
+
+void* roaring_aligned_malloc_at(roaring_allocation_site_t site,
+                                size_t alignment, size_t size) {
+    (void)site;
+    return dispatch_aligned_malloc(current_allocator, alignment, size);
+}
+
+void roaring_free(void* p) { dispatch_free(current_allocator, p); }
+
+void roaring_aligned_free(void* p) {
+    dispatch_aligned_free(current_allocator, p);
+}
+
+void* roaring_hooks_malloc(size_t n) { return global_memory_hook.malloc(n); }
+
+void roaring_hooks_free(void* p) { global_memory_hook.free(p); }
+
+bool roaring_allocation_stats(roaring_allocation_stats_t* stats) {
+    memset(stats, 0, sizeof(*stats));
+    return false;
+}
+
+void roaring_allocation_stats_reset_peaks(void) {}
+
+#endif  // ROARING_ALLOCATION_STATS
+
+void* roaring_malloc(size_t n) {
+    return roaring_malloc_at(ROARING_ALLOCATION_OTHER, n);
+}
+
+void* roaring_realloc(void* p, size_t new_sz) {
+    return roaring_realloc_at(ROARING_ALLOCATION_OTHER, p, new_sz);
+}
+
+void* roaring_calloc(size_t n_elements, size_t element_size) {
+    return roaring_calloc_at(ROARING_ALLOCATION_OTHER, n_elements,
+                             element_size);
+}
+
+void* roaring_aligned_malloc(size_t alignment, size_t size) {
+    return roaring_aligned_malloc_at(ROARING_ALLOCATION_OTHER, alignment, size);
+}
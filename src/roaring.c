@@ -45,6 +45,119 @@ static inline bool is_frozen(const roaring_bitmap_t *r) {
     return r->high_low_container.flags & ROARING_FLAG_FROZEN;
 }
 
+// Routes the allocations made while working on `r` to its allocator, if any,
+// until leave_allocator_of. Bitmaps without an allocator are never modified
+// from within another allocator, so they leave the thread-local one alone.
+static inline const roaring_allocator_t *enter_allocator_of(
+    const roaring_bitmap_t *r) {
+    const roaring_allocator_t *allocator = r->high_low_container.allocator;
+    return allocator == NULL ? NULL : roaring_allocator_enter(allocator);
+}
+
+static inline void leave_allocator_of(const roaring_bitmap_t *r,
+                                      const roaring_allocator_t *previous) {
+    if (r->high_low_container.allocator != NULL) {
+        roaring_allocator_leave(previous);
+    }
+}
+
+// Whether the containers of `src` may be shared with `dst` instead of being
+// copied. A shared container is freed by the last bitmap holding it, so both
+// must allocate from the same place.
+static inline bool can_share(const roaring_bitmap_t *src,
+                             const roaring_bitmap_t *dst) {
+    return is_cow(src) && src->high_low_container.allocator ==
+                              dst->high_low_container.allocator;
+}
+
+static inline roaring_arena_t *arena_of(const roaring_bitmap_t *r) {
+    return roaring_allocator_arena(r->high_low_container.allocator);
+}
+
+// Called once a new bitmap is initialized: it keeps its arena alive.
+static inline roaring_bitmap_t *bitmap_created(roaring_bitmap_t *r) {
+    roaring_arena_t *arena = arena_of(r);
+    if (arena != NULL) {
+        roaring_arena_add_bitmap(arena);
+    }
+    return r;
+}
+
+struct roaring_workspace_s {
+    bitset_container_pool_t pool;
+    // the allocator of the pooled bitsets, NULL for the memory hooks
+    const roaring_allocator_t *allocator;
+};
+
+roaring_workspace_t *roaring_workspace_create(size_t max_bitsets) {
+    if (max_bitsets == 0) {
+        max_bitsets = 64;
+    } else if (max_bitsets > INT32_MAX) {
+        max_bitsets = INT32_MAX;
+    }
+    roaring_workspace_t *workspace =
+        (roaring_workspace_t *)roaring_hooks_malloc(sizeof(*workspace));
+    if (workspace == NULL) {
+        return NULL;
+    }
+    workspace->pool.bitsets = (bitset_container_t **)roaring_hooks_malloc(
+        max_bitsets * sizeof(bitset_container_t *));
+    if (workspace->pool.bitsets == NULL) {
+        roaring_hooks_free(workspace);
+        return NULL;
+    }
+    workspace->pool.size = 0;
+    workspace->pool.capacity = (int32_t)max_bitsets;
+    workspace->allocator = NULL;
+    return workspace;
+}
+
+// Gives the pooled bitsets back to the allocator they come from.
+static void clear_workspace(roaring_workspace_t *workspace) {
+    const roaring_allocator_t *previous =
+        roaring_allocator_enter(workspace->allocator);
+    bitset_container_pool_clear(&workspace->pool);
+    roaring_allocator_leave(previous);
+}
+
+void roaring_workspace_free(roaring_workspace_t *workspace) {
+    if (workspace == NULL) {
+        return;
+    }
+    clear_workspace(workspace);
+    roaring_hooks_free(workspace->pool.bitsets);
+    roaring_hooks_free(workspace);
+}
+
+// Arena bitmaps do without the workspace: their allocations are cheap already
+// and the arena may go before the workspace.
+static inline bool workspace_serves(const roaring_workspace_t *workspace,
+                                    const roaring_bitmap_t *r) {
+    return workspace != NULL && arena_of(r) == NULL;
+}
+
+// Pools the temporary bitsets of an operation creating or modifying `r`, whose
+// allocator must be entered.
+static inline bitset_container_pool_t *enter_workspace(
+    roaring_workspace_t *workspace, const roaring_bitmap_t *r) {
+    if (!workspace_serves(workspace, r)) {
+        return NULL;
+    }
+    if (workspace->allocator != r->high_low_container.allocator) {
+        clear_workspace(workspace);
+        workspace->allocator = r->high_low_container.allocator;
+    }
+    return bitset_container_pool_enter(&workspace->pool);
+}
+
+static inline void leave_workspace(const roaring_workspace_t *workspace,
+                                   const roaring_bitmap_t *r,
+                                   bitset_container_pool_t *previous) {
+    if (workspace_serves(workspace, r)) {
+        bitset_container_pool_leave(previous);
+    }
+}
+
 // this is like roaring_bitmap_add, but it populates pointer arguments in such a
 // way
 // that we can recover the container touched, which, in turn can be used to
@@ -85,18 +198,30 @@ static inline container_t *containerptr_roaring_bitmap_add(roaring_bitmap_t *r,
 
 roaring_bitmap_t *roaring_bitmap_create_with_capacity(uint32_t cap) {
     roaring_bitmap_t *ans =
-        (roaring_bitmap_t *)roaring_malloc(sizeof(roaring_bitmap_t));
+        (roaring_bitmap_t *)roaring_hooks_malloc(sizeof(roaring_bitmap_t));
     if (!ans) {
         return NULL;
     }
     bool is_ok = ra_init_with_capacity(&ans->high_low_container, cap);
     if (!is_ok) {
-        roaring_free(ans);
+        roaring_hooks_free(ans);
         return NULL;
     }
+    return bitmap_created(ans);
+}
+
+roaring_bitmap_t *roaring_bitmap_create_with_allocator(
+    const roaring_allocator_t *allocator) {
+    const roaring_allocator_t *previous = roaring_allocator_enter(allocator);
+    roaring_bitmap_t *ans = roaring_bitmap_create_with_capacity(0);
+    roaring_allocator_leave(previous);
     return ans;
 }
 
+roaring_bitmap_t *roaring_bitmap_create_in_arena(roaring_arena_t *arena) {
+    return roaring_bitmap_create_with_allocator(roaring_arena_allocator(arena));
+}
+
 bool roaring_bitmap_init_with_capacity(roaring_bitmap_t *r, uint32_t cap) {
     return ra_init_with_capacity(&r->high_low_container, cap);
 }
@@ -141,6 +266,7 @@ void roaring_bitmap_add_many(roaring_bitmap_t *r, size_t n_args,
     if (n_args == 0) {
         return;
     }
+    const roaring_allocator_t *previous = enter_allocator_of(r);
 
     uint8_t typecode;
     int idx;
@@ -154,11 +280,14 @@ void roaring_bitmap_add_many(roaring_bitmap_t *r, size_t n_args,
         memcpy(&val, current_val, sizeof(val));
         add_bulk_impl(r, &context, val);
     }
+    leave_allocator_of(r, previous);
 }
 
 void roaring_bitmap_add_bulk(roaring_bitmap_t *r,
                              roaring_bulk_context_t *context, uint32_t val) {
+    const roaring_allocator_t *previous = enter_allocator_of(r);
     add_bulk_impl(r, context, val);
+    leave_allocator_of(r, previous);
 }
 
 bool roaring_bitmap_contains_bulk(const roaring_bitmap_t *r,
@@ -198,6 +327,196 @@ roaring_bitmap_t *roaring_bitmap_of_ptr(size_t n_args, const uint32_t *vals) {
     return answer;
 }
 
+// Below this many values, partitioning by high bits costs more (one pass over
+// 65536 counters) than it saves, and we defer to roaring_bitmap_add_many.
+#define ROARING_UNSORTED_MIN_BATCH 65536
+
+typedef struct unsorted_partitions_s {
+    // the low 16 bits of the values having key k are
+    // lows[offsets[k], offsets[k + 1])
+    const size_t *offsets;
+    uint16_t *lows;
+    roaring_array_t *ra;
+} unsorted_partitions_t;
+
+// Sorts vals with two counting-sort passes (low byte, then high byte) using
+// tmp as a buffer of the same length, then removes duplicates in place.
+// Returns the number of distinct values.
+static int32_t radix_sort_unique_uint16(uint16_t *vals, int32_t n,
+                                        uint16_t *tmp) {
+    int32_t count[256];
+    int32_t sum;
+    memset(count, 0, sizeof(count));
+    for (int32_t i = 0; i < n; i++) count[vals[i] & 0xFF]++;
+    sum = 0;
+    for (int b = 0; b < 256; b++) {
+        int32_t c = count[b];
+        count[b] = sum;
+        sum += c;
+    }
+    for (int32_t i = 0; i < n; i++) tmp[count[vals[i] & 0xFF]++] = vals[i];
+
+    memset(count, 0, sizeof(count));
+    for (int32_t i = 0; i < n; i++) count[tmp[i] >> 8]++;
+    sum = 0;
+    for (int b = 0; b < 256; b++) {
+        int32_t c = count[b];
+        count[b] = sum;
+        sum += c;
+    }
+    for (int32_t i = 0; i < n; i++) vals[count[tmp[i] >> 8]++] = tmp[i];
+
+    if (n == 0) return 0;
+    int32_t card = 1;
+    for (int32_t i = 1; i < n; i++) {
+        if (vals[i] != vals[card - 1]) vals[card++] = vals[i];
+    }
+    return card;
+}
+
+// Builds the container at index k of the partitions' roaring array. Leaves a
+// NULL container behind on allocation failure.
+static void unsorted_partition_to_container(void *arg, size_t k) {
+    unsorted_partitions_t *p = (unsorted_partitions_t *)arg;
+    uint16_t key = p->ra->keys[k];
+    uint16_t *lows = p->lows + p->offsets[key];
+    size_t n = p->offsets[key + 1] - p->offsets[key];
+    container_t *c = NULL;
+    uint8_t typecode = ARRAY_CONTAINER_TYPE;
+    if (n > DEFAULT_MAX_SIZE) {
+        bitset_container_t *bitset = bitset_container_create();
+        if (bitset != NULL) {
+            bitset->cardinality =
+                (int32_t)bitset_set_list_withcard(bitset->words, 0, lows, n);
+            if (bitset->cardinality <= DEFAULT_MAX_SIZE) {
+                // duplicates made a dense-looking partition sparse
+                c = array_container_from_bitset(bitset);
+                bitset_container_free(bitset);
+            } else {
+                c = bitset;
+                typecode = BITSET_CONTAINER_TYPE;
+            }
+        }
+    } else {
+        uint16_t tmp[DEFAULT_MAX_SIZE];
+        int32_t card = radix_sort_unique_uint16(lows, (int32_t)n, tmp);
+        array_container_t *array = array_container_create_given_capacity(card);
+        if (array != NULL) {
+            memcpy(array->array, lows, card * sizeof(uint16_t));
+            array->cardinality = card;
+            c = array;
+        }
+    }
+    p->ra->containers[k] = c;
+    p->ra->typecodes[k] = typecode;
+}
+
+static bool bitmap_add_many_unsorted(roaring_bitmap_t *r, size_t n_args,
+                                     const uint32_t *vals,
+                                     const roaring_executor_t *executor) {
+    if (n_args < ROARING_UNSORTED_MIN_BATCH) {
+        roaring_bitmap_add_many(r, n_args, vals);
+        return true;
+    }
+    size_t *offsets =
+        (size_t *)roaring_hooks_malloc((0x10000 + 1) * sizeof(size_t));
+    uint16_t *lows =
+        (uint16_t *)roaring_hooks_malloc(n_args * sizeof(uint16_t));
+    if (offsets == NULL || lows == NULL) {
+        roaring_hooks_free(offsets);
+        roaring_hooks_free(lows);
+        return false;
+    }
+    memset(offsets, 0, (0x10000 + 1) * sizeof(size_t));
+    // radix partition by the high 16 bits: histogram, prefix sum, scatter
+    for (size_t i = 0; i < n_args; i++) {
+        offsets[vals[i] >> 16]++;
+    }
+    int32_t nkeys = 0;
+    size_t sum = 0;
+    for (uint32_t key = 0; key < 0x10000; key++) {
+        size_t c = offsets[key];
+        nkeys += (c != 0);
+        offsets[key] = sum;
+        sum += c;
+    }
+    for (size_t i = 0; i < n_args; i++) {
+        lows[offsets[vals[i] >> 16]++] = (uint16_t)(vals[i] & 0xFFFF);
+    }
+    // the scatter advanced offsets[k] to the start of k + 1: shift them back
+    memmove(offsets + 1, offsets, 0x10000 * sizeof(size_t));
+    offsets[0] = 0;
+
+    roaring_array_t ra;
+    if (!ra_init_with_capacity(&ra, nkeys)) {
+        roaring_hooks_free(offsets);
+        roaring_hooks_free(lows);
+        return false;
+    }
+    for (uint32_t key = 0; key < 0x10000; key++) {
+        if (offsets[key + 1] != offsets[key]) {
+            ra.keys[ra.size] = (uint16_t)key;
+            ra.containers[ra.size] = NULL;
+            ra.typecodes[ra.size] = ARRAY_CONTAINER_TYPE;
+            ra.size++;
+        }
+    }
+    unsorted_partitions_t partitions = {offsets, lows, &ra};
+    roaring_execute_tasks(executor, (size_t)ra.size,
+                          unsorted_partition_to_container, &partitions);
+    roaring_hooks_free(offsets);
+    roaring_hooks_free(lows);
+
+    bool failed = false;
+    for (int32_t k = 0; k < ra.size; k++) {
+        if (ra.containers[k] == NULL) {
+            failed = true;
+        }
+    }
+    if (failed) {
+        for (int32_t k = 0; k < ra.size; k++) {
+            if (ra.containers[k] != NULL) {
+                container_free(ra.containers[k], ra.typecodes[k]);
+            }
+        }
+        ra_clear_without_containers(&ra);
+        return false;
+    }
+    if (r->high_low_container.size == 0) {
+        ra.flags = r->high_low_container.flags;
+        ra_clear(&r->high_low_container);
+        r->high_low_container = ra;
+    } else {
+        roaring_bitmap_t partitioned;
+        partitioned.high_low_container = ra;
+        roaring_bitmap_or_inplace(r, &partitioned);
+        ra_clear(&ra);
+    }
+    return true;
+}
+
+bool roaring_bitmap_add_many_unsorted(roaring_bitmap_t *r, size_t n_args,
+                                      const uint32_t *vals,
+                                      const roaring_executor_t *executor) {
+    const roaring_allocator_t *previous = enter_allocator_of(r);
+    bool answer = bitmap_add_many_unsorted(r, n_args, vals, executor);
+    leave_allocator_of(r, previous);
+    return answer;
+}
+
+roaring_bitmap_t *roaring_bitmap_of_unsorted(
+    size_t n_args, const uint32_t *vals, const roaring_executor_t *executor) {
+    roaring_bitmap_t *answer = roaring_bitmap_create();
+    if (answer == NULL) {
+        return NULL;
+    }
+    if (!roaring_bitmap_add_many_unsorted(answer, n_args, vals, executor)) {
+        roaring_bitmap_free(answer);
+        return NULL;
+    }
+    return answer;
+}
+
 roaring_bitmap_t *roaring_bitmap_of(size_t n_args, ...) {
     // todo: could be greatly optimized but we do not expect this call to ever
     // include long lists
@@ -253,6 +572,7 @@ void roaring_bitmap_add_range_closed(roaring_bitmap_t *r, uint32_t min,
     if (min > max) {
         return;
     }
+    const roaring_allocator_t *previous = enter_allocator_of(r);
 
     roaring_array_t *ra = &r->high_low_container;
 
@@ -297,6 +617,7 @@ void roaring_bitmap_add_range_closed(roaring_bitmap_t *r, uint32_t min,
                                               new_container, new_type);
         dst--;
     }
+    leave_allocator_of(r, previous);
 }
 
 void roaring_bitmap_remove_range_closed(roaring_bitmap_t *r, uint32_t min,
@@ -304,6 +625,7 @@ void roaring_bitmap_remove_range_closed(roaring_bitmap_t *r, uint32_t min,
     if (min > max) {
         return;
     }
+    const roaring_allocator_t *previous = enter_allocator_of(r);
 
     roaring_array_t *ra = &r->high_low_container;
 
@@ -336,6 +658,7 @@ void roaring_bitmap_remove_range_closed(roaring_bitmap_t *r, uint32_t min,
     if (src > dst) {
         ra_shift_tail(ra, ra->size - src, dst - src);
     }
+    leave_allocator_of(r, previous);
 }
 
 void roaring_bitmap_printf(const roaring_bitmap_t *r) {
@@ -418,6 +741,12 @@ void roaring_bitmap_statistics(const roaring_bitmap_t *r,
     }
 }
 
+bool roaring_kernel_counters(roaring_kernel_counters_t *counters) {
+    return container_kernel_counters(counters);
+}
+
+void roaring_kernel_counters_reset(void) { container_kernel_counters_reset(); }
+
 bool roaring_contains_shared(const roaring_bitmap_t *r) {
     const roaring_array_t *ra = &r->high_low_container;
     for (int i = 0; i < ra->size; ++i) {
@@ -429,6 +758,7 @@ bool roaring_contains_shared(const roaring_bitmap_t *r) {
 }
 
 bool roaring_unshare_all(roaring_bitmap_t *r) {
+    const roaring_allocator_t *previous = enter_allocator_of(r);
     const roaring_array_t *ra = &r->high_low_container;
     bool unshared = false;
     for (int i = 0; i < ra->size; ++i) {
@@ -439,6 +769,7 @@ bool roaring_unshare_all(roaring_bitmap_t *r) {
             unshared = true;
         }
     }
+    leave_allocator_of(r, previous);
     return unshared;
 }
 
@@ -522,19 +853,22 @@ bool roaring_bitmap_internal_validate(const roaring_bitmap_t *r,
     return true;
 }
 
-roaring_bitmap_t *roaring_bitmap_copy(const roaring_bitmap_t *r) {
+// Copies r with the allocator of the calling thread.
+static roaring_bitmap_t *bitmap_copy(const roaring_bitmap_t *r) {
     roaring_bitmap_t *ans =
-        (roaring_bitmap_t *)roaring_malloc(sizeof(roaring_bitmap_t));
+        (roaring_bitmap_t *)roaring_hooks_malloc(sizeof(roaring_bitmap_t));
     if (!ans) {
         return NULL;
     }
     if (!ra_init_with_capacity(  // allocation of list of containers can fail
             &ans->high_low_container, r->high_low_container.size)) {
-        roaring_free(ans);
+        roaring_hooks_free(ans);
         return NULL;
     }
+    bitmap_created(ans);
     if (!ra_overwrite(  // memory allocation of individual containers may fail
-            &r->high_low_container, &ans->high_low_container, is_cow(r))) {
+            &r->high_low_container, &ans->high_low_container,
+            can_share(r, ans))) {
         roaring_bitmap_free(ans);  // overwrite should leave in freeable state
         return NULL;
     }
@@ -542,28 +876,48 @@ roaring_bitmap_t *roaring_bitmap_copy(const roaring_bitmap_t *r) {
     return ans;
 }
 
+roaring_bitmap_t *roaring_bitmap_copy(const roaring_bitmap_t *r) {
+    const roaring_allocator_t *previous = enter_allocator_of(r);
+    roaring_bitmap_t *ans = bitmap_copy(r);
+    leave_allocator_of(r, previous);
+    return ans;
+}
+
 bool roaring_bitmap_overwrite(roaring_bitmap_t *dest,
                               const roaring_bitmap_t *src) {
+    const roaring_allocator_t *previous = enter_allocator_of(dest);
     roaring_bitmap_set_copy_on_write(dest, is_cow(src));
-    return ra_overwrite(&src->high_low_container, &dest->high_low_container,
-                        is_cow(src));
+    bool is_ok = ra_overwrite(&src->high_low_container,
+                              &dest->high_low_container, can_share(src, dest));
+    leave_allocator_of(dest, previous);
+    return is_ok;
 }
 
 void roaring_bitmap_free(const roaring_bitmap_t *r) {
     if (r == NULL) {
         return;
     }
-    if (!is_frozen(r)) {
+    roaring_arena_t *arena = arena_of(r);
+    if (arena == NULL && !is_frozen(r)) {
+        const roaring_allocator_t *previous = enter_allocator_of(r);
         ra_clear((roaring_array_t *)&r->high_low_container);
+        leave_allocator_of(r, previous);
+    }
+    // the containers of a bitmap in an arena go with the arena
+    roaring_hooks_free((void *)r);
+    if (arena != NULL) {
+        roaring_arena_remove_bitmap(arena);
     }
-    roaring_free((roaring_bitmap_t *)r);
 }
 
 void roaring_bitmap_clear(roaring_bitmap_t *r) {
+    const roaring_allocator_t *previous = enter_allocator_of(r);
     ra_reset(&r->high_low_container);
+    leave_allocator_of(r, previous);
 }
 
 void roaring_bitmap_add(roaring_bitmap_t *r, uint32_t val) {
+    const roaring_allocator_t *previous = enter_allocator_of(r);
     roaring_array_t *ra = &r->high_low_container;
 
     const uint16_t hb = val >> 16;
@@ -589,9 +943,11 @@ void roaring_bitmap_add(roaring_bitmap_t *r, uint32_t val) {
         ra_insert_new_key_value_at(&r->high_low_container, -i - 1, hb,
                                    container, typecode);
     }
+    leave_allocator_of(r, previous);
 }
 
 bool roaring_bitmap_add_checked(roaring_bitmap_t *r, uint32_t val) {
+    const roaring_allocator_t *previous = enter_allocator_of(r);
     const uint16_t hb = val >> 16;
     const int i = ra_get_index(&r->high_low_container, hb);
     uint8_t typecode;
@@ -628,10 +984,12 @@ bool roaring_bitmap_add_checked(roaring_bitmap_t *r, uint32_t val) {
         result = true;
     }
 
+    leave_allocator_of(r, previous);
     return result;
 }
 
 void roaring_bitmap_remove(roaring_bitmap_t *r, uint32_t val) {
+    const roaring_allocator_t *previous = enter_allocator_of(r);
     const uint16_t hb = val >> 16;
     const int i = ra_get_index(&r->high_low_container, hb);
     uint8_t typecode;
@@ -654,9 +1012,11 @@ void roaring_bitmap_remove(roaring_bitmap_t *r, uint32_t val) {
             ra_remove_at_index_and_free(&r->high_low_container, i);
         }
     }
+    leave_allocator_of(r, previous);
 }
 
 bool roaring_bitmap_remove_checked(roaring_bitmap_t *r, uint32_t val) {
+    const roaring_allocator_t *previous = enter_allocator_of(r);
     const uint16_t hb = val >> 16;
     const int i = ra_get_index(&r->high_low_container, hb);
     uint8_t typecode;
@@ -690,6 +1050,7 @@ bool roaring_bitmap_remove_checked(roaring_bitmap_t *r, uint32_t val) {
 
         result = oldCardinality != newCardinality;
     }
+    leave_allocator_of(r, previous);
     return result;
 }
 
@@ -698,6 +1059,7 @@ void roaring_bitmap_remove_many(roaring_bitmap_t *r, size_t n_args,
     if (n_args == 0 || r->high_low_container.size == 0) {
         return;
     }
+    const roaring_allocator_t *previous = enter_allocator_of(r);
     int32_t pos =
         -1;  // position of the container used in the previous iteration
     for (size_t i = 0; i < n_args; i++) {
@@ -725,11 +1087,12 @@ void roaring_bitmap_remove_many(roaring_bitmap_t *r, size_t n_args,
             }
         }
     }
+    leave_allocator_of(r, previous);
 }
 
 // there should be some SIMD optimizations possible here
-roaring_bitmap_t *roaring_bitmap_and(const roaring_bitmap_t *x1,
-                                     const roaring_bitmap_t *x2) {
+static roaring_bitmap_t *bitmap_and(const roaring_bitmap_t *x1,
+                                    const roaring_bitmap_t *x2) {
     uint8_t result_type = 0;
     const int length1 = x1->high_low_container.size,
               length2 = x2->high_low_container.size;
@@ -769,49 +1132,80 @@ roaring_bitmap_t *roaring_bitmap_and(const roaring_bitmap_t *x1,
     return answer;
 }
 
+roaring_bitmap_t *roaring_bitmap_and_ex(const roaring_bitmap_t *x1,
+                                        const roaring_bitmap_t *x2,
+                                        roaring_workspace_t *workspace) {
+    const roaring_allocator_t *previous = enter_allocator_of(x1);
+    bitset_container_pool_t *pool = enter_workspace(workspace, x1);
+    roaring_bitmap_t *answer = bitmap_and(x1, x2);
+    leave_workspace(workspace, x1, pool);
+    leave_allocator_of(x1, previous);
+    return answer;
+}
+
+roaring_bitmap_t *roaring_bitmap_and(const roaring_bitmap_t *x1,
+                                     const roaring_bitmap_t *x2) {
+    return roaring_bitmap_and_ex(x1, x2, NULL);
+}
+
 /**
  * Compute the union of 'number' bitmaps.
  */
-roaring_bitmap_t *roaring_bitmap_or_many(size_t number,
-                                         const roaring_bitmap_t **x) {
+roaring_bitmap_t *roaring_bitmap_or_many_ex(size_t number,
+                                            const roaring_bitmap_t **x,
+                                            roaring_workspace_t *workspace) {
     if (number == 0) {
         return roaring_bitmap_create();
     }
     if (number == 1) {
         return roaring_bitmap_copy(x[0]);
     }
-    roaring_bitmap_t *answer =
-        roaring_bitmap_lazy_or(x[0], x[1], LAZY_OR_BITSET_CONVERSION);
+    roaring_bitmap_t *answer = roaring_bitmap_lazy_or_ex(
+        x[0], x[1], LAZY_OR_BITSET_CONVERSION, workspace);
     for (size_t i = 2; i < number; i++) {
-        roaring_bitmap_lazy_or_inplace(answer, x[i], LAZY_OR_BITSET_CONVERSION);
+        roaring_bitmap_lazy_or_inplace_ex(answer, x[i],
+                                          LAZY_OR_BITSET_CONVERSION, workspace);
     }
-    roaring_bitmap_repair_after_lazy(answer);
+    roaring_bitmap_repair_after_lazy_ex(answer, workspace);
     return answer;
 }
 
+roaring_bitmap_t *roaring_bitmap_or_many(size_t number,
+                                         const roaring_bitmap_t **x) {
+    return roaring_bitmap_or_many_ex(number, x, NULL);
+}
+
 /**
  * Compute the xor of 'number' bitmaps.
  */
-roaring_bitmap_t *roaring_bitmap_xor_many(size_t number,
-                                          const roaring_bitmap_t **x) {
+roaring_bitmap_t *roaring_bitmap_xor_many_ex(size_t number,
+                                             const roaring_bitmap_t **x,
+                                             roaring_workspace_t *workspace) {
     if (number == 0) {
         return roaring_bitmap_create();
     }
     if (number == 1) {
         return roaring_bitmap_copy(x[0]);
     }
-    roaring_bitmap_t *answer = roaring_bitmap_lazy_xor(x[0], x[1]);
+    roaring_bitmap_t *answer =
+        roaring_bitmap_lazy_xor_ex(x[0], x[1], workspace);
     for (size_t i = 2; i < number; i++) {
-        roaring_bitmap_lazy_xor_inplace(answer, x[i]);
+        roaring_bitmap_lazy_xor_inplace_ex(answer, x[i], workspace);
     }
-    roaring_bitmap_repair_after_lazy(answer);
+    roaring_bitmap_repair_after_lazy_ex(answer, workspace);
     return answer;
 }
 
+roaring_bitmap_t *roaring_bitmap_xor_many(size_t number,
+                                          const roaring_bitmap_t **x) {
+    return roaring_bitmap_xor_many_ex(number, x, NULL);
+}
+
 // inplace and (modifies its first argument).
 void roaring_bitmap_and_inplace(roaring_bitmap_t *x1,
                                 const roaring_bitmap_t *x2) {
     if (x1 == x2) return;
+    const roaring_allocator_t *previous = enter_allocator_of(x1);
     int pos1 = 0, pos2 = 0, intersection_size = 0;
     const int length1 = ra_get_size(&x1->high_low_container);
     const int length2 = ra_get_size(&x2->high_low_container);
@@ -872,18 +1266,19 @@ void roaring_bitmap_and_inplace(roaring_bitmap_t *x1,
 
     // all containers after this have either been copied or freed
     ra_downsize(&x1->high_low_container, intersection_size);
+    leave_allocator_of(x1, previous);
 }
 
-roaring_bitmap_t *roaring_bitmap_or(const roaring_bitmap_t *x1,
-                                    const roaring_bitmap_t *x2) {
+static roaring_bitmap_t *bitmap_or(const roaring_bitmap_t *x1,
+                                   const roaring_bitmap_t *x2) {
     uint8_t result_type = 0;
     const int length1 = x1->high_low_container.size,
               length2 = x2->high_low_container.size;
     if (0 == length1) {
-        return roaring_bitmap_copy(x2);
+        return bitmap_copy(x2);
     }
     if (0 == length2) {
-        return roaring_bitmap_copy(x1);
+        return bitmap_copy(x1);
     }
     roaring_bitmap_t *answer =
         roaring_bitmap_create_with_capacity(length1 + length2);
@@ -915,8 +1310,8 @@ roaring_bitmap_t *roaring_bitmap_or(const roaring_bitmap_t *x1,
             container_t *c1 = ra_get_container_at_index(&x1->high_low_container,
                                                         (uint16_t)pos1, &type1);
             // c1 = container_clone(c1, type1);
-            c1 = get_copy_of_container(c1, &type1, is_cow(x1));
-            if (is_cow(x1)) {
+            c1 = get_copy_of_container(c1, &type1, can_share(x1, answer));
+            if (can_share(x1, answer)) {
                 ra_set_container_at_index(&x1->high_low_container, pos1, c1,
                                           type1);
             }
@@ -929,8 +1324,8 @@ roaring_bitmap_t *roaring_bitmap_or(const roaring_bitmap_t *x1,
             container_t *c2 = ra_get_container_at_index(&x2->high_low_container,
                                                         (uint16_t)pos2, &type2);
             // c2 = container_clone(c2, type2);
-            c2 = get_copy_of_container(c2, &type2, is_cow(x2));
-            if (is_cow(x2)) {
+            c2 = get_copy_of_container(c2, &type2, can_share(x2, answer));
+            if (can_share(x2, answer)) {
                 ra_set_container_at_index(&x2->high_low_container, pos2, c2,
                                           type2);
             }
@@ -943,21 +1338,37 @@ roaring_bitmap_t *roaring_bitmap_or(const roaring_bitmap_t *x1,
     if (pos1 == length1) {
         ra_append_copy_range(&answer->high_low_container,
                              &x2->high_low_container, pos2, length2,
-                             is_cow(x2));
+                             can_share(x2, answer));
     } else if (pos2 == length2) {
         ra_append_copy_range(&answer->high_low_container,
                              &x1->high_low_container, pos1, length1,
-                             is_cow(x1));
+                             can_share(x1, answer));
     }
     return answer;
 }
 
+roaring_bitmap_t *roaring_bitmap_or_ex(const roaring_bitmap_t *x1,
+                                       const roaring_bitmap_t *x2,
+                                       roaring_workspace_t *workspace) {
+    const roaring_allocator_t *previous = enter_allocator_of(x1);
+    bitset_container_pool_t *pool = enter_workspace(workspace, x1);
+    roaring_bitmap_t *answer = bitmap_or(x1, x2);
+    leave_workspace(workspace, x1, pool);
+    leave_allocator_of(x1, previous);
+    return answer;
+}
+
+roaring_bitmap_t *roaring_bitmap_or(const roaring_bitmap_t *x1,
+                                    const roaring_bitmap_t *x2) {
+    return roaring_bitmap_or_ex(x1, x2, NULL);
+}
+
 static void roaring_inplace_merge_bulk(roaring_bitmap_t *x1,
                                        const roaring_bitmap_t *x2, int dst,
                                        int left, int right, bool is_xor) {
     roaring_array_t *ra1 = &x1->high_low_container;
     const roaring_array_t *ra2 = &x2->high_low_container;
-    const bool cow2 = is_cow(x2);
+    const bool cow2 = can_share(x2, x1);
     const int length1 = ra1->size;
     const int length2 = ra2->size;
 
@@ -1060,8 +1471,8 @@ static void roaring_inplace_merge_bulk(roaring_bitmap_t *x1,
 }
 
 // inplace or (modifies its first argument).
-void roaring_bitmap_or_inplace(roaring_bitmap_t *x1,
-                               const roaring_bitmap_t *x2) {
+static void bitmap_or_inplace(roaring_bitmap_t *x1,
+                              const roaring_bitmap_t *x2) {
     uint8_t result_type = 0;
     int length1 = x1->high_low_container.size;
     const int length2 = x2->high_low_container.size;
@@ -1114,20 +1525,27 @@ void roaring_bitmap_or_inplace(roaring_bitmap_t *x1,
     }
     if (pos1 == length1) {
         ra_append_copy_range(&x1->high_low_container, &x2->high_low_container,
-                             pos2, length2, is_cow(x2));
+                             pos2, length2, can_share(x2, x1));
     }
 }
 
-roaring_bitmap_t *roaring_bitmap_xor(const roaring_bitmap_t *x1,
-                                     const roaring_bitmap_t *x2) {
+void roaring_bitmap_or_inplace(roaring_bitmap_t *x1,
+                               const roaring_bitmap_t *x2) {
+    const roaring_allocator_t *previous = enter_allocator_of(x1);
+    bitmap_or_inplace(x1, x2);
+    leave_allocator_of(x1, previous);
+}
+
+static roaring_bitmap_t *bitmap_xor(const roaring_bitmap_t *x1,
+                                    const roaring_bitmap_t *x2) {
     uint8_t result_type = 0;
     const int length1 = x1->high_low_container.size,
               length2 = x2->high_low_container.size;
     if (0 == length1) {
-        return roaring_bitmap_copy(x2);
+        return bitmap_copy(x2);
     }
     if (0 == length2) {
-        return roaring_bitmap_copy(x1);
+        return bitmap_copy(x1);
     }
     roaring_bitmap_t *answer =
         roaring_bitmap_create_with_capacity(length1 + length2);
@@ -1159,8 +1577,8 @@ roaring_bitmap_t *roaring_bitmap_xor(const roaring_bitmap_t *x1,
         } else if (s1 < s2) {  // s1 < s2
             container_t *c1 = ra_get_container_at_index(&x1->high_low_container,
                                                         (uint16_t)pos1, &type1);
-            c1 = get_copy_of_container(c1, &type1, is_cow(x1));
-            if (is_cow(x1)) {
+            c1 = get_copy_of_container(c1, &type1, can_share(x1, answer));
+            if (can_share(x1, answer)) {
                 ra_set_container_at_index(&x1->high_low_container, pos1, c1,
                                           type1);
             }
@@ -1172,8 +1590,8 @@ roaring_bitmap_t *roaring_bitmap_xor(const roaring_bitmap_t *x1,
         } else {  // s1 > s2
             container_t *c2 = ra_get_container_at_index(&x2->high_low_container,
                                                         (uint16_t)pos2, &type2);
-            c2 = get_copy_of_container(c2, &type2, is_cow(x2));
-            if (is_cow(x2)) {
+            c2 = get_copy_of_container(c2, &type2, can_share(x2, answer));
+            if (can_share(x2, answer)) {
                 ra_set_container_at_index(&x2->high_low_container, pos2, c2,
                                           type2);
             }
@@ -1186,19 +1604,35 @@ roaring_bitmap_t *roaring_bitmap_xor(const roaring_bitmap_t *x1,
     if (pos1 == length1) {
         ra_append_copy_range(&answer->high_low_container,
                              &x2->high_low_container, pos2, length2,
-                             is_cow(x2));
+                             can_share(x2, answer));
     } else if (pos2 == length2) {
         ra_append_copy_range(&answer->high_low_container,
                              &x1->high_low_container, pos1, length1,
-                             is_cow(x1));
+                             can_share(x1, answer));
     }
     return answer;
 }
 
+roaring_bitmap_t *roaring_bitmap_xor_ex(const roaring_bitmap_t *x1,
+                                        const roaring_bitmap_t *x2,
+                                        roaring_workspace_t *workspace) {
+    const roaring_allocator_t *previous = enter_allocator_of(x1);
+    bitset_container_pool_t *pool = enter_workspace(workspace, x1);
+    roaring_bitmap_t *answer = bitmap_xor(x1, x2);
+    leave_workspace(workspace, x1, pool);
+    leave_allocator_of(x1, previous);
+    return answer;
+}
+
+roaring_bitmap_t *roaring_bitmap_xor(const roaring_bitmap_t *x1,
+                                     const roaring_bitmap_t *x2) {
+    return roaring_bitmap_xor_ex(x1, x2, NULL);
+}
+
 // inplace xor (modifies its first argument).
 
-void roaring_bitmap_xor_inplace(roaring_bitmap_t *x1,
-                                const roaring_bitmap_t *x2) {
+static void bitmap_xor_inplace(roaring_bitmap_t *x1,
+                               const roaring_bitmap_t *x2) {
     assert(x1 != x2);
     uint8_t result_type = 0;
     int length1 = x1->high_low_container.size;
@@ -1268,12 +1702,19 @@ void roaring_bitmap_xor_inplace(roaring_bitmap_t *x1,
     }
     if (pos1 == length1) {
         ra_append_copy_range(&x1->high_low_container, &x2->high_low_container,
-                             pos2, length2, is_cow(x2));
+                             pos2, length2, can_share(x2, x1));
     }
 }
 
-roaring_bitmap_t *roaring_bitmap_andnot(const roaring_bitmap_t *x1,
-                                        const roaring_bitmap_t *x2) {
+void roaring_bitmap_xor_inplace(roaring_bitmap_t *x1,
+                                const roaring_bitmap_t *x2) {
+    const roaring_allocator_t *previous = enter_allocator_of(x1);
+    bitmap_xor_inplace(x1, x2);
+    leave_allocator_of(x1, previous);
+}
+
+static roaring_bitmap_t *bitmap_andnot(const roaring_bitmap_t *x1,
+                                       const roaring_bitmap_t *x2) {
     uint8_t result_type = 0;
     const int length1 = x1->high_low_container.size,
               length2 = x2->high_low_container.size;
@@ -1284,7 +1725,7 @@ roaring_bitmap_t *roaring_bitmap_andnot(const roaring_bitmap_t *x1,
         return empty_bitmap;
     }
     if (0 == length2) {
-        return roaring_bitmap_copy(x1);
+        return bitmap_copy(x1);
     }
     roaring_bitmap_t *answer = roaring_bitmap_create_with_capacity(length1);
     roaring_bitmap_set_copy_on_write(answer, is_cow(x1) || is_cow(x2));
@@ -1319,7 +1760,7 @@ roaring_bitmap_t *roaring_bitmap_andnot(const roaring_bitmap_t *x1,
                 ra_advance_until(&x1->high_low_container, s2, pos1);
             ra_append_copy_range(&answer->high_low_container,
                                  &x1->high_low_container, pos1, next_pos1,
-                                 is_cow(x1));
+                                 can_share(x1, answer));
             // TODO : perhaps some of the copy_on_write should be based on
             // answer rather than x1 (more stringent?).  Many similar cases
             pos1 = next_pos1;
@@ -1332,15 +1773,31 @@ roaring_bitmap_t *roaring_bitmap_andnot(const roaring_bitmap_t *x1,
     if (pos2 == length2) {
         ra_append_copy_range(&answer->high_low_container,
                              &x1->high_low_container, pos1, length1,
-                             is_cow(x1));
+                             can_share(x1, answer));
     }
     return answer;
 }
 
+roaring_bitmap_t *roaring_bitmap_andnot_ex(const roaring_bitmap_t *x1,
+                                           const roaring_bitmap_t *x2,
+                                           roaring_workspace_t *workspace) {
+    const roaring_allocator_t *previous = enter_allocator_of(x1);
+    bitset_container_pool_t *pool = enter_workspace(workspace, x1);
+    roaring_bitmap_t *answer = bitmap_andnot(x1, x2);
+    leave_workspace(workspace, x1, pool);
+    leave_allocator_of(x1, previous);
+    return answer;
+}
+
+roaring_bitmap_t *roaring_bitmap_andnot(const roaring_bitmap_t *x1,
+                                        const roaring_bitmap_t *x2) {
+    return roaring_bitmap_andnot_ex(x1, x2, NULL);
+}
+
 // inplace andnot (modifies its first argument).
 
-void roaring_bitmap_andnot_inplace(roaring_bitmap_t *x1,
-                                   const roaring_bitmap_t *x2) {
+static void bitmap_andnot_inplace(roaring_bitmap_t *x1,
+                                  const roaring_bitmap_t *x2) {
     assert(x1 != x2);
 
     uint8_t result_type = 0;
@@ -1433,6 +1890,13 @@ void roaring_bitmap_andnot_inplace(roaring_bitmap_t *x1,
     ra_downsize(&x1->high_low_container, intersection_size);
 }
 
+void roaring_bitmap_andnot_inplace(roaring_bitmap_t *x1,
+                                   const roaring_bitmap_t *x2) {
+    const roaring_allocator_t *previous = enter_allocator_of(x1);
+    bitmap_andnot_inplace(x1, x2);
+    leave_allocator_of(x1, previous);
+}
+
 uint64_t roaring_bitmap_get_cardinality(const roaring_bitmap_t *r) {
     const roaring_array_t *ra = &r->high_low_container;
 
@@ -1522,30 +1986,189 @@ bool roaring_bitmap_range_uint32_array(const roaring_bitmap_t *r, size_t offset,
     return true;
 }
 
+struct roaring_bitmap_appender_s {
+    roaring_bitmap_t *r;
+    uint16_t key;  // high 16 bits of the values held by the builder
+    container_builder_t builder;
+};
+
+roaring_bitmap_appender_t *roaring_bitmap_appender_create(
+    roaring_bitmap_t *r) {
+    roaring_bitmap_appender_t *a = (roaring_bitmap_appender_t *)roaring_malloc(
+        sizeof(roaring_bitmap_appender_t));
+    if (a == NULL) {
+        return NULL;
+    }
+    a->r = r;
+    a->key = 0;
+    container_builder_init(&a->builder);
+    return a;
+}
+
+// Adds the container c, which the bitmap takes over, under the given key,
+// merging it into the container already there if any.
+static void ra_or_container(roaring_array_t *ra, uint16_t key, container_t *c,
+                            uint8_t typecode) {
+    if (ra->size == 0 || ra->keys[ra->size - 1] < key) {
+        // the common case: appending past the end of the bitmap
+        ra_append(ra, key, c, typecode);
+        return;
+    }
+    int32_t i = ra_get_index(ra, key);
+    if (i < 0) {
+        ra_insert_new_key_value_at(ra, -i - 1, key, c, typecode);
+        return;
+    }
+    uint8_t type1, result_type;
+    container_t *c1 = ra_get_container_at_index(ra, (uint16_t)i, &type1);
+    container_t *c2 = (type1 == SHARED_CONTAINER_TYPE)
+                          ? container_or(c1, type1, c, typecode, &result_type)
+                          : container_ior(c1, type1, c, typecode, &result_type);
+    if (c2 != c1) {
+        container_free(c1, type1);
+    }
+    container_free(c, typecode);
+    ra_set_container_at_index(ra, i, c2, result_type);
+}
+
+bool roaring_bitmap_appender_flush(roaring_bitmap_appender_t *a) {
+    if (a->builder.cardinality == 0) {
+        return true;
+    }
+    const roaring_allocator_t *previous = enter_allocator_of(a->r);
+    uint8_t typecode;
+    container_t *c = container_builder_finish(&a->builder, &typecode);
+    if (c != NULL) {
+        ra_or_container(&a->r->high_low_container, a->key, c, typecode);
+    }
+    leave_allocator_of(a->r, previous);
+    return c != NULL;
+}
+
+bool roaring_bitmap_appender_add(roaring_bitmap_appender_t *a, uint32_t val) {
+    uint16_t key = (uint16_t)(val >> 16);
+    container_builder_t *b = &a->builder;
+    bool flushed = true;
+    if (b->cardinality == 0 || key > a->key) {
+        flushed = roaring_bitmap_appender_flush(a);
+        a->key = key;
+    } else if (key < a->key || (uint16_t)val <= b->last) {
+        // out of order: give up on the open container for this value
+        flushed = roaring_bitmap_appender_flush(a);
+        roaring_bitmap_add(a->r, val);
+        return flushed;
+    }
+    return container_builder_append(b, (uint16_t)val) && flushed;
+}
+
+void roaring_bitmap_appender_free(roaring_bitmap_appender_t *a) {
+    if (a == NULL) {
+        return;
+    }
+    roaring_bitmap_appender_flush(a);
+    container_builder_clear(&a->builder);
+    roaring_free(a);
+}
+
+// Converts the container at index i to its most compact form. Returns true
+// if it became a run container.
+static bool run_optimize_at_index(roaring_array_t *ra, int32_t i) {
+    uint8_t type_original, type_after;
+    ra_unshare_container_at_index(
+        ra, (uint16_t)i);  // TODO: this introduces extra cloning!
+    container_t *c =
+        ra_get_container_at_index(ra, (uint16_t)i, &type_original);
+    container_t *c1 = convert_run_optimize(c, type_original, &type_after);
+    ra_set_container_at_index(ra, i, c1, type_after);
+    return type_after == RUN_CONTAINER_TYPE;
+}
+
+// Converts the container at index i away from run encoding. Returns true if
+// it was a run container.
+static bool remove_run_compression_at_index(roaring_array_t *ra, int32_t i) {
+    uint8_t type_original, type_after;
+    container_t *c =
+        ra_get_container_at_index(ra, (uint16_t)i, &type_original);
+    if (get_container_type(c, type_original) != RUN_CONTAINER_TYPE) {
+        return false;
+    }
+    if (type_original == SHARED_CONTAINER_TYPE) {
+        run_container_t *truec = CAST_run(CAST_shared(c)->container);
+        int32_t card = run_container_cardinality(truec);
+        container_t *c1 =
+            convert_to_bitset_or_array_container(truec, card, &type_after);
+        shared_container_free(CAST_shared(c));  // frees run as needed
+        ra_set_container_at_index(ra, i, c1, type_after);
+    } else {
+        int32_t card = run_container_cardinality(CAST_run(c));
+        container_t *c1 = convert_to_bitset_or_array_container(
+            CAST_run(c), card, &type_after);
+        run_container_free(CAST_run(c));
+        ra_set_container_at_index(ra, i, c1, type_after);
+    }
+    return true;
+}
+
 /** convert array and bitmap containers to run containers when it is more
  * efficient;
  * also convert from run containers when more space efficient.  Returns
  * true if the result has at least one run container.
  */
 bool roaring_bitmap_run_optimize(roaring_bitmap_t *r) {
+    const roaring_allocator_t *previous = enter_allocator_of(r);
     bool answer = false;
     for (int i = 0; i < r->high_low_container.size; i++) {
-        uint8_t type_original, type_after;
-        ra_unshare_container_at_index(
-            &r->high_low_container,
-            (uint16_t)i);  // TODO: this introduces extra cloning!
-        container_t *c = ra_get_container_at_index(&r->high_low_container,
-                                                   (uint16_t)i, &type_original);
-        container_t *c1 = convert_run_optimize(c, type_original, &type_after);
-        if (type_after == RUN_CONTAINER_TYPE) {
-            answer = true;
+        answer |= run_optimize_at_index(&r->high_low_container, i);
+    }
+    leave_allocator_of(r, previous);
+    return answer;
+}
+
+// Copies the containers of the roaring array passed as context to fresh
+// memory of the current arena, shrunk to fit, and replaces them.
+static bool move_containers_to_fresh_slabs(void *context) {
+    roaring_array_t *ra = (roaring_array_t *)context;
+    roaring_array_t fresh;
+    if (!ra_init_with_capacity(&fresh, (uint32_t)ra->size)) {
+        return false;
+    }
+    for (int32_t i = 0; i < ra->size; i++) {
+        uint8_t typecode = ra->typecodes[i];
+        const container_t *c =
+            container_unwrap_shared(ra->containers[i], &typecode);
+        container_t *copy = container_clone(c, typecode);
+        if (copy == NULL) {
+            ra_clear(&fresh);
+            return false;
         }
-        ra_set_container_at_index(&r->high_low_container, i, c1, type_after);
+        // the copy was allocated last, so this shrinks it in place
+        container_shrink_to_fit(copy, typecode);
+        ra_append(&fresh, ra->keys[i], copy, typecode);
+    }
+    fresh.flags = ra->flags;
+    *ra = fresh;  // the former containers go with the former slabs
+    return true;
+}
+
+// A bitmap in an arena is shrunk by copying it to fresh slabs, which is only
+// possible when no other bitmap lives in the arena.
+static size_t compact_arena_of(roaring_bitmap_t *r) {
+    roaring_arena_t *arena = arena_of(r);
+    if (roaring_arena_bitmap_count(arena) != 1) {
+        return 0;
     }
+    const roaring_allocator_t *previous = enter_allocator_of(r);
+    size_t answer = roaring_arena_compact(
+        arena, move_containers_to_fresh_slabs, &r->high_low_container);
+    leave_allocator_of(r, previous);
     return answer;
 }
 
 size_t roaring_bitmap_shrink_to_fit(roaring_bitmap_t *r) {
+    if (arena_of(r) != NULL) {
+        return compact_arena_of(r);
+    }
+    const roaring_allocator_t *previous = enter_allocator_of(r);
     size_t answer = 0;
     for (int i = 0; i < r->high_low_container.size; i++) {
         uint8_t type_original;
@@ -1554,6 +2177,7 @@ size_t roaring_bitmap_shrink_to_fit(roaring_bitmap_t *r) {
         answer += container_shrink_to_fit(c, type_original);
     }
     answer += ra_shrink_to_fit(&r->high_low_container);
+    leave_allocator_of(r, previous);
     return answer;
 }
 
@@ -1562,32 +2186,106 @@ size_t roaring_bitmap_shrink_to_fit(roaring_bitmap_t *r) {
  *  return whether a change was applied
  */
 bool roaring_bitmap_remove_run_compression(roaring_bitmap_t *r) {
+    const roaring_allocator_t *previous = enter_allocator_of(r);
     bool answer = false;
     for (int i = 0; i < r->high_low_container.size; i++) {
-        uint8_t type_original, type_after;
-        container_t *c = ra_get_container_at_index(&r->high_low_container,
-                                                   (uint16_t)i, &type_original);
-        if (get_container_type(c, type_original) == RUN_CONTAINER_TYPE) {
-            answer = true;
-            if (type_original == SHARED_CONTAINER_TYPE) {
-                run_container_t *truec = CAST_run(CAST_shared(c)->container);
-                int32_t card = run_container_cardinality(truec);
-                container_t *c1 = convert_to_bitset_or_array_container(
-                    truec, card, &type_after);
-                shared_container_free(CAST_shared(c));  // frees run as needed
-                ra_set_container_at_index(&r->high_low_container, i, c1,
-                                          type_after);
+        answer |= remove_run_compression_at_index(&r->high_low_container, i);
+    }
+    leave_allocator_of(r, previous);
+    return answer;
+}
 
-            } else {
-                int32_t card = run_container_cardinality(CAST_run(c));
-                container_t *c1 = convert_to_bitset_or_array_container(
-                    CAST_run(c), card, &type_after);
-                run_container_free(CAST_run(c));
-                ra_set_container_at_index(&r->high_low_container, i, c1,
-                                          type_after);
-            }
-        }
+typedef struct container_chunks_s {
+    roaring_array_t *ra;
+    size_t chunk_size;
+    size_t results[ROARING_MAX_TASKS];
+} container_chunks_t;
+
+static void run_optimize_chunk(void *arg, size_t task) {
+    container_chunks_t *chunks = (container_chunks_t *)arg;
+    size_t begin = task * chunks->chunk_size;
+    size_t end = minimum_uint64(begin + chunks->chunk_size,
+                                (size_t)chunks->ra->size);
+    bool answer = false;
+    for (size_t i = begin; i < end; i++) {
+        answer |= run_optimize_at_index(chunks->ra, (int32_t)i);
+    }
+    chunks->results[task] = answer;
+}
+
+static void shrink_to_fit_chunk(void *arg, size_t task) {
+    container_chunks_t *chunks = (container_chunks_t *)arg;
+    size_t begin = task * chunks->chunk_size;
+    size_t end = minimum_uint64(begin + chunks->chunk_size,
+                                (size_t)chunks->ra->size);
+    size_t answer = 0;
+    for (size_t i = begin; i < end; i++) {
+        uint8_t typecode;
+        container_t *c =
+            ra_get_container_at_index(chunks->ra, (uint16_t)i, &typecode);
+        answer += container_shrink_to_fit(c, typecode);
+    }
+    chunks->results[task] = answer;
+}
+
+static void remove_run_compression_chunk(void *arg, size_t task) {
+    container_chunks_t *chunks = (container_chunks_t *)arg;
+    size_t begin = task * chunks->chunk_size;
+    size_t end = minimum_uint64(begin + chunks->chunk_size,
+                                (size_t)chunks->ra->size);
+    bool answer = false;
+    for (size_t i = begin; i < end; i++) {
+        answer |= remove_run_compression_at_index(chunks->ra, (int32_t)i);
+    }
+    chunks->results[task] = answer;
+}
+
+// Runs task over all the containers of r, split in chunks, and returns the
+// sum of the per-chunk results.
+static size_t for_each_container_chunk(roaring_bitmap_t *r,
+                                       const roaring_executor_t *executor,
+                                       roaring_task_fn task) {
+    container_chunks_t chunks;
+    size_t size = (size_t)r->high_low_container.size;
+    chunks.ra = &r->high_low_container;
+    chunks.chunk_size =
+        roaring_task_chunk_size(size, ROARING_MIN_CONTAINERS_PER_TASK);
+    size_t num_tasks = (size + chunks.chunk_size - 1) / chunks.chunk_size;
+    roaring_execute_tasks(executor, num_tasks, task, &chunks);
+    size_t answer = 0;
+    for (size_t t = 0; t < num_tasks; t++) {
+        answer += chunks.results[t];
+    }
+    return answer;
+}
+
+bool roaring_bitmap_run_optimize_parallel(roaring_bitmap_t *r,
+                                          const roaring_executor_t *executor) {
+    const roaring_allocator_t *previous = enter_allocator_of(r);
+    bool answer =
+        for_each_container_chunk(r, executor, run_optimize_chunk) != 0;
+    leave_allocator_of(r, previous);
+    return answer;
+}
+
+size_t roaring_bitmap_shrink_to_fit_parallel(
+    roaring_bitmap_t *r, const roaring_executor_t *executor) {
+    if (arena_of(r) != NULL) {
+        return compact_arena_of(r);
     }
+    const roaring_allocator_t *previous = enter_allocator_of(r);
+    size_t answer = for_each_container_chunk(r, executor, shrink_to_fit_chunk);
+    answer += ra_shrink_to_fit(&r->high_low_container);
+    leave_allocator_of(r, previous);
+    return answer;
+}
+
+bool roaring_bitmap_remove_run_compression_parallel(
+    roaring_bitmap_t *r, const roaring_executor_t *executor) {
+    const roaring_allocator_t *previous = enter_allocator_of(r);
+    bool answer = for_each_container_chunk(r, executor,
+                                           remove_run_compression_chunk) != 0;
+    leave_allocator_of(r, previous);
     return answer;
 }
 
@@ -1631,7 +2329,7 @@ size_t roaring_bitmap_portable_size_in_bytes(const roaring_bitmap_t *r) {
 roaring_bitmap_t *roaring_bitmap_portable_deserialize_safe(const char *buf,
                                                            size_t maxbytes) {
     roaring_bitmap_t *ans =
-        (roaring_bitmap_t *)roaring_malloc(sizeof(roaring_bitmap_t));
+        (roaring_bitmap_t *)roaring_hooks_malloc(sizeof(roaring_bitmap_t));
     if (ans == NULL) {
         return NULL;
     }
@@ -1639,15 +2337,33 @@ roaring_bitmap_t *roaring_bitmap_portable_deserialize_safe(const char *buf,
     bool is_ok = ra_portable_deserialize(&ans->high_low_container, buf,
                                          maxbytes, &bytesread);
     if (!is_ok) {
-        roaring_free(ans);
+        roaring_hooks_free(ans);
         return NULL;
     }
     roaring_bitmap_set_copy_on_write(ans, false);
     if (!is_ok) {
-        roaring_free(ans);
+        roaring_hooks_free(ans);
         return NULL;
     }
-    return ans;
+    return bitmap_created(ans);
+}
+
+roaring_bitmap_t *roaring_bitmap_portable_deserialize_safe_parallel(
+    const char *buf, size_t maxbytes, const roaring_executor_t *executor) {
+    roaring_bitmap_t *ans =
+        (roaring_bitmap_t *)roaring_hooks_malloc(sizeof(roaring_bitmap_t));
+    if (ans == NULL) {
+        return NULL;
+    }
+    size_t bytesread;
+    bool is_ok = ra_portable_deserialize_parallel(
+        &ans->high_low_container, buf, maxbytes, &bytesread, executor);
+    if (!is_ok) {
+        roaring_hooks_free(ans);
+        return NULL;
+    }
+    roaring_bitmap_set_copy_on_write(ans, false);
+    return bitmap_created(ans);
 }
 
 roaring_bitmap_t *roaring_bitmap_portable_deserialize(const char *buf) {
@@ -1663,6 +2379,12 @@ size_t roaring_bitmap_portable_serialize(const roaring_bitmap_t *r, char *buf) {
     return ra_portable_serialize(&r->high_low_container, buf);
 }
 
+size_t roaring_bitmap_portable_serialize_parallel(
+    const roaring_bitmap_t *r, char *buf, const roaring_executor_t *executor) {
+    return ra_portable_serialize_parallel(&r->high_low_container, buf,
+                                          executor);
+}
+
 roaring_bitmap_t *roaring_bitmap_deserialize(const void *buf) {
     const char *bufaschar = (const char *)buf;
     if (bufaschar[0] == CROARING_SERIALIZATION_ARRAY_UINT32) {
@@ -2125,6 +2847,75 @@ void roaring_uint32_iterator_free(roaring_uint32_iterator_t *it) {
  * end of roaring_uint32_iterator_t
  *****/
 
+// Appends [min, max] to ranges, extending the last range instead when the two
+// touch. Returns false if a new range is needed but ranges is full.
+static inline bool range_runs_append(roaring_uint32_range_closed_t *ranges,
+                                     size_t *count, size_t max_ranges,
+                                     uint32_t min, uint32_t max) {
+    if (*count > 0 && ranges[*count - 1].max + 1 == min) {
+        ranges[*count - 1].max = max;
+        return true;
+    }
+    if (*count == max_ranges) {
+        return false;
+    }
+    ranges[*count].min = min;
+    ranges[*count].max = max;
+    (*count)++;
+    return true;
+}
+
+size_t roaring_bitmap_range_runs(const roaring_bitmap_t *r,
+                                 uint64_t range_start, uint64_t range_end,
+                                 roaring_uint32_range_closed_t *ranges,
+                                 size_t max_ranges) {
+    if (range_end > (uint64_t)UINT32_MAX + 1) {
+        range_end = (uint64_t)UINT32_MAX + 1;
+    }
+    if (range_start >= range_end || max_ranges == 0) {
+        return 0;
+    }
+    const roaring_array_t *ra = &r->high_low_container;
+    uint32_t last = (uint32_t)(range_end - 1);
+    int32_t i = ra_get_index(ra, (uint16_t)(range_start >> 16));
+    if (i < 0) {
+        i = -i - 1;
+    }
+    size_t count = 0;
+    for (; i < ra->size; i++) {
+        uint32_t highbits = (uint32_t)ra->keys[i] << 16;
+        if (highbits > last) {
+            break;
+        }
+        uint8_t typecode = ra->typecodes[i];
+        const container_t *c =
+            container_unwrap_shared(ra->containers[i], &typecode);
+        uint16_t value;
+        roaring_container_iterator_t it;
+        if (highbits < range_start) {
+            if (!container_iterator_lower_bound(c, typecode, &it, &value,
+                                                (uint16_t)range_start)) {
+                continue;
+            }
+        } else {
+            it = container_init_iterator(c, typecode, &value);
+        }
+        bool has_more = true;
+        while (has_more && (highbits | value) <= last) {
+            uint32_t min = highbits | value;
+            uint32_t max = highbits | container_iterator_find_run_end(
+                                          c, typecode, &it, &value, &has_more);
+            if (max > last) {
+                max = last;
+            }
+            if (!range_runs_append(ranges, &count, max_ranges, min, max)) {
+                return count;
+            }
+        }
+    }
+    return count;
+}
+
 bool roaring_bitmap_equals(const roaring_bitmap_t *r1,
                            const roaring_bitmap_t *r2) {
     const roaring_array_t *ra1 = &r1->high_low_container;
@@ -2296,11 +3087,11 @@ roaring_bitmap_t *roaring_bitmap_flip(const roaring_bitmap_t *x1,
                                       (uint32_t)(range_end - 1));
 }
 
-roaring_bitmap_t *roaring_bitmap_flip_closed(const roaring_bitmap_t *x1,
-                                             uint32_t range_start,
-                                             uint32_t range_end) {
+static roaring_bitmap_t *bitmap_flip_closed(const roaring_bitmap_t *x1,
+                                            uint32_t range_start,
+                                            uint32_t range_end) {
     if (range_start > range_end) {
-        return roaring_bitmap_copy(x1);
+        return bitmap_copy(x1);
     }
 
     roaring_bitmap_t *ans = roaring_bitmap_create();
@@ -2312,7 +3103,7 @@ roaring_bitmap_t *roaring_bitmap_flip_closed(const roaring_bitmap_t *x1,
     const uint16_t lb_end = (uint16_t)range_end;  // & 0xFFFF;
 
     ra_append_copies_until(&ans->high_low_container, &x1->high_low_container,
-                           hb_start, is_cow(x1));
+                           hb_start, can_share(x1, ans));
     if (hb_start == hb_end) {
         insert_flipped_container(&ans->high_low_container,
                                  &x1->high_low_container, hb_start, lb_start,
@@ -2344,10 +3135,19 @@ roaring_bitmap_t *roaring_bitmap_flip_closed(const roaring_bitmap_t *x1,
         }
     }
     ra_append_copies_after(&ans->high_low_container, &x1->high_low_container,
-                           hb_end, is_cow(x1));
+                           hb_end, can_share(x1, ans));
     return ans;
 }
 
+roaring_bitmap_t *roaring_bitmap_flip_closed(const roaring_bitmap_t *x1,
+                                             uint32_t range_start,
+                                             uint32_t range_end) {
+    const roaring_allocator_t *previous = enter_allocator_of(x1);
+    roaring_bitmap_t *answer = bitmap_flip_closed(x1, range_start, range_end);
+    leave_allocator_of(x1, previous);
+    return answer;
+}
+
 void roaring_bitmap_flip_inplace(roaring_bitmap_t *x1, uint64_t range_start,
                                  uint64_t range_end) {
     if (range_start >= range_end || range_start > (uint64_t)UINT32_MAX + 1) {
@@ -2363,6 +3163,7 @@ void roaring_bitmap_flip_inplace_closed(roaring_bitmap_t *x1,
     if (range_start > range_end) {
         return;  // empty range
     }
+    const roaring_allocator_t *previous = enter_allocator_of(x1);
 
     uint16_t hb_start = (uint16_t)(range_start >> 16);
     const uint16_t lb_start = (uint16_t)range_start;
@@ -2393,6 +3194,7 @@ void roaring_bitmap_flip_inplace_closed(roaring_bitmap_t *x1,
             ++hb_end;
         }
     }
+    leave_allocator_of(x1, previous);
 }
 
 static void offset_append_with_merge(roaring_array_t *ra, int k, container_t *c,
@@ -2428,8 +3230,8 @@ static void offset_append_with_merge(roaring_array_t *ra, int k, container_t *c,
 // outside of the range [0,2^32), that the element will be dropped.
 // We need "offset" to be 64 bits because we want to support values
 // between -0xFFFFFFFF up to +0xFFFFFFFF.
-roaring_bitmap_t *roaring_bitmap_add_offset(const roaring_bitmap_t *bm,
-                                            int64_t offset) {
+static roaring_bitmap_t *bitmap_add_offset(const roaring_bitmap_t *bm,
+                                           int64_t offset) {
     roaring_bitmap_t *answer;
     roaring_array_t *ans_ra;
     int64_t container_offset;
@@ -2439,15 +3241,15 @@ roaring_bitmap_t *roaring_bitmap_add_offset(const roaring_bitmap_t *bm,
     int length = bm_ra->size;
 
     if (offset == 0) {
-        return roaring_bitmap_copy(bm);
+        return bitmap_copy(bm);
     }
 
     container_offset = offset >> 16;
     in_offset = (uint16_t)(offset - container_offset * (1 << 16));
 
     answer = roaring_bitmap_create();
-    bool cow = is_cow(bm);
-    roaring_bitmap_set_copy_on_write(answer, cow);
+    roaring_bitmap_set_copy_on_write(answer, is_cow(bm));
+    bool cow = can_share(bm, answer);
 
     ans_ra = &answer->high_low_container;
 
@@ -2506,17 +3308,25 @@ roaring_bitmap_t *roaring_bitmap_add_offset(const roaring_bitmap_t *bm,
     return answer;
 }
 
-roaring_bitmap_t *roaring_bitmap_lazy_or(const roaring_bitmap_t *x1,
-                                         const roaring_bitmap_t *x2,
-                                         const bool bitsetconversion) {
+roaring_bitmap_t *roaring_bitmap_add_offset(const roaring_bitmap_t *bm,
+                                            int64_t offset) {
+    const roaring_allocator_t *previous = enter_allocator_of(bm);
+    roaring_bitmap_t *answer = bitmap_add_offset(bm, offset);
+    leave_allocator_of(bm, previous);
+    return answer;
+}
+
+static roaring_bitmap_t *bitmap_lazy_or(const roaring_bitmap_t *x1,
+                                        const roaring_bitmap_t *x2,
+                                        const bool bitsetconversion) {
     uint8_t result_type = 0;
     const int length1 = x1->high_low_container.size,
               length2 = x2->high_low_container.size;
     if (0 == length1) {
-        return roaring_bitmap_copy(x2);
+        return bitmap_copy(x2);
     }
     if (0 == length2) {
-        return roaring_bitmap_copy(x1);
+        return bitmap_copy(x1);
     }
     roaring_bitmap_t *answer =
         roaring_bitmap_create_with_capacity(length1 + length2);
@@ -2561,8 +3371,8 @@ roaring_bitmap_t *roaring_bitmap_lazy_or(const roaring_bitmap_t *x1,
         } else if (s1 < s2) {  // s1 < s2
             container_t *c1 = ra_get_container_at_index(&x1->high_low_container,
                                                         (uint16_t)pos1, &type1);
-            c1 = get_copy_of_container(c1, &type1, is_cow(x1));
-            if (is_cow(x1)) {
+            c1 = get_copy_of_container(c1, &type1, can_share(x1, answer));
+            if (can_share(x1, answer)) {
                 ra_set_container_at_index(&x1->high_low_container, pos1, c1,
                                           type1);
             }
@@ -2574,8 +3384,8 @@ roaring_bitmap_t *roaring_bitmap_lazy_or(const roaring_bitmap_t *x1,
         } else {  // s1 > s2
             container_t *c2 = ra_get_container_at_index(&x2->high_low_container,
                                                         (uint16_t)pos2, &type2);
-            c2 = get_copy_of_container(c2, &type2, is_cow(x2));
-            if (is_cow(x2)) {
+            c2 = get_copy_of_container(c2, &type2, can_share(x2, answer));
+            if (can_share(x2, answer)) {
                 ra_set_container_at_index(&x2->high_low_container, pos2, c2,
                                           type2);
             }
@@ -2588,18 +3398,36 @@ roaring_bitmap_t *roaring_bitmap_lazy_or(const roaring_bitmap_t *x1,
     if (pos1 == length1) {
         ra_append_copy_range(&answer->high_low_container,
                              &x2->high_low_container, pos2, length2,
-                             is_cow(x2));
+                             can_share(x2, answer));
     } else if (pos2 == length2) {
         ra_append_copy_range(&answer->high_low_container,
                              &x1->high_low_container, pos1, length1,
-                             is_cow(x1));
+                             can_share(x1, answer));
     }
     return answer;
 }
 
-void roaring_bitmap_lazy_or_inplace(roaring_bitmap_t *x1,
-                                    const roaring_bitmap_t *x2,
-                                    const bool bitsetconversion) {
+roaring_bitmap_t *roaring_bitmap_lazy_or_ex(const roaring_bitmap_t *x1,
+                                            const roaring_bitmap_t *x2,
+                                            const bool bitsetconversion,
+                                            roaring_workspace_t *workspace) {
+    const roaring_allocator_t *previous = enter_allocator_of(x1);
+    bitset_container_pool_t *pool = enter_workspace(workspace, x1);
+    roaring_bitmap_t *answer = bitmap_lazy_or(x1, x2, bitsetconversion);
+    leave_workspace(workspace, x1, pool);
+    leave_allocator_of(x1, previous);
+    return answer;
+}
+
+roaring_bitmap_t *roaring_bitmap_lazy_or(const roaring_bitmap_t *x1,
+                                         const roaring_bitmap_t *x2,
+                                         const bool bitsetconversion) {
+    return roaring_bitmap_lazy_or_ex(x1, x2, bitsetconversion, NULL);
+}
+
+static void bitmap_lazy_or_inplace(roaring_bitmap_t *x1,
+                                   const roaring_bitmap_t *x2,
+                                   const bool bitsetconversion) {
     uint8_t result_type = 0;
     int length1 = x1->high_low_container.size;
     const int length2 = x2->high_low_container.size;
@@ -2661,8 +3489,8 @@ void roaring_bitmap_lazy_or_inplace(roaring_bitmap_t *x1,
             container_t *c2 = ra_get_container_at_index(&x2->high_low_container,
                                                         (uint16_t)pos2, &type2);
             // container_t *c2_clone = container_clone(c2, type2);
-            c2 = get_copy_of_container(c2, &type2, is_cow(x2));
-            if (is_cow(x2)) {
+            c2 = get_copy_of_container(c2, &type2, can_share(x2, x1));
+            if (can_share(x2, x1)) {
                 ra_set_container_at_index(&x2->high_low_container, pos2, c2,
                                           type2);
             }
@@ -2677,20 +3505,37 @@ void roaring_bitmap_lazy_or_inplace(roaring_bitmap_t *x1,
     }
     if (pos1 == length1) {
         ra_append_copy_range(&x1->high_low_container, &x2->high_low_container,
-                             pos2, length2, is_cow(x2));
+                             pos2, length2, can_share(x2, x1));
     }
 }
 
-roaring_bitmap_t *roaring_bitmap_lazy_xor(const roaring_bitmap_t *x1,
-                                          const roaring_bitmap_t *x2) {
+void roaring_bitmap_lazy_or_inplace_ex(roaring_bitmap_t *x1,
+                                       const roaring_bitmap_t *x2,
+                                       const bool bitsetconversion,
+                                       roaring_workspace_t *workspace) {
+    const roaring_allocator_t *previous = enter_allocator_of(x1);
+    bitset_container_pool_t *pool = enter_workspace(workspace, x1);
+    bitmap_lazy_or_inplace(x1, x2, bitsetconversion);
+    leave_workspace(workspace, x1, pool);
+    leave_allocator_of(x1, previous);
+}
+
+void roaring_bitmap_lazy_or_inplace(roaring_bitmap_t *x1,
+                                    const roaring_bitmap_t *x2,
+                                    const bool bitsetconversion) {
+    roaring_bitmap_lazy_or_inplace_ex(x1, x2, bitsetconversion, NULL);
+}
+
+static roaring_bitmap_t *bitmap_lazy_xor(const roaring_bitmap_t *x1,
+                                         const roaring_bitmap_t *x2) {
     uint8_t result_type = 0;
     const int length1 = x1->high_low_container.size,
               length2 = x2->high_low_container.size;
     if (0 == length1) {
-        return roaring_bitmap_copy(x2);
+        return bitmap_copy(x2);
     }
     if (0 == length2) {
-        return roaring_bitmap_copy(x1);
+        return bitmap_copy(x1);
     }
     roaring_bitmap_t *answer =
         roaring_bitmap_create_with_capacity(length1 + length2);
@@ -2724,8 +3569,8 @@ roaring_bitmap_t *roaring_bitmap_lazy_xor(const roaring_bitmap_t *x1,
         } else if (s1 < s2) {  // s1 < s2
             container_t *c1 = ra_get_container_at_index(&x1->high_low_container,
                                                         (uint16_t)pos1, &type1);
-            c1 = get_copy_of_container(c1, &type1, is_cow(x1));
-            if (is_cow(x1)) {
+            c1 = get_copy_of_container(c1, &type1, can_share(x1, answer));
+            if (can_share(x1, answer)) {
                 ra_set_container_at_index(&x1->high_low_container, pos1, c1,
                                           type1);
             }
@@ -2737,8 +3582,8 @@ roaring_bitmap_t *roaring_bitmap_lazy_xor(const roaring_bitmap_t *x1,
         } else {  // s1 > s2
             container_t *c2 = ra_get_container_at_index(&x2->high_low_container,
                                                         (uint16_t)pos2, &type2);
-            c2 = get_copy_of_container(c2, &type2, is_cow(x2));
-            if (is_cow(x2)) {
+            c2 = get_copy_of_container(c2, &type2, can_share(x2, answer));
+            if (can_share(x2, answer)) {
                 ra_set_container_at_index(&x2->high_low_container, pos2, c2,
                                           type2);
             }
@@ -2751,17 +3596,33 @@ roaring_bitmap_t *roaring_bitmap_lazy_xor(const roaring_bitmap_t *x1,
     if (pos1 == length1) {
         ra_append_copy_range(&answer->high_low_container,
                              &x2->high_low_container, pos2, length2,
-                             is_cow(x2));
+                             can_share(x2, answer));
     } else if (pos2 == length2) {
         ra_append_copy_range(&answer->high_low_container,
                              &x1->high_low_container, pos1, length1,
-                             is_cow(x1));
+                             can_share(x1, answer));
     }
     return answer;
 }
 
-void roaring_bitmap_lazy_xor_inplace(roaring_bitmap_t *x1,
-                                     const roaring_bitmap_t *x2) {
+roaring_bitmap_t *roaring_bitmap_lazy_xor_ex(const roaring_bitmap_t *x1,
+                                             const roaring_bitmap_t *x2,
+                                             roaring_workspace_t *workspace) {
+    const roaring_allocator_t *previous = enter_allocator_of(x1);
+    bitset_container_pool_t *pool = enter_workspace(workspace, x1);
+    roaring_bitmap_t *answer = bitmap_lazy_xor(x1, x2);
+    leave_workspace(workspace, x1, pool);
+    leave_allocator_of(x1, previous);
+    return answer;
+}
+
+roaring_bitmap_t *roaring_bitmap_lazy_xor(const roaring_bitmap_t *x1,
+                                          const roaring_bitmap_t *x2) {
+    return roaring_bitmap_lazy_xor_ex(x1, x2, NULL);
+}
+
+static void bitmap_lazy_xor_inplace(roaring_bitmap_t *x1,
+                                    const roaring_bitmap_t *x2) {
     assert(x1 != x2);
     uint8_t result_type = 0;
     int length1 = x1->high_low_container.size;
@@ -2822,8 +3683,8 @@ void roaring_bitmap_lazy_xor_inplace(roaring_bitmap_t *x1,
             container_t *c2 = ra_get_container_at_index(&x2->high_low_container,
                                                         (uint16_t)pos2, &type2);
             // container_t *c2_clone = container_clone(c2, type2);
-            c2 = get_copy_of_container(c2, &type2, is_cow(x2));
-            if (is_cow(x2)) {
+            c2 = get_copy_of_container(c2, &type2, can_share(x2, x1));
+            if (can_share(x2, x1)) {
                 ra_set_container_at_index(&x2->high_low_container, pos2, c2,
                                           type2);
             }
@@ -2838,11 +3699,29 @@ void roaring_bitmap_lazy_xor_inplace(roaring_bitmap_t *x1,
     }
     if (pos1 == length1) {
         ra_append_copy_range(&x1->high_low_container, &x2->high_low_container,
-                             pos2, length2, is_cow(x2));
+                             pos2, length2, can_share(x2, x1));
     }
 }
 
-void roaring_bitmap_repair_after_lazy(roaring_bitmap_t *r) {
+void roaring_bitmap_lazy_xor_inplace_ex(roaring_bitmap_t *x1,
+                                        const roaring_bitmap_t *x2,
+                                        roaring_workspace_t *workspace) {
+    const roaring_allocator_t *previous = enter_allocator_of(x1);
+    bitset_container_pool_t *pool = enter_workspace(workspace, x1);
+    bitmap_lazy_xor_inplace(x1, x2);
+    leave_workspace(workspace, x1, pool);
+    leave_allocator_of(x1, previous);
+}
+
+void roaring_bitmap_lazy_xor_inplace(roaring_bitmap_t *x1,
+                                     const roaring_bitmap_t *x2) {
+    roaring_bitmap_lazy_xor_inplace_ex(x1, x2, NULL);
+}
+
+void roaring_bitmap_repair_after_lazy_ex(roaring_bitmap_t *r,
+                                         roaring_workspace_t *workspace) {
+    const roaring_allocator_t *previous = enter_allocator_of(r);
+    bitset_container_pool_t *pool = enter_workspace(workspace, r);
     roaring_array_t *ra = &r->high_low_container;
 
     for (int i = 0; i < ra->size; ++i) {
@@ -2853,6 +3732,12 @@ void roaring_bitmap_repair_after_lazy(roaring_bitmap_t *r) {
         ra->containers[i] = new_c;
         ra->typecodes[i] = new_type;
     }
+    leave_workspace(workspace, r, pool);
+    leave_allocator_of(r, previous);
+}
+
+void roaring_bitmap_repair_after_lazy(roaring_bitmap_t *r) {
+    roaring_bitmap_repair_after_lazy_ex(r, NULL);
 }
 
 /**
@@ -3401,6 +4286,7 @@ const roaring_bitmap_t *roaring_bitmap_frozen_view(const char *buf,
     roaring_bitmap_t *rb =
         (roaring_bitmap_t *)arena_alloc(&arena, sizeof(roaring_bitmap_t));
     rb->high_low_container.flags = ROARING_FLAG_FROZEN;
+    rb->high_low_container.allocator = NULL;
     rb->high_low_container.allocation_size = num_containers;
     rb->high_low_container.size = num_containers;
     rb->high_low_container.keys = (uint16_t *)keys;
@@ -3536,6 +4422,7 @@ roaring_bitmap_t *roaring_bitmap_portable_deserialize_frozen(const char *buf) {
     roaring_bitmap_t *rb =
         (roaring_bitmap_t *)arena_alloc(&arena, sizeof(roaring_bitmap_t));
     rb->high_low_container.flags = ROARING_FLAG_FROZEN;
+    rb->high_low_container.allocator = NULL;
     rb->high_low_container.allocation_size = num_containers;
     rb->high_low_container.size = num_containers;
     rb->high_low_container.containers = (container_t **)arena_alloc(
@@ -3657,6 +4544,269 @@ bool roaring_bitmap_to_bitset(const roaring_bitmap_t *r, bitset_t *bitset) {
     return true;
 }
 
+// ORs into words, where bit i stands for the value start + i, the values of
+// the container with the given high bits that fall within [from, end). We
+// have start <= from.
+static void container_to_words(const container_t *c, uint8_t type,
+                               uint32_t highbits, uint64_t start,
+                               uint64_t from, uint64_t end, uint64_t *words) {
+    uint32_t lo = from > highbits ? (uint32_t)(from - highbits) : 0;
+    uint32_t hi = end < (uint64_t)highbits + (1 << 16)
+                      ? (uint32_t)(end - highbits)
+                      : (1 << 16);
+    if (lo >= hi) {
+        return;
+    }
+    // position in words of the container value 0, possibly negative
+    int64_t origin = (int64_t)highbits - (int64_t)start;
+    c = container_unwrap_shared(c, &type);
+    switch (type) {
+        case BITSET_CONTAINER_TYPE: {
+            const uint64_t *src = const_CAST_bitset(c)->words;
+            uint32_t w0 = lo / 64, w1 = (hi + 63) / 64;
+            uint64_t first_mask = UINT64_MAX << (lo % 64);
+            uint64_t last_mask = UINT64_MAX >> ((64 - hi % 64) % 64);
+            if (origin % 64 == 0) {
+                // word-aligned: the inner words are copied as they are
+                uint64_t *dst = words + (origin / 64 + w0);
+                if (w1 - w0 == 1) {
+                    dst[0] |= src[w0] & first_mask & last_mask;
+                    break;
+                }
+                dst[0] |= src[w0] & first_mask;
+                memcpy(dst + 1, src + w0 + 1,
+                       (w1 - w0 - 2) * sizeof(uint64_t));
+                dst[w1 - w0 - 1] |= src[w1 - 1] & last_mask;
+                break;
+            }
+            for (uint32_t w = w0; w < w1; w++) {
+                uint64_t bits = src[w];
+                if (w == w0) bits &= first_mask;
+                if (w == w1 - 1) bits &= last_mask;
+                int64_t pos = origin + 64 * (int64_t)w;
+                if (pos < 0) {
+                    // only bits at or after start were kept
+                    words[0] |= bits >> (-pos);
+                    continue;
+                }
+                uint32_t shift = (uint32_t)(pos % 64);
+                words[pos / 64] |= bits << shift;
+                if (shift != 0 && (bits >> (64 - shift)) != 0) {
+                    words[pos / 64 + 1] |= bits >> (64 - shift);
+                }
+            }
+        } break;
+        case ARRAY_CONTAINER_TYPE: {
+            const array_container_t *ac = const_CAST_array(c);
+            int32_t i = array_container_index_equalorlarger(ac, (uint16_t)lo);
+            if (i < 0) break;
+            for (; i < ac->cardinality && ac->array[i] < hi; i++) {
+                uint64_t pos = (uint64_t)(origin + ac->array[i]);
+                words[pos / 64] |= UINT64_C(1) << (pos % 64);
+            }
+        } break;
+        case RUN_CONTAINER_TYPE: {
+            const run_container_t *rc = const_CAST_run(c);
+            int32_t i = run_container_index_equalorlarger(rc, (uint16_t)lo);
+            if (i < 0) break;
+            for (; i < rc->n_runs && rc->runs[i].value < hi; i++) {
+                uint32_t run_start = rc->runs[i].value;
+                uint32_t run_end = run_start + rc->runs[i].length + 1;
+                if (run_start < lo) run_start = lo;
+                if (run_end > hi) run_end = hi;
+                bitset_set_range(words, (uint32_t)(origin + run_start),
+                                 (uint32_t)(origin + run_end));
+            }
+        } break;
+        default:
+            roaring_unreachable;
+    }
+}
+
+// Fills words with the values of [from, start + n) from the containers at
+// index i and after, bit k standing for start + k. Returns the index of the
+// first container that may hold values at or after start + n.
+static int32_t containers_to_words(const roaring_array_t *ra, int32_t i,
+                                   uint32_t start, uint32_t from, uint32_t n,
+                                   uint64_t *words) {
+    memset(words, 0, ((size_t)n + 63) / 64 * sizeof(uint64_t));
+    uint64_t end = (uint64_t)start + n;
+    if (end > (uint64_t)UINT32_MAX + 1) {
+        end = (uint64_t)UINT32_MAX + 1;
+    }
+    for (; i < ra->size; i++) {
+        uint32_t highbits = (uint32_t)ra->keys[i] << 16;
+        if (highbits >= end) {
+            break;
+        }
+        if ((uint64_t)highbits + (1 << 16) <= from) {
+            continue;
+        }
+        container_to_words(ra->containers[i], ra->typecodes[i], highbits,
+                           start, from, end, words);
+        if ((uint64_t)highbits + (1 << 16) > end) {
+            break;
+        }
+    }
+    return i;
+}
+
+// Returns the 64 bits of words starting at bit position pos (which may be
+// negative), reading zeros outside of the nwords words.
+static inline uint64_t load_word_at_bit(const uint64_t *words, size_t nwords,
+                                        int64_t pos) {
+    if (pos <= -64 || pos >= (int64_t)nwords * 64) {
+        return 0;
+    }
+    if (pos < 0) {
+        return words[0] << (-pos);
+    }
+    size_t w = (size_t)pos / 64;
+    uint32_t shift = (uint32_t)(pos % 64);
+    if (shift == 0) {
+        return words[w];
+    }
+    uint64_t answer = words[w] >> shift;
+    if (w + 1 < nwords) {
+        answer |= words[w + 1] << (64 - shift);
+    }
+    return answer;
+}
+
+static bool bitmap_or_words(roaring_bitmap_t *r, const uint64_t *words,
+                            size_t nwords, uint32_t base_offset) {
+    if (nwords == 0) {
+        return true;
+    }
+    roaring_array_t *ra = &r->high_low_container;
+    uint64_t end = (uint64_t)base_offset + (uint64_t)nwords * 64;
+    if (end > (uint64_t)UINT32_MAX + 1) {
+        end = (uint64_t)UINT32_MAX + 1;
+    }
+    uint32_t first_key = base_offset >> 16;
+    uint32_t last_key = (uint32_t)((end - 1) >> 16);
+    uint64_t *block = NULL;  // for blocks not aligned on a container
+    for (uint32_t key = first_key; key <= last_key; key++) {
+        uint64_t highbits = (uint64_t)key << 16;
+        int64_t pos = (int64_t)highbits - (int64_t)base_offset;
+        const uint64_t *src;
+        if (pos >= 0 && pos % 64 == 0 &&
+            (size_t)pos / 64 + BITSET_CONTAINER_SIZE_IN_WORDS <= nwords) {
+            src = words + pos / 64;  // read in place
+        } else {
+            if (block == NULL) {
+                block = (uint64_t *)roaring_hooks_malloc(
+                    BITSET_CONTAINER_SIZE_IN_WORDS * sizeof(uint64_t));
+                if (block == NULL) {
+                    return false;
+                }
+            }
+            for (int32_t j = 0; j < BITSET_CONTAINER_SIZE_IN_WORDS; j++) {
+                block[j] = load_word_at_bit(words, nwords, pos + 64 * j);
+            }
+            src = block;
+        }
+        int32_t j = 0;
+        while (j < BITSET_CONTAINER_SIZE_IN_WORDS && src[j] == 0) j++;
+        if (j == BITSET_CONTAINER_SIZE_IN_WORDS) {
+            continue;
+        }
+        int32_t i = -1;
+        if (ra->size > 0 && ra->keys[ra->size - 1] >= key) {
+            i = ra_get_index(ra, (uint16_t)key);
+        }
+        if (i >= 0 && ra->typecodes[i] == BITSET_CONTAINER_TYPE) {
+            // OR straight into an existing bitset container
+            bitset_container_t *bc = CAST_bitset(ra->containers[i]);
+            for (; j < BITSET_CONTAINER_SIZE_IN_WORDS; j++) {
+                bc->words[j] |= src[j];
+            }
+            bc->cardinality = bitset_container_compute_cardinality(bc);
+            continue;
+        }
+        uint8_t typecode;
+        container_t *c = container_from_words(src, &typecode);
+        if (c == NULL) {
+            if (block != NULL) roaring_hooks_free(block);
+            return false;
+        }
+        ra_or_container(ra, (uint16_t)key, c, typecode);
+    }
+    if (block != NULL) roaring_hooks_free(block);
+    return true;
+}
+
+bool roaring_bitmap_or_words(roaring_bitmap_t *r, const uint64_t *words,
+                             size_t nwords, uint32_t base_offset) {
+    const roaring_allocator_t *previous = enter_allocator_of(r);
+    bool answer = bitmap_or_words(r, words, nwords, base_offset);
+    leave_allocator_of(r, previous);
+    return answer;
+}
+
+roaring_bitmap_t *roaring_bitmap_from_words(const uint64_t *words,
+                                            size_t nwords,
+                                            uint32_t base_offset) {
+    roaring_bitmap_t *answer = roaring_bitmap_create();
+    if (answer == NULL) {
+        return NULL;
+    }
+    if (!roaring_bitmap_or_words(answer, words, nwords, base_offset)) {
+        roaring_bitmap_free(answer);
+        return NULL;
+    }
+    return answer;
+}
+
+void roaring_bitmap_to_words(const roaring_bitmap_t *r, uint32_t start,
+                             uint32_t n, uint64_t *words) {
+    if (n == 0) {
+        return;
+    }
+    const roaring_array_t *ra = &r->high_low_container;
+    int32_t i = ra_get_index(ra, (uint16_t)(start >> 16));
+    if (i < 0) {
+        i = -i - 1;
+    }
+    containers_to_words(ra, i, start, start, n, words);
+}
+
+bool roaring_uint32_iterator_read_words(roaring_uint32_iterator_t *it,
+                                        uint32_t start, uint32_t n,
+                                        uint64_t *words) {
+    if (it->has_value && it->current_value < start) {
+        roaring_uint32_iterator_move_equalorlarger(it, start);
+    }
+    uint64_t end = (uint64_t)start + n;
+    if (!it->has_value || it->current_value >= end) {
+        memset(words, 0, ((size_t)n + 63) / 64 * sizeof(uint64_t));
+        return it->has_value;
+    }
+    const roaring_array_t *ra = &it->parent->high_low_container;
+    it->container_index = containers_to_words(
+        ra, it->container_index, start, it->current_value, n, words);
+    if (end > UINT32_MAX) {
+        it->container_index = ra->size;
+        it->current_value = UINT32_MAX;
+        return (it->has_value = false);
+    }
+    // Position the iterator at end without searching the keys again: the
+    // container containers_to_words stopped at is the only one that can hold
+    // both values below and at or after end.
+    if (it->container_index < ra->size &&
+        ra->keys[it->container_index] == (uint16_t)(end >> 16)) {
+        if (container_maximum(ra->containers[it->container_index],
+                              ra->typecodes[it->container_index]) >=
+            (uint16_t)end) {
+            it->has_value = loadfirstvalue_largeorequal(it, (uint32_t)end);
+            return it->has_value;
+        }
+        it->container_index++;
+    }
+    it->has_value = loadfirstvalue(it);
+    return it->has_value;
+}
+
 #ifdef __cplusplus
 }
 }
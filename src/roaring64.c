@@ -39,13 +39,34 @@ typedef struct roaring64_bitmap_s {
     uint64_t first_free;
     uint64_t capacity;
     container_t **containers;
+
+    // Hot leaf cache, see roaring64_bitmap_set_leaf_cache. `cached_leaf` is
+    // valid while `cached_leaf_version` equals the leaf version of the ART.
+    bool leaf_cache;
+    uint8_t cached_high48[ART_KEY_BYTES];
+    roaring64_leaf_t *cached_leaf;
+    uint64_t cached_leaf_version;
+
+    // Where the containers and the ART come from, NULL for the memory hooks.
+    const roaring_allocator_t *allocator;
 } roaring64_bitmap_t;
 
 // Leaf type of the ART used to keep the high 48 bits of each entry.
 // Low 8 bits: typecode
 // High 56 bits: container index
+//
+// Containers of up to INLINE_LEAF_MAX values are not allocated, their values
+// are kept sorted in the leaf itself instead, which matters for very sparse
+// bitmaps where most containers hold a single value. Such inline leaves are
+// marked by INLINE_LEAF_FLAG in the low 8 bits:
+// Bits 0-1: number of values
+// Bit 7: INLINE_LEAF_FLAG
+// Bits 16-31, 32-47, 48-63: values
 typedef roaring64_leaf_t leaf_t;
 
+#define INLINE_LEAF_FLAG 0x80
+#define INLINE_LEAF_MAX 3
+
 // Iterator struct to hold iteration state.
 typedef struct roaring64_iterator_s {
     const roaring64_bitmap_t *r;
@@ -67,6 +88,20 @@ static inline bool is_frozen64(const roaring64_bitmap_t *r) {
     return r->flags & ROARING_FLAG_FROZEN;
 }
 
+// Routes the allocations made while working on `r` to its allocator, if any,
+// until leave_allocator_of64, as for 32-bit bitmaps.
+static inline const roaring_allocator_t *enter_allocator_of64(
+    const roaring64_bitmap_t *r) {
+    return r->allocator == NULL ? NULL : roaring_allocator_enter(r->allocator);
+}
+
+static inline void leave_allocator_of64(const roaring64_bitmap_t *r,
+                                        const roaring_allocator_t *previous) {
+    if (r->allocator != NULL) {
+        roaring_allocator_leave(previous);
+    }
+}
+
 // Splits the given uint64 key into high 48 bit and low 16 bit components.
 // Expects high48_out to be of length ART_KEY_BYTES.
 static inline uint16_t split_key(uint64_t key, uint8_t high48_out[]) {
@@ -91,15 +126,133 @@ static inline leaf_t create_leaf(uint64_t container_index, uint8_t typecode) {
     return (container_index << 8) | typecode;
 }
 
-static inline uint8_t get_typecode(leaf_t leaf) { return (uint8_t)leaf; }
+static inline bool is_inline_leaf(leaf_t leaf) {
+    return (leaf & INLINE_LEAF_FLAG) != 0;
+}
+
+// Inline leaves behave as array containers.
+static inline uint8_t get_typecode(leaf_t leaf) {
+    return is_inline_leaf(leaf) ? ARRAY_CONTAINER_TYPE : (uint8_t)leaf;
+}
 
 static inline uint64_t get_index(leaf_t leaf) { return leaf >> 8; }
 
 static inline container_t *get_container(const roaring64_bitmap_t *r,
                                          leaf_t leaf) {
+    assert(!is_inline_leaf(leaf));
     return r->containers[get_index(leaf)];
 }
 
+static inline int32_t inline_leaf_cardinality(leaf_t leaf) {
+    return (int32_t)(leaf & 0x3);
+}
+
+static inline uint16_t inline_leaf_value(leaf_t leaf, int32_t i) {
+    return (uint16_t)(leaf >> (16 * (i + 1)));
+}
+
+// Expects 1 to INLINE_LEAF_MAX sorted values.
+static inline leaf_t create_inline_leaf(const uint16_t *values, int32_t n) {
+    leaf_t leaf = INLINE_LEAF_FLAG | (leaf_t)n;
+    for (int32_t i = 0; i < n; i++) {
+        leaf |= (leaf_t)values[i] << (16 * (i + 1));
+    }
+    return leaf;
+}
+
+static inline bool inline_leaf_contains(leaf_t leaf, uint16_t val) {
+    int32_t n = inline_leaf_cardinality(leaf);
+    for (int32_t i = 0; i < n; i++) {
+        if (inline_leaf_value(leaf, i) == val) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Adds the value to the inline leaf. Returns false if the leaf is full and
+// doesn't contain the value yet.
+static bool inline_leaf_add(leaf_t *leaf, uint16_t val) {
+    int32_t n = inline_leaf_cardinality(*leaf);
+    uint16_t values[INLINE_LEAF_MAX + 1];
+    int32_t pos = 0;
+    for (int32_t i = 0; i < n; i++) {
+        uint16_t v = inline_leaf_value(*leaf, i);
+        if (v == val) {
+            return true;
+        }
+        if (v < val) {
+            values[pos++] = v;
+        } else {
+            values[i + 1] = v;
+        }
+    }
+    if (n == INLINE_LEAF_MAX) {
+        return false;
+    }
+    values[pos] = val;
+    *leaf = create_inline_leaf(values, n + 1);
+    return true;
+}
+
+// Removes the value from the inline leaf, which is left with no values if it
+// held only this one. Returns false if the value was not present.
+static bool inline_leaf_remove(leaf_t *leaf, uint16_t val) {
+    int32_t n = inline_leaf_cardinality(*leaf);
+    uint16_t values[INLINE_LEAF_MAX];
+    int32_t kept = 0;
+    for (int32_t i = 0; i < n; i++) {
+        uint16_t v = inline_leaf_value(*leaf, i);
+        if (v != val) {
+            values[kept++] = v;
+        }
+    }
+    if (kept == n) {
+        return false;
+    }
+    *leaf = kept == 0 ? (leaf_t)INLINE_LEAF_FLAG
+                      : create_inline_leaf(values, kept);
+    return true;
+}
+
+// Array container standing in for an inline leaf, see leaf_container. The
+// values are kept in the inline storage of the container.
+typedef array_container_t leaf_view_t;
+CROARING_STATIC_ASSERT(INLINE_LEAF_MAX <= ARRAY_CONTAINER_INLINE_SIZE,
+                       "inline leaves must fit in an inline array container");
+
+// Returns the container of the leaf. The container of an inline leaf is
+// built in `view`, it must only be read and not outlive the view.
+static inline container_t *leaf_container(const roaring64_bitmap_t *r,
+                                          leaf_t leaf, leaf_view_t *view) {
+    if (!is_inline_leaf(leaf)) {
+        return get_container(r, leaf);
+    }
+    int32_t n = inline_leaf_cardinality(leaf);
+    for (int32_t i = 0; i < n; i++) {
+        view->inline_array[i] = inline_leaf_value(leaf, i);
+    }
+    view->cardinality = n;
+    view->capacity = ARRAY_CONTAINER_INLINE_SIZE;
+    view->array = view->inline_array;
+    return view;
+}
+
+// Returns true and sets *leaf to an inline leaf holding the values of the
+// container if it is small enough. The container is left untouched.
+static inline bool inline_leaf_of(const container_t *c, uint8_t typecode,
+                                  leaf_t *leaf) {
+    if (typecode != ARRAY_CONTAINER_TYPE) {
+        return false;
+    }
+    const array_container_t *ac = const_CAST_array(c);
+    if (ac->cardinality == 0 || ac->cardinality > INLINE_LEAF_MAX) {
+        return false;
+    }
+    *leaf = create_inline_leaf(ac->array, ac->cardinality);
+    return true;
+}
+
 // Replaces the container of `leaf` with the given container. Returns the
 // modified leaf for convenience.
 static inline leaf_t replace_container(roaring64_bitmap_t *r, leaf_t *leaf,
@@ -128,8 +281,9 @@ static void extend_containers(roaring64_bitmap_t *r) {
         new_capacity = 5 * r->capacity / 4;
     }
     uint64_t increase = new_capacity - r->capacity;
-    r->containers = (container_t **)roaring_realloc(
-        r->containers, new_capacity * sizeof(container_t *));
+    r->containers = (container_t **)roaring_realloc_at(
+        ROARING_ALLOCATION_ART, r->containers,
+        new_capacity * sizeof(container_t *));
     memset(r->containers + r->capacity, 0, increase * sizeof(container_t *));
     r->capacity = new_capacity;
 }
@@ -152,14 +306,28 @@ static uint64_t allocate_index(roaring64_bitmap_t *r) {
     return first_free;
 }
 
-static leaf_t add_container(roaring64_bitmap_t *r, container_t *container,
-                            uint8_t typecode) {
+static leaf_t store_container(roaring64_bitmap_t *r, container_t *container,
+                              uint8_t typecode) {
     uint64_t index = allocate_index(r);
     r->containers[index] = container;
     return create_leaf(index, typecode);
 }
 
+// Takes ownership of the container, which is freed if it can be kept inline.
+static leaf_t add_container(roaring64_bitmap_t *r, container_t *container,
+                            uint8_t typecode) {
+    leaf_t leaf;
+    if (inline_leaf_of(container, typecode, &leaf)) {
+        container_free(container, typecode);
+        return leaf;
+    }
+    return store_container(r, container, typecode);
+}
+
 static void remove_container(roaring64_bitmap_t *r, leaf_t leaf) {
+    if (is_inline_leaf(leaf)) {
+        return;
+    }
     uint64_t index = get_index(leaf);
     r->containers[index] = NULL;
     if (index < r->first_free) {
@@ -167,10 +335,96 @@ static void remove_container(roaring64_bitmap_t *r, leaf_t leaf) {
     }
 }
 
+// Frees the container of the leaf, if it has one, and its slot.
+static inline void free_leaf_container(roaring64_bitmap_t *r, leaf_t leaf) {
+    if (!is_inline_leaf(leaf)) {
+        container_free(get_container(r, leaf), get_typecode(leaf));
+        remove_container(r, leaf);
+    }
+}
+
+// Moves the values of an inline leaf to an array container, so that the
+// container of the leaf can be modified in place.
+static void promote_leaf(roaring64_bitmap_t *r, leaf_t *leaf) {
+    if (!is_inline_leaf(*leaf)) {
+        return;
+    }
+    int32_t n = inline_leaf_cardinality(*leaf);
+    array_container_t *ac =
+        array_container_create_given_capacity(INLINE_LEAF_MAX + 1);
+    for (int32_t i = 0; i < n; i++) {
+        ac->array[i] = inline_leaf_value(*leaf, i);
+    }
+    ac->cardinality = n;
+    *leaf = store_container(r, ac, ARRAY_CONTAINER_TYPE);
+}
+
+// Makes the leaf inline if its container has become small enough.
+static void demote_leaf(roaring64_bitmap_t *r, leaf_t *leaf) {
+    if (is_inline_leaf(*leaf)) {
+        return;
+    }
+    leaf_t inline_leaf;
+    if (inline_leaf_of(get_container(r, *leaf), get_typecode(*leaf),
+                       &inline_leaf)) {
+        free_leaf_container(r, *leaf);
+        *leaf = inline_leaf;
+    }
+}
+
+// Collects leaves in increasing order of their high 48 bits, so that the ART
+// of a bitmap under construction can be built at once with art_bulk_load.
+typedef struct leaf_appender_s {
+    art_key_chunk_t *keys;
+    art_val_t *vals;
+    size_t size;
+    size_t capacity;
+} leaf_appender_t;
+
+static inline void leaf_appender_init(leaf_appender_t *appender) {
+    appender->keys = NULL;
+    appender->vals = NULL;
+    appender->size = 0;
+    appender->capacity = 0;
+}
+
+// The key must be larger than all keys appended before.
+static void leaf_appender_append(leaf_appender_t *appender,
+                                 const art_key_chunk_t key[], leaf_t leaf) {
+    if (appender->size == appender->capacity) {
+        size_t new_capacity =
+            appender->capacity == 0 ? 16 : 2 * appender->capacity;
+        appender->keys = (art_key_chunk_t *)roaring_realloc(
+            appender->keys, new_capacity * ART_KEY_BYTES);
+        appender->vals = (art_val_t *)roaring_realloc(
+            appender->vals, new_capacity * sizeof(art_val_t));
+        appender->capacity = new_capacity;
+    }
+    memcpy(appender->keys + appender->size * ART_KEY_BYTES, key,
+           ART_KEY_BYTES);
+    appender->vals[appender->size++] = (art_val_t)leaf;
+}
+
+// Builds the ART of `r`, which must be empty, from the appended leaves and
+// releases the appender.
+static void leaf_appender_finish(leaf_appender_t *appender,
+                                 roaring64_bitmap_t *r) {
+    art_bulk_load(&r->art, appender->keys, appender->vals, appender->size);
+    roaring_free(appender->keys);
+    roaring_free(appender->vals);
+}
+
 // Copies the container referenced by `leaf` from `r1` to `r2`.
 static inline leaf_t copy_leaf_container(const roaring64_bitmap_t *r1,
                                          roaring64_bitmap_t *r2, leaf_t leaf) {
+    if (is_inline_leaf(leaf)) {
+        return leaf;
+    }
     uint8_t typecode = get_typecode(leaf);
+    leaf_t inline_leaf;
+    if (inline_leaf_of(get_container(r1, leaf), typecode, &inline_leaf)) {
+        return inline_leaf;
+    }
     // get_copy_of_container modifies the typecode passed in.
     container_t *container = get_copy_of_container(
         get_container(r1, leaf), &typecode, /*copy_on_write=*/false);
@@ -182,13 +436,42 @@ static inline int compare_high48(art_key_chunk_t key1[],
     return art_compare_keys(key1, key2);
 }
 
+static inline void set_cached_leaf(roaring64_bitmap_t *r,
+                                   const uint8_t high48[], leaf_t *leaf) {
+    memcpy(r->cached_high48, high48, ART_KEY_BYTES);
+    r->cached_leaf = leaf;
+    r->cached_leaf_version = r->art.leaf_version;
+}
+
+// Finds the leaf for the given high 48 bits, going through the hot leaf cache
+// if it is enabled.
+static inline leaf_t *find_leaf(const roaring64_bitmap_t *r,
+                                const uint8_t high48[]) {
+    if (!r->leaf_cache) {
+        return (leaf_t *)art_find(&r->art, high48);
+    }
+    if (r->cached_leaf != NULL &&
+        r->cached_leaf_version == r->art.leaf_version &&
+        memcmp(r->cached_high48, high48, ART_KEY_BYTES) == 0) {
+        return r->cached_leaf;
+    }
+    leaf_t *leaf = (leaf_t *)art_find(&r->art, high48);
+    if (leaf != NULL) {
+        // The cache is not part of the logical value of the bitmap, which is
+        // why it may be updated through a const pointer.
+        set_cached_leaf((roaring64_bitmap_t *)r, high48, leaf);
+    }
+    return leaf;
+}
+
 static inline bool roaring64_iterator_init_at_leaf_first(
     roaring64_iterator_t *it) {
     it->high48 = combine_key(it->art_it.key, 0);
     leaf_t leaf = (leaf_t)*it->art_it.value;
     uint16_t low16 = 0;
-    it->container_it = container_init_iterator(get_container(it->r, leaf),
-                                               get_typecode(leaf), &low16);
+    leaf_view_t view;
+    it->container_it = container_init_iterator(
+        leaf_container(it->r, leaf, &view), get_typecode(leaf), &low16);
     it->value = it->high48 | low16;
     return (it->has_value = true);
 }
@@ -198,8 +481,9 @@ static inline bool roaring64_iterator_init_at_leaf_last(
     it->high48 = combine_key(it->art_it.key, 0);
     leaf_t leaf = (leaf_t)*it->art_it.value;
     uint16_t low16 = 0;
-    it->container_it = container_init_iterator_last(get_container(it->r, leaf),
-                                                    get_typecode(leaf), &low16);
+    leaf_view_t view;
+    it->container_it = container_init_iterator_last(
+        leaf_container(it->r, leaf, &view), get_typecode(leaf), &low16);
     it->value = it->high48 | low16;
     return (it->has_value = true);
 }
@@ -223,19 +507,57 @@ static inline roaring64_iterator_t *roaring64_iterator_init_at(
 
 roaring64_bitmap_t *roaring64_bitmap_create(void) {
     roaring64_bitmap_t *r =
-        (roaring64_bitmap_t *)roaring_malloc(sizeof(roaring64_bitmap_t));
+        (roaring64_bitmap_t *)roaring_hooks_malloc(sizeof(roaring64_bitmap_t));
     art_init_cleared(&r->art);
     r->flags = 0;
     r->capacity = 0;
     r->first_free = 0;
     r->containers = NULL;
+    r->leaf_cache = false;
+    r->cached_leaf = NULL;
+    r->cached_leaf_version = 0;
+    r->allocator = roaring_allocator_current();
+    roaring_arena_t *arena = roaring_allocator_arena(r->allocator);
+    if (arena != NULL) {
+        roaring_arena_add_bitmap(arena);
+    }
     return r;
 }
 
+roaring64_bitmap_t *roaring64_bitmap_create_with_allocator(
+    const roaring_allocator_t *allocator) {
+    const roaring_allocator_t *previous = roaring_allocator_enter(allocator);
+    roaring64_bitmap_t *r = roaring64_bitmap_create();
+    roaring_allocator_leave(previous);
+    return r;
+}
+
+roaring64_bitmap_t *roaring64_bitmap_create_in_arena(roaring_arena_t *arena) {
+    return roaring64_bitmap_create_with_allocator(
+        roaring_arena_allocator(arena));
+}
+
+bool roaring64_bitmap_get_leaf_cache(const roaring64_bitmap_t *r) {
+    return r->leaf_cache;
+}
+
+void roaring64_bitmap_set_leaf_cache(roaring64_bitmap_t *r, bool enabled) {
+    r->leaf_cache = enabled;
+    r->cached_leaf = NULL;
+}
+
 void roaring64_bitmap_free(roaring64_bitmap_t *r) {
     if (!r) {
         return;
     }
+    roaring_arena_t *arena = roaring_allocator_arena(r->allocator);
+    if (arena != NULL) {
+        // the containers and the ART go with the arena
+        roaring_hooks_free(r);
+        roaring_arena_remove_bitmap(arena);
+        return;
+    }
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
     art_iterator_t it = art_init_iterator(&r->art, /*first=*/true);
     while (it.value != NULL) {
         leaf_t leaf = (leaf_t)*it.value;
@@ -243,7 +565,7 @@ void roaring64_bitmap_free(roaring64_bitmap_t *r) {
             // Only free the container itself, not the buffer-backed contents
             // within.
             roaring_free(get_container(r, leaf));
-        } else {
+        } else if (!is_inline_leaf(leaf)) {
             container_free(get_container(r, leaf), get_typecode(leaf));
         }
         art_iterator_next(&it);
@@ -252,28 +574,36 @@ void roaring64_bitmap_free(roaring64_bitmap_t *r) {
         art_free(&r->art);
     }
     roaring_free(r->containers);
-    roaring_free(r);
+    leave_allocator_of64(r, previous);
+    roaring_hooks_free(r);
 }
 
-roaring64_bitmap_t *roaring64_bitmap_copy(const roaring64_bitmap_t *r) {
+static roaring64_bitmap_t *bitmap64_copy(const roaring64_bitmap_t *r) {
     roaring64_bitmap_t *result = roaring64_bitmap_create();
+    leaf_appender_t appender;
+    leaf_appender_init(&appender);
+    result->leaf_cache = r->leaf_cache;
 
     art_iterator_t it = art_init_iterator((art_t *)&r->art, /*first=*/true);
     while (it.value != NULL) {
-        leaf_t leaf = (leaf_t)*it.value;
-        uint8_t result_typecode = get_typecode(leaf);
-        container_t *result_container = get_copy_of_container(
-            get_container(r, leaf), &result_typecode, /*copy_on_write=*/false);
         leaf_t result_leaf =
-            add_container(result, result_container, result_typecode);
-        art_insert(&result->art, it.key, (art_val_t)result_leaf);
+            copy_leaf_container(r, result, (leaf_t)*it.value);
+        leaf_appender_append(&appender, it.key, result_leaf);
         art_iterator_next(&it);
     }
+    leaf_appender_finish(&appender, result);
     return result;
 }
 
-void roaring64_bitmap_overwrite(roaring64_bitmap_t *dest,
-                                const roaring64_bitmap_t *src) {
+roaring64_bitmap_t *roaring64_bitmap_copy(const roaring64_bitmap_t *r) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
+    roaring64_bitmap_t *answer = bitmap64_copy(r);
+    leave_allocator_of64(r, previous);
+    return answer;
+}
+
+static void bitmap64_overwrite(roaring64_bitmap_t *dest,
+                               const roaring64_bitmap_t *src) {
     if (dest == src) {
         return;
     }
@@ -282,7 +612,9 @@ void roaring64_bitmap_overwrite(roaring64_bitmap_t *dest,
     art_iterator_t it = art_init_iterator(&dest->art, /*first=*/true);
     while (it.value != NULL) {
         leaf_t leaf = (leaf_t)*it.value;
-        container_free(get_container(dest, leaf), get_typecode(leaf));
+        if (!is_inline_leaf(leaf)) {
+            container_free(get_container(dest, leaf), get_typecode(leaf));
+        }
         art_iterator_next(&it);
     }
     art_free(&dest->art);
@@ -290,6 +622,7 @@ void roaring64_bitmap_overwrite(roaring64_bitmap_t *dest,
     // Reinitialize dest.
     art_init_cleared(&dest->art);
     dest->flags = 0;
+    dest->cached_leaf = NULL;
     dest->first_free = 0;
     if (dest->capacity > 0) {
         memset(dest->containers, 0,
@@ -299,24 +632,29 @@ void roaring64_bitmap_overwrite(roaring64_bitmap_t *dest,
     // Copy src's containers into dest.
     it = art_init_iterator((art_t *)&src->art, /*first=*/true);
     while (it.value != NULL) {
-        leaf_t leaf = (leaf_t)*it.value;
-        uint8_t typecode = get_typecode(leaf);
-        container_t *container = get_copy_of_container(
-            get_container(src, leaf), &typecode, /*copy_on_write=*/false);
-        leaf_t dest_leaf = add_container(dest, container, typecode);
+        leaf_t dest_leaf = copy_leaf_container(src, dest, (leaf_t)*it.value);
         art_insert(&dest->art, it.key, (art_val_t)dest_leaf);
         art_iterator_next(&it);
     }
 }
 
+void roaring64_bitmap_overwrite(roaring64_bitmap_t *dest,
+                                const roaring64_bitmap_t *src) {
+    const roaring_allocator_t *previous = enter_allocator_of64(dest);
+    bitmap64_overwrite(dest, src);
+    leave_allocator_of64(dest, previous);
+}
+
 /**
- * Steal the containers from a 32-bit bitmap and insert them into a 64-bit
- * bitmap (with an offset)
+ * Steal the containers from a 32-bit bitmap and append them to a 64-bit
+ * bitmap under construction (with an offset). The keys must be larger than
+ * all keys appended before.
  *
  * After calling this function, the original bitmap will be empty, and the
  * returned bitmap will contain all the values from the original bitmap.
  */
 static void move_from_roaring32_offset(roaring64_bitmap_t *dst,
+                                       leaf_appender_t *appender,
                                        roaring_bitmap_t *src,
                                        uint32_t high_bits) {
     uint64_t key_base = ((uint64_t)high_bits) << 32;
@@ -331,7 +669,7 @@ static void move_from_roaring32_offset(roaring64_bitmap_t *dst,
         uint64_t high48_bits = key_base | ((uint64_t)key << 16);
         split_key(high48_bits, high48);
         leaf_t leaf = add_container(dst, container, typecode);
-        art_insert(&dst->art, high48, (art_val_t)leaf);
+        leaf_appender_append(appender, high48, leaf);
     }
     // We stole all the containers, so leave behind a size of zero
     src->high_low_container.size = 0;
@@ -339,10 +677,19 @@ static void move_from_roaring32_offset(roaring64_bitmap_t *dst,
 
 roaring64_bitmap_t *roaring64_bitmap_move_from_roaring32(
     roaring_bitmap_t *bitmap32) {
+    // the containers move, so the result takes the allocator they come from
+    const roaring_allocator_t *allocator =
+        bitmap32->high_low_container.allocator;
+    const roaring_allocator_t *previous =
+        allocator == NULL ? NULL : roaring_allocator_enter(allocator);
     roaring64_bitmap_t *result = roaring64_bitmap_create();
-
-    move_from_roaring32_offset(result, bitmap32, 0);
-
+    leaf_appender_t appender;
+    leaf_appender_init(&appender);
+    move_from_roaring32_offset(result, &appender, bitmap32, 0);
+    leaf_appender_finish(&appender, result);
+    if (allocator != NULL) {
+        roaring_allocator_leave(previous);
+    }
     return result;
 }
 
@@ -362,6 +709,8 @@ roaring64_bitmap_t *roaring64_bitmap_from_range(uint64_t min, uint64_t max,
         }
         return r;
     }
+    leaf_appender_t appender;
+    leaf_appender_init(&appender);
     do {
         uint64_t high_bits = min & 0xFFFFFFFFFFFF0000;
         uint16_t container_min = min & 0xFFFF;
@@ -374,7 +723,7 @@ roaring64_bitmap_t *roaring64_bitmap_from_range(uint64_t min, uint64_t max,
         uint8_t high48[ART_KEY_BYTES];
         split_key(min, high48);
         leaf_t leaf = add_container(r, container, typecode);
-        art_insert(&r->art, high48, (art_val_t)leaf);
+        leaf_appender_append(&appender, high48, leaf);
 
         uint64_t gap = container_max - container_min + step - 1;
         uint64_t increment = gap - (gap % step);
@@ -383,6 +732,7 @@ roaring64_bitmap_t *roaring64_bitmap_from_range(uint64_t min, uint64_t max,
         }
         min += increment;
     } while (min < max);
+    leaf_appender_finish(&appender, r);
     return r;
 }
 
@@ -398,6 +748,10 @@ static inline leaf_t *containerptr_roaring64_bitmap_add(roaring64_bitmap_t *r,
                                                         uint16_t low16,
                                                         leaf_t *leaf) {
     if (leaf != NULL) {
+        if (is_inline_leaf(*leaf) && inline_leaf_add(leaf, low16)) {
+            return leaf;
+        }
+        promote_leaf(r, leaf);
         uint8_t typecode = get_typecode(*leaf);
         container_t *container = get_container(r, *leaf);
         uint8_t typecode2;
@@ -409,47 +763,67 @@ static inline leaf_t *containerptr_roaring64_bitmap_add(roaring64_bitmap_t *r,
         }
         return leaf;
     } else {
-        array_container_t *ac = array_container_create();
-        uint8_t typecode;
-        container_t *container =
-            container_add(ac, low16, ARRAY_CONTAINER_TYPE, &typecode);
-        assert(ac == container);
-        leaf_t new_leaf = add_container(r, container, typecode);
+        leaf_t new_leaf = create_inline_leaf(&low16, 1);
         return (leaf_t *)art_insert(&r->art, high48, (art_val_t)new_leaf);
     }
 }
 
-void roaring64_bitmap_add(roaring64_bitmap_t *r, uint64_t val) {
+static void bitmap64_add(roaring64_bitmap_t *r, uint64_t val) {
     uint8_t high48[ART_KEY_BYTES];
     uint16_t low16 = split_key(val, high48);
-    leaf_t *leaf = (leaf_t *)art_find(&r->art, high48);
-    containerptr_roaring64_bitmap_add(r, high48, low16, leaf);
+    leaf_t *leaf = find_leaf(r, high48);
+    leaf_t *added_leaf =
+        containerptr_roaring64_bitmap_add(r, high48, low16, leaf);
+    if (leaf == NULL && r->leaf_cache) {
+        set_cached_leaf(r, high48, added_leaf);
+    }
 }
 
-bool roaring64_bitmap_add_checked(roaring64_bitmap_t *r, uint64_t val) {
+void roaring64_bitmap_add(roaring64_bitmap_t *r, uint64_t val) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
+    bitmap64_add(r, val);
+    leave_allocator_of64(r, previous);
+}
+
+static bool bitmap64_add_checked(roaring64_bitmap_t *r, uint64_t val) {
     uint8_t high48[ART_KEY_BYTES];
     uint16_t low16 = split_key(val, high48);
-    leaf_t *leaf = (leaf_t *)art_find(&r->art, high48);
+    leaf_t *leaf = find_leaf(r, high48);
 
+    leaf_view_t view;
     int old_cardinality = 0;
     if (leaf != NULL) {
-        old_cardinality = container_get_cardinality(get_container(r, *leaf),
-                                                    get_typecode(*leaf));
+        old_cardinality = container_get_cardinality(
+            leaf_container(r, *leaf, &view), get_typecode(*leaf));
     }
-    leaf = containerptr_roaring64_bitmap_add(r, high48, low16, leaf);
-    int new_cardinality =
-        container_get_cardinality(get_container(r, *leaf), get_typecode(*leaf));
+    leaf_t *added_leaf =
+        containerptr_roaring64_bitmap_add(r, high48, low16, leaf);
+    if (leaf == NULL && r->leaf_cache) {
+        set_cached_leaf(r, high48, added_leaf);
+    }
+    int new_cardinality = container_get_cardinality(
+        leaf_container(r, *added_leaf, &view), get_typecode(*added_leaf));
     return old_cardinality != new_cardinality;
 }
 
-void roaring64_bitmap_add_bulk(roaring64_bitmap_t *r,
-                               roaring64_bulk_context_t *context,
-                               uint64_t val) {
+bool roaring64_bitmap_add_checked(roaring64_bitmap_t *r, uint64_t val) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
+    bool answer = bitmap64_add_checked(r, val);
+    leave_allocator_of64(r, previous);
+    return answer;
+}
+
+static void bitmap64_add_bulk(roaring64_bitmap_t *r,
+                              roaring64_bulk_context_t *context, uint64_t val) {
     uint8_t high48[ART_KEY_BYTES];
     uint16_t low16 = split_key(val, high48);
     leaf_t *leaf = context->leaf;
     if (leaf != NULL && compare_high48(context->high_bytes, high48) == 0) {
         // We're at a container with the correct high bits.
+        if (is_inline_leaf(*leaf) && inline_leaf_add(leaf, low16)) {
+            return;
+        }
+        promote_leaf(r, leaf);
         uint8_t typecode1 = get_typecode(*leaf);
         container_t *container1 = get_container(r, *leaf);
         uint8_t typecode2;
@@ -469,8 +843,16 @@ void roaring64_bitmap_add_bulk(roaring64_bitmap_t *r,
     }
 }
 
-void roaring64_bitmap_add_many(roaring64_bitmap_t *r, size_t n_args,
-                               const uint64_t *vals) {
+void roaring64_bitmap_add_bulk(roaring64_bitmap_t *r,
+                               roaring64_bulk_context_t *context,
+                               uint64_t val) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
+    bitmap64_add_bulk(r, context, val);
+    leave_allocator_of64(r, previous);
+}
+
+static void bitmap64_add_many(roaring64_bitmap_t *r, size_t n_args,
+                              const uint64_t *vals) {
     if (n_args == 0) {
         return;
     }
@@ -482,11 +864,109 @@ void roaring64_bitmap_add_many(roaring64_bitmap_t *r, size_t n_args,
     }
 }
 
+void roaring64_bitmap_add_many(roaring64_bitmap_t *r, size_t n_args,
+                               const uint64_t *vals) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
+    bitmap64_add_many(r, n_args, vals);
+    leave_allocator_of64(r, previous);
+}
+
+struct roaring64_bitmap_appender_s {
+    roaring64_bitmap_t *r;
+    uint64_t high48;  // high 48 bits of the values held by the builder
+    container_builder_t builder;
+};
+
+roaring64_bitmap_appender_t *roaring64_bitmap_appender_create(
+    roaring64_bitmap_t *r) {
+    roaring64_bitmap_appender_t *a =
+        (roaring64_bitmap_appender_t *)roaring_malloc(
+            sizeof(roaring64_bitmap_appender_t));
+    if (a == NULL) {
+        return NULL;
+    }
+    a->r = r;
+    a->high48 = 0;
+    container_builder_init(&a->builder);
+    return a;
+}
+
+static bool bitmap64_appender_flush(roaring64_bitmap_appender_t *a) {
+    uint8_t typecode;
+    container_t *c = container_builder_finish(&a->builder, &typecode);
+    if (c == NULL) {
+        return false;
+    }
+    roaring64_bitmap_t *r = a->r;
+    uint8_t high48[ART_KEY_BYTES];
+    split_key(a->high48, high48);
+    leaf_t *leaf = (leaf_t *)art_find(&r->art, high48);
+    if (leaf == NULL) {
+        art_insert(&r->art, high48, (art_val_t)add_container(r, c, typecode));
+        return true;
+    }
+    promote_leaf(r, leaf);
+    uint8_t typecode1 = get_typecode(*leaf);
+    container_t *container1 = get_container(r, *leaf);
+    uint8_t typecode2;
+    container_t *container2;
+    if (typecode1 == SHARED_CONTAINER_TYPE) {
+        container2 = container_or(container1, typecode1, c, typecode,
+                                  &typecode2);
+    } else {
+        container2 = container_ior(container1, typecode1, c, typecode,
+                                   &typecode2);
+    }
+    if (container2 != container1) {
+        container_free(container1, typecode1);
+        replace_container(r, leaf, container2, typecode2);
+    }
+    container_free(c, typecode);
+    return true;
+}
+
+bool roaring64_bitmap_appender_flush(roaring64_bitmap_appender_t *a) {
+    if (a->builder.cardinality == 0) {
+        return true;
+    }
+    const roaring_allocator_t *previous = enter_allocator_of64(a->r);
+    bool answer = bitmap64_appender_flush(a);
+    leave_allocator_of64(a->r, previous);
+    return answer;
+}
+
+bool roaring64_bitmap_appender_add(roaring64_bitmap_appender_t *a,
+                                   uint64_t val) {
+    uint64_t high48 = val & ~UINT64_C(0xFFFF);
+    container_builder_t *b = &a->builder;
+    bool flushed = true;
+    if (b->cardinality == 0 || high48 > a->high48) {
+        flushed = roaring64_bitmap_appender_flush(a);
+        a->high48 = high48;
+    } else if (high48 < a->high48 || (uint16_t)val <= b->last) {
+        // out of order: give up on the open container for this value
+        flushed = roaring64_bitmap_appender_flush(a);
+        roaring64_bitmap_add(a->r, val);
+        return flushed;
+    }
+    return container_builder_append(b, (uint16_t)val) && flushed;
+}
+
+void roaring64_bitmap_appender_free(roaring64_bitmap_appender_t *a) {
+    if (a == NULL) {
+        return;
+    }
+    roaring64_bitmap_appender_flush(a);
+    container_builder_clear(&a->builder);
+    roaring_free(a);
+}
+
 static inline void add_range_closed_at(roaring64_bitmap_t *r, art_t *art,
                                        uint8_t *high48, uint16_t min,
                                        uint16_t max) {
     leaf_t *leaf = (leaf_t *)art_find(art, high48);
     if (leaf != NULL) {
+        promote_leaf(r, leaf);
         uint8_t typecode1 = get_typecode(*leaf);
         container_t *container1 = get_container(r, *leaf);
         uint8_t typecode2;
@@ -514,8 +994,8 @@ void roaring64_bitmap_add_range(roaring64_bitmap_t *r, uint64_t min,
     roaring64_bitmap_add_range_closed(r, min, max - 1);
 }
 
-void roaring64_bitmap_add_range_closed(roaring64_bitmap_t *r, uint64_t min,
-                                       uint64_t max) {
+static void bitmap64_add_range_closed(roaring64_bitmap_t *r, uint64_t min,
+                                      uint64_t max) {
     if (min > max) {
         return;
     }
@@ -545,11 +1025,21 @@ void roaring64_bitmap_add_range_closed(roaring64_bitmap_t *r, uint64_t min,
     add_range_closed_at(r, art, max_high48, 0, max_low16);
 }
 
+void roaring64_bitmap_add_range_closed(roaring64_bitmap_t *r, uint64_t min,
+                                       uint64_t max) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
+    bitmap64_add_range_closed(r, min, max);
+    leave_allocator_of64(r, previous);
+}
+
 bool roaring64_bitmap_contains(const roaring64_bitmap_t *r, uint64_t val) {
     uint8_t high48[ART_KEY_BYTES];
     uint16_t low16 = split_key(val, high48);
-    leaf_t *leaf = (leaf_t *)art_find(&r->art, high48);
+    leaf_t *leaf = find_leaf(r, high48);
     if (leaf != NULL) {
+        if (is_inline_leaf(*leaf)) {
+            return inline_leaf_contains(*leaf, low16);
+        }
         return container_contains(get_container(r, *leaf), low16,
                                   get_typecode(*leaf));
     }
@@ -594,6 +1084,8 @@ bool roaring64_bitmap_contains_range_closed(const roaring64_bitmap_t *r,
         }
 
         leaf_t leaf = (leaf_t)*it.value;
+        leaf_view_t view;
+        const container_t *c = leaf_container(r, leaf, &view);
         uint32_t container_min = 0;
         if (compare_high48(it.key, min_high48) == 0) {
             container_min = min_low16;
@@ -606,12 +1098,10 @@ bool roaring64_bitmap_contains_range_closed(const roaring64_bitmap_t *r,
         // For the first and last containers we use container_contains_range,
         // for the intermediate containers we can use container_is_full.
         if (container_min == 0 && container_max == 0xFFFF + 1) {
-            if (!container_is_full(get_container(r, leaf),
-                                   get_typecode(leaf))) {
+            if (!container_is_full(c, get_typecode(leaf))) {
                 return false;
             }
-        } else if (!container_contains_range(get_container(r, leaf),
-                                             container_min, container_max,
+        } else if (!container_contains_range(c, container_min, container_max,
                                              get_typecode(leaf))) {
             return false;
         }
@@ -638,8 +1128,12 @@ bool roaring64_bitmap_contains_bulk(const roaring64_bitmap_t *r,
         context->leaf = leaf;
         memcpy(context->high_bytes, high48, ART_KEY_BYTES);
     }
-    return container_contains(get_container(r, *context->leaf), low16,
-                              get_typecode(*context->leaf));
+    leaf_t leaf = *context->leaf;
+    if (is_inline_leaf(leaf)) {
+        return inline_leaf_contains(leaf, low16);
+    }
+    return container_contains(get_container(r, leaf), low16,
+                              get_typecode(leaf));
 }
 
 bool roaring64_bitmap_select(const roaring64_bitmap_t *r, uint64_t rank,
@@ -648,13 +1142,14 @@ bool roaring64_bitmap_select(const roaring64_bitmap_t *r, uint64_t rank,
     uint64_t start_rank = 0;
     while (it.value != NULL) {
         leaf_t leaf = (leaf_t)*it.value;
-        uint64_t cardinality = container_get_cardinality(get_container(r, leaf),
-                                                         get_typecode(leaf));
+        leaf_view_t view;
+        const container_t *c = leaf_container(r, leaf, &view);
+        uint64_t cardinality = container_get_cardinality(c, get_typecode(leaf));
         if (start_rank + cardinality > rank) {
             uint32_t uint32_start = 0;
             uint32_t uint32_rank = rank - start_rank;
             uint32_t uint32_element = 0;
-            if (container_select(get_container(r, leaf), get_typecode(leaf),
+            if (container_select(c, get_typecode(leaf),
                                  &uint32_start, uint32_rank, &uint32_element)) {
                 *element = combine_key(it.key, (uint16_t)uint32_element);
                 return true;
@@ -675,12 +1170,13 @@ uint64_t roaring64_bitmap_rank(const roaring64_bitmap_t *r, uint64_t val) {
     uint64_t rank = 0;
     while (it.value != NULL) {
         leaf_t leaf = (leaf_t)*it.value;
+        leaf_view_t view;
         int compare_result = compare_high48(it.key, high48);
         if (compare_result < 0) {
-            rank += container_get_cardinality(get_container(r, leaf),
+            rank += container_get_cardinality(leaf_container(r, leaf, &view),
                                               get_typecode(leaf));
         } else if (compare_result == 0) {
-            return rank + container_rank(get_container(r, leaf),
+            return rank + container_rank(leaf_container(r, leaf, &view),
                                          get_typecode(leaf), low16);
         } else {
             return rank;
@@ -699,12 +1195,13 @@ bool roaring64_bitmap_get_index(const roaring64_bitmap_t *r, uint64_t val,
     uint64_t index = 0;
     while (it.value != NULL) {
         leaf_t leaf = (leaf_t)*it.value;
+        leaf_view_t view;
         int compare_result = compare_high48(it.key, high48);
         if (compare_result < 0) {
-            index += container_get_cardinality(get_container(r, leaf),
+            index += container_get_cardinality(leaf_container(r, leaf, &view),
                                                get_typecode(leaf));
         } else if (compare_result == 0) {
-            int index16 = container_get_index(get_container(r, leaf),
+            int index16 = container_get_index(leaf_container(r, leaf, &view),
                                               get_typecode(leaf), low16);
             if (index16 < 0) {
                 return false;
@@ -727,6 +1224,16 @@ static inline bool containerptr_roaring64_bitmap_remove(roaring64_bitmap_t *r,
     if (leaf == NULL) {
         return false;
     }
+    if (is_inline_leaf(*leaf)) {
+        if (!inline_leaf_remove(leaf, low16) ||
+            inline_leaf_cardinality(*leaf) > 0) {
+            return false;
+        }
+        bool erased = art_erase(&r->art, high48, NULL);
+        assert(erased);
+        (void)erased;
+        return true;
+    }
 
     uint8_t typecode = get_typecode(*leaf);
     container_t *container = get_container(r, *leaf);
@@ -745,45 +1252,65 @@ static inline bool containerptr_roaring64_bitmap_remove(roaring64_bitmap_t *r,
         remove_container(r, *leaf);
         return true;
     }
+    demote_leaf(r, leaf);
     return false;
 }
 
-void roaring64_bitmap_remove(roaring64_bitmap_t *r, uint64_t val) {
-    art_t *art = &r->art;
+static void bitmap64_remove(roaring64_bitmap_t *r, uint64_t val) {
     uint8_t high48[ART_KEY_BYTES];
     uint16_t low16 = split_key(val, high48);
 
-    leaf_t *leaf = (leaf_t *)art_find(art, high48);
+    leaf_t *leaf = find_leaf(r, high48);
     containerptr_roaring64_bitmap_remove(r, high48, low16, leaf);
 }
 
-bool roaring64_bitmap_remove_checked(roaring64_bitmap_t *r, uint64_t val) {
-    art_t *art = &r->art;
+void roaring64_bitmap_remove(roaring64_bitmap_t *r, uint64_t val) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
+    bitmap64_remove(r, val);
+    leave_allocator_of64(r, previous);
+}
+
+static bool bitmap64_remove_checked(roaring64_bitmap_t *r, uint64_t val) {
     uint8_t high48[ART_KEY_BYTES];
     uint16_t low16 = split_key(val, high48);
-    leaf_t *leaf = (leaf_t *)art_find(art, high48);
+    leaf_t *leaf = find_leaf(r, high48);
 
     if (leaf == NULL) {
         return false;
     }
-    int old_cardinality =
-        container_get_cardinality(get_container(r, *leaf), get_typecode(*leaf));
+    leaf_view_t view;
+    int old_cardinality = container_get_cardinality(
+        leaf_container(r, *leaf, &view), get_typecode(*leaf));
     if (containerptr_roaring64_bitmap_remove(r, high48, low16, leaf)) {
         return true;
     }
-    int new_cardinality =
-        container_get_cardinality(get_container(r, *leaf), get_typecode(*leaf));
+    int new_cardinality = container_get_cardinality(
+        leaf_container(r, *leaf, &view), get_typecode(*leaf));
     return new_cardinality != old_cardinality;
 }
 
-void roaring64_bitmap_remove_bulk(roaring64_bitmap_t *r,
-                                  roaring64_bulk_context_t *context,
-                                  uint64_t val) {
+bool roaring64_bitmap_remove_checked(roaring64_bitmap_t *r, uint64_t val) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
+    bool answer = bitmap64_remove_checked(r, val);
+    leave_allocator_of64(r, previous);
+    return answer;
+}
+
+static void bitmap64_remove_bulk(roaring64_bitmap_t *r,
+                                 roaring64_bulk_context_t *context,
+                                 uint64_t val) {
     art_t *art = &r->art;
     uint8_t high48[ART_KEY_BYTES];
     uint16_t low16 = split_key(val, high48);
     if (context->leaf != NULL &&
-        compare_high48(context->high_bytes, high48) == 0) {
+        compare_high48(context->high_bytes, high48) == 0 &&
+        is_inline_leaf(*context->leaf)) {
+        if (containerptr_roaring64_bitmap_remove(r, high48, low16,
+                                                 context->leaf)) {
+            context->leaf = NULL;
+        }
+    } else if (context->leaf != NULL &&
+               compare_high48(context->high_bytes, high48) == 0) {
         // We're at a container with the correct high bits.
         uint8_t typecode = get_typecode(*context->leaf);
         container_t *container = get_container(r, *context->leaf);
@@ -802,6 +1329,8 @@ void roaring64_bitmap_remove_bulk(roaring64_bitmap_t *r,
             (void)erased;
             remove_container(r, leaf);
             context->leaf = NULL;
+        } else {
+            demote_leaf(r, context->leaf);
         }
     } else {
         // We're not positioned anywhere yet or the high bits of the key
@@ -813,8 +1342,16 @@ void roaring64_bitmap_remove_bulk(roaring64_bitmap_t *r,
     }
 }
 
-void roaring64_bitmap_remove_many(roaring64_bitmap_t *r, size_t n_args,
-                                  const uint64_t *vals) {
+void roaring64_bitmap_remove_bulk(roaring64_bitmap_t *r,
+                                  roaring64_bulk_context_t *context,
+                                  uint64_t val) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
+    bitmap64_remove_bulk(r, context, val);
+    leave_allocator_of64(r, previous);
+}
+
+static void bitmap64_remove_many(roaring64_bitmap_t *r, size_t n_args,
+                                 const uint64_t *vals) {
     if (n_args == 0) {
         return;
     }
@@ -826,6 +1363,13 @@ void roaring64_bitmap_remove_many(roaring64_bitmap_t *r, size_t n_args,
     }
 }
 
+void roaring64_bitmap_remove_many(roaring64_bitmap_t *r, size_t n_args,
+                                  const uint64_t *vals) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
+    bitmap64_remove_many(r, n_args, vals);
+    leave_allocator_of64(r, previous);
+}
+
 static inline void remove_range_closed_at(roaring64_bitmap_t *r, art_t *art,
                                           uint8_t *high48, uint16_t min,
                                           uint16_t max) {
@@ -833,6 +1377,7 @@ static inline void remove_range_closed_at(roaring64_bitmap_t *r, art_t *art,
     if (leaf == NULL) {
         return;
     }
+    promote_leaf(r, leaf);
     uint8_t typecode = get_typecode(*leaf);
     container_t *container = get_container(r, *leaf);
     uint8_t typecode2;
@@ -847,8 +1392,10 @@ static inline void remove_range_closed_at(roaring64_bitmap_t *r, art_t *art,
             assert(erased);
             (void)erased;
             remove_container(r, *leaf);
+            return;
         }
     }
+    demote_leaf(r, leaf);
 }
 
 void roaring64_bitmap_remove_range(roaring64_bitmap_t *r, uint64_t min,
@@ -859,8 +1406,8 @@ void roaring64_bitmap_remove_range(roaring64_bitmap_t *r, uint64_t min,
     roaring64_bitmap_remove_range_closed(r, min, max - 1);
 }
 
-void roaring64_bitmap_remove_range_closed(roaring64_bitmap_t *r, uint64_t min,
-                                          uint64_t max) {
+static void bitmap64_remove_range_closed(roaring64_bitmap_t *r, uint64_t min,
+                                         uint64_t max) {
     if (min > max) {
         return;
     }
@@ -886,23 +1433,39 @@ void roaring64_bitmap_remove_range_closed(roaring64_bitmap_t *r, uint64_t min,
         bool erased = art_iterator_erase(&it, (art_val_t *)&leaf);
         assert(erased);
         (void)erased;
-        container_free(get_container(r, leaf), get_typecode(leaf));
-        remove_container(r, leaf);
+        free_leaf_container(r, leaf);
     }
     remove_range_closed_at(r, art, max_high48, 0, max_low16);
 }
 
-void roaring64_bitmap_clear(roaring64_bitmap_t *r) {
+void roaring64_bitmap_remove_range_closed(roaring64_bitmap_t *r, uint64_t min,
+                                          uint64_t max) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
+    bitmap64_remove_range_closed(r, min, max);
+    leave_allocator_of64(r, previous);
+}
+
+static void bitmap64_clear(roaring64_bitmap_t *r) {
     roaring64_bitmap_remove_range_closed(r, 0, UINT64_MAX);
 }
 
+void roaring64_bitmap_clear(roaring64_bitmap_t *r) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
+    bitmap64_clear(r);
+    leave_allocator_of64(r, previous);
+}
+
 uint64_t roaring64_bitmap_get_cardinality(const roaring64_bitmap_t *r) {
     art_iterator_t it = art_init_iterator((art_t *)&r->art, /*first=*/true);
     uint64_t cardinality = 0;
     while (it.value != NULL) {
         leaf_t leaf = (leaf_t)*it.value;
-        cardinality += container_get_cardinality(get_container(r, leaf),
-                                                 get_typecode(leaf));
+        if (is_inline_leaf(leaf)) {
+            cardinality += inline_leaf_cardinality(leaf);
+        } else {
+            cardinality += container_get_cardinality(get_container(r, leaf),
+                                                     get_typecode(leaf));
+        }
         art_iterator_next(&it);
     }
     return cardinality;
@@ -941,7 +1504,8 @@ uint64_t roaring64_bitmap_range_closed_cardinality(const roaring64_bitmap_t *r,
 
         leaf_t leaf = (leaf_t)*it.value;
         uint8_t typecode = get_typecode(leaf);
-        container_t *container = get_container(r, leaf);
+        leaf_view_t view;
+        const container_t *container = leaf_container(r, leaf, &view);
         if (max_compare_result == 0) {
             // We're at the max high key, add only the range up to the low
             // 16 bits of max.
@@ -961,6 +1525,86 @@ uint64_t roaring64_bitmap_range_closed_cardinality(const roaring64_bitmap_t *r,
     return cardinality;
 }
 
+// Appends [min, max] to ranges, extending the last range instead when the two
+// touch. Returns false if a new range is needed but ranges is full.
+static inline bool range_runs_append64(roaring64_range_closed_t *ranges,
+                                       size_t *count, size_t max_ranges,
+                                       uint64_t min, uint64_t max) {
+    if (*count > 0 && ranges[*count - 1].max + 1 == min) {
+        ranges[*count - 1].max = max;
+        return true;
+    }
+    if (*count == max_ranges) {
+        return false;
+    }
+    ranges[*count].min = min;
+    ranges[*count].max = max;
+    (*count)++;
+    return true;
+}
+
+size_t roaring64_bitmap_range_runs(const roaring64_bitmap_t *r, uint64_t min,
+                                   uint64_t max,
+                                   roaring64_range_closed_t *ranges,
+                                   size_t max_ranges) {
+    if (min >= max) {
+        return 0;
+    }
+    return roaring64_bitmap_range_closed_runs(r, min, max - 1, ranges,
+                                              max_ranges);
+}
+
+size_t roaring64_bitmap_range_closed_runs(const roaring64_bitmap_t *r,
+                                          uint64_t min, uint64_t max,
+                                          roaring64_range_closed_t *ranges,
+                                          size_t max_ranges) {
+    if (min > max || max_ranges == 0) {
+        return 0;
+    }
+    uint8_t min_high48[ART_KEY_BYTES];
+    uint16_t min_low16 = split_key(min, min_high48);
+    uint8_t max_high48[ART_KEY_BYTES];
+    split_key(max, max_high48);
+
+    size_t count = 0;
+    art_iterator_t it = art_lower_bound((art_t *)&r->art, min_high48);
+    for (; it.value != NULL; art_iterator_next(&it)) {
+        if (compare_high48(it.key, max_high48) > 0) {
+            break;
+        }
+        uint64_t high48 = combine_key(it.key, 0);
+        leaf_t leaf = (leaf_t)*it.value;
+        uint8_t typecode = get_typecode(leaf);
+        leaf_view_t view;
+        const container_t *c = leaf_container(r, leaf, &view);
+        uint16_t value;
+        roaring_container_iterator_t container_it;
+        if (compare_high48(it.key, min_high48) == 0) {
+            if (!container_iterator_lower_bound(c, typecode, &container_it,
+                                                &value, min_low16)) {
+                continue;
+            }
+        } else {
+            container_it = container_init_iterator(c, typecode, &value);
+        }
+        bool has_more = true;
+        while (has_more && (high48 | value) <= max) {
+            uint64_t run_min = high48 | value;
+            uint64_t run_max =
+                high48 | container_iterator_find_run_end(
+                             c, typecode, &container_it, &value, &has_more);
+            if (run_max > max) {
+                run_max = max;
+            }
+            if (!range_runs_append64(ranges, &count, max_ranges, run_min,
+                                     run_max)) {
+                return count;
+            }
+        }
+    }
+    return count;
+}
+
 bool roaring64_bitmap_is_empty(const roaring64_bitmap_t *r) {
     return art_is_empty(&r->art);
 }
@@ -971,8 +1615,9 @@ uint64_t roaring64_bitmap_minimum(const roaring64_bitmap_t *r) {
         return UINT64_MAX;
     }
     leaf_t leaf = (leaf_t)*it.value;
-    return combine_key(
-        it.key, container_minimum(get_container(r, leaf), get_typecode(leaf)));
+    leaf_view_t view;
+    return combine_key(it.key, container_minimum(leaf_container(r, leaf, &view),
+                                                 get_typecode(leaf)));
 }
 
 uint64_t roaring64_bitmap_maximum(const roaring64_bitmap_t *r) {
@@ -981,48 +1626,81 @@ uint64_t roaring64_bitmap_maximum(const roaring64_bitmap_t *r) {
         return 0;
     }
     leaf_t leaf = (leaf_t)*it.value;
-    return combine_key(
-        it.key, container_maximum(get_container(r, leaf), get_typecode(leaf)));
+    leaf_view_t view;
+    return combine_key(it.key, container_maximum(leaf_container(r, leaf, &view),
+                                                 get_typecode(leaf)));
 }
 
-bool roaring64_bitmap_remove_run_compression(roaring64_bitmap_t *r) {
+// Converts the container of the leaf away from run encoding. Returns true if
+// it was a run container.
+static bool remove_run_compression_leaf(roaring64_bitmap_t *r, leaf_t *leaf) {
+    if (get_typecode(*leaf) != RUN_CONTAINER_TYPE) {
+        return false;
+    }
+    run_container_t *run = CAST_run(get_container(r, *leaf));
+    int32_t card = run_container_cardinality(run);
+    uint8_t new_typecode;
+    container_t *new_container =
+        convert_to_bitset_or_array_container(run, card, &new_typecode);
+    run_container_free(run);
+    replace_container(r, leaf, new_container, new_typecode);
+    return true;
+}
+
+// Converts the container of the leaf to its most compact form. Returns true
+// if it became a run container.
+static bool run_optimize_leaf(roaring64_bitmap_t *r, leaf_t *leaf) {
+    if (is_inline_leaf(*leaf)) {
+        // Already takes no space besides the leaf.
+        return false;
+    }
+    uint8_t new_typecode;
+    // We don't need to free the existing container if a new one was
+    // created, convert_run_optimize does that internally.
+    container_t *new_container = convert_run_optimize(
+        get_container(r, *leaf), get_typecode(*leaf), &new_typecode);
+    replace_container(r, leaf, new_container, new_typecode);
+    return new_typecode == RUN_CONTAINER_TYPE;
+}
+
+static bool bitmap64_remove_run_compression(roaring64_bitmap_t *r) {
     art_iterator_t it = art_init_iterator(&r->art, /*first=*/true);
     bool removed = false;
-    while (it.value != NULL) {
-        leaf_t *leaf = (leaf_t *)it.value;
-        if (get_typecode(*leaf) == RUN_CONTAINER_TYPE) {
-            run_container_t *run = CAST_run(get_container(r, *leaf));
-            int32_t card = run_container_cardinality(run);
-            uint8_t new_typecode;
-            container_t *new_container =
-                convert_to_bitset_or_array_container(run, card, &new_typecode);
-            run_container_free(run);
-            replace_container(r, leaf, new_container, new_typecode);
-            removed = true;
-        }
+    while (it.value != NULL) {
+        removed |= remove_run_compression_leaf(r, (leaf_t *)it.value);
         art_iterator_next(&it);
     }
     return removed;
 }
 
-bool roaring64_bitmap_run_optimize(roaring64_bitmap_t *r) {
+bool roaring64_bitmap_remove_run_compression(roaring64_bitmap_t *r) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
+    bool answer = bitmap64_remove_run_compression(r);
+    leave_allocator_of64(r, previous);
+    return answer;
+}
+
+static bool bitmap64_run_optimize(roaring64_bitmap_t *r) {
     art_iterator_t it = art_init_iterator(&r->art, /*first=*/true);
     bool has_run_container = false;
     while (it.value != NULL) {
-        leaf_t *leaf = (leaf_t *)it.value;
-        uint8_t new_typecode;
-        // We don't need to free the existing container if a new one was
-        // created, convert_run_optimize does that internally.
-        container_t *new_container = convert_run_optimize(
-            get_container(r, *leaf), get_typecode(*leaf), &new_typecode);
-        replace_container(r, leaf, new_container, new_typecode);
-        has_run_container |= new_typecode == RUN_CONTAINER_TYPE;
+        has_run_container |= run_optimize_leaf(r, (leaf_t *)it.value);
         art_iterator_next(&it);
     }
     return has_run_container;
 }
 
+bool roaring64_bitmap_run_optimize(roaring64_bitmap_t *r) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
+    bool answer = bitmap64_run_optimize(r);
+    leave_allocator_of64(r, previous);
+    return answer;
+}
+
 static void move_to_shrink(roaring64_bitmap_t *r, leaf_t *leaf) {
+    if (is_inline_leaf(*leaf)) {
+        return;
+    }
     uint64_t idx = get_index(*leaf);
     if (idx < r->first_free) {
         return;
@@ -1037,13 +1715,25 @@ static inline bool is_shrunken(const roaring64_bitmap_t *r) {
     return art_is_shrunken(&r->art) && r->first_free == r->capacity;
 }
 
-size_t roaring64_bitmap_shrink_to_fit(roaring64_bitmap_t *r) {
+// Shrinks the ART and the array of container pointers, and also the
+// containers themselves if shrink_containers is true.
+static size_t shrink_art_and_containers(roaring64_bitmap_t *r,
+                                        bool shrink_containers) {
     size_t freed = art_shrink_to_fit(&r->art);
+    // Containers that can be kept inline are released first, the slots they
+    // leave are filled by the moves below.
     art_iterator_t it = art_init_iterator(&r->art, true);
+    while (it.value != NULL) {
+        demote_leaf(r, (leaf_t *)it.value);
+        art_iterator_next(&it);
+    }
+    it = art_init_iterator(&r->art, true);
     while (it.value != NULL) {
         leaf_t *leaf = (leaf_t *)it.value;
-        freed += container_shrink_to_fit(get_container(r, *leaf),
-                                         get_typecode(*leaf));
+        if (shrink_containers && !is_inline_leaf(*leaf)) {
+            freed += container_shrink_to_fit(get_container(r, *leaf),
+                                             get_typecode(*leaf));
+        }
         move_to_shrink(r, leaf);
         art_iterator_next(&it);
     }
@@ -1052,14 +1742,169 @@ size_t roaring64_bitmap_shrink_to_fit(roaring64_bitmap_t *r) {
     }
     uint64_t new_capacity = r->first_free;
     if (new_capacity < r->capacity) {
-        r->containers = (container_t **)roaring_realloc(
-            r->containers, new_capacity * sizeof(container_t *));
+        r->containers = (container_t **)roaring_realloc_at(
+            ROARING_ALLOCATION_ART, r->containers,
+            new_capacity * sizeof(container_t *));
         freed += (r->capacity - new_capacity) * sizeof(container_t *);
         r->capacity = new_capacity;
     }
     return freed;
 }
 
+static size_t bitmap64_shrink_to_fit(roaring64_bitmap_t *r) {
+    return shrink_art_and_containers(r, /*shrink_containers=*/true);
+}
+
+size_t roaring64_bitmap_shrink_to_fit(roaring64_bitmap_t *r) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
+    size_t answer = bitmap64_shrink_to_fit(r);
+    leave_allocator_of64(r, previous);
+    return answer;
+}
+
+// Fewer leaves than this per task are not worth handing to an executor.
+#define ROARING64_MIN_LEAVES_PER_TASK 64
+
+typedef struct leaf_chunks_s {
+    roaring64_bitmap_t *r;
+    leaf_t **leaves;
+    size_t num_leaves;
+    size_t chunk_size;
+    size_t results[ROARING_MAX_TASKS];
+} leaf_chunks_t;
+
+static void remove_run_compression_leaf_chunk(void *arg, size_t task) {
+    leaf_chunks_t *chunks = (leaf_chunks_t *)arg;
+    size_t begin = task * chunks->chunk_size;
+    size_t end = minimum(begin + chunks->chunk_size, chunks->num_leaves);
+    bool removed = false;
+    for (size_t i = begin; i < end; i++) {
+        removed |= remove_run_compression_leaf(chunks->r, chunks->leaves[i]);
+    }
+    chunks->results[task] = removed;
+}
+
+static void run_optimize_leaf_chunk(void *arg, size_t task) {
+    leaf_chunks_t *chunks = (leaf_chunks_t *)arg;
+    size_t begin = task * chunks->chunk_size;
+    size_t end = minimum(begin + chunks->chunk_size, chunks->num_leaves);
+    bool has_run_container = false;
+    for (size_t i = begin; i < end; i++) {
+        has_run_container |= run_optimize_leaf(chunks->r, chunks->leaves[i]);
+    }
+    chunks->results[task] = has_run_container;
+}
+
+static void shrink_to_fit_leaf_chunk(void *arg, size_t task) {
+    leaf_chunks_t *chunks = (leaf_chunks_t *)arg;
+    size_t begin = task * chunks->chunk_size;
+    size_t end = minimum(begin + chunks->chunk_size, chunks->num_leaves);
+    size_t freed = 0;
+    for (size_t i = begin; i < end; i++) {
+        leaf_t leaf = *chunks->leaves[i];
+        if (!is_inline_leaf(leaf)) {
+            freed += container_shrink_to_fit(get_container(chunks->r, leaf),
+                                             get_typecode(leaf));
+        }
+    }
+    chunks->results[task] = freed;
+}
+
+// Runs task over all the leaves of r, split in chunks, and stores the sum of
+// the per-chunk results in *result. Returns false if memory allocation
+// failed, in which case nothing was done.
+static bool for_each_leaf_chunk(roaring64_bitmap_t *r,
+                                const roaring_executor_t *executor,
+                                roaring_task_fn task, size_t *result) {
+    leaf_chunks_t chunks;
+    chunks.r = r;
+    chunks.num_leaves = 0;
+    art_iterator_t it = art_init_iterator(&r->art, /*first=*/true);
+    while (it.value != NULL) {
+        chunks.num_leaves++;
+        art_iterator_next(&it);
+    }
+    *result = 0;
+    if (chunks.num_leaves == 0) {
+        return true;
+    }
+    chunks.leaves =
+        (leaf_t **)roaring_malloc(chunks.num_leaves * sizeof(leaf_t *));
+    if (chunks.leaves == NULL) {
+        return false;
+    }
+    size_t i = 0;
+    it = art_init_iterator(&r->art, /*first=*/true);
+    while (it.value != NULL) {
+        chunks.leaves[i++] = (leaf_t *)it.value;
+        art_iterator_next(&it);
+    }
+    chunks.chunk_size = roaring_task_chunk_size(chunks.num_leaves,
+                                                ROARING64_MIN_LEAVES_PER_TASK);
+    size_t num_tasks =
+        (chunks.num_leaves + chunks.chunk_size - 1) / chunks.chunk_size;
+    roaring_execute_tasks(executor, num_tasks, task, &chunks);
+    for (size_t t = 0; t < num_tasks; t++) {
+        *result += chunks.results[t];
+    }
+    roaring_free(chunks.leaves);
+    return true;
+}
+
+static bool bitmap64_remove_run_compression_parallel(
+    roaring64_bitmap_t *r, const roaring_executor_t *executor) {
+    size_t removed;
+    if (!for_each_leaf_chunk(r, executor, remove_run_compression_leaf_chunk,
+                             &removed)) {
+        return roaring64_bitmap_remove_run_compression(r);
+    }
+    return removed != 0;
+}
+
+bool roaring64_bitmap_remove_run_compression_parallel(
+    roaring64_bitmap_t *r, const roaring_executor_t *executor) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
+    bool answer = bitmap64_remove_run_compression_parallel(r, executor);
+    leave_allocator_of64(r, previous);
+    return answer;
+}
+
+static bool bitmap64_run_optimize_parallel(roaring64_bitmap_t *r,
+                                           const roaring_executor_t *executor) {
+    size_t has_run_container;
+    if (!for_each_leaf_chunk(r, executor, run_optimize_leaf_chunk,
+                             &has_run_container)) {
+        return roaring64_bitmap_run_optimize(r);
+    }
+    return has_run_container != 0;
+}
+
+bool roaring64_bitmap_run_optimize_parallel(
+    roaring64_bitmap_t *r, const roaring_executor_t *executor) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
+    bool answer = bitmap64_run_optimize_parallel(r, executor);
+    leave_allocator_of64(r, previous);
+    return answer;
+}
+
+static size_t bitmap64_shrink_to_fit_parallel(
+    roaring64_bitmap_t *r, const roaring_executor_t *executor) {
+    size_t freed;
+    if (!for_each_leaf_chunk(r, executor, shrink_to_fit_leaf_chunk, &freed)) {
+        return roaring64_bitmap_shrink_to_fit(r);
+    }
+    // the ART reorganization moves leaves, so it must come last
+    return freed + shrink_art_and_containers(r, /*shrink_containers=*/false);
+}
+
+size_t roaring64_bitmap_shrink_to_fit_parallel(
+    roaring64_bitmap_t *r, const roaring_executor_t *executor) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
+    size_t answer = bitmap64_shrink_to_fit_parallel(r, executor);
+    leave_allocator_of64(r, previous);
+    return answer;
+}
+
 /**
  *  (For advanced users.)
  * Collect statistics about the bitmap
@@ -1073,13 +1918,12 @@ void roaring64_bitmap_statistics(const roaring64_bitmap_t *r,
     art_iterator_t it = art_init_iterator((art_t *)&r->art, true);
     while (it.value != NULL) {
         leaf_t leaf = (leaf_t)*it.value;
+        leaf_view_t view;
+        const container_t *c = leaf_container(r, leaf, &view);
         stat->n_containers++;
-        uint8_t truetype =
-            get_container_type(get_container(r, leaf), get_typecode(leaf));
-        uint32_t card = container_get_cardinality(get_container(r, leaf),
-                                                  get_typecode(leaf));
-        uint32_t sbytes =
-            container_size_in_bytes(get_container(r, leaf), get_typecode(leaf));
+        uint8_t truetype = get_container_type(c, get_typecode(leaf));
+        uint32_t card = container_get_cardinality(c, get_typecode(leaf));
+        uint32_t sbytes = container_size_in_bytes(c, get_typecode(leaf));
         stat->cardinality += card;
         switch (truetype) {
             case BITSET_CONTAINER_TYPE:
@@ -1110,6 +1954,22 @@ static bool roaring64_leaf_internal_validate(const art_val_t val,
                                              void *context) {
     leaf_t leaf = (leaf_t)val;
     roaring64_bitmap_t *r = (roaring64_bitmap_t *)context;
+    if (is_inline_leaf(leaf)) {
+        int32_t n = inline_leaf_cardinality(leaf);
+        // Unused bits must be zero.
+        if ((leaf & 0xFF7C) != 0 || n == 0 ||
+            (n < INLINE_LEAF_MAX && (leaf >> (16 * (n + 1))) != 0)) {
+            *reason = "invalid inline leaf";
+            return false;
+        }
+        for (int32_t i = 1; i < n; i++) {
+            if (inline_leaf_value(leaf, i - 1) >= inline_leaf_value(leaf, i)) {
+                *reason = "inline leaf values not strictly increasing";
+                return false;
+            }
+        }
+        return true;
+    }
     return container_internal_validate(get_container(r, leaf),
                                        get_typecode(leaf), reason);
 }
@@ -1131,8 +1991,11 @@ bool roaring64_bitmap_equals(const roaring64_bitmap_t *r1,
         }
         leaf_t leaf1 = (leaf_t)*it1.value;
         leaf_t leaf2 = (leaf_t)*it2.value;
-        if (!container_equals(get_container(r1, leaf1), get_typecode(leaf1),
-                              get_container(r2, leaf2), get_typecode(leaf2))) {
+        leaf_view_t view1, view2;
+        if (!container_equals(leaf_container(r1, leaf1, &view1),
+                              get_typecode(leaf1),
+                              leaf_container(r2, leaf2, &view2),
+                              get_typecode(leaf2))) {
             return false;
         }
         art_iterator_next(&it1);
@@ -1155,9 +2018,11 @@ bool roaring64_bitmap_is_subset(const roaring64_bitmap_t *r1,
             if (compare_result == 0) {
                 leaf_t leaf1 = (leaf_t)*it1.value;
                 leaf_t leaf2 = (leaf_t)*it2.value;
+                leaf_view_t view1, view2;
                 if (!container_is_subset(
-                        get_container(r1, leaf1), get_typecode(leaf1),
-                        get_container(r2, leaf2), get_typecode(leaf2))) {
+                        leaf_container(r1, leaf1, &view1), get_typecode(leaf1),
+                        leaf_container(r2, leaf2, &view2),
+                        get_typecode(leaf2))) {
                     return false;
                 }
                 art_iterator_next(&it1);
@@ -1180,9 +2045,11 @@ bool roaring64_bitmap_is_strict_subset(const roaring64_bitmap_t *r1,
            roaring64_bitmap_is_subset(r1, r2);
 }
 
-roaring64_bitmap_t *roaring64_bitmap_and(const roaring64_bitmap_t *r1,
-                                         const roaring64_bitmap_t *r2) {
+static roaring64_bitmap_t *bitmap64_and(const roaring64_bitmap_t *r1,
+                                        const roaring64_bitmap_t *r2) {
     roaring64_bitmap_t *result = roaring64_bitmap_create();
+    leaf_appender_t appender;
+    leaf_appender_init(&appender);
 
     art_iterator_t it1 = art_init_iterator((art_t *)&r1->art, /*first=*/true);
     art_iterator_t it2 = art_init_iterator((art_t *)&r2->art, /*first=*/true);
@@ -1197,16 +2064,17 @@ roaring64_bitmap_t *roaring64_bitmap_and(const roaring64_bitmap_t *r1,
             // Case 2: iterators at the same high key position.
             leaf_t leaf1 = (leaf_t)*it1.value;
             leaf_t leaf2 = (leaf_t)*it2.value;
+            leaf_view_t view1, view2;
             uint8_t result_typecode;
-            container_t *result_container =
-                container_and(get_container(r1, leaf1), get_typecode(leaf1),
-                              get_container(r2, leaf2), get_typecode(leaf2),
-                              &result_typecode);
+            container_t *result_container = container_and(
+                leaf_container(r1, leaf1, &view1), get_typecode(leaf1),
+                leaf_container(r2, leaf2, &view2), get_typecode(leaf2),
+                &result_typecode);
             if (container_nonzero_cardinality(result_container,
                                               result_typecode)) {
                 leaf_t result_leaf =
                     add_container(result, result_container, result_typecode);
-                art_insert(&result->art, it1.key, (art_val_t)result_leaf);
+                leaf_appender_append(&appender, it1.key, result_leaf);
             } else {
                 container_free(result_container, result_typecode);
             }
@@ -1220,9 +2088,18 @@ roaring64_bitmap_t *roaring64_bitmap_and(const roaring64_bitmap_t *r1,
             art_iterator_lower_bound(&it2, it1.key);
         }
     }
+    leaf_appender_finish(&appender, result);
     return result;
 }
 
+roaring64_bitmap_t *roaring64_bitmap_and(const roaring64_bitmap_t *r1,
+                                         const roaring64_bitmap_t *r2) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r1);
+    roaring64_bitmap_t *answer = bitmap64_and(r1, r2);
+    leave_allocator_of64(r1, previous);
+    return answer;
+}
+
 uint64_t roaring64_bitmap_and_cardinality(const roaring64_bitmap_t *r1,
                                           const roaring64_bitmap_t *r2) {
     uint64_t result = 0;
@@ -1240,9 +2117,10 @@ uint64_t roaring64_bitmap_and_cardinality(const roaring64_bitmap_t *r1,
             // Case 2: iterators at the same high key position.
             leaf_t leaf1 = (leaf_t)*it1.value;
             leaf_t leaf2 = (leaf_t)*it2.value;
+            leaf_view_t view1, view2;
             result += container_and_cardinality(
-                get_container(r1, leaf1), get_typecode(leaf1),
-                get_container(r2, leaf2), get_typecode(leaf2));
+                leaf_container(r1, leaf1, &view1), get_typecode(leaf1),
+                leaf_container(r2, leaf2, &view2), get_typecode(leaf2));
             art_iterator_next(&it1);
             art_iterator_next(&it2);
         } else if (compare_result < 0) {
@@ -1257,8 +2135,8 @@ uint64_t roaring64_bitmap_and_cardinality(const roaring64_bitmap_t *r1,
 }
 
 // Inplace and (modifies its first argument).
-void roaring64_bitmap_and_inplace(roaring64_bitmap_t *r1,
-                                  const roaring64_bitmap_t *r2) {
+static void bitmap64_and_inplace(roaring64_bitmap_t *r1,
+                                 const roaring64_bitmap_t *r2) {
     if (r1 == r2) {
         return;
     }
@@ -1287,18 +2165,20 @@ void roaring64_bitmap_and_inplace(roaring64_bitmap_t *r1,
                 // copy and then doing the computation in place which is
                 // likely less efficient than avoiding in place entirely and
                 // always generating a new container.
+                promote_leaf(r1, leaf1);
                 uint8_t typecode = get_typecode(*leaf1);
                 container_t *container = get_container(r1, *leaf1);
+                leaf_view_t view2;
+                const container_t *c2 = leaf_container(r2, leaf2, &view2);
                 uint8_t typecode2;
                 container_t *container2;
                 if (typecode == SHARED_CONTAINER_TYPE) {
-                    container2 = container_and(container, typecode,
-                                               get_container(r2, leaf2),
+                    container2 = container_and(container, typecode, c2,
                                                get_typecode(leaf2), &typecode2);
                 } else {
-                    container2 = container_iand(
-                        container, typecode, get_container(r2, leaf2),
-                        get_typecode(leaf2), &typecode2);
+                    container2 = container_iand(container, typecode, c2,
+                                                get_typecode(leaf2),
+                                                &typecode2);
                 }
 
                 if (container2 != container) {
@@ -1312,6 +2192,7 @@ void roaring64_bitmap_and_inplace(roaring64_bitmap_t *r1,
                     if (container2 != container) {
                         replace_container(r1, leaf1, container2, typecode2);
                     }
+                    demote_leaf(r1, leaf1);
                     // Only advance the iterator if we didn't delete the
                     // leaf, as erasing advances by itself.
                     art_iterator_next(&it1);
@@ -1326,8 +2207,7 @@ void roaring64_bitmap_and_inplace(roaring64_bitmap_t *r1,
             bool erased = art_iterator_erase(&it1, (art_val_t *)&leaf);
             assert(erased);
             (void)erased;
-            container_free(get_container(r1, leaf), get_typecode(leaf));
-            remove_container(r1, leaf);
+            free_leaf_container(r1, leaf);
         } else if (compare_result > 0) {
             // Case 2c: it1 is after it2.
             art_iterator_lower_bound(&it2, it1.key);
@@ -1335,6 +2215,13 @@ void roaring64_bitmap_and_inplace(roaring64_bitmap_t *r1,
     }
 }
 
+void roaring64_bitmap_and_inplace(roaring64_bitmap_t *r1,
+                                  const roaring64_bitmap_t *r2) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r1);
+    bitmap64_and_inplace(r1, r2);
+    leave_allocator_of64(r1, previous);
+}
+
 bool roaring64_bitmap_intersect(const roaring64_bitmap_t *r1,
                                 const roaring64_bitmap_t *r2) {
     bool intersect = false;
@@ -1351,9 +2238,10 @@ bool roaring64_bitmap_intersect(const roaring64_bitmap_t *r1,
             // Case 2: iterators at the same high key position.
             leaf_t leaf1 = (leaf_t)*it1.value;
             leaf_t leaf2 = (leaf_t)*it2.value;
+            leaf_view_t view1, view2;
             intersect |= container_intersect(
-                get_container(r1, leaf1), get_typecode(leaf1),
-                get_container(r2, leaf2), get_typecode(leaf2));
+                leaf_container(r1, leaf1, &view1), get_typecode(leaf1),
+                leaf_container(r2, leaf2, &view2), get_typecode(leaf2));
             art_iterator_next(&it1);
             art_iterator_next(&it2);
         } else if (compare_result < 0) {
@@ -1389,9 +2277,11 @@ double roaring64_bitmap_jaccard_index(const roaring64_bitmap_t *r1,
     return (double)inter / (double)(c1 + c2 - inter);
 }
 
-roaring64_bitmap_t *roaring64_bitmap_or(const roaring64_bitmap_t *r1,
-                                        const roaring64_bitmap_t *r2) {
+static roaring64_bitmap_t *bitmap64_or(const roaring64_bitmap_t *r1,
+                                       const roaring64_bitmap_t *r2) {
     roaring64_bitmap_t *result = roaring64_bitmap_create();
+    leaf_appender_t appender;
+    leaf_appender_init(&appender);
 
     art_iterator_t it1 = art_init_iterator((art_t *)&r1->art, /*first=*/true);
     art_iterator_t it2 = art_init_iterator((art_t *)&r2->art, /*first=*/true);
@@ -1414,14 +2304,15 @@ roaring64_bitmap_t *roaring64_bitmap_or(const roaring64_bitmap_t *r1,
                 // Case 3b: iterators at the same high key position.
                 leaf_t leaf1 = (leaf_t)*it1.value;
                 leaf_t leaf2 = (leaf_t)*it2.value;
+                leaf_view_t view1, view2;
                 uint8_t result_typecode;
-                container_t *result_container =
-                    container_or(get_container(r1, leaf1), get_typecode(leaf1),
-                                 get_container(r2, leaf2), get_typecode(leaf2),
-                                 &result_typecode);
+                container_t *result_container = container_or(
+                    leaf_container(r1, leaf1, &view1), get_typecode(leaf1),
+                    leaf_container(r2, leaf2, &view2), get_typecode(leaf2),
+                    &result_typecode);
                 leaf_t result_leaf =
                     add_container(result, result_container, result_typecode);
-                art_insert(&result->art, it1.key, (art_val_t)result_leaf);
+                leaf_appender_append(&appender, it1.key, result_leaf);
                 art_iterator_next(&it1);
                 art_iterator_next(&it2);
             }
@@ -1430,19 +2321,28 @@ roaring64_bitmap_t *roaring64_bitmap_or(const roaring64_bitmap_t *r1,
             // Cases 1 and 3a: it1 is the only iterator or is before it2.
             leaf_t result_leaf =
                 copy_leaf_container(r1, result, (leaf_t)*it1.value);
-            art_insert(&result->art, it1.key, (art_val_t)result_leaf);
+            leaf_appender_append(&appender, it1.key, result_leaf);
             art_iterator_next(&it1);
         } else if ((!it1_present && it2_present) || compare_result > 0) {
             // Cases 2 and 3c: it2 is the only iterator or is before it1.
             leaf_t result_leaf =
                 copy_leaf_container(r2, result, (leaf_t)*it2.value);
-            art_insert(&result->art, it2.key, (art_val_t)result_leaf);
+            leaf_appender_append(&appender, it2.key, result_leaf);
             art_iterator_next(&it2);
         }
     }
+    leaf_appender_finish(&appender, result);
     return result;
 }
 
+roaring64_bitmap_t *roaring64_bitmap_or(const roaring64_bitmap_t *r1,
+                                        const roaring64_bitmap_t *r2) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r1);
+    roaring64_bitmap_t *answer = bitmap64_or(r1, r2);
+    leave_allocator_of64(r1, previous);
+    return answer;
+}
+
 uint64_t roaring64_bitmap_or_cardinality(const roaring64_bitmap_t *r1,
                                          const roaring64_bitmap_t *r2) {
     uint64_t c1 = roaring64_bitmap_get_cardinality(r1);
@@ -1451,8 +2351,8 @@ uint64_t roaring64_bitmap_or_cardinality(const roaring64_bitmap_t *r1,
     return c1 + c2 - inter;
 }
 
-void roaring64_bitmap_or_inplace(roaring64_bitmap_t *r1,
-                                 const roaring64_bitmap_t *r2) {
+static void bitmap64_or_inplace(roaring64_bitmap_t *r1,
+                                const roaring64_bitmap_t *r2) {
     if (r1 == r2) {
         return;
     }
@@ -1477,23 +2377,25 @@ void roaring64_bitmap_or_inplace(roaring64_bitmap_t *r1,
                 // Case 3b: iterators at the same high key position.
                 leaf_t *leaf1 = (leaf_t *)it1.value;
                 leaf_t leaf2 = (leaf_t)*it2.value;
+                promote_leaf(r1, leaf1);
                 uint8_t typecode1 = get_typecode(*leaf1);
                 container_t *container1 = get_container(r1, *leaf1);
+                leaf_view_t view2;
+                const container_t *c2 = leaf_container(r2, leaf2, &view2);
                 uint8_t typecode2;
                 container_t *container2;
                 if (get_typecode(*leaf1) == SHARED_CONTAINER_TYPE) {
-                    container2 = container_or(container1, typecode1,
-                                              get_container(r2, leaf2),
+                    container2 = container_or(container1, typecode1, c2,
                                               get_typecode(leaf2), &typecode2);
                 } else {
-                    container2 = container_ior(container1, typecode1,
-                                               get_container(r2, leaf2),
+                    container2 = container_ior(container1, typecode1, c2,
                                                get_typecode(leaf2), &typecode2);
                 }
                 if (container2 != container1) {
                     container_free(container1, typecode1);
                     replace_container(r1, leaf1, container2, typecode2);
                 }
+                demote_leaf(r1, leaf1);
                 art_iterator_next(&it1);
                 art_iterator_next(&it2);
             }
@@ -1511,9 +2413,18 @@ void roaring64_bitmap_or_inplace(roaring64_bitmap_t *r1,
     }
 }
 
-roaring64_bitmap_t *roaring64_bitmap_xor(const roaring64_bitmap_t *r1,
-                                         const roaring64_bitmap_t *r2) {
+void roaring64_bitmap_or_inplace(roaring64_bitmap_t *r1,
+                                 const roaring64_bitmap_t *r2) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r1);
+    bitmap64_or_inplace(r1, r2);
+    leave_allocator_of64(r1, previous);
+}
+
+static roaring64_bitmap_t *bitmap64_xor(const roaring64_bitmap_t *r1,
+                                        const roaring64_bitmap_t *r2) {
     roaring64_bitmap_t *result = roaring64_bitmap_create();
+    leaf_appender_t appender;
+    leaf_appender_init(&appender);
 
     art_iterator_t it1 = art_init_iterator((art_t *)&r1->art, /*first=*/true);
     art_iterator_t it2 = art_init_iterator((art_t *)&r2->art, /*first=*/true);
@@ -1536,16 +2447,17 @@ roaring64_bitmap_t *roaring64_bitmap_xor(const roaring64_bitmap_t *r1,
                 // Case 3b: iterators at the same high key position.
                 leaf_t leaf1 = (leaf_t)*it1.value;
                 leaf_t leaf2 = (leaf_t)*it2.value;
+                leaf_view_t view1, view2;
                 uint8_t result_typecode;
-                container_t *result_container =
-                    container_xor(get_container(r1, leaf1), get_typecode(leaf1),
-                                  get_container(r2, leaf2), get_typecode(leaf2),
-                                  &result_typecode);
+                container_t *result_container = container_xor(
+                    leaf_container(r1, leaf1, &view1), get_typecode(leaf1),
+                    leaf_container(r2, leaf2, &view2), get_typecode(leaf2),
+                    &result_typecode);
                 if (container_nonzero_cardinality(result_container,
                                                   result_typecode)) {
                     leaf_t result_leaf = add_container(result, result_container,
                                                        result_typecode);
-                    art_insert(&result->art, it1.key, (art_val_t)result_leaf);
+                    leaf_appender_append(&appender, it1.key, result_leaf);
                 } else {
                     container_free(result_container, result_typecode);
                 }
@@ -1557,19 +2469,28 @@ roaring64_bitmap_t *roaring64_bitmap_xor(const roaring64_bitmap_t *r1,
             // Cases 1 and 3a: it1 is the only iterator or is before it2.
             leaf_t result_leaf =
                 copy_leaf_container(r1, result, (leaf_t)*it1.value);
-            art_insert(&result->art, it1.key, (art_val_t)result_leaf);
+            leaf_appender_append(&appender, it1.key, result_leaf);
             art_iterator_next(&it1);
         } else if ((!it1_present && it2_present) || compare_result > 0) {
             // Cases 2 and 3c: it2 is the only iterator or is before it1.
             leaf_t result_leaf =
                 copy_leaf_container(r2, result, (leaf_t)*it2.value);
-            art_insert(&result->art, it2.key, (art_val_t)result_leaf);
+            leaf_appender_append(&appender, it2.key, result_leaf);
             art_iterator_next(&it2);
         }
     }
+    leaf_appender_finish(&appender, result);
     return result;
 }
 
+roaring64_bitmap_t *roaring64_bitmap_xor(const roaring64_bitmap_t *r1,
+                                         const roaring64_bitmap_t *r2) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r1);
+    roaring64_bitmap_t *answer = bitmap64_xor(r1, r2);
+    leave_allocator_of64(r1, previous);
+    return answer;
+}
+
 uint64_t roaring64_bitmap_xor_cardinality(const roaring64_bitmap_t *r1,
                                           const roaring64_bitmap_t *r2) {
     uint64_t c1 = roaring64_bitmap_get_cardinality(r1);
@@ -1578,8 +2499,8 @@ uint64_t roaring64_bitmap_xor_cardinality(const roaring64_bitmap_t *r1,
     return c1 + c2 - 2 * inter;
 }
 
-void roaring64_bitmap_xor_inplace(roaring64_bitmap_t *r1,
-                                  const roaring64_bitmap_t *r2) {
+static void bitmap64_xor_inplace(roaring64_bitmap_t *r1,
+                                 const roaring64_bitmap_t *r2) {
     assert(r1 != r2);
     art_iterator_t it1 = art_init_iterator(&r1->art, /*first=*/true);
     art_iterator_t it2 = art_init_iterator((art_t *)&r2->art, /*first=*/true);
@@ -1602,13 +2523,15 @@ void roaring64_bitmap_xor_inplace(roaring64_bitmap_t *r1,
                 // Case 3b: iterators at the same high key position.
                 leaf_t *leaf1 = (leaf_t *)it1.value;
                 leaf_t leaf2 = (leaf_t)*it2.value;
+                promote_leaf(r1, leaf1);
                 uint8_t typecode1 = get_typecode(*leaf1);
                 container_t *container1 = get_container(r1, *leaf1);
+                leaf_view_t view2;
+                const container_t *c2 = leaf_container(r2, leaf2, &view2);
                 uint8_t typecode2;
                 container_t *container2;
                 if (typecode1 == SHARED_CONTAINER_TYPE) {
-                    container2 = container_xor(container1, typecode1,
-                                               get_container(r2, leaf2),
+                    container2 = container_xor(container1, typecode1, c2,
                                                get_typecode(leaf2), &typecode2);
                     if (container2 != container1) {
                         // We only free when doing container_xor, not
@@ -1617,9 +2540,9 @@ void roaring64_bitmap_xor_inplace(roaring64_bitmap_t *r1,
                         container_free(container1, typecode1);
                     }
                 } else {
-                    container2 = container_ixor(
-                        container1, typecode1, get_container(r2, leaf2),
-                        get_typecode(leaf2), &typecode2);
+                    container2 = container_ixor(container1, typecode1, c2,
+                                                get_typecode(leaf2),
+                                                &typecode2);
                 }
 
                 if (!container_nonzero_cardinality(container2, typecode2)) {
@@ -1632,6 +2555,7 @@ void roaring64_bitmap_xor_inplace(roaring64_bitmap_t *r1,
                     if (container2 != container1) {
                         replace_container(r1, leaf1, container2, typecode2);
                     }
+                    demote_leaf(r1, leaf1);
                     // Only advance the iterator if we didn't delete the
                     // leaf, as erasing advances by itself.
                     art_iterator_next(&it1);
@@ -1657,9 +2581,270 @@ void roaring64_bitmap_xor_inplace(roaring64_bitmap_t *r1,
     }
 }
 
-roaring64_bitmap_t *roaring64_bitmap_andnot(const roaring64_bitmap_t *r1,
-                                            const roaring64_bitmap_t *r2) {
+void roaring64_bitmap_xor_inplace(roaring64_bitmap_t *r1,
+                                  const roaring64_bitmap_t *r2) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r1);
+    bitmap64_xor_inplace(r1, r2);
+    leave_allocator_of64(r1, previous);
+}
+
+// Min-heap of iterator indices, ordered by the high 48 bits the iterators
+// point at. Used to merge the ART iterators of many bitmaps in key order.
+typedef struct art_iterator_heap_s {
+    art_iterator_t *its;
+    size_t *heap;
+    size_t size;
+} art_iterator_heap_t;
+
+static inline bool art_iterator_heap_less(art_iterator_heap_t *h, size_t i,
+                                          size_t j) {
+    return compare_high48(h->its[h->heap[i]].key, h->its[h->heap[j]].key) < 0;
+}
+
+static inline void art_iterator_heap_swap(art_iterator_heap_t *h, size_t i,
+                                          size_t j) {
+    size_t tmp = h->heap[i];
+    h->heap[i] = h->heap[j];
+    h->heap[j] = tmp;
+}
+
+static void art_iterator_heap_push(art_iterator_heap_t *h, size_t it_index) {
+    size_t i = h->size++;
+    h->heap[i] = it_index;
+    while (i > 0 && art_iterator_heap_less(h, i, (i - 1) / 2)) {
+        art_iterator_heap_swap(h, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static size_t art_iterator_heap_pop(art_iterator_heap_t *h) {
+    size_t top = h->heap[0];
+    h->heap[0] = h->heap[--h->size];
+    size_t i = 0;
+    while (true) {
+        size_t smallest = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < h->size && art_iterator_heap_less(h, left, smallest)) {
+            smallest = left;
+        }
+        if (right < h->size && art_iterator_heap_less(h, right, smallest)) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            return top;
+        }
+        art_iterator_heap_swap(h, i, smallest);
+        i = smallest;
+    }
+}
+
+// Computes the union (or the symmetric difference if `is_xor`) of the
+// containers at the current position of the given iterators, which must all
+// be at the same high 48 bits. Returns NULL if the result is empty.
+static container_t *lazy_merge_leaves(const roaring64_bitmap_t **rs,
+                                      const art_iterator_t *its,
+                                      const size_t *group, size_t n_group,
+                                      bool is_xor, uint8_t *typecode) {
+    leaf_t leaf = (leaf_t)*its[group[0]].value;
+    *typecode = get_typecode(leaf);
+    leaf_view_t first_view, view;
+    const container_t *first = container_unwrap_shared(
+        leaf_container(rs[group[0]], leaf, &first_view), typecode);
+    if (n_group == 1) {
+        return container_clone(first, *typecode);
+    }
+    container_t *c;
+    if (is_xor) {
+        leaf_t leaf2 = (leaf_t)*its[group[1]].value;
+        c = container_lazy_xor(first, *typecode,
+                               leaf_container(rs[group[1]], leaf2, &view),
+                               get_typecode(leaf2), typecode);
+        for (size_t i = 2; i < n_group; i++) {
+            leaf_t leaf_i = (leaf_t)*its[group[i]].value;
+            // container_lazy_ixor frees the original if it creates a new one.
+            c = container_lazy_ixor(c, *typecode,
+                                    leaf_container(rs[group[i]], leaf_i, &view),
+                                    get_typecode(leaf_i), typecode);
+        }
+    } else {
+        // Accumulate into a bitset, as roaring_bitmap_lazy_or does with
+        // bitset conversion.
+        if (*typecode == BITSET_CONTAINER_TYPE) {
+            c = container_clone(first, *typecode);
+        } else {
+            c = container_to_bitset((container_t *)first, *typecode);
+            *typecode = BITSET_CONTAINER_TYPE;
+        }
+        for (size_t i = 1; i < n_group; i++) {
+            leaf_t leaf_i = (leaf_t)*its[group[i]].value;
+            uint8_t result_typecode;
+            container_t *result = container_lazy_ior(
+                c, *typecode, leaf_container(rs[group[i]], leaf_i, &view),
+                get_typecode(leaf_i), &result_typecode);
+            if (result != c) {
+                container_free(c, *typecode);
+            }
+            c = result;
+            *typecode = result_typecode;
+        }
+    }
+    c = container_repair_after_lazy(c, typecode);
+    if (!container_nonzero_cardinality(c, *typecode)) {
+        container_free(c, *typecode);
+        return NULL;
+    }
+    return c;
+}
+
+// Shared implementation of roaring64_bitmap_or_many and
+// roaring64_bitmap_xor_many.
+static roaring64_bitmap_t *roaring64_bitmap_lazy_merge_many(
+    size_t number, const roaring64_bitmap_t **rs, bool is_xor) {
+    if (number == 0) {
+        return roaring64_bitmap_create();
+    }
+    if (number == 1) {
+        return roaring64_bitmap_copy(rs[0]);
+    }
+    const roaring_allocator_t *previous = enter_allocator_of64(rs[0]);
+    roaring64_bitmap_t *result = roaring64_bitmap_create();
+    leaf_appender_t appender;
+    leaf_appender_init(&appender);
+    art_iterator_heap_t h;
+    h.its = (art_iterator_t *)roaring_malloc(number * sizeof(art_iterator_t));
+    h.heap = (size_t *)roaring_malloc(2 * number * sizeof(size_t));
+    h.size = 0;
+    // Iterators positioned at the key being merged.
+    size_t *group = h.heap + number;
+    for (size_t i = 0; i < number; i++) {
+        h.its[i] = art_init_iterator((art_t *)&rs[i]->art, /*first=*/true);
+        if (h.its[i].value != NULL) {
+            art_iterator_heap_push(&h, i);
+        }
+    }
+    while (h.size > 0) {
+        size_t n_group = 0;
+        group[n_group++] = art_iterator_heap_pop(&h);
+        art_key_chunk_t *key = h.its[group[0]].key;
+        while (h.size > 0 &&
+               compare_high48(h.its[h.heap[0]].key, key) == 0) {
+            group[n_group++] = art_iterator_heap_pop(&h);
+        }
+        uint8_t typecode;
+        container_t *c =
+            lazy_merge_leaves(rs, h.its, group, n_group, is_xor, &typecode);
+        if (c != NULL) {
+            leaf_t leaf = add_container(result, c, typecode);
+            leaf_appender_append(&appender, key, leaf);
+        }
+        for (size_t i = 0; i < n_group; i++) {
+            if (art_iterator_next(&h.its[group[i]])) {
+                art_iterator_heap_push(&h, group[i]);
+            }
+        }
+    }
+    roaring_free(h.heap);
+    roaring_free(h.its);
+    leaf_appender_finish(&appender, result);
+    leave_allocator_of64(rs[0], previous);
+    return result;
+}
+
+roaring64_bitmap_t *roaring64_bitmap_or_many(size_t number,
+                                             const roaring64_bitmap_t **rs) {
+    return roaring64_bitmap_lazy_merge_many(number, rs, /*is_xor=*/false);
+}
+
+roaring64_bitmap_t *roaring64_bitmap_xor_many(size_t number,
+                                              const roaring64_bitmap_t **rs) {
+    return roaring64_bitmap_lazy_merge_many(number, rs, /*is_xor=*/true);
+}
+
+roaring64_bitmap_t *roaring64_bitmap_and_many(size_t number,
+                                              const roaring64_bitmap_t **rs) {
+    if (number == 0) {
+        return roaring64_bitmap_create();
+    }
+    if (number == 1) {
+        return roaring64_bitmap_copy(rs[0]);
+    }
+    const roaring_allocator_t *previous = enter_allocator_of64(rs[0]);
+    roaring64_bitmap_t *result = roaring64_bitmap_create();
+    leaf_appender_t appender;
+    leaf_appender_init(&appender);
+    art_iterator_t *its =
+        (art_iterator_t *)roaring_malloc(number * sizeof(art_iterator_t));
+    for (size_t i = 0; i < number; i++) {
+        its[i] = art_init_iterator((art_t *)&rs[i]->art, /*first=*/true);
+    }
+    art_key_chunk_t key[ART_KEY_BYTES];
+    bool has_key = its[0].value != NULL;
+    if (has_key) {
+        memcpy(key, its[0].key, ART_KEY_BYTES);
+    }
+    while (has_key) {
+        // Move the iterators round-robin to the lower bound of the largest
+        // key seen, until all of them agree on it.
+        size_t agree = 1;
+        for (size_t i = 1; agree < number; i = (i + 1) % number) {
+            if (!art_iterator_lower_bound(&its[i], key)) {
+                has_key = false;
+                break;
+            }
+            if (compare_high48(its[i].key, key) == 0) {
+                agree++;
+            } else {
+                memcpy(key, its[i].key, ART_KEY_BYTES);
+                agree = 1;
+            }
+        }
+        if (!has_key) {
+            break;
+        }
+        leaf_t leaf1 = (leaf_t)*its[0].value;
+        leaf_t leaf2 = (leaf_t)*its[1].value;
+        leaf_view_t view1, view2;
+        uint8_t typecode;
+        container_t *c = container_and(
+            leaf_container(rs[0], leaf1, &view1), get_typecode(leaf1),
+            leaf_container(rs[1], leaf2, &view2), get_typecode(leaf2),
+            &typecode);
+        for (size_t i = 2;
+             i < number && container_nonzero_cardinality(c, typecode); i++) {
+            leaf_t leaf_i = (leaf_t)*its[i].value;
+            uint8_t typecode2;
+            container_t *c2 = container_iand(
+                c, typecode, leaf_container(rs[i], leaf_i, &view2),
+                get_typecode(leaf_i), &typecode2);
+            if (c2 != c) {
+                container_free(c, typecode);
+            }
+            c = c2;
+            typecode = typecode2;
+        }
+        if (container_nonzero_cardinality(c, typecode)) {
+            leaf_t leaf = add_container(result, c, typecode);
+            leaf_appender_append(&appender, key, leaf);
+        } else {
+            container_free(c, typecode);
+        }
+        has_key = art_iterator_next(&its[0]);
+        if (has_key) {
+            memcpy(key, its[0].key, ART_KEY_BYTES);
+        }
+    }
+    roaring_free(its);
+    leaf_appender_finish(&appender, result);
+    leave_allocator_of64(rs[0], previous);
+    return result;
+}
+
+static roaring64_bitmap_t *bitmap64_andnot(const roaring64_bitmap_t *r1,
+                                           const roaring64_bitmap_t *r2) {
     roaring64_bitmap_t *result = roaring64_bitmap_create();
+    leaf_appender_t appender;
+    leaf_appender_init(&appender);
 
     art_iterator_t it1 = art_init_iterator((art_t *)&r1->art, /*first=*/true);
     art_iterator_t it2 = art_init_iterator((art_t *)&r2->art, /*first=*/true);
@@ -1680,16 +2865,17 @@ roaring64_bitmap_t *roaring64_bitmap_andnot(const roaring64_bitmap_t *r1,
                 leaf_t *leaf1 = (leaf_t *)it1.value;
                 leaf_t leaf2 = (leaf_t)*it2.value;
                 uint8_t result_typecode;
+                leaf_view_t view1, view2;
                 container_t *result_container = container_andnot(
-                    get_container(r1, *leaf1), get_typecode(*leaf1),
-                    get_container(r2, leaf2), get_typecode(leaf2),
+                    leaf_container(r1, *leaf1, &view1), get_typecode(*leaf1),
+                    leaf_container(r2, leaf2, &view2), get_typecode(leaf2),
                     &result_typecode);
 
                 if (container_nonzero_cardinality(result_container,
                                                   result_typecode)) {
                     leaf_t result_leaf = add_container(result, result_container,
                                                        result_typecode);
-                    art_insert(&result->art, it1.key, (art_val_t)result_leaf);
+                    leaf_appender_append(&appender, it1.key, result_leaf);
                 } else {
                     container_free(result_container, result_typecode);
                 }
@@ -1701,16 +2887,25 @@ roaring64_bitmap_t *roaring64_bitmap_andnot(const roaring64_bitmap_t *r1,
             // Cases 1 and 2a: it1 is the only iterator or is before it2.
             leaf_t result_leaf =
                 copy_leaf_container(r1, result, (leaf_t)*it1.value);
-            art_insert(&result->art, it1.key, (art_val_t)result_leaf);
+            leaf_appender_append(&appender, it1.key, result_leaf);
             art_iterator_next(&it1);
         } else if (compare_result > 0) {
             // Case 2c: it1 is after it2.
             art_iterator_next(&it2);
         }
     }
+    leaf_appender_finish(&appender, result);
     return result;
 }
 
+roaring64_bitmap_t *roaring64_bitmap_andnot(const roaring64_bitmap_t *r1,
+                                            const roaring64_bitmap_t *r2) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r1);
+    roaring64_bitmap_t *answer = bitmap64_andnot(r1, r2);
+    leave_allocator_of64(r1, previous);
+    return answer;
+}
+
 uint64_t roaring64_bitmap_andnot_cardinality(const roaring64_bitmap_t *r1,
                                              const roaring64_bitmap_t *r2) {
     uint64_t c1 = roaring64_bitmap_get_cardinality(r1);
@@ -1718,8 +2913,8 @@ uint64_t roaring64_bitmap_andnot_cardinality(const roaring64_bitmap_t *r1,
     return c1 - inter;
 }
 
-void roaring64_bitmap_andnot_inplace(roaring64_bitmap_t *r1,
-                                     const roaring64_bitmap_t *r2) {
+static void bitmap64_andnot_inplace(roaring64_bitmap_t *r1,
+                                    const roaring64_bitmap_t *r2) {
     art_iterator_t it1 = art_init_iterator(&r1->art, /*first=*/true);
     art_iterator_t it2 = art_init_iterator((art_t *)&r2->art, /*first=*/true);
 
@@ -1738,14 +2933,17 @@ void roaring64_bitmap_andnot_inplace(roaring64_bitmap_t *r1,
                 // Case 2b: iterators at the same high key position.
                 leaf_t *leaf1 = (leaf_t *)it1.value;
                 leaf_t leaf2 = (leaf_t)*it2.value;
+                promote_leaf(r1, leaf1);
                 uint8_t typecode1 = get_typecode(*leaf1);
                 container_t *container1 = get_container(r1, *leaf1);
+                leaf_view_t view2;
+                const container_t *c2 = leaf_container(r2, leaf2, &view2);
                 uint8_t typecode2;
                 container_t *container2;
                 if (typecode1 == SHARED_CONTAINER_TYPE) {
-                    container2 = container_andnot(
-                        container1, typecode1, get_container(r2, leaf2),
-                        get_typecode(leaf2), &typecode2);
+                    container2 = container_andnot(container1, typecode1, c2,
+                                                  get_typecode(leaf2),
+                                                  &typecode2);
                     if (container2 != container1) {
                         // We only free when doing container_andnot, not
                         // container_iandnot, as iandnot frees the original
@@ -1753,9 +2951,9 @@ void roaring64_bitmap_andnot_inplace(roaring64_bitmap_t *r1,
                         container_free(container1, typecode1);
                     }
                 } else {
-                    container2 = container_iandnot(
-                        container1, typecode1, get_container(r2, leaf2),
-                        get_typecode(leaf2), &typecode2);
+                    container2 = container_iandnot(container1, typecode1, c2,
+                                                   get_typecode(leaf2),
+                                                   &typecode2);
                 }
 
                 if (!container_nonzero_cardinality(container2, typecode2)) {
@@ -1768,6 +2966,7 @@ void roaring64_bitmap_andnot_inplace(roaring64_bitmap_t *r1,
                     if (container2 != container1) {
                         replace_container(r1, leaf1, container2, typecode2);
                     }
+                    demote_leaf(r1, leaf1);
                     // Only advance the iterator if we didn't delete the
                     // leaf, as erasing advances by itself.
                     art_iterator_next(&it1);
@@ -1785,6 +2984,13 @@ void roaring64_bitmap_andnot_inplace(roaring64_bitmap_t *r1,
     }
 }
 
+void roaring64_bitmap_andnot_inplace(roaring64_bitmap_t *r1,
+                                     const roaring64_bitmap_t *r2) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r1);
+    bitmap64_andnot_inplace(r1, r2);
+    leave_allocator_of64(r1, previous);
+}
+
 /**
  * Flips the leaf at high48 in the range [min, max), adding the result to
  * `r2`. If the high48 key is not found in `r1`, a new container is created.
@@ -1800,13 +3006,15 @@ static void roaring64_flip_leaf(const roaring64_bitmap_t *r1,
         container2 = container_range_of_ones(min, max, &typecode2);
     } else if (min == 0 && max > 0xFFFF) {
         // Flip whole container.
-        container2 = container_not(get_container(r1, *leaf1),
+        leaf_view_t view1;
+        container2 = container_not(leaf_container(r1, *leaf1, &view1),
                                    get_typecode(*leaf1), &typecode2);
     } else {
         // Partially flip a container.
-        container2 =
-            container_not_range(get_container(r1, *leaf1), get_typecode(*leaf1),
-                                min, max, &typecode2);
+        leaf_view_t view1;
+        container2 = container_not_range(leaf_container(r1, *leaf1, &view1),
+                                         get_typecode(*leaf1), min, max,
+                                         &typecode2);
     }
     if (container_nonzero_cardinality(container2, typecode2)) {
         leaf_t leaf2 = add_container(r2, container2, typecode2);
@@ -1834,6 +3042,7 @@ static void roaring64_flip_leaf_inplace(roaring64_bitmap_t *r, uint8_t high48[],
         return;
     }
 
+    promote_leaf(r, leaf);
     if (min == 0 && max > 0xFFFF) {
         // Flip whole container.
         container2 = container_inot(get_container(r, *leaf),
@@ -1846,6 +3055,7 @@ static void roaring64_flip_leaf_inplace(roaring64_bitmap_t *r, uint8_t high48[],
 
     if (container_nonzero_cardinality(container2, typecode2)) {
         replace_container(r, leaf, container2, typecode2);
+        demote_leaf(r, leaf);
     } else {
         bool erased = art_erase(&r->art, high48, NULL);
         assert(erased);
@@ -1863,10 +3073,10 @@ roaring64_bitmap_t *roaring64_bitmap_flip(const roaring64_bitmap_t *r,
     return roaring64_bitmap_flip_closed(r, min, max - 1);
 }
 
-roaring64_bitmap_t *roaring64_bitmap_flip_closed(const roaring64_bitmap_t *r1,
-                                                 uint64_t min, uint64_t max) {
+static roaring64_bitmap_t *bitmap64_flip_closed(const roaring64_bitmap_t *r1,
+                                                uint64_t min, uint64_t max) {
     if (min > max) {
-        return roaring64_bitmap_copy(r1);
+        return bitmap64_copy(r1);
     }
     uint8_t min_high48_key[ART_KEY_BYTES];
     uint16_t min_low16 = split_key(min, min_high48_key);
@@ -1880,11 +3090,7 @@ roaring64_bitmap_t *roaring64_bitmap_flip_closed(const roaring64_bitmap_t *r1,
 
     // Copy the containers before min unchanged.
     while (it.value != NULL && compare_high48(it.key, min_high48_key) < 0) {
-        leaf_t leaf1 = (leaf_t)*it.value;
-        uint8_t typecode2 = get_typecode(leaf1);
-        container_t *container2 = get_copy_of_container(
-            get_container(r1, leaf1), &typecode2, /*copy_on_write=*/false);
-        leaf_t leaf2 = add_container(r2, container2, typecode2);
+        leaf_t leaf2 = copy_leaf_container(r1, r2, (leaf_t)*it.value);
         art_insert(&r2->art, it.key, (art_val_t)leaf2);
         art_iterator_next(&it);
     }
@@ -1912,11 +3118,7 @@ roaring64_bitmap_t *roaring64_bitmap_flip_closed(const roaring64_bitmap_t *r1,
     // Copy the containers after max unchanged.
     it = art_upper_bound((art_t *)&r1->art, max_high48_key);
     while (it.value != NULL) {
-        leaf_t leaf1 = (leaf_t)*it.value;
-        uint8_t typecode2 = get_typecode(leaf1);
-        container_t *container2 = get_copy_of_container(
-            get_container(r1, leaf1), &typecode2, /*copy_on_write=*/false);
-        leaf_t leaf2 = add_container(r2, container2, typecode2);
+        leaf_t leaf2 = copy_leaf_container(r1, r2, (leaf_t)*it.value);
         art_insert(&r2->art, it.key, (art_val_t)leaf2);
         art_iterator_next(&it);
     }
@@ -1924,6 +3126,14 @@ roaring64_bitmap_t *roaring64_bitmap_flip_closed(const roaring64_bitmap_t *r1,
     return r2;
 }
 
+roaring64_bitmap_t *roaring64_bitmap_flip_closed(const roaring64_bitmap_t *r1,
+                                                 uint64_t min, uint64_t max) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r1);
+    roaring64_bitmap_t *answer = bitmap64_flip_closed(r1, min, max);
+    leave_allocator_of64(r1, previous);
+    return answer;
+}
+
 void roaring64_bitmap_flip_inplace(roaring64_bitmap_t *r, uint64_t min,
                                    uint64_t max) {
     if (min >= max) {
@@ -1932,8 +3142,8 @@ void roaring64_bitmap_flip_inplace(roaring64_bitmap_t *r, uint64_t min,
     roaring64_bitmap_flip_closed_inplace(r, min, max - 1);
 }
 
-void roaring64_bitmap_flip_closed_inplace(roaring64_bitmap_t *r, uint64_t min,
-                                          uint64_t max) {
+static void bitmap64_flip_closed_inplace(roaring64_bitmap_t *r, uint64_t min,
+                                         uint64_t max) {
     if (min > max) {
         return;
     }
@@ -1963,10 +3173,17 @@ void roaring64_bitmap_flip_closed_inplace(roaring64_bitmap_t *r, uint64_t min,
     }
 }
 
-roaring64_bitmap_t *roaring64_bitmap_add_offset_signed(
+void roaring64_bitmap_flip_closed_inplace(roaring64_bitmap_t *r, uint64_t min,
+                                          uint64_t max) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
+    bitmap64_flip_closed_inplace(r, min, max);
+    leave_allocator_of64(r, previous);
+}
+
+static roaring64_bitmap_t *bitmap64_add_offset_signed(
     const roaring64_bitmap_t *r, bool positive, uint64_t offset) {
     if (offset == 0) {
-        return roaring64_bitmap_copy(r);
+        return bitmap64_copy(r);
     }
 
     roaring64_bitmap_t *answer = roaring64_bitmap_create();
@@ -2000,11 +3217,7 @@ roaring64_bitmap_t *roaring64_bitmap_add_offset_signed(
             if ((uint64_t)k < (uint64_t)1 << 48) {
                 uint8_t new_high48[ART_KEY_BYTES];
                 split_key((uint64_t)k << 16, new_high48);
-                uint8_t typecode = get_typecode(leaf);
-                container_t *container =
-                    get_copy_of_container(get_container(r, leaf), &typecode,
-                                          /*copy_on_write=*/false);
-                leaf_t new_leaf = add_container(answer, container, typecode);
+                leaf_t new_leaf = copy_leaf_container(r, answer, leaf);
                 art_insert(&answer->art, new_high48, (art_val_t)new_leaf);
             }
             art_iterator_next(&it);
@@ -2036,12 +3249,14 @@ roaring64_bitmap_t *roaring64_bitmap_add_offset_signed(
         }
 
         uint8_t typecode = get_typecode(leaf);
-        const container_t *c =
-            container_unwrap_shared(get_container(r, leaf), &typecode);
+        leaf_view_t view;
+        const container_t *c = container_unwrap_shared(
+            leaf_container(r, leaf, &view), &typecode);
         container_add_offset(c, typecode, lo_ptr, hi_ptr, in_offset);
 
         if (lo != NULL) {
             if (prev_hi_leaf != NULL && prev_hi_k == k) {
+                promote_leaf(answer, prev_hi_leaf);
                 uint8_t existing_type = get_typecode(*prev_hi_leaf);
                 container_t *existing_c = get_container(answer, *prev_hi_leaf);
                 uint8_t merged_type;
@@ -2078,16 +3293,28 @@ roaring64_bitmap_t *roaring64_bitmap_add_offset_signed(
     art_iterator_t repair_it = art_init_iterator(&answer->art, /*first=*/true);
     while (repair_it.value != NULL) {
         leaf_t *leaf_ptr = (leaf_t *)repair_it.value;
-        uint8_t typecode = get_typecode(*leaf_ptr);
-        container_t *repaired = container_repair_after_lazy(
-            get_container(answer, *leaf_ptr), &typecode);
-        replace_container(answer, leaf_ptr, repaired, typecode);
+        if (!is_inline_leaf(*leaf_ptr)) {
+            uint8_t typecode = get_typecode(*leaf_ptr);
+            container_t *repaired = container_repair_after_lazy(
+                get_container(answer, *leaf_ptr), &typecode);
+            replace_container(answer, leaf_ptr, repaired, typecode);
+            demote_leaf(answer, leaf_ptr);
+        }
         art_iterator_next(&repair_it);
     }
 
     return answer;
 }
 
+roaring64_bitmap_t *roaring64_bitmap_add_offset_signed(
+    const roaring64_bitmap_t *r, bool positive, uint64_t offset) {
+    const roaring_allocator_t *previous = enter_allocator_of64(r);
+    roaring64_bitmap_t *answer = 
+        bitmap64_add_offset_signed(r, positive, offset);
+    leave_allocator_of64(r, previous);
+    return answer;
+}
+
 // Returns the number of distinct high 32-bit entries in the bitmap.
 static inline uint64_t count_high32(const roaring64_bitmap_t *r) {
     art_iterator_t it = art_init_iterator((art_t *)&r->art, /*first=*/true);
@@ -2104,10 +3331,20 @@ static inline uint64_t count_high32(const roaring64_bitmap_t *r) {
     return high32_count;
 }
 
+// Makes room for at least `n` leaf views in `*views`, which holds `*capacity`.
+static void reserve_leaf_views(leaf_view_t **views, size_t *capacity,
+                               size_t n) {
+    if (n > *capacity) {
+        roaring_free(*views);
+        *views = (leaf_view_t *)roaring_malloc(n * sizeof(leaf_view_t));
+        *capacity = n;
+    }
+}
+
 // Frees the (32-bit!) bitmap without freeing the containers.
 static inline void roaring_bitmap_free_without_containers(roaring_bitmap_t *r) {
     ra_clear_without_containers(&r->high_low_container);
-    roaring_free(r);
+    roaring_hooks_free(r);
 }
 
 size_t roaring64_bitmap_portable_size_in_bytes(const roaring64_bitmap_t *r) {
@@ -2122,6 +3359,10 @@ size_t roaring64_bitmap_portable_size_in_bytes(const roaring64_bitmap_t *r) {
     art_iterator_t it = art_init_iterator((art_t *)&r->art, /*first=*/true);
     uint32_t prev_high32 = 0;
     roaring_bitmap_t *bitmap32 = NULL;
+    // Containers of the inline leaves of the current bucket.
+    leaf_view_t *views = NULL;
+    size_t views_capacity = 0;
+    size_t views_used = 0;
 
     // Iterate through buckets ordered by increasing keys.
     while (it.value != NULL) {
@@ -2141,20 +3382,25 @@ size_t roaring64_bitmap_portable_size_in_bytes(const roaring64_bitmap_t *r) {
             // Start a new 32-bit bitmap with the current high 32 bits.
             art_iterator_t it2 = it;
             uint32_t containers_with_high32 = 0;
+            size_t inline_with_high32 = 0;
             while (it2.value != NULL && (uint32_t)(combine_key(it2.key, 0) >>
                                                    32) == current_high32) {
                 containers_with_high32++;
+                inline_with_high32 += is_inline_leaf((leaf_t)*it2.value);
                 art_iterator_next(&it2);
             }
             bitmap32 =
                 roaring_bitmap_create_with_capacity(containers_with_high32);
+            reserve_leaf_views(&views, &views_capacity, inline_with_high32);
+            views_used = 0;
 
             prev_high32 = current_high32;
         }
         leaf_t leaf = (leaf_t)*it.value;
+        leaf_view_t *view = is_inline_leaf(leaf) ? &views[views_used++] : NULL;
         ra_append(&bitmap32->high_low_container,
-                  (uint16_t)(current_high32 >> 16), get_container(r, leaf),
-                  get_typecode(leaf));
+                  (uint16_t)(current_high32 >> 16),
+                  leaf_container(r, leaf, view), get_typecode(leaf));
         art_iterator_next(&it);
     }
 
@@ -2167,6 +3413,7 @@ size_t roaring64_bitmap_portable_size_in_bytes(const roaring64_bitmap_t *r) {
         size += roaring_bitmap_portable_size_in_bytes(bitmap32);
         roaring_bitmap_free_without_containers(bitmap32);
     }
+    roaring_free(views);
 
     return size;
 }
@@ -2189,6 +3436,10 @@ size_t roaring64_bitmap_portable_serialize(const roaring64_bitmap_t *r,
     art_iterator_t it = art_init_iterator((art_t *)&r->art, /*first=*/true);
     uint32_t prev_high32 = 0;
     roaring_bitmap_t *bitmap32 = NULL;
+    // Containers of the inline leaves of the current bucket.
+    leaf_view_t *views = NULL;
+    size_t views_capacity = 0;
+    size_t views_used = 0;
 
     // Iterate through buckets ordered by increasing keys.
     while (it.value != NULL) {
@@ -2211,20 +3462,25 @@ size_t roaring64_bitmap_portable_serialize(const roaring64_bitmap_t *r,
             // Start a new 32-bit bitmap with the current high 32 bits.
             art_iterator_t it2 = it;
             uint32_t containers_with_high32 = 0;
-            while (it2.value != NULL &&
-                   (uint32_t)combine_key(it2.key, 0) == current_high32) {
+            size_t inline_with_high32 = 0;
+            while (it2.value != NULL && (uint32_t)(combine_key(it2.key, 0) >>
+                                                   32) == current_high32) {
                 containers_with_high32++;
+                inline_with_high32 += is_inline_leaf((leaf_t)*it2.value);
                 art_iterator_next(&it2);
             }
             bitmap32 =
                 roaring_bitmap_create_with_capacity(containers_with_high32);
+            reserve_leaf_views(&views, &views_capacity, inline_with_high32);
+            views_used = 0;
 
             prev_high32 = current_high32;
         }
         leaf_t leaf = (leaf_t)*it.value;
+        leaf_view_t *view = is_inline_leaf(leaf) ? &views[views_used++] : NULL;
         ra_append(&bitmap32->high_low_container,
-                  (uint16_t)(current_high48 >> 16), get_container(r, leaf),
-                  get_typecode(leaf));
+                  (uint16_t)(current_high48 >> 16),
+                  leaf_container(r, leaf, view), get_typecode(leaf));
         art_iterator_next(&it);
     }
 
@@ -2239,6 +3495,7 @@ size_t roaring64_bitmap_portable_serialize(const roaring64_bitmap_t *r,
         buf += roaring_bitmap_portable_serialize(bitmap32, buf);
         roaring_bitmap_free_without_containers(bitmap32);
     }
+    roaring_free(views);
 
     return buf - initial_buf;
 }
@@ -2315,12 +3572,18 @@ roaring64_bitmap_t *roaring64_bitmap_portable_deserialize_safe(
     }
 
     roaring64_bitmap_t *r = roaring64_bitmap_create();
+    // The buckets are in increasing key order, so the ART is built at once at
+    // the end. On failure the leaves appended so far must still be loaded so
+    // that their containers are freed with the bitmap.
+    leaf_appender_t appender;
+    leaf_appender_init(&appender);
     // Iterate through buckets ordered by increasing keys.
     int64_t previous_high32 = -1;
     for (uint64_t bucket = 0; bucket < buckets; ++bucket) {
         // Read as uint32 the most significant 32 bits of the bucket.
         uint32_t high32;
         if (read_bytes + sizeof(high32) > maxbytes) {
+            leaf_appender_finish(&appender, r);
             roaring64_bitmap_free(r);
             return NULL;
         }
@@ -2330,6 +3593,7 @@ roaring64_bitmap_t *roaring64_bitmap_portable_deserialize_safe(
         read_bytes += sizeof(high32);
         // High 32 bits must be strictly increasing.
         if (high32 <= previous_high32) {
+            leaf_appender_finish(&appender, r);
             roaring64_bitmap_free(r);
             return NULL;
         }
@@ -2340,6 +3604,7 @@ roaring64_bitmap_t *roaring64_bitmap_portable_deserialize_safe(
         size_t bitmap32_size = roaring_bitmap_portable_deserialize_size(
             buf, maxbytes - read_bytes);
         if (bitmap32_size == 0) {
+            leaf_appender_finish(&appender, r);
             roaring64_bitmap_free(r);
             return NULL;
         }
@@ -2347,6 +3612,7 @@ roaring64_bitmap_t *roaring64_bitmap_portable_deserialize_safe(
         roaring_bitmap_t *bitmap32 = roaring_bitmap_portable_deserialize_safe(
             buf, maxbytes - read_bytes);
         if (bitmap32 == NULL) {
+            leaf_appender_finish(&appender, r);
             roaring64_bitmap_free(r);
             return NULL;
         }
@@ -2365,6 +3631,7 @@ roaring64_bitmap_t *roaring64_bitmap_portable_deserialize_safe(
             uint16_t key = bitmap32->high_low_container.keys[i];
             if (key <= last_bitmap_key) {
                 roaring_bitmap_free(bitmap32);
+                leaf_appender_finish(&appender, r);
                 roaring64_bitmap_free(r);
                 return NULL;
             }
@@ -2372,9 +3639,10 @@ roaring64_bitmap_t *roaring64_bitmap_portable_deserialize_safe(
         }
 
         // Insert all containers of the 32-bit bitmap into the 64-bit bitmap.
-        move_from_roaring32_offset(r, bitmap32, high32);
+        move_from_roaring32_offset(r, &appender, bitmap32, high32);
         roaring_bitmap_free(bitmap32);
     }
+    leaf_appender_finish(&appender, r);
     return r;
 }
 
@@ -2429,28 +3697,32 @@ size_t roaring64_bitmap_frozen_size_in_bytes(const roaring64_bitmap_t *r) {
     if (!is_shrunken(r)) {
         return 0;
     }
+    uint64_t total_sizes[4] =
+        CROARING_ZERO_INITIALIZER;  // Indexed by typecode.
+    uint64_t num_inline = 0;
+    art_iterator_t it = art_init_iterator((art_t *)&r->art, /*first=*/true);
+    while (it.value != NULL) {
+        leaf_t leaf = (leaf_t)*it.value;
+        uint8_t typecode = get_typecode(leaf);
+        leaf_view_t view;
+        total_sizes[typecode] += container_get_frozen_size(
+            leaf_container(r, leaf, &view), typecode);
+        num_inline += is_inline_leaf(leaf);
+        art_iterator_next(&it);
+    }
+
     // Flags.
     uint64_t size = sizeof(r->flags);
     // Container count.
     size += sizeof(r->capacity);
     // Container element counts.
-    size += r->capacity * sizeof(uint16_t);
+    size += (r->capacity + num_inline) * sizeof(uint16_t);
     // Total container sizes.
     size += 3 * sizeof(uint64_t);
     // ART (8 byte aligned).
     size = align_size(size, 8);
     size += art_size_in_bytes(&r->art);
 
-    uint64_t total_sizes[4] =
-        CROARING_ZERO_INITIALIZER;  // Indexed by typecode.
-    art_iterator_t it = art_init_iterator((art_t *)&r->art, /*first=*/true);
-    while (it.value != NULL) {
-        leaf_t leaf = (leaf_t)*it.value;
-        uint8_t typecode = get_typecode(leaf);
-        total_sizes[typecode] +=
-            container_get_frozen_size(get_container(r, leaf), typecode);
-        art_iterator_next(&it);
-    }
     // Containers (aligned).
     size = align_size(size, CROARING_BITSET_ALIGNMENT);
     size += total_sizes[BITSET_CONTAINER_TYPE];
@@ -2495,6 +3767,17 @@ static inline void container_frozen_serialize(const container_t *container,
     }
 }
 
+// Gives the inline leaves the indices following the containers of the
+// bitmap, numbered by `*context`, when serializing the ART.
+static art_val_t frozen_leaf_index(art_val_t val, void *context) {
+    leaf_t leaf = (leaf_t)val;
+    if (!is_inline_leaf(leaf)) {
+        return val;
+    }
+    uint64_t *next_index = (uint64_t *)context;
+    return (art_val_t)create_leaf((*next_index)++, ARRAY_CONTAINER_TYPE);
+}
+
 static inline char *pad_align(char *buf, const char *initial_buf,
                               size_t alignment) {
     uint64_t buf_size = buf - initial_buf;
@@ -2517,18 +3800,27 @@ size_t roaring64_bitmap_frozen_serialize(const roaring64_bitmap_t *r,
     memcpy(buf, &r->flags, sizeof(r->flags));
     buf += sizeof(r->flags);
 
-    // Container count.
-    memcpy(buf, &r->capacity, sizeof(r->capacity));
-    buf += sizeof(r->capacity);
+    // Container count. Inline leaves are written as array containers, so
+    // that the format is the same as for a bitmap without them.
+    uint64_t num_inline = 0;
+    art_iterator_t it = art_init_iterator((art_t *)&r->art, /*first=*/true);
+    while (it.value != NULL) {
+        num_inline += is_inline_leaf((leaf_t)*it.value);
+        art_iterator_next(&it);
+    }
+    uint64_t container_count = r->capacity + num_inline;
+    memcpy(buf, &container_count, sizeof(container_count));
+    buf += sizeof(container_count);
 
     // Container element counts.
     uint64_t total_sizes[4] =
         CROARING_ZERO_INITIALIZER;  // Indexed by typecode.
-    art_iterator_t it = art_init_iterator((art_t *)&r->art, /*first=*/true);
+    it = art_init_iterator((art_t *)&r->art, /*first=*/true);
     while (it.value != NULL) {
         leaf_t leaf = (leaf_t)*it.value;
         uint8_t typecode = get_typecode(leaf);
-        container_t *container = get_container(r, leaf);
+        leaf_view_t view;
+        const container_t *container = leaf_container(r, leaf, &view);
 
         uint32_t elem_count = container_get_element_count(container, typecode);
         uint16_t compressed_elem_count = (uint16_t)(elem_count - 1);
@@ -2549,7 +3841,8 @@ size_t roaring64_bitmap_frozen_serialize(const roaring64_bitmap_t *r,
 
     // ART.
     buf = pad_align(buf, initial_buf, 8);
-    buf += art_serialize(&r->art, buf);
+    uint64_t next_index = r->capacity;
+    buf += art_serialize_mapped(&r->art, buf, frozen_leaf_index, &next_index);
 
     // Containers (aligned).
     // Runs before arrays as run elements are larger than array elements and
@@ -2568,9 +3861,9 @@ size_t roaring64_bitmap_frozen_serialize(const roaring64_bitmap_t *r,
     while (it.value != NULL) {
         leaf_t leaf = (leaf_t)*it.value;
         uint8_t typecode = get_typecode(leaf);
-        container_t *container = get_container(r, leaf);
-        container_frozen_serialize(container, typecode, &bitsets, &arrays,
-                                   &runs);
+        leaf_view_t view;
+        container_frozen_serialize(leaf_container(r, leaf, &view), typecode,
+                                   &bitsets, &arrays, &runs);
         art_iterator_next(&it);
     }
 
@@ -2649,8 +3942,8 @@ roaring64_bitmap_t *roaring64_bitmap_frozen_view(const char *buf,
     buf += sizeof(r->capacity);
     maxbytes -= sizeof(r->capacity);
 
-    r->containers =
-        (container_t **)roaring_malloc(r->capacity * sizeof(container_t *));
+    r->containers = (container_t **)roaring_malloc_at(
+        ROARING_ALLOCATION_ART, r->capacity * sizeof(container_t *));
 
     // Container element counts.
     if (maxbytes < r->capacity * sizeof(uint16_t)) {
@@ -2737,8 +4030,10 @@ bool roaring64_bitmap_iterate(const roaring64_bitmap_t *r,
         uint64_t high32 = high48 & 0xFFFFFFFF00000000ULL;
         uint32_t low32 = high48;
         leaf_t leaf = (leaf_t)*it.value;
-        if (!container_iterate64(get_container(r, leaf), get_typecode(leaf),
-                                 low32, iterator, high32, ptr)) {
+        leaf_view_t view;
+        if (!container_iterate64(leaf_container(r, leaf, &view),
+                                 get_typecode(leaf), low32, iterator, high32,
+                                 ptr)) {
             return false;
         }
         art_iterator_next(&it);
@@ -2803,8 +4098,10 @@ bool roaring64_iterator_advance(roaring64_iterator_t *it) {
     }
     leaf_t leaf = (leaf_t)*it->art_it.value;
     uint16_t low16 = (uint16_t)it->value;
-    if (container_iterator_next(get_container(it->r, leaf), get_typecode(leaf),
-                                &it->container_it, &low16)) {
+    leaf_view_t view;
+    if (container_iterator_next(leaf_container(it->r, leaf, &view),
+                                get_typecode(leaf), &it->container_it,
+                                &low16)) {
         it->value = it->high48 | low16;
         return (it->has_value = true);
     }
@@ -2826,8 +4123,10 @@ bool roaring64_iterator_previous(roaring64_iterator_t *it) {
     }
     leaf_t leaf = (leaf_t)*it->art_it.value;
     uint16_t low16 = (uint16_t)it->value;
-    if (container_iterator_prev(get_container(it->r, leaf), get_typecode(leaf),
-                                &it->container_it, &low16)) {
+    leaf_view_t view;
+    if (container_iterator_prev(leaf_container(it->r, leaf, &view),
+                                get_typecode(leaf), &it->container_it,
+                                &low16)) {
         it->value = it->high48 | low16;
         return (it->has_value = true);
     }
@@ -2860,8 +4159,9 @@ bool roaring64_iterator_move_equalorlarger(roaring64_iterator_t *it,
         // in this container.
         leaf_t leaf = (leaf_t)*it->art_it.value;
         uint16_t low16 = (uint16_t)it->value;
+        leaf_view_t view;
         if (container_iterator_lower_bound(
-                get_container(it->r, leaf), get_typecode(leaf),
+                leaf_container(it->r, leaf, &view), get_typecode(leaf),
                 &it->container_it, &low16, val_low16)) {
             it->value = it->high48 | low16;
             return (it->has_value = true);
@@ -2889,9 +4189,11 @@ uint64_t roaring64_iterator_read(roaring64_iterator_t *it, uint64_t *buf,
         if (count - consumed < (uint64_t)UINT32_MAX) {
             container_count = count - consumed;
         }
+        leaf_view_t view;
         bool has_value = container_iterator_read_into_uint64(
-            get_container(it->r, leaf), get_typecode(leaf), &it->container_it,
-            it->high48, buf, container_count, &container_consumed, &low16);
+            leaf_container(it->r, leaf, &view), get_typecode(leaf),
+            &it->container_it, it->high48, buf, container_count,
+            &container_consumed, &low16);
         consumed += container_consumed;
         buf += container_consumed;
         if (has_value) {
@@ -2921,9 +4223,11 @@ uint64_t roaring64_iterator_read_backward(roaring64_iterator_t *it,
         if (count - consumed < (uint64_t)UINT32_MAX) {
             container_count = count - consumed;
         }
+        leaf_view_t view;
         bool has_value = container_iterator_read_backward_into_uint64(
-            get_container(it->r, leaf), get_typecode(leaf), &it->container_it,
-            it->high48, buf, container_count, &container_consumed, &low16);
+            leaf_container(it->r, leaf, &view), get_typecode(leaf),
+            &it->container_it, it->high48, buf, container_count,
+            &container_consumed, &low16);
         consumed += container_consumed;
         buf += container_consumed;
         if (has_value) {
@@ -2952,8 +4256,9 @@ size_t roaring64_iterator_read_ranges(roaring64_iterator_t *it,
             uint16_t low16 = (uint16_t)it->value;
             leaf_t leaf = (leaf_t)*it->art_it.value;
             bool container_has_more;
+            leaf_view_t view;
             uint16_t run_end_low16 = container_iterator_find_run_end(
-                get_container(it->r, leaf), get_typecode(leaf),
+                leaf_container(it->r, leaf, &view), get_typecode(leaf),
                 &it->container_it, &low16, &container_has_more);
             buf[ret].max = it->high48 | run_end_low16;
 
@@ -2990,8 +4295,9 @@ size_t roaring64_iterator_read_prev_ranges(roaring64_iterator_t *it,
             uint16_t low16 = (uint16_t)it->value;
             leaf_t leaf = (leaf_t)*it->art_it.value;
             bool container_has_more;
+            leaf_view_t view;
             uint16_t run_start_low16 = container_iterator_find_run_start(
-                get_container(it->r, leaf), get_typecode(leaf),
+                leaf_container(it->r, leaf, &view), get_typecode(leaf),
                 &it->container_it, &low16, &container_has_more);
             buf[ret].min = it->high48 | run_start_low16;
 
@@ -56,7 +56,8 @@ static bool realloc_array(roaring_array_t *ra, int32_t new_capacity) {
     const size_t memoryneeded =
         new_capacity *
         (sizeof(uint16_t) + sizeof(container_t *) + sizeof(uint8_t));
-    void *bigalloc = roaring_malloc(memoryneeded);
+    void *bigalloc =
+        roaring_malloc_at(ROARING_ALLOCATION_ROARING_ARRAY, memoryneeded);
     if (!bigalloc) return false;
     void *oldbigalloc = ra->containers;
     container_t **newcontainers = (container_t **)bigalloc;
@@ -88,7 +89,8 @@ bool ra_init_with_capacity(roaring_array_t *new_ra, uint32_t cap) {
     }
 
     if (cap > 0) {
-        void *bigalloc = roaring_malloc(
+        void *bigalloc = roaring_malloc_at(
+            ROARING_ALLOCATION_ROARING_ARRAY,
             cap * (sizeof(uint16_t) + sizeof(container_t *) + sizeof(uint8_t)));
         if (bigalloc == NULL) return false;
         new_ra->containers = (container_t **)bigalloc;
@@ -121,6 +123,7 @@ void ra_init(roaring_array_t *new_ra) {
     new_ra->allocation_size = 0;
     new_ra->size = 0;
     new_ra->flags = 0;
+    new_ra->allocator = roaring_allocator_current();
 }
 
 bool ra_overwrite(const roaring_array_t *source, roaring_array_t *dest,
@@ -149,11 +152,12 @@ bool ra_overwrite(const roaring_array_t *source, roaring_array_t *dest,
         memcpy(dest->typecodes, source->typecodes,
                dest->size * sizeof(uint8_t));
     } else {
-        memcpy(dest->typecodes, source->typecodes,
-               dest->size * sizeof(uint8_t));
         for (int32_t i = 0; i < dest->size; i++) {
-            dest->containers[i] =
-                container_clone(source->containers[i], source->typecodes[i]);
+            // shared containers are unwrapped: a bitmap in an arena may hold
+            // some even though the copy is not copy-on-write
+            dest->typecodes[i] = source->typecodes[i];
+            dest->containers[i] = get_copy_of_container(
+                source->containers[i], &dest->typecodes[i], false);
             if (dest->containers[i] == NULL) {
                 for (int32_t j = 0; j < i; j++) {
                     container_free(dest->containers[j], dest->typecodes[j]);
@@ -234,9 +238,11 @@ void ra_append_copy(roaring_array_t *ra, const roaring_array_t *sa,
         ra->containers[pos] = sa->containers[index];
         ra->typecodes[pos] = sa->typecodes[index];
     } else {
+        // copies what a shared container wraps, which may be from elsewhere
+        uint8_t typecode = sa->typecodes[index];
         ra->containers[pos] =
-            container_clone(sa->containers[index], sa->typecodes[index]);
-        ra->typecodes[pos] = sa->typecodes[index];
+            get_copy_of_container(sa->containers[index], &typecode, false);
+        ra->typecodes[pos] = typecode;
     }
     ra->size++;
 }
@@ -262,9 +268,10 @@ void ra_append_copy_range(roaring_array_t *ra, const roaring_array_t *sa,
             ra->containers[pos] = sa->containers[i];
             ra->typecodes[pos] = sa->typecodes[i];
         } else {
+            uint8_t typecode = sa->typecodes[i];
             ra->containers[pos] =
-                container_clone(sa->containers[i], sa->typecodes[i]);
-            ra->typecodes[pos] = sa->typecodes[i];
+                get_copy_of_container(sa->containers[i], &typecode, false);
+            ra->typecodes[pos] = typecode;
         }
         ra->size++;
     }
@@ -308,9 +315,10 @@ void ra_append_range(roaring_array_t *ra, roaring_array_t *sa,
             ra->containers[pos] = sa->containers[i];
             ra->typecodes[pos] = sa->typecodes[i];
         } else {
+            uint8_t typecode = sa->typecodes[i];
             ra->containers[pos] =
-                container_clone(sa->containers[i], sa->typecodes[i]);
-            ra->typecodes[pos] = sa->typecodes[i];
+                get_copy_of_container(sa->containers[i], &typecode, false);
+            ra->typecodes[pos] = typecode;
         }
         ra->size++;
     }
@@ -464,9 +472,13 @@ size_t ra_portable_size_in_bytes(const roaring_array_t *ra) {
     return count;
 }
 
+// Writes everything that precedes the container payloads (cookie, run
+// bitmap, keys and cardinalities, offsets) and returns the number of bytes
+// written.
+//
 // The portable serialization format is little-endian. On big-endian hosts we
 // byte-swap multi-byte fields before writing them to the buffer.
-size_t ra_portable_serialize(const roaring_array_t *ra, char *buf) {
+static size_t ra_portable_write_header(const roaring_array_t *ra, char *buf) {
     char *initbuf = buf;
     uint32_t startOffset = 0;
     bool hasrun = ra_has_run_container(ra);
@@ -524,6 +536,12 @@ size_t ra_portable_serialize(const roaring_array_t *ra, char *buf) {
                 container_size_in_bytes(ra->containers[k], ra->typecodes[k]);
         }
     }
+    return buf - initbuf;
+}
+
+size_t ra_portable_serialize(const roaring_array_t *ra, char *buf) {
+    char *initbuf = buf;
+    buf += ra_portable_write_header(ra, buf);
     for (int32_t k = 0; k < ra->size; ++k) {
         buf += container_write(ra->containers[k], ra->typecodes[k], buf);
     }
@@ -630,12 +648,24 @@ size_t ra_portable_deserialize_size(const char *buf, const size_t maxbytes) {
 //
 // The portable serialization format is little-endian. On big-endian hosts we
 // byte-swap multi-byte fields after reading them from the buffer.
-bool ra_portable_deserialize(roaring_array_t *answer, const char *buf,
-                             const size_t maxbytes, size_t *readbytes) {
-    *readbytes = sizeof(int32_t);  // for cookie
-    if (*readbytes > maxbytes) {
+// What precedes the container payloads in the portable serialization.
+typedef struct portable_header_s {
+    int32_t size;                       // number of containers
+    const char *bitmapOfRunContainers;  // NULL without run containers
+    const char *keyscards;              // keys and cardinalities minus one
+    const char *payloads;               // first container payload
+} portable_header_t;
+
+// Parses the cookie, run bitmap, keys and cardinalities and offsets at buf,
+// checking that they fit in maxbytes bytes. Returns how many bytes they
+// take, or 0 if no properly serialized header can be found. The offsets are
+// skipped: they are not trusted.
+static size_t ra_portable_read_header(const char *buf, const size_t maxbytes,
+                                      portable_header_t *header) {
+    size_t readbytes = sizeof(int32_t);  // for cookie
+    if (readbytes > maxbytes) {
         // Ran out of bytes while reading first 4 bytes.
-        return false;
+        return 0;
     }
     uint32_t cookie;
     memcpy(&cookie, buf, sizeof(int32_t));
@@ -644,17 +674,17 @@ bool ra_portable_deserialize(roaring_array_t *answer, const char *buf,
     if ((cookie & 0xFFFF) != SERIAL_COOKIE &&
         cookie != SERIAL_COOKIE_NO_RUNCONTAINER) {
         // "I failed to find one of the right cookies.
-        return false;
+        return 0;
     }
     int32_t size;
 
     if ((cookie & 0xFFFF) == SERIAL_COOKIE)
         size = (cookie >> 16) + 1;
     else {
-        *readbytes += sizeof(int32_t);
-        if (*readbytes > maxbytes) {
+        readbytes += sizeof(int32_t);
+        if (readbytes > maxbytes) {
             // Ran out of bytes while reading second part of the cookie.
-            return false;
+            return 0;
         }
         uint32_t size_le;
         memcpy(&size_le, buf, sizeof(int32_t));
@@ -664,33 +694,61 @@ bool ra_portable_deserialize(roaring_array_t *answer, const char *buf,
     if (size < 0) {
         // You cannot have a negative number of containers, the data must be
         // corrupted.
-        return false;
+        return 0;
     }
     if (size > (1 << 16)) {
         // You cannot have so many containers, the data must be corrupted.
-        return false;
+        return 0;
     }
-    const char *bitmapOfRunContainers = NULL;
+    header->size = size;
+    header->bitmapOfRunContainers = NULL;
     bool hasrun = (cookie & 0xFFFF) == SERIAL_COOKIE;
     if (hasrun) {
         int32_t s = (size + 7) / 8;
-        *readbytes += s;
-        if (*readbytes > maxbytes) {  // data is corrupted?
+        readbytes += s;
+        if (readbytes > maxbytes) {  // data is corrupted?
             // Ran out of bytes while reading run bitmap.
-            return false;
+            return 0;
         }
-        bitmapOfRunContainers = buf;
+        header->bitmapOfRunContainers = buf;
         buf += s;
     }
-    const char *keyscards = buf;
+    header->keyscards = buf;
 
-    *readbytes += size * 2 * sizeof(uint16_t);
-    if (*readbytes > maxbytes) {
+    readbytes += size * 2 * sizeof(uint16_t);
+    if (readbytes > maxbytes) {
         // Ran out of bytes while reading key-cardinality array.
-        return false;
+        return 0;
     }
     buf += size * 2 * sizeof(uint16_t);
 
+    if ((!hasrun) || (size >= NO_OFFSET_THRESHOLD)) {
+        readbytes += size * 4;
+        if (readbytes > maxbytes) {  // data is corrupted?
+            // Ran out of bytes while reading offsets.
+            return 0;
+        }
+
+        // skipping the offsets
+        buf += size * 4;
+    }
+    header->payloads = buf;
+    return readbytes;
+}
+
+bool ra_portable_deserialize(roaring_array_t *answer, const char *buf,
+                             const size_t maxbytes, size_t *readbytes) {
+    portable_header_t header;
+    *readbytes = ra_portable_read_header(buf, maxbytes, &header);
+    if (*readbytes == 0) {
+        return false;
+    }
+    int32_t size = header.size;
+    const char *bitmapOfRunContainers = header.bitmapOfRunContainers;
+    bool hasrun = bitmapOfRunContainers != NULL;
+    const char *keyscards = header.keyscards;
+    buf = header.payloads;
+
     bool is_ok = ra_init_with_capacity(answer, size);
     if (!is_ok) {
         // Failed to allocate memory for roaring array. Bailing out.
@@ -702,18 +760,6 @@ bool ra_portable_deserialize(roaring_array_t *answer, const char *buf,
         memcpy(&tmp, keyscards + 4 * k, sizeof(tmp));
         answer->keys[k] = croaring_letoh16(tmp);
     }
-    if ((!hasrun) || (size >= NO_OFFSET_THRESHOLD)) {
-        *readbytes += size * 4;
-        if (*readbytes > maxbytes) {  // data is corrupted?
-            // Ran out of bytes while reading offsets.
-            ra_clear(answer);  // we need to clear the containers already
-                               // allocated, and the roaring array
-            return false;
-        }
-
-        // skipping the offsets
-        buf += size * 4;
-    }
     // Reading the containers
     for (int32_t k = 0; k < size; ++k) {
         uint16_t tmp;
@@ -812,6 +858,183 @@ bool ra_portable_deserialize(roaring_array_t *answer, const char *buf,
     return true;
 }
 
+typedef struct portable_write_chunks_s {
+    const roaring_array_t *ra;
+    size_t chunk_size;
+    char *starts[ROARING_MAX_TASKS];  // first payload of each task
+} portable_write_chunks_t;
+
+static void portable_write_chunk(void *arg, size_t task) {
+    portable_write_chunks_t *chunks = (portable_write_chunks_t *)arg;
+    const roaring_array_t *ra = chunks->ra;
+    size_t begin = task * chunks->chunk_size;
+    size_t end = begin + chunks->chunk_size;
+    if (end > (size_t)ra->size) end = (size_t)ra->size;
+    char *buf = chunks->starts[task];
+    for (size_t k = begin; k < end; k++) {
+        buf += container_write(ra->containers[k], ra->typecodes[k], buf);
+    }
+}
+
+size_t ra_portable_serialize_parallel(const roaring_array_t *ra, char *buf,
+                                      const roaring_executor_t *executor) {
+    size_t chunk_size = roaring_task_chunk_size(
+        (size_t)ra->size, ROARING_MIN_CONTAINERS_PER_TASK);
+    size_t num_tasks = ((size_t)ra->size + chunk_size - 1) / chunk_size;
+    if (executor == NULL || num_tasks <= 1) {
+        return ra_portable_serialize(ra, buf);
+    }
+    portable_write_chunks_t chunks;
+    chunks.ra = ra;
+    chunks.chunk_size = chunk_size;
+    // prefix sum over the payload sizes, the same one that fills the offsets
+    size_t offset = ra_portable_write_header(ra, buf);
+    for (int32_t k = 0; k < ra->size; ++k) {
+        if ((size_t)k % chunk_size == 0) {
+            chunks.starts[(size_t)k / chunk_size] = buf + offset;
+        }
+        offset += container_size_in_bytes(ra->containers[k], ra->typecodes[k]);
+    }
+    roaring_execute_tasks(executor, num_tasks, portable_write_chunk, &chunks);
+    return offset;
+}
+
+typedef struct portable_read_chunks_s {
+    roaring_array_t *ra;
+    const char *keyscards;
+    const char *bitmapOfRunContainers;  // NULL without run containers
+    size_t chunk_size;
+    const char *starts[ROARING_MAX_TASKS];  // first payload of each task
+    bool failed[ROARING_MAX_TASKS];
+} portable_read_chunks_t;
+
+static void portable_read_chunk(void *arg, size_t task) {
+    portable_read_chunks_t *chunks = (portable_read_chunks_t *)arg;
+    roaring_array_t *ra = chunks->ra;
+    size_t begin = task * chunks->chunk_size;
+    size_t end = begin + chunks->chunk_size;
+    if (end > (size_t)ra->size) end = (size_t)ra->size;
+    const char *buf = chunks->starts[task];
+    chunks->failed[task] = false;
+    for (size_t k = begin; k < end; k++) {
+        uint16_t tmp;
+        memcpy(&tmp, chunks->keyscards + 4 * k + 2, sizeof(tmp));
+        uint32_t thiscard = (uint32_t)croaring_letoh16(tmp) + 1;
+        bool isrun = chunks->bitmapOfRunContainers != NULL &&
+                     (chunks->bitmapOfRunContainers[k / 8] & (1 << (k % 8)));
+        if (isrun) {
+            run_container_t *c = run_container_create();
+            if (c == NULL) {
+                chunks->failed[task] = true;
+                return;
+            }
+            buf += run_container_read(thiscard, c, buf);
+            ra->containers[k] = c;
+            ra->typecodes[k] = RUN_CONTAINER_TYPE;
+        } else if (thiscard > DEFAULT_MAX_SIZE) {
+            bitset_container_t *c = bitset_container_create();
+            if (c == NULL) {
+                chunks->failed[task] = true;
+                return;
+            }
+            buf += bitset_container_read(thiscard, c, buf);
+            ra->containers[k] = c;
+            ra->typecodes[k] = BITSET_CONTAINER_TYPE;
+        } else {
+            array_container_t *c =
+                array_container_create_given_capacity(thiscard);
+            if (c == NULL) {
+                chunks->failed[task] = true;
+                return;
+            }
+            buf += array_container_read(thiscard, c, buf);
+            ra->containers[k] = c;
+            ra->typecodes[k] = ARRAY_CONTAINER_TYPE;
+        }
+    }
+}
+
+bool ra_portable_deserialize_parallel(roaring_array_t *answer, const char *buf,
+                                      const size_t maxbytes, size_t *readbytes,
+                                      const roaring_executor_t *executor) {
+    if (executor == NULL) {
+        return ra_portable_deserialize(answer, buf, maxbytes, readbytes);
+    }
+    // The header is parsed once, as by ra_portable_deserialize. We then walk
+    // the payloads to find where each task starts: the offsets are not
+    // trusted, and the walk only needs to read the run counts.
+    portable_header_t header;
+    size_t bytestotal = ra_portable_read_header(buf, maxbytes, &header);
+    if (bytestotal == 0) {
+        return false;
+    }
+    int32_t size = header.size;
+    size_t chunk_size = roaring_task_chunk_size(
+        (size_t)size, ROARING_MIN_CONTAINERS_PER_TASK);
+    size_t num_tasks = ((size_t)size + chunk_size - 1) / chunk_size;
+    if (num_tasks <= 1) {
+        return ra_portable_deserialize(answer, buf, maxbytes, readbytes);
+    }
+    portable_read_chunks_t chunks;
+    chunks.chunk_size = chunk_size;
+    chunks.bitmapOfRunContainers = header.bitmapOfRunContainers;
+    chunks.keyscards = header.keyscards;
+    buf = header.payloads;
+    for (int32_t k = 0; k < size; ++k) {
+        if ((size_t)k % chunk_size == 0) {
+            chunks.starts[(size_t)k / chunk_size] = buf;
+        }
+        uint16_t tmp;
+        memcpy(&tmp, chunks.keyscards + 4 * k + 2, sizeof(tmp));
+        uint32_t thiscard = (uint32_t)croaring_letoh16(tmp) + 1;
+        size_t containersize;
+        if (chunks.bitmapOfRunContainers != NULL &&
+            (chunks.bitmapOfRunContainers[k / 8] & (1 << (k % 8)))) {
+            if (bytestotal + sizeof(uint16_t) > maxbytes) return false;
+            uint16_t n_runs;
+            memcpy(&n_runs, buf, sizeof(uint16_t));
+            n_runs = croaring_letoh16(n_runs);
+            containersize = sizeof(uint16_t) + n_runs * sizeof(rle16_t);
+        } else if (thiscard > DEFAULT_MAX_SIZE) {
+            containersize = BITSET_CONTAINER_SIZE_IN_WORDS * sizeof(uint64_t);
+        } else {
+            containersize = thiscard * sizeof(uint16_t);
+        }
+        bytestotal += containersize;
+        if (bytestotal > maxbytes) return false;
+        buf += containersize;
+    }
+
+    if (!ra_init_with_capacity(answer, size)) {
+        return false;
+    }
+    for (int32_t k = 0; k < size; ++k) {
+        uint16_t tmp;
+        memcpy(&tmp, chunks.keyscards + 4 * k, sizeof(tmp));
+        answer->keys[k] = croaring_letoh16(tmp);
+        answer->containers[k] = NULL;
+    }
+    answer->size = size;
+    chunks.ra = answer;
+    roaring_execute_tasks(executor, num_tasks, portable_read_chunk, &chunks);
+    for (size_t i = 0; i < num_tasks; i++) {
+        if (chunks.failed[i]) {
+            // free whatever the tasks managed to allocate
+            for (int32_t k = 0; k < size; ++k) {
+                if (answer->containers[k] != NULL) {
+                    container_free(answer->containers[k],
+                                   answer->typecodes[k]);
+                }
+            }
+            answer->size = 0;
+            ra_clear(answer);
+            return false;
+        }
+    }
+    *readbytes = bytestotal;
+    return true;
+}
+
 #ifdef __cplusplus
 }
 }
@@ -186,8 +186,8 @@ static roaring_bitmap_t *lazy_or_from_lazy_inputs(roaring_bitmap_t *x1,
     }
     ra_clear_without_containers(&x1->high_low_container);
     ra_clear_without_containers(&x2->high_low_container);
-    roaring_free(x1);
-    roaring_free(x2);
+    roaring_bitmap_free(x1);
+    roaring_bitmap_free(x2);
     return answer;
 }
 
@@ -193,6 +193,41 @@ DEFINE_TEST(capacity_test) {
     array_container_free(array);
 }
 
+DEFINE_TEST(inline_array_test) {
+    array_container_t* array = array_container_create();
+    assert_true(array_container_is_inline(array));
+    for (uint16_t i = 0; i < ARRAY_CONTAINER_INLINE_SIZE; i++) {
+        array_container_add(array, (uint16_t)(100 - i * 10));
+        assert_true(array_container_is_inline(array));
+    }
+    array_container_t* copy = array_container_clone(array);
+    assert_true(array_container_is_inline(copy));
+    assert_true(array_container_equals(array, copy));
+
+    // growing moves the values out of the struct
+    array_container_add(array, 1000);
+    assert_false(array_container_is_inline(array));
+    assert_int_equal(array_container_cardinality(array),
+                     ARRAY_CONTAINER_INLINE_SIZE + 1);
+    for (uint16_t i = 0; i < ARRAY_CONTAINER_INLINE_SIZE; i++) {
+        assert_true(array_container_contains(array, (uint16_t)(100 - i * 10)));
+    }
+    array_container_shrink_to_fit(array);
+    assert_false(array_container_is_inline(array));
+
+    // shrinking a small enough container moves them back
+    array_container_remove(array, 1000);
+    assert_true(array_container_shrink_to_fit(array) > 0);
+    assert_true(array_container_is_inline(array));
+    assert_true(array_container_equals(array, copy));
+    assert_int_equal(array_container_shrink_to_fit(array), 0);
+
+    array_container_copy(copy, array);
+    assert_true(array_container_is_inline(array));
+    array_container_free(array);
+    array_container_free(copy);
+}
+
 /* This is a fixed-increment version of Java 8's SplittableRandom generator
    See http://dx.doi.org/10.1145/2714064.2660195 and
    http://docs.oracle.com/javase/8/docs/api/java/util/SplittableRandom.html */
@@ -374,7 +409,8 @@ int main() {
         cmocka_unit_test(and_or_test),
         cmocka_unit_test(to_uint32_array_test),
         cmocka_unit_test(select_test),
-        cmocka_unit_test(capacity_test)};
+        cmocka_unit_test(capacity_test),
+        cmocka_unit_test(inline_array_test)};
 
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
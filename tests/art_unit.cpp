@@ -655,6 +655,28 @@ DEFINE_TEST(test_art_shrink_grow_node48) {
     art_free(&art);
 }
 
+DEFINE_TEST(test_art_node16_search) {
+    // Node16 keys spread over the whole chunk range, including chunks with the
+    // high bit set, so that signed comparisons would give the wrong order.
+    for (int count = 5; count <= 16; ++count) {
+        ShadowedART art;
+        for (int i = 0; i < count; ++i) {
+            art.insert(Key(0x0100 | (i * 17 + 0x0F)), i);
+        }
+        art.assertValid();
+        for (int chunk = 0; chunk < 256; ++chunk) {
+            art.assertLowerBoundValid(Key(0x0100 | chunk));
+            art.assertUpperBoundValid(Key(0x0100 | chunk));
+        }
+        // Erasing shrinks the node one key at a time down to a Node4.
+        for (int i = count - 1; i >= 4; i -= 2) {
+            art.erase(Key(0x0100 | (i * 17 + 0x0F)));
+            art.assertValid();
+            art.assertLowerBoundValid(Key(0x0100 | 0xFF));
+        }
+    }
+}
+
 DEFINE_TEST(test_art_frozen_view) {
     {
         // ART with multiple node sizes.
@@ -731,6 +753,68 @@ DEFINE_TEST(test_art_frozen_view) {
     }
 }
 
+DEFINE_TEST(test_art_bulk_load) {
+    std::vector<std::vector<uint64_t>> key_sets = {
+        {42},
+        // Max depth.
+        {0x000000000000, 0x000000000001, 0x000000000100, 0x000000010000,
+         0x000001000000, 0x000100000000, 0x010000000000},
+    };
+    // One inner node of each size under a shared prefix, and a root with 256
+    // children that each hold a Node4.
+    for (uint64_t count : {2, 4, 5, 16, 17, 48, 49, 256}) {
+        std::vector<uint64_t> keys;
+        for (uint64_t i = 0; i < count; ++i) {
+            keys.push_back(0x123456780000 | (i * 256 / count));
+        }
+        key_sets.push_back(keys);
+    }
+    std::vector<uint64_t> wide;
+    for (uint64_t i = 0; i < 256; ++i) {
+        for (uint64_t j = 0; j < 3; ++j) {
+            wide.push_back((i << 40) | (j << 8));
+        }
+    }
+    key_sets.push_back(wide);
+
+    for (const auto& key_set : key_sets) {
+        std::vector<uint8_t> chunks;
+        std::vector<art_val_t> values;
+        for (uint64_t key : key_set) {
+            Key k(key);
+            chunks.insert(chunks.end(), k.data(), k.data() + 6);
+            values.push_back(key * 3 + 1);
+        }
+        art_t art;
+        art_init_cleared(&art);
+        art_bulk_load(&art, chunks.data(), values.data(), key_set.size());
+        assert_art_valid(&art);
+
+        art_iterator_t iterator = art_init_iterator(&art, true);
+        for (size_t i = 0; i < key_set.size(); ++i) {
+            Key k(key_set[i]);
+            assert_key_eq(iterator.key, k.data());
+            assert_true(*iterator.value == values[i]);
+            art_val_t* found = art_find(&art, k.data());
+            assert_true(found != nullptr && *found == values[i]);
+            art_iterator_next(&iterator);
+        }
+        assert_null(iterator.value);
+
+        // The bulk-loaded tree supports regular updates.
+        Key extra(0xFFFFFFFFFFFF);
+        art_insert(&art, extra.data(), 7);
+        assert_art_valid(&art);
+        for (uint64_t key : key_set) {
+            assert_true(art_erase(&art, Key(key).data(), nullptr));
+            assert_art_valid(&art);
+        }
+        assert_true(art_erase(&art, extra.data(), nullptr));
+        assert_true(art_is_empty(&art));
+        art_free(&art);
+    }
+}
+
 }  // namespace
 
 int main() {
@@ -747,7 +831,9 @@ int main() {
         cmocka_unit_test(test_art_iterator_insert),
         cmocka_unit_test(test_art_shadowed),
         cmocka_unit_test(test_art_shrink_grow_node48),
+        cmocka_unit_test(test_art_node16_search),
         cmocka_unit_test(test_art_frozen_view),
+        cmocka_unit_test(test_art_bulk_load),
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
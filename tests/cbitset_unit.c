@@ -289,6 +289,157 @@ DEFINE_TEST(test_contains_all) {
     bitset_free(subset);
 }
 
+static uint64_t next_random_word(uint64_t *state) {
+    // xorshift64*
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * UINT64_C(2685821657736338717);
+}
+
+static size_t word_count(uint64_t w) {
+    size_t count = 0;
+    for (; w != 0; w &= w - 1) count++;
+    return count;
+}
+
+static bitset_t *random_bitset(size_t words, uint64_t *state) {
+    bitset_t *b = words ? bitset_create_with_capacity(words * 64)
+                        : bitset_create();
+    for (size_t k = 0; k < words; k++) b->array[k] = next_random_word(state);
+    return b;
+}
+
+static uint64_t word_or_zero(const bitset_t *b, size_t k) {
+    return k < b->arraysize ? b->array[k] : 0;
+}
+
+/* The operations work on whole vectors of words, then on the remaining
+ * words: sizes around the vector widths check both parts. */
+DEFINE_TEST(test_vector_sizes) {
+    const size_t sizes[] = {0, 1, 3, 4, 5, 8, 9, 15, 16, 17, 33, 100, 1031};
+    const size_t n_sizes = sizeof(sizes) / sizeof(sizes[0]);
+    uint64_t state = UINT64_C(0x9E3779B97F4A7C15);
+    for (size_t i = 0; i < n_sizes; i++) {
+        for (size_t j = 0; j < n_sizes; j++) {
+            bitset_t *b1 = random_bitset(sizes[i], &state);
+            bitset_t *b2 = random_bitset(sizes[j], &state);
+            size_t longest = sizes[i] > sizes[j] ? sizes[i] : sizes[j];
+            size_t card = 0, or_card = 0, and_card = 0, andnot_card = 0,
+                   xor_card = 0;
+            for (size_t k = 0; k < longest; k++) {
+                uint64_t w1 = word_or_zero(b1, k), w2 = word_or_zero(b2, k);
+                card += word_count(w1);
+                or_card += word_count(w1 | w2);
+                and_card += word_count(w1 & w2);
+                andnot_card += word_count(w1 & ~w2);
+                xor_card += word_count(w1 ^ w2);
+            }
+            assert_int_equal(bitset_count(b1), card);
+            assert_int_equal(bitset_union_count(b1, b2), or_card);
+            assert_int_equal(bitset_intersection_count(b1, b2), and_card);
+            assert_int_equal(bitset_difference_count(b1, b2), andnot_card);
+            assert_int_equal(bitset_symmetric_difference_count(b1, b2),
+                             xor_card);
+
+            bitset_t *r = bitset_copy(b1);
+            assert_true(bitset_inplace_union(r, b2));
+            assert_int_equal(r->arraysize, longest);
+            for (size_t k = 0; k < longest; k++) {
+                assert_true(r->array[k] ==
+                            (word_or_zero(b1, k) | word_or_zero(b2, k)));
+            }
+            bitset_free(r);
+            r = bitset_copy(b1);
+            bitset_inplace_intersection(r, b2);
+            for (size_t k = 0; k < sizes[i]; k++) {
+                assert_true(r->array[k] ==
+                            (b1->array[k] & word_or_zero(b2, k)));
+            }
+            bitset_free(r);
+            r = bitset_copy(b1);
+            bitset_inplace_difference(r, b2);
+            for (size_t k = 0; k < sizes[i]; k++) {
+                assert_true(r->array[k] ==
+                            (b1->array[k] & ~word_or_zero(b2, k)));
+            }
+            bitset_free(r);
+            r = bitset_copy(b1);
+            assert_true(bitset_inplace_symmetric_difference(r, b2));
+            for (size_t k = 0; k < longest; k++) {
+                assert_true(r->array[k] ==
+                            (word_or_zero(b1, k) ^ word_or_zero(b2, k)));
+            }
+            bitset_free(r);
+            bitset_free(b2);
+            bitset_free(b1);
+        }
+    }
+}
+
+DEFINE_TEST(test_vector_shifts) {
+    const size_t sizes[] = {1, 4, 5, 8, 9, 17, 100, 1031};
+    const size_t shifts[] = {1, 13, 63, 64, 65, 200, 640};
+    uint64_t state = UINT64_C(0x2545F4914F6CDD1D);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        bitset_t *b = random_bitset(sizes[i], &state);
+        size_t bits = sizes[i] * 64;
+        for (size_t j = 0; j < sizeof(shifts) / sizeof(shifts[0]); j++) {
+            size_t sh = shifts[j];
+            bitset_t *left = bitset_copy(b);
+            bitset_shift_left(left, sh);
+            assert_int_equal(bitset_count(left), bitset_count(b));
+            for (size_t k = 0; k < bits; k++) {
+                assert_true(bitset_get(left, k + sh) == bitset_get(b, k));
+            }
+            bitset_free(left);
+            if (sh >= bits) continue;
+            bitset_t *right = bitset_copy(b);
+            bitset_shift_right(right, sh);
+            for (size_t k = sh; k < bits; k++) {
+                assert_true(bitset_get(right, k - sh) == bitset_get(b, k));
+            }
+            bitset_free(right);
+        }
+        bitset_free(b);
+    }
+}
+
+DEFINE_TEST(test_many) {
+    bitset_t *b = bitset_create();
+    size_t indexes[] = {3, 700, 64, 3, 100000, 65};
+    const size_t n = sizeof(indexes) / sizeof(indexes[0]);
+    assert_true(bitset_set_many(b, n, indexes));
+    assert_int_equal(b->arraysize, 100000 / 64 + 1);  // grown once
+    assert_int_equal(bitset_count(b), 5);
+    bool results[sizeof(indexes) / sizeof(indexes[0])];
+    assert_int_equal(bitset_test_many(b, n, indexes, results), n);
+    for (size_t k = 0; k < n; k++) {
+        assert_true(results[k]);
+    }
+
+    size_t others[] = {4, 64, 1000000, 3};
+    const size_t n_others = sizeof(others) / sizeof(others[0]);
+    assert_int_equal(bitset_test_many(b, n_others, others, NULL), 2);
+    bitset_clear_many(b, n_others, others);  // past the end: ignored
+    assert_int_equal(b->arraysize, 100000 / 64 + 1);
+    assert_int_equal(bitset_count(b), 3);
+    assert_true(!bitset_get(b, 3) && !bitset_get(b, 64));
+    assert_true(bitset_get(b, 65) && bitset_get(b, 700));
+
+    assert_true(bitset_flip_many(b, n_others, others));
+    assert_int_equal(b->arraysize, 1000000 / 64 + 1);
+    assert_int_equal(bitset_count(b), 7);
+    assert_true(bitset_get(b, 4) && bitset_get(b, 1000000));
+    size_t twice[] = {5, 5};
+    assert_true(bitset_flip_many(b, 2, twice));
+    assert_true(!bitset_get(b, 5));
+
+    assert_true(bitset_set_many(b, 0, NULL));
+    assert_int_equal(bitset_test_many(b, 0, NULL, NULL), 0);
+    bitset_free(b);
+}
+
 int main() {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_set_to_val),
@@ -305,6 +456,9 @@ int main() {
         cmocka_unit_test(test_intersects),
         cmocka_unit_test(test_contains_all),
         cmocka_unit_test(test_contains_all_different_sizes),
+        cmocka_unit_test(test_vector_sizes),
+        cmocka_unit_test(test_vector_shifts),
+        cmocka_unit_test(test_many),
     };
 
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -64,6 +64,31 @@ DEFINE_TEST(test_cpp_r64_add_remove_contains_clear) {
     assert_true(r.isEmpty());
 }
 
+DEFINE_TEST(test_cpp_r64_appender) {
+    Roaring64 r;
+    {
+        roaring::Roaring64Appender appender(r);
+        for (uint64_t v = 0; v < 100000; v += 7) {
+            appender.add(v);
+        }
+        appender.flush();
+        assert_int_equal(r.cardinality(), (100000 + 6) / 7);
+        appender.add(uint64_t(1) << 40);
+    }
+    assert_true(r.contains(uint64_t(1) << 40));
+    assert_true(r.contains(99995));
+
+    roaring::Roaring r32;
+    {
+        roaring::RoaringAppender appender(r32);
+        for (uint32_t v = 100; v < 300000; v += 2) {
+            appender.add(v);
+        }
+    }
+    assert_int_equal(r32.cardinality(), 149950);
+    assert_true(r32.contains(299998));
+}
+
 DEFINE_TEST(test_cpp_r64_construction_helpers) {
     const uint64_t vals[] = {1, uint64_t(1) << 33, uint64_t(1) << 33, 7};
     Roaring64 r;
@@ -289,17 +314,203 @@ DEFINE_TEST(test_cpp_r64_random_vs_set) {
     r.validate();
 }
 
+DEFINE_TEST(test_cpp_r64_ranges_and_rank) {
+    const uint64_t base = uint64_t(1) << 40;
+    Roaring64 r;
+    assert_true(r.addChecked(7));
+    assert_false(r.addChecked(7));
+    r.addRange(base, base + 100);
+    r.addRangeClosed(base + 200, base + 300);
+    assert_int_equal(r.cardinality(), 1 + 100 + 101);
+    assert_true(r.containsRange(base, base + 100));
+    assert_false(r.containsRange(base, base + 101));
+    assert_true(r.containsRangeClosed(base + 200, base + 300));
+    assert_int_equal(r.rangeCardinality(base, base + 250), 100 + 50);
+
+    uint64_t element;
+    assert_true(r.select(0, &element));
+    assert_int_equal(element, 7);
+    assert_true(r.select(101, &element));
+    assert_int_equal(element, base + 200);
+    assert_false(r.select(r.cardinality(), &element));
+    assert_int_equal(r.rank(base + 99), 101);
+    assert_int_equal(r.getIndex(base + 200), 101);
+    assert_int_equal(r.getIndex(base + 150), -1);
+
+    assert_true(r.removeChecked(7));
+    assert_false(r.removeChecked(7));
+    r.removeRange(base + 50, base + 100);
+    r.removeRangeClosed(base + 200, base + 249);
+    assert_int_equal(r.cardinality(), 50 + 51);
+    const uint64_t vals[] = {base, base + 1, base + 250};
+    r.removeMany(3, vals);
+    assert_int_equal(r.cardinality(), 48 + 50);
+
+    r.flip(base, base + 60);
+    assert_int_equal(r.rangeCardinality(base, base + 60), 2 + 10);
+    r.flipClosed(base, base + 59);
+    assert_int_equal(r.rangeCardinality(base, base + 60), 48);
+
+    Roaring64 runs;
+    runs.addRange(0, 100000);
+    assert_true(runs.runOptimize());
+    assert_true(runs.removeRunCompression());
+    (void)runs.shrinkToFit();
+    assert_int_equal(runs.cardinality(), 100000);
+
+    r.setLeafCache(true);
+    assert_true(r.getLeafCache());
+    assert_true(r.contains(base + 2));
+    r.setLeafCache(false);
+    assert_false(r.getLeafCache());
+}
+
+DEFINE_TEST(test_cpp_r64_bulk_context) {
+    Roaring64 r;
+    roaring::Roaring64BulkContext context;
+    for (uint64_t v = 0; v < 1000; v += 3) {
+        r.addBulk(context, (uint64_t(1) << 45) + v);
+    }
+    roaring::Roaring64BulkContext search;
+    for (uint64_t v = 0; v < 1000; ++v) {
+        assert_true(r.containsBulk(search, (uint64_t(1) << 45) + v) ==
+                    (v % 3 == 0));
+    }
+    roaring::Roaring64BulkContext removal;
+    for (uint64_t v = 0; v < 1000; v += 6) {
+        r.removeBulk(removal, (uint64_t(1) << 45) + v);
+    }
+    assert_int_equal(r.cardinality(), 334 - 167);
+}
+
+DEFINE_TEST(test_cpp_r64_comparisons) {
+    Roaring64 a{1, 2, 3, uint64_t(1) << 60};
+    Roaring64 b{2, 3};
+    assert_true(b.isSubset(a));
+    assert_true(b.isStrictSubset(a));
+    assert_false(a.isSubset(b));
+    assert_true(a != b);
+    assert_int_equal(a.and_cardinality(b), 2);
+    assert_int_equal(a.or_cardinality(b), 4);
+    assert_int_equal(a.xor_cardinality(b), 2);
+    assert_int_equal(a.andnot_cardinality(b), 2);
+    assert_true(a.intersect(b));
+    assert_true(a.jaccard_index(b) == 0.5);
+
+    Roaring64 c(a);
+    c -= c;
+    assert_true(c.isEmpty());
+    c = a;
+    c ^= c;
+    assert_true(c.isEmpty());
+}
+
+DEFINE_TEST(test_cpp_r64_from_roaring32) {
+    roaring::Roaring r32{1, 5, 100000, 4000000000u};
+    Roaring64 r(r32);
+    assert_int_equal(r.cardinality(), 4);
+    assert_true(r.contains(4000000000u));
+    assert_int_equal(r32.cardinality(), 4);
+    assert_string_equal(r.toString().c_str(), "{1,5,100000,4000000000}");
+    assert_string_equal(Roaring64().toString().c_str(), "{}");
+}
+
+DEFINE_TEST(test_cpp_r64_iterator_reads) {
+    const uint64_t base = uint64_t(1) << 36;
+    Roaring64 r;
+    r.addRange(base, base + 10);
+    r.addRange(base + 100, base + 110);
+    r.add(base << 8);
+
+    Roaring64::const_bidirectional_iterator it = r.begin();
+    it.move_equalorlarger(base + 5);
+    assert_int_equal(*it, base + 5);
+    uint64_t buf[8];
+    assert_int_equal(it.read(buf, 8), 8);
+    assert_int_equal(buf[0], base + 5);
+    assert_int_equal(buf[5], base + 100);
+    assert_int_equal(*it, base + 103);
+
+    roaring::api::roaring64_range_closed_t ranges[4];
+    it = r.begin();
+    assert_int_equal(it.read_ranges(ranges, 4), 3);
+    assert_int_equal(ranges[0].min, base);
+    assert_int_equal(ranges[0].max, base + 9);
+    assert_int_equal(ranges[1].min, base + 100);
+    assert_int_equal(ranges[2].min, base << 8);
+    assert_true(it == r.end());
+
+    it = r.begin();
+    it.move_equalorlarger(base + 105);
+    assert_int_equal(it.read_prev_ranges(ranges, 4), 2);
+    assert_int_equal(ranges[0].min, base + 100);
+    assert_int_equal(ranges[0].max, base + 105);
+    assert_int_equal(ranges[1].max, base + 9);
+}
+
+DEFINE_TEST(test_cpp_r64_serialization) {
+    Roaring64 r;
+    r.addRange(uint64_t(1) << 33, (uint64_t(1) << 33) + 70000);
+    for (uint64_t v = 0; v < 10000; v += 7) {
+        r.add((uint64_t(1) << 50) + v);
+    }
+    r.runOptimize();
+
+    std::vector<char> portable(r.getSizeInBytes());
+    assert_int_equal(r.write(portable.data()), portable.size());
+    assert_int_equal(
+        Roaring64::serializedSizeInBytesSafe(portable.data(), portable.size()),
+        portable.size());
+    Roaring64 back = Roaring64::readSafe(portable.data(), portable.size());
+    assert_true(back == r);
+
+    r.shrinkToFit();
+    size_t frozen_size = r.getFrozenSizeInBytes();
+    std::vector<char> frozen(frozen_size + 64);
+    char* aligned = frozen.data();
+    aligned += (64 - (uintptr_t)aligned % 64) % 64;
+    assert_int_equal(r.writeFrozen(aligned), frozen_size);
+    const Roaring64 view = Roaring64::frozenView(aligned, frozen_size);
+    assert_true(view == r);
+    assert_int_equal(view.cardinality(), r.cardinality());
+}
+
+DEFINE_TEST(test_cpp_r64_fast_many) {
+    Roaring64 a{1, 2, 3, uint64_t(1) << 40};
+    Roaring64 b{2, 3, 4};
+    Roaring64 c{3, 4, 5, uint64_t(1) << 40};
+    const Roaring64* inputs[] = {&a, &b, &c};
+
+    assert_true(Roaring64::fastunion(3, inputs) == (a | b | c));
+    assert_true(Roaring64::fastintersection(3, inputs) == (a & b & c));
+    assert_true(Roaring64::fastxor(3, inputs) == (a ^ b ^ c));
+    assert_true(Roaring64::fastunion(0, inputs).isEmpty());
+    assert_true(Roaring64::fastintersection(0, inputs).isEmpty());
+
+    Roaring64 d{10, 20};
+    const Roaring64* disjoint[] = {&a, &d};
+    assert_true(Roaring64::fastintersection(2, disjoint).isEmpty());
+}
+
 int main() {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_cpp_r64_default_empty),
         cmocka_unit_test(test_cpp_r64_copy_and_move),
         cmocka_unit_test(test_cpp_r64_add_remove_contains_clear),
+        cmocka_unit_test(test_cpp_r64_appender),
         cmocka_unit_test(test_cpp_r64_construction_helpers),
         cmocka_unit_test(test_cpp_r64_minmax_equals),
         cmocka_unit_test(test_cpp_r64_set_ops),
         cmocka_unit_test(test_cpp_r64_iteration),
         cmocka_unit_test(test_cpp_r64_bidirectional),
         cmocka_unit_test(test_cpp_r64_random_vs_set),
+        cmocka_unit_test(test_cpp_r64_ranges_and_rank),
+        cmocka_unit_test(test_cpp_r64_bulk_context),
+        cmocka_unit_test(test_cpp_r64_comparisons),
+        cmocka_unit_test(test_cpp_r64_from_roaring32),
+        cmocka_unit_test(test_cpp_r64_iterator_reads),
+        cmocka_unit_test(test_cpp_r64_serialization),
+        cmocka_unit_test(test_cpp_r64_fast_many),
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -23,6 +23,7 @@
 
 using roaring::Roaring;       // the C++ wrapper class
 using roaring::Roaring64Map;  // C++ class extended for 64-bit numbers
+using roaring::Roaring64FlatMap;  // same API, sorted vector storage
 
 #include "roaring64map_checked.hh"
 #include "test.h"
@@ -1594,11 +1595,30 @@ DEFINE_TEST(test_cpp_frozen_64) {
 
     size_t num_bytes = r1.getFrozenSizeInBytes();
     char *buf = (char *)roaring_aligned_malloc(32, num_bytes);
-    r1.writeFrozen(buf);
+    assert_int_equal(r1.writeFrozen(buf), num_bytes);
 
     const Roaring64Map r2 = Roaring64Map::frozenView(buf);
     assert_true(r1 == r2);
 
+    // bounded view, for both outer storages
+    {
+        const Roaring64Map bounded = Roaring64Map::frozenView(buf, num_bytes);
+        assert_true(bounded == r1);
+        const Roaring64FlatMap flat =
+            Roaring64FlatMap::frozenView(buf, num_bytes);
+        assert_true(Roaring64Map(flat) == r1);
+    }
+#if ROARING_EXCEPTIONS
+    // truncated buffers are rejected
+    for (size_t length : {size_t(0), size_t(7), size_t(40), num_bytes - 1}) {
+        try {
+            Roaring64Map::frozenView(buf, length);
+            assert(false);
+        } catch (...) {
+        }
+    }
+#endif
+
     // copy constructor
     {
         Roaring64Map tmp(r2);
@@ -2312,6 +2332,24 @@ DEFINE_TEST(test_cpp_contains_range_interleaved_containers) {
     }
 }
 
+DEFINE_TEST(test_cpp_words) {
+    Roaring r;
+    r.addRange(100, 1000);
+    r.add(70000);
+    r.add(131072 + 5);
+    std::vector<uint64_t> words(2048 / 64);
+    r.toWords(64, 2048, words.data());
+    assert_true(words[0] == ~uint64_t(0) << 36);
+    Roaring back = Roaring::fromWords(words.data(), words.size(), 64);
+    assert_true(back.cardinality() == 900);
+    assert_true(back.minimum() == 100 && back.maximum() == 999);
+
+    std::vector<uint64_t> more((65536 + 6 + 63) / 64);
+    r.toWords(65536, 65536 + 6, more.data());
+    back.addWords(more.data(), more.size(), 65536);
+    assert_true(back == r);
+}
+
 // Test that it is pointed to the new map, see
 // https://github.com/RoaringBitmap/CRoaring/issues/589
 DEFINE_TEST(test_cpp_copy_map_iterator_to_different_map) {
@@ -2326,6 +2364,113 @@ DEFINE_TEST(test_cpp_copy_map_iterator_to_different_map) {
     assert_int_equal(2, n);
 }
 
+DEFINE_TEST(test_cpp_flat_map_64) {
+    // Roaring64FlatMap must behave exactly like Roaring64Map. Values are drawn
+    // from a few high words so that entries get inserted and erased in the
+    // middle of the outer storage.
+    std::mt19937_64 gen(1234);
+    auto random_value = [&gen]() {
+        return ((gen() % 12) << 32) | (gen() % 300000);
+    };
+    auto random_map = [&]() {
+        Roaring64Map r;
+        for (int i = 0; i < 200; ++i) {
+            r.add(random_value());
+        }
+        uint64_t start = random_value();
+        r.addRange(start, start + gen() % 300000);
+        return r;
+    };
+    auto check = [](const Roaring64Map &m, const Roaring64FlatMap &f) {
+        assert_true(Roaring64FlatMap(m) == f);
+        assert_true(Roaring64Map(f) == m);
+        assert_int_equal(m.cardinality(), f.cardinality());
+        // Full iteration would be slow; compare a prefix.
+        auto m_it = m.begin();
+        auto f_it = f.begin();
+        for (int i = 0; i < 1000 && m_it != m.end(); ++i, ++m_it, ++f_it) {
+            assert_true(f_it != f.end() && *m_it == *f_it);
+        }
+    };
+
+    Roaring64Map m;
+    Roaring64FlatMap f;
+    for (int round = 0; round < 200; ++round) {
+        // Short ranges, a few of which cross into the next high word.
+        uint64_t a = random_value();
+        if (round % 40 < 10) {
+            a = (a & ~uint64_t(0xFFFFFFFF)) | (0xFFFFFFFF - gen() % 300000);
+        }
+        uint64_t b = a + gen() % 300000;
+        Roaring64Map other = random_map();
+        Roaring64FlatMap flat_other(other);
+        switch (round % 10) {
+            case 0:
+                m.add(a);
+                f.add(a);
+                m.remove(b);
+                f.remove(b);
+                break;
+            case 1:
+                m.addRange(a, b);
+                f.addRange(a, b);
+                break;
+            case 2:
+                m.removeRange(a, b);
+                f.removeRange(a, b);
+                break;
+            case 3:
+                m.flip(a, b);
+                f.flip(a, b);
+                break;
+            case 4:
+                m |= other;
+                f |= flat_other;
+                break;
+            case 5:
+                m ^= other;
+                f ^= flat_other;
+                break;
+            case 6:
+                other |= m;
+                flat_other |= f;
+                m &= other;
+                f &= flat_other;
+                break;
+            case 7:
+                m -= other;
+                f -= flat_other;
+                break;
+            case 8: {
+                const Roaring64Map *maps[] = {&m, &other};
+                const Roaring64FlatMap *flat_maps[] = {&f, &flat_other};
+                m = Roaring64Map::fastunion(2, maps);
+                f = Roaring64FlatMap::fastunion(2, flat_maps);
+                break;
+            }
+            default:
+                m.addMany(1, &a);
+                f.addMany(1, &a);
+                assert_int_equal(m.shrinkToFit(), f.shrinkToFit());
+                assert_true(m.runOptimize() == f.runOptimize());
+                break;
+        }
+        check(m, f);
+        assert_int_equal(m.rank(a), f.rank(a));
+        assert_true(m.contains(b) == f.contains(b));
+        auto m_it = m.begin();
+        auto f_it = f.begin();
+        assert_true(m_it.move_equalorlarger(a) == f_it.move_equalorlarger(a));
+        assert_true(m_it == m.end() || *m_it == *f_it);
+    }
+
+    std::vector<char> buf(f.getSizeInBytes());
+    assert_int_equal(f.write(buf.data()), buf.size());
+    assert_int_equal(m.getSizeInBytes(), buf.size());
+    check(Roaring64Map::readSafe(buf.data(), buf.size()),
+          Roaring64FlatMap::readSafe(buf.data(), buf.size()));
+}
+
 int main() {
     roaring::misc::tellmeall();
     const struct CMUnitTest tests[] = {
@@ -2403,7 +2548,9 @@ int main() {
         cmocka_unit_test(test_cpp_to_string),
         cmocka_unit_test(test_cpp_remove_run_compression),
         cmocka_unit_test(test_cpp_contains_range_interleaved_containers),
+        cmocka_unit_test(test_cpp_words),
         cmocka_unit_test(test_cpp_copy_map_iterator_to_different_map),
+        cmocka_unit_test(test_cpp_flat_map_64),
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
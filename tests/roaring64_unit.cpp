@@ -3,6 +3,7 @@
 #include <map>
 #include <numeric>
 #include <random>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -340,6 +341,35 @@ DEFINE_TEST(test_add_bulk) {
     roaring64_bitmap_free(r);
 }
 
+DEFINE_TEST(test_appender) {
+    roaring64_bitmap_t* r = roaring64_bitmap_create();
+    roaring64_bitmap_t* expected = roaring64_bitmap_create();
+    roaring64_bitmap_add(r, 10);
+    roaring64_bitmap_add(expected, 10);
+    roaring64_bitmap_appender_t* a = roaring64_bitmap_appender_create(r);
+    std::vector<uint64_t> vals;
+    for (uint64_t v = 0; v < 200000; v += 3) {
+        vals.push_back(v);
+    }
+    for (uint64_t v = 1ULL << 40; v < (1ULL << 40) + 100000; v++) {
+        vals.push_back(v);
+    }
+    for (uint64_t v = 1ULL << 50; v < (1ULL << 60); v += 1ULL << 50) {
+        vals.push_back(v);
+    }
+    vals.push_back(4);  // out of order
+    vals.push_back(UINT64_MAX);
+    for (uint64_t v : vals) {
+        roaring64_bitmap_appender_add(a, v);
+        roaring64_bitmap_add(expected, v);
+    }
+    roaring64_bitmap_appender_free(a);
+    assert_r64_valid(r);
+    assert_true(roaring64_bitmap_equals(r, expected));
+    roaring64_bitmap_free(r);
+    roaring64_bitmap_free(expected);
+}
+
 DEFINE_TEST(test_add_many) {
     {
         roaring64_bitmap_t* r = roaring64_bitmap_create();
@@ -2042,6 +2072,133 @@ DEFINE_TEST(test_frozen_serialize) {
     roaring64_bitmap_free(r);
 }
 
+// Containers of up to three values are kept inline in the leaves, check that
+// they behave like any other container.
+DEFINE_TEST(test_sparse_leaves) {
+    roaring64_bitmap_t* r = roaring64_bitmap_create();
+    std::set<uint64_t> expected;
+    for (uint64_t high = 0; high < 200; high++) {
+        uint64_t base = high * 0x123450000ULL;
+        for (uint64_t i = 0; i < high % 6; i++) {
+            uint64_t v = base + ((high * 7919 + i * 104729) & 0xFFFF);
+            roaring64_bitmap_add(r, v);
+            expected.insert(v);
+        }
+    }
+    roaring64_bitmap_t* dense = roaring64_bitmap_create();
+    for (uint64_t high = 0; high < 200; high += 3) {
+        roaring64_bitmap_add_range(dense, high * 0x123450000ULL,
+                                   high * 0x123450000ULL + 0x8000);
+    }
+    assert_r64_valid(r);
+    assert_int_equal(roaring64_bitmap_get_cardinality(r), expected.size());
+    for (uint64_t v : expected) {
+        assert_true(roaring64_bitmap_contains(r, v));
+        assert_int_equal(roaring64_bitmap_contains(r, v + 1),
+                         expected.count(v + 1));
+    }
+    std::vector<uint64_t> values(expected.begin(), expected.end());
+    std::vector<uint64_t> actual(values.size());
+    roaring64_bitmap_to_uint64_array(r, actual.data());
+    assert_vector_equal(actual, values);
+    assert_int_equal(roaring64_bitmap_minimum(r), values.front());
+    assert_int_equal(roaring64_bitmap_maximum(r), values.back());
+    uint64_t element;
+    assert_true(roaring64_bitmap_select(r, values.size() / 2, &element));
+    assert_int_equal(element, values[values.size() / 2]);
+    assert_int_equal(roaring64_bitmap_rank(r, values[7]), 8);
+
+    roaring64_statistics_t stats;
+    roaring64_bitmap_statistics(r, &stats);
+    assert_int_equal(stats.n_array_containers, stats.n_containers);
+    assert_int_equal(stats.n_values_array_containers, expected.size());
+
+    // Set operations, in place or not, with sparse and dense bitmaps.
+    roaring64_bitmap_t* r_copy = roaring64_bitmap_copy(r);
+    assert_true(roaring64_bitmap_equals(r, r_copy));
+    roaring64_bitmap_t* ored = roaring64_bitmap_or(r, dense);
+    roaring64_bitmap_t* anded = roaring64_bitmap_and(r, dense);
+    roaring64_bitmap_t* xored = roaring64_bitmap_xor(r, dense);
+    roaring64_bitmap_t* andnoted = roaring64_bitmap_andnot(r, dense);
+    assert_int_equal(roaring64_bitmap_get_cardinality(ored),
+                     roaring64_bitmap_or_cardinality(r, dense));
+    assert_int_equal(roaring64_bitmap_get_cardinality(anded),
+                     roaring64_bitmap_and_cardinality(r, dense));
+    assert_true(roaring64_bitmap_is_subset(anded, r));
+    assert_true(roaring64_bitmap_is_subset(andnoted, r));
+    roaring64_bitmap_or_inplace(r_copy, dense);
+    assert_true(roaring64_bitmap_equals(r_copy, ored));
+    roaring64_bitmap_xor_inplace(r_copy, ored);
+    assert_true(roaring64_bitmap_is_empty(r_copy));
+    roaring64_bitmap_overwrite(r_copy, r);
+    roaring64_bitmap_and_inplace(r_copy, dense);
+    assert_true(roaring64_bitmap_equals(r_copy, anded));
+    roaring64_bitmap_overwrite(r_copy, r);
+    roaring64_bitmap_andnot_inplace(r_copy, dense);
+    assert_true(roaring64_bitmap_equals(r_copy, andnoted));
+    roaring64_bitmap_overwrite(r_copy, r);
+    roaring64_bitmap_xor_inplace(r_copy, dense);
+    assert_true(roaring64_bitmap_equals(r_copy, xored));
+    const roaring64_bitmap_t* inputs[] = {r, dense, anded};
+    roaring64_bitmap_t* or_many = roaring64_bitmap_or_many(3, inputs);
+    assert_true(roaring64_bitmap_equals(or_many, ored));
+    roaring64_bitmap_t* and_many = roaring64_bitmap_and_many(3, inputs);
+    assert_true(roaring64_bitmap_equals(and_many, anded));
+    for (roaring64_bitmap_t* b :
+         {r_copy, ored, anded, xored, andnoted, or_many, and_many}) {
+        assert_r64_valid(b);
+        roaring64_bitmap_free(b);
+    }
+
+    // Grow containers past the inline limit and shrink them back.
+    roaring64_bitmap_t* grown = roaring64_bitmap_copy(r);
+    for (uint64_t v : values) {
+        roaring64_bitmap_add_range_closed(grown, v, v + 5);
+    }
+    assert_r64_valid(grown);
+    for (uint64_t v : values) {
+        roaring64_bitmap_remove_range_closed(grown, v + 1, v + 5);
+    }
+    roaring64_bitmap_andnot_inplace(grown, r);
+    roaring64_bitmap_or_inplace(grown, r);
+    roaring64_bitmap_shrink_to_fit(grown);
+    assert_r64_valid(grown);
+    assert_true(roaring64_bitmap_equals(grown, r));
+    roaring64_bitmap_free(grown);
+
+    roaring64_bitmap_t* shifted = roaring64_bitmap_add_offset(r, 0x18000);
+    assert_int_equal(roaring64_bitmap_get_cardinality(shifted),
+                     expected.size());
+    assert_r64_valid(shifted);
+    roaring64_bitmap_free(shifted);
+    roaring64_bitmap_t* flipped = roaring64_bitmap_flip(r, 0, 1 << 20);
+    roaring64_bitmap_flip_inplace(flipped, 0, 1 << 20);
+    assert_true(roaring64_bitmap_equals(flipped, r));
+    roaring64_bitmap_free(flipped);
+
+    check_portable_serialization(r);
+    check_frozen_serialization(r);
+    roaring64_bitmap_run_optimize(r);
+    check_frozen_serialization(r);
+
+    // Remove values one at a time, through both removal paths.
+    roaring64_bulk_context_t context{};
+    for (size_t i = 0; i < values.size(); i++) {
+        if (i % 2 == 0) {
+            assert_true(roaring64_bitmap_remove_checked(r, values[i]));
+            assert_false(roaring64_bitmap_remove_checked(r, values[i]));
+        } else {
+            roaring64_bitmap_remove_bulk(r, &context, values[i]);
+        }
+        assert_false(roaring64_bitmap_contains(r, values[i]));
+    }
+    assert_r64_valid(r);
+    assert_true(roaring64_bitmap_is_empty(r));
+
+    roaring64_bitmap_free(dense);
+    roaring64_bitmap_free(r);
+}
+
 bool roaring_iterator64_sumall(uint64_t value, void* param) {
     *(uint64_t*)param += value;
     return true;
@@ -2564,6 +2721,191 @@ DEFINE_TEST(test_iterator_read_ranges) {
     roaring64_bitmap_free(r);
 }
 
+DEFINE_TEST(test_range_runs) {
+    roaring64_bitmap_t* r = roaring64_bitmap_create();
+    roaring64_range_closed_t buf[4];
+    assert_int_equal(roaring64_bitmap_range_runs(r, 0, UINT64_MAX, buf, 4), 0);
+
+    uint64_t high_base = UINT64_C(1) << 40;
+    roaring64_bitmap_add_range_closed(r, 0, 2);
+    roaring64_bitmap_add(r, 10);
+    // bitset container whose run continues into the next container
+    for (uint64_t v = 0x10000; v < 0x1F000; v += 2) {
+        roaring64_bitmap_add(r, v);
+    }
+    roaring64_bitmap_add_range_closed(r, 0x1F000, 0x20005);
+    roaring64_bitmap_add_range_closed(r, high_base, high_base + 100);
+    roaring64_bitmap_add(r, UINT64_MAX);
+
+    assert_int_equal(roaring64_bitmap_range_runs(r, 0, 20, buf, 4), 2);
+    assert_int_equal(buf[0].min, 0);
+    assert_int_equal(buf[0].max, 2);
+    assert_int_equal(buf[1].min, 10);
+    assert_int_equal(buf[1].max, 10);
+
+    // clipped on both ends, merged across containers
+    assert_int_equal(
+        roaring64_bitmap_range_runs(r, 0x1EFFE, high_base + 51, buf, 4), 3);
+    assert_int_equal(buf[0].min, 0x1EFFE);
+    assert_int_equal(buf[0].max, 0x1EFFE);
+    assert_int_equal(buf[1].min, 0x1F000);
+    assert_int_equal(buf[1].max, 0x20005);
+    assert_int_equal(buf[2].min, high_base);
+    assert_int_equal(buf[2].max, high_base + 50);
+
+    // limited output, then resumed two past the last max
+    assert_int_equal(
+        roaring64_bitmap_range_runs(r, 0x1EFFD, UINT64_MAX, buf, 1), 1);
+    assert_int_equal(buf[0].min, 0x1EFFE);
+    assert_int_equal(roaring64_bitmap_range_closed_runs(r, buf[0].max + 2,
+                                                        UINT64_MAX, buf, 4),
+                     3);
+    assert_int_equal(buf[0].min, 0x1F000);
+    assert_int_equal(buf[2].min, UINT64_MAX);
+    assert_int_equal(buf[2].max, UINT64_MAX);
+
+    roaring64_bitmap_run_optimize(r);
+    assert_int_equal(roaring64_bitmap_range_closed_runs(r, 1, 0x10003, buf, 4),
+                     4);
+    assert_int_equal(buf[0].min, 1);
+    assert_int_equal(buf[0].max, 2);
+    assert_int_equal(buf[3].min, 0x10002);
+    assert_int_equal(buf[3].max, 0x10002);
+    roaring64_bitmap_free(r);
+}
+
+DEFINE_TEST(test_leaf_cache) {
+    roaring64_bitmap_t* r = roaring64_bitmap_create();
+    roaring64_bitmap_t* expected = roaring64_bitmap_create();
+    assert_false(roaring64_bitmap_get_leaf_cache(r));
+    roaring64_bitmap_set_leaf_cache(r, true);
+    assert_true(roaring64_bitmap_get_leaf_cache(r));
+
+    // Few values per block, so that removals regularly empty a container and
+    // erase its leaf while it is cached.
+    std::mt19937_64 gen(1234);
+    for (int i = 0; i < 100000; ++i) {
+        uint64_t block = gen() % 64;
+        uint64_t val = (block << 36) | (gen() % 4);
+        switch (gen() % 5) {
+            case 0:
+                roaring64_bitmap_add(r, val);
+                roaring64_bitmap_add(expected, val);
+                break;
+            case 1:
+                assert_true(roaring64_bitmap_add_checked(r, val) ==
+                            roaring64_bitmap_add_checked(expected, val));
+                break;
+            case 2:
+                roaring64_bitmap_remove(r, val);
+                roaring64_bitmap_remove(expected, val);
+                break;
+            case 3:
+                assert_true(roaring64_bitmap_remove_checked(r, val) ==
+                            roaring64_bitmap_remove_checked(expected, val));
+                break;
+            default:
+                assert_true(roaring64_bitmap_contains(r, val) ==
+                            roaring64_bitmap_contains(expected, val));
+                break;
+        }
+        if (i % 10000 == 0) {
+            // Moves every leaf.
+            roaring64_bitmap_shrink_to_fit(r);
+        }
+    }
+    assert_r64_valid(r);
+    assert_true(roaring64_bitmap_equals(r, expected));
+
+    roaring64_bitmap_t* copy = roaring64_bitmap_copy(r);
+    assert_true(roaring64_bitmap_get_leaf_cache(copy));
+    roaring64_bitmap_add(copy, 5);
+    roaring64_bitmap_overwrite(copy, expected);
+    roaring64_bitmap_add(expected, UINT64_MAX);
+    roaring64_bitmap_add(copy, UINT64_MAX);
+    assert_true(roaring64_bitmap_contains(copy, UINT64_MAX));
+    assert_true(roaring64_bitmap_equals(copy, expected));
+
+    roaring64_bitmap_free(copy);
+    roaring64_bitmap_free(expected);
+    roaring64_bitmap_free(r);
+}
+
+DEFINE_TEST(test_many_way_ops) {
+    std::mt19937_64 gen(42);
+    std::vector<roaring64_bitmap_t*> bitmaps;
+    for (int i = 0; i < 20; ++i) {
+        roaring64_bitmap_t* r = roaring64_bitmap_create();
+        if (i % 7 != 6) {
+            // Arrays, bitsets and runs over a few shared blocks, plus a few
+            // blocks far apart.
+            for (int j = 0; j < 3000; ++j) {
+                roaring64_bitmap_add(r, gen() % (UINT64_C(1) << 19));
+            }
+            uint64_t base = (gen() % 4) << 16;
+            roaring64_bitmap_add_range(r, base, base + 40000);
+            roaring64_bitmap_add(r, (gen() % 8) << 40);
+            roaring64_bitmap_add(r, UINT64_MAX);
+            roaring64_bitmap_run_optimize(r);
+        }
+        bitmaps.push_back(r);
+    }
+    // The same bitmap twice cancels out in a xor.
+    bitmaps.push_back(bitmaps[0]);
+
+    const roaring64_bitmap_t** inputs =
+        const_cast<const roaring64_bitmap_t**>(bitmaps.data());
+    for (size_t n = 0; n <= bitmaps.size(); ++n) {
+        roaring64_bitmap_t* expected_or = roaring64_bitmap_create();
+        roaring64_bitmap_t* expected_xor = roaring64_bitmap_create();
+        roaring64_bitmap_t* expected_and =
+            n > 0 ? roaring64_bitmap_copy(bitmaps[0])
+                  : roaring64_bitmap_create();
+        for (size_t i = 0; i < n; ++i) {
+            roaring64_bitmap_or_inplace(expected_or, bitmaps[i]);
+            roaring64_bitmap_xor_inplace(expected_xor, bitmaps[i]);
+            roaring64_bitmap_and_inplace(expected_and, bitmaps[i]);
+        }
+
+        roaring64_bitmap_t* actual = roaring64_bitmap_or_many(n, inputs);
+        assert_r64_valid(actual);
+        assert_true(roaring64_bitmap_equals(actual, expected_or));
+        roaring64_bitmap_free(actual);
+
+        actual = roaring64_bitmap_xor_many(n, inputs);
+        assert_r64_valid(actual);
+        assert_true(roaring64_bitmap_equals(actual, expected_xor));
+        roaring64_bitmap_free(actual);
+
+        actual = roaring64_bitmap_and_many(n, inputs);
+        assert_r64_valid(actual);
+        assert_true(roaring64_bitmap_equals(actual, expected_and));
+        roaring64_bitmap_free(actual);
+
+        roaring64_bitmap_free(expected_or);
+        roaring64_bitmap_free(expected_xor);
+        roaring64_bitmap_free(expected_and);
+    }
+
+    // Intersection of bitmaps that all hold the last block.
+    std::vector<roaring64_bitmap_t*> nonempty;
+    for (auto* r : bitmaps) {
+        if (!roaring64_bitmap_is_empty(r)) {
+            nonempty.push_back(r);
+        }
+    }
+    roaring64_bitmap_t* actual = roaring64_bitmap_and_many(
+        nonempty.size(),
+        const_cast<const roaring64_bitmap_t**>(nonempty.data()));
+    assert_true(roaring64_bitmap_contains(actual, UINT64_MAX));
+    roaring64_bitmap_free(actual);
+
+    bitmaps.pop_back();
+    for (auto* r : bitmaps) {
+        roaring64_bitmap_free(r);
+    }
+}
+
 DEFINE_TEST(test_iterator_read_prev_ranges) {
     roaring64_bitmap_t* r = roaring64_bitmap_create();
 
@@ -2884,6 +3226,142 @@ DEFINE_TEST(test_iterator_read_past_end_can_go_previous) {
     roaring64_bitmap_free(bitmap);
 }
 
+// Counts the blocks a bitmap allocator hands out and has not taken back.
+struct counting_allocator {
+    int64_t live = 0;
+    uint64_t allocations = 0;
+    roaring_allocator_t allocator;
+
+    counting_allocator() {
+        allocator.malloc = [](void* context, size_t size) -> void* {
+            static_cast<counting_allocator*>(context)->count(nullptr);
+            return malloc(size);
+        };
+        allocator.realloc = [](void* context, void* p, size_t size) -> void* {
+            static_cast<counting_allocator*>(context)->count(p);
+            if (size == 0) {
+                allocator_free(context, p);
+                return nullptr;
+            }
+            return realloc(p, size);
+        };
+        allocator.free = allocator_free;
+        // The blocks are over-allocated, the address malloc gave precedes them.
+        allocator.aligned_malloc = [](void* context, size_t alignment,
+                                      size_t size) -> void* {
+            static_cast<counting_allocator*>(context)->count(nullptr);
+            char* p = static_cast<char*>(
+                malloc(size + alignment + sizeof(void*)));
+            if (p == nullptr) return nullptr;
+            uintptr_t aligned =
+                (reinterpret_cast<uintptr_t>(p + sizeof(void*)) + alignment -
+                 1) &
+                ~static_cast<uintptr_t>(alignment - 1);
+            reinterpret_cast<void**>(aligned)[-1] = p;
+            return reinterpret_cast<void*>(aligned);
+        };
+        allocator.aligned_free = [](void* context, void* p) {
+            if (p == nullptr) return;
+            allocator_free(context, static_cast<void**>(p)[-1]);
+        };
+        allocator.context = this;
+    }
+
+    void count(void* p) {
+        if (p == nullptr) live++;
+        allocations++;
+    }
+
+    static void allocator_free(void* context, void* p) {
+        if (p != nullptr) static_cast<counting_allocator*>(context)->live--;
+        free(p);
+    }
+};
+
+void fill_with_containers(roaring64_bitmap_t* r, uint64_t shift) {
+    for (uint64_t k = 0; k < 100; k++) {
+        uint64_t base = (k * 3 + shift) << 32;
+        if (k % 3 == 0) {
+            roaring64_bitmap_add_range_closed(r, base, base + 9000);
+        } else {
+            for (uint64_t j = 0; j < 20 * (k % 7); j++) {
+                roaring64_bitmap_add(r, base + j * 13 + shift);
+            }
+        }
+    }
+}
+
+DEFINE_TEST(test_allocator_bitmaps) {
+    counting_allocator counter;
+    roaring64_bitmap_t* a =
+        roaring64_bitmap_create_with_allocator(&counter.allocator);
+    roaring64_bitmap_t* b = roaring64_bitmap_create();
+    roaring64_bitmap_t* ra = roaring64_bitmap_create();
+    fill_with_containers(a, 0);
+    fill_with_containers(ra, 0);
+    fill_with_containers(b, 1);
+    assert_true(counter.live > 0);
+
+    // the heap bitmap never goes through the allocator, even as a result
+    uint64_t allocations = counter.allocations;
+    roaring64_bitmap_t* heap_or = roaring64_bitmap_or(b, a);
+    roaring64_bitmap_or_inplace(b, a);
+    assert_int_equal(counter.allocations, allocations);
+    assert_true(roaring64_bitmap_equals(b, heap_or));
+
+    // results computed from the bitmap inherit its allocator
+    int64_t live = counter.live;
+    std::vector<roaring64_bitmap_t*> results = {
+        roaring64_bitmap_or(a, ra), roaring64_bitmap_and(a, b),
+        roaring64_bitmap_xor(a, b), roaring64_bitmap_andnot(a, ra),
+        roaring64_bitmap_copy(a), roaring64_bitmap_flip(a, 0, 1 << 20)};
+    assert_true(counter.live > live);
+    assert_true(roaring64_bitmap_equals(results[0], ra));
+    assert_true(roaring64_bitmap_equals(results[1], ra));
+    assert_true(roaring64_bitmap_is_empty(results[3]));
+    assert_true(roaring64_bitmap_equals(results[4], ra));
+    for (roaring64_bitmap_t* result : results) {
+        assert_r64_valid(result);
+        roaring64_bitmap_free(result);
+    }
+    assert_int_equal(counter.live, live);
+
+    roaring64_bitmap_run_optimize(a);
+    roaring64_bitmap_shrink_to_fit(a);
+    roaring64_bitmap_and_inplace(a, b);
+    assert_true(roaring64_bitmap_equals(a, ra));
+    roaring64_bitmap_free(a);
+    assert_int_equal(counter.live, 0);
+
+    roaring64_bitmap_free(heap_or);
+    roaring64_bitmap_free(b);
+    roaring64_bitmap_free(ra);
+}
+
+DEFINE_TEST(test_arena_bitmaps) {
+    roaring_arena_t* arena = roaring_arena_create(4096);
+    assert_non_null(arena);
+    roaring64_bitmap_t* a = roaring64_bitmap_create_in_arena(arena);
+    roaring64_bitmap_t* b = roaring64_bitmap_create_in_arena(arena);
+    roaring64_bitmap_t* ra = roaring64_bitmap_create();
+    fill_with_containers(a, 0);
+    fill_with_containers(b, 2);
+    fill_with_containers(ra, 0);
+    roaring64_bitmap_t* c = roaring64_bitmap_or(a, b);
+    roaring64_bitmap_or_inplace(ra, b);
+    assert_true(roaring64_bitmap_equals(c, ra));
+    assert_true(roaring_arena_size_in_bytes(arena) > 0);
+
+    // the bitmaps are released in O(1), and the arena once they are all gone
+    roaring64_bitmap_free(a);
+    roaring_arena_free(arena);
+    assert_r64_valid(c);
+    assert_true(roaring64_bitmap_equals(c, ra));
+    roaring64_bitmap_free(b);
+    roaring64_bitmap_free(c);
+    roaring64_bitmap_free(ra);
+}
+
 }  // namespace
 
 int main() {
@@ -2901,6 +3379,7 @@ int main() {
         cmocka_unit_test(test_add_checked),
         cmocka_unit_test(test_add_bulk),
         cmocka_unit_test(test_add_many),
+        cmocka_unit_test(test_appender),
         cmocka_unit_test(test_add_range_closed),
         cmocka_unit_test(test_contains_range),
         cmocka_unit_test(test_contains_range_closed),
@@ -2942,6 +3421,7 @@ int main() {
         cmocka_unit_test(test_add_offset),
         cmocka_unit_test(test_portable_serialize),
         cmocka_unit_test(test_frozen_serialize),
+        cmocka_unit_test(test_sparse_leaves),
         cmocka_unit_test(test_iterate),
         cmocka_unit_test(test_to_uint64_array),
         cmocka_unit_test(test_iterator_create),
@@ -2955,6 +3435,9 @@ int main() {
         cmocka_unit_test(test_iterator_read),
         cmocka_unit_test(test_iterator_read_backward),
         cmocka_unit_test(test_iterator_read_ranges),
+        cmocka_unit_test(test_range_runs),
+        cmocka_unit_test(test_leaf_cache),
+        cmocka_unit_test(test_many_way_ops),
         cmocka_unit_test(test_iterator_read_prev_ranges),
         cmocka_unit_test(test_iterator_read_ranges_mid_range),
         cmocka_unit_test(test_iterator_read_ranges_uint64_max),
@@ -2962,6 +3445,8 @@ int main() {
         cmocka_unit_test(test_iterator_read_ranges_interleaved),
         cmocka_unit_test(test_stats),
         cmocka_unit_test(test_iterator_read_past_end_can_go_previous),
+        cmocka_unit_test(test_allocator_bitmaps),
+        cmocka_unit_test(test_arena_bitmaps),
     };
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
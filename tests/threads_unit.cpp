@@ -1,9 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <thread>
+#include <vector>
 
+#include <roaring/bitset/bitset.h>
 #include <roaring/misc/configreport.h>
 #include <roaring/roaring.h>
+#include <roaring/roaring64map.hh>
 
 // We are mostly running this test to check for data races using thread
 // sanitizer.
@@ -74,9 +77,280 @@ bool run_threads_unit_tests() {
     return true;
 }
 
+// Runs the tasks on a fixed number of std::threads, task i going to thread
+// i % nthreads.
+static void thread_executor(void *context, size_t num_tasks,
+                            roaring_task_fn task, void *task_arg) {
+    size_t nthreads = *(const size_t *)context;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < nthreads; t++) {
+        threads.emplace_back([=]() {
+            for (size_t i = t; i < num_tasks; i += nthreads) {
+                task(task_arg, i);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+bool run_executor_unit_tests() {
+    size_t nthreads = 4;
+    roaring_executor_t executor = {thread_executor, &nthreads};
+
+    std::vector<uint32_t> vals;
+    uint32_t x = 12345;
+    for (size_t i = 0; i < 1000000; i++) {
+        x = x * 1103515245 + 12345;
+        vals.push_back((i % 3 == 0) ? (x % 2000000) : x);
+    }
+    roaring_bitmap_t *expected = roaring_bitmap_create();
+    roaring_bitmap_add_many(expected, vals.size(), vals.data());
+    roaring_bitmap_t *r =
+        roaring_bitmap_of_unsorted(vals.size(), vals.data(), &executor);
+    bool is_ok = r != NULL && roaring_bitmap_equals(r, expected);
+
+    // containers holding runs, spread over many keys
+    for (uint32_t k = 0; k < 2000; k++) {
+        roaring_bitmap_add_range(r, k * 65536 + 100, k * 65536 + 20000);
+        roaring_bitmap_add_range(expected, k * 65536 + 100, k * 65536 + 20000);
+    }
+    is_ok = is_ok && roaring_bitmap_run_optimize_parallel(r, &executor) ==
+                         roaring_bitmap_run_optimize(expected);
+    roaring_bitmap_shrink_to_fit_parallel(r, &executor);
+    is_ok = is_ok && roaring_bitmap_equals(r, expected) &&
+            roaring_bitmap_portable_size_in_bytes(r) ==
+                roaring_bitmap_portable_size_in_bytes(expected);
+    is_ok = is_ok && roaring_bitmap_remove_run_compression_parallel(
+                         r, &executor) &&
+            !roaring_bitmap_remove_run_compression_parallel(r, &executor) &&
+            roaring_bitmap_equals(r, expected);
+
+    std::vector<char> serial(roaring_bitmap_portable_size_in_bytes(r));
+    std::vector<char> parallel(serial.size());
+    roaring_bitmap_portable_serialize(r, serial.data());
+    is_ok = is_ok && roaring_bitmap_portable_serialize_parallel(
+                         r, parallel.data(), &executor) == parallel.size();
+    is_ok = is_ok && serial == parallel;
+    roaring_bitmap_t *back = roaring_bitmap_portable_deserialize_safe_parallel(
+        parallel.data(), parallel.size(), &executor);
+    is_ok = is_ok && back != NULL && roaring_bitmap_equals(r, back);
+    roaring_bitmap_free(back);
+    roaring_bitmap_free(r);
+    roaring_bitmap_free(expected);
+
+    roaring64_bitmap_t *r64 = roaring64_bitmap_create();
+    for (uint64_t k = 0; k < 2000; k++) {
+        uint64_t base = k << 36;
+        roaring64_bitmap_add_range(r64, base, base + 30000);
+        for (uint64_t v = base + 65536; v < base + 2 * 65536; v += 5) {
+            roaring64_bitmap_add(r64, v);
+        }
+    }
+    roaring64_bitmap_t *r64_copy = roaring64_bitmap_copy(r64);
+    is_ok = is_ok && roaring64_bitmap_run_optimize_parallel(r64, &executor);
+    roaring64_bitmap_shrink_to_fit_parallel(r64, &executor);
+    is_ok = is_ok && roaring64_bitmap_internal_validate(r64, NULL) &&
+            roaring64_bitmap_equals(r64, r64_copy);
+    is_ok = is_ok &&
+            roaring64_bitmap_remove_run_compression_parallel(r64, &executor) &&
+            roaring64_bitmap_equals(r64, r64_copy);
+    roaring64_bitmap_free(r64);
+    roaring64_bitmap_free(r64_copy);
+    return is_ok;
+}
+
+// Checks the executor variants of the Roaring64Map set operations against
+// the sequential operators.
+template <typename Map>
+bool run_map64_executor_unit_tests(const roaring_executor_t *executor) {
+    std::vector<Map> maps(3);
+    uint64_t x = 6789;
+    for (size_t m = 0; m < maps.size(); m++) {
+        for (uint64_t high = 0; high < 300; high++) {
+            x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+            if ((x >> 60) % 3 == m % 3) {
+                continue;  // keys missing from some of the maps
+            }
+            uint64_t base = (high * 7) << 32;
+            maps[m].addRange(base + (x >> 50), base + (x >> 50) + 20000);
+            for (uint64_t v = base + 100000; v < base + 200000; v += 3 + m) {
+                maps[m].add(v);
+            }
+        }
+    }
+    maps[2].add(uint64_t(1) << 63);
+
+    bool is_ok = true;
+    for (size_t i = 0; i < maps.size(); i++) {
+        const Map &a = maps[i];
+        const Map &b = maps[(i + 1) % maps.size()];
+        Map expected = a;
+        Map actual = a;
+        expected |= b;
+        is_ok = is_ok && actual.orInplace(b, executor) == expected;
+        expected = a;
+        actual = a;
+        expected &= b;
+        is_ok = is_ok && actual.andInplace(b, executor) == expected;
+        expected = a;
+        actual = a;
+        expected ^= b;
+        is_ok = is_ok && actual.xorInplace(b, executor) == expected;
+        is_ok = is_ok && actual.xorInplace(actual, executor).isEmpty();
+    }
+
+    // Entries that are empty, or that the operation leaves empty, are kept or
+    // erased as the operators do: the serialized sizes count the entries.
+    const Map empty_entry{roaring::Roaring()};
+    Map self = maps[0];
+    self.removeRange(0, uint64_t(1) << 32);
+    Map other = maps[1];
+    other.removeRange(0, uint64_t(1) << 32);
+    self |= empty_entry;
+    for (int both = 0; both < 2; both++) {
+        Map expected = self;
+        Map actual = self;
+        expected |= other;
+        actual.orInplace(other, executor);
+        is_ok = is_ok && actual.getSizeInBytes() == expected.getSizeInBytes();
+        expected = self;
+        actual = self;
+        expected ^= other;
+        actual.xorInplace(other, executor);
+        is_ok = is_ok && actual.getSizeInBytes() == expected.getSizeInBytes();
+        other |= empty_entry;
+    }
+
+    const Map *inputs[] = {&maps[0], &maps[1], &maps[2]};
+    Map expected = maps[0] | maps[1] | maps[2];
+    is_ok = is_ok && Map::fastunion(3, inputs, executor) == expected;
+    is_ok = is_ok && Map::fastunion(3, inputs) == expected;
+    is_ok = is_ok && Map::fastunion(0, inputs, executor).isEmpty();
+    return is_ok;
+}
+
+static void *plain_malloc(void *, size_t size) { return malloc(size); }
+static void *plain_realloc(void *, void *p, size_t size) {
+    return realloc(p, size);
+}
+static void plain_free(void *, void *p) { free(p); }
+static void *plain_aligned_malloc(void *, size_t alignment, size_t size) {
+    return roaring_aligned_malloc(alignment, size);
+}
+static void plain_aligned_free(void *, void *p) { roaring_aligned_free(p); }
+
+static void refusing_executor(void *context, size_t, roaring_task_fn, void *) {
+    *(bool *)context = true;
+}
+
+// Checks that the executor variants of the Roaring64Map set operations do not
+// use the executor once an inner bitmap has an allocator, which need not be
+// thread safe.
+template <typename Map>
+bool run_map64_allocator_unit_tests() {
+    roaring_allocator_t allocator = {
+        plain_malloc,         plain_realloc,      plain_free,
+        plain_aligned_malloc, plain_aligned_free, nullptr};
+    bool called = false;
+    roaring_executor_t executor = {refusing_executor, &called};
+    // copies of the maps would not keep the allocator: build them in place
+    auto make_map = [&](uint64_t first, uint64_t last) {
+        roaring::Roaring r(roaring_bitmap_create_with_allocator(&allocator));
+        Map m(std::move(r));
+        for (uint64_t high = 0; high < 100; high++) {
+            m.addRange((high << 32) + first, (high << 32) + last);
+        }
+        return m;
+    };
+    Map b = make_map(2000, 9000);
+    Map heap_b;
+    heap_b |= b;
+    Map expected = make_map(10, 5000);
+    Map actual = make_map(10, 5000);
+    const Map *inputs[] = {&heap_b, &actual};
+    bool is_ok = Map::fastunion(2, inputs, &executor) == (expected | b);
+    expected |= heap_b;
+    is_ok = is_ok && actual.orInplace(heap_b, &executor) == expected;
+    expected &= b;
+    is_ok = is_ok && actual.andInplace(b, &executor) == expected;
+    actual = make_map(10, 5000);
+    Map expected_xor = heap_b;
+    expected_xor ^= actual;
+    is_ok = is_ok && heap_b.xorInplace(actual, &executor) == expected_xor;
+    return is_ok && !called;
+}
+
+// Checks the executor variants of the bitset_t operations, on bitsets split
+// in several chunks, against the sequential ones.
+bool run_bitset_executor_unit_tests(const roaring_executor_t *executor) {
+    const size_t words1 = 300001, words2 = 250003;
+    bitset_t *b1 = bitset_create_with_capacity(words1 * 64);
+    bitset_t *b2 = bitset_create_with_capacity(words2 * 64);
+    uint64_t x = 4242;
+    for (size_t k = 0; k < words1; k++) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        b1->array[k] = x;
+    }
+    for (size_t k = 0; k < words2; k++) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        b2->array[k] = x ^ (x >> 29);
+    }
+    bool is_ok = bitset_count_parallel(b1, executor) == bitset_count(b1);
+    for (int swap = 0; swap < 2; swap++) {
+        const bitset_t *a = swap ? b2 : b1;
+        const bitset_t *b = swap ? b1 : b2;
+        is_ok = is_ok && bitset_union_count_parallel(a, b, executor) ==
+                             bitset_union_count(a, b);
+        is_ok = is_ok && bitset_intersection_count_parallel(a, b, executor) ==
+                             bitset_intersection_count(a, b);
+        is_ok = is_ok && bitset_difference_count_parallel(a, b, executor) ==
+                             bitset_difference_count(a, b);
+        is_ok = is_ok &&
+                bitset_symmetric_difference_count_parallel(a, b, executor) ==
+                    bitset_symmetric_difference_count(a, b);
+
+        bitset_t *expected = bitset_copy(a);
+        bitset_t *actual = bitset_copy(a);
+        auto same = [&]() {
+            return expected->arraysize == actual->arraysize &&
+                   memcmp(expected->array, actual->array,
+                          expected->arraysize * sizeof(uint64_t)) == 0;
+        };
+        bitset_inplace_union(expected, b);
+        is_ok = is_ok && bitset_inplace_union_parallel(actual, b, executor) &&
+                same();
+        bitset_inplace_difference(expected, b);
+        bitset_inplace_difference_parallel(actual, b, executor);
+        is_ok = is_ok && same();
+        bitset_inplace_symmetric_difference(expected, a);
+        is_ok = is_ok &&
+                bitset_inplace_symmetric_difference_parallel(actual, a,
+                                                             executor) &&
+                same();
+        bitset_inplace_intersection(expected, b);
+        bitset_inplace_intersection_parallel(actual, b, executor);
+        is_ok = is_ok && same();
+        bitset_free(expected);
+        bitset_free(actual);
+    }
+    bitset_free(b1);
+    bitset_free(b2);
+    return is_ok;
+}
+
 int main() {
     roaring::misc::tellmeall();
-    bool is_ok = run_threads_unit_tests();
+    size_t nthreads = 4;
+    roaring_executor_t executor = {thread_executor, &nthreads};
+    bool is_ok =
+        run_threads_unit_tests() && run_executor_unit_tests() &&
+        run_map64_executor_unit_tests<roaring::Roaring64Map>(&executor) &&
+        run_map64_executor_unit_tests<roaring::Roaring64FlatMap>(&executor) &&
+        run_map64_allocator_unit_tests<roaring::Roaring64Map>() &&
+        run_map64_allocator_unit_tests<roaring::Roaring64FlatMap>() &&
+        run_bitset_executor_unit_tests(&executor);
     if (is_ok) {
         printf("code run completed.\n");
     }
@@ -1131,6 +1131,209 @@ DEFINE_TEST(test_addremove_bulk) {
     roaring_bitmap_free(bm);
 }
 
+DEFINE_TEST(test_add_many_unsorted) {
+    // a mix of dense, sparse and duplicated keys, in scrambled order
+    const size_t n = 300000;
+    uint32_t *vals = (uint32_t *)malloc(n * sizeof(uint32_t));
+    for (size_t i = 0; i < n; i++) {
+        uint32_t v = our_rand();
+        switch (i % 4) {
+            case 0:
+                vals[i] = v % 100000;  // dense: becomes bitsets
+                break;
+            case 1:
+                vals[i] = v % 64 + (uint32_t)(i % 7) * 1000000;  // duplicates
+                break;
+            default:
+                vals[i] = v * 4099;  // sparse, spans all keys
+                break;
+        }
+    }
+    roaring_bitmap_t *expected = roaring_bitmap_create();
+    roaring_bitmap_add_many(expected, n, vals);
+
+    roaring_bitmap_t *r = roaring_bitmap_of_unsorted(n, vals, NULL);
+    assert_non_null(r);
+    assert_bitmap_validate(r);
+    assert_true(roaring_bitmap_equals(r, expected));
+    roaring_bitmap_free(r);
+
+    // adding to a non-empty bitmap merges
+    r = roaring_bitmap_from(1, 2, 3, 0xFFFFFFFF);
+    assert_true(roaring_bitmap_add_many_unsorted(r, n, vals, NULL));
+    assert_bitmap_validate(r);
+    const uint32_t extra[] = {1, 2, 3, 0xFFFFFFFF};
+    roaring_bitmap_add_many(expected, 4, extra);
+    assert_true(roaring_bitmap_equals(r, expected));
+    roaring_bitmap_free(r);
+
+    // small batches take the plain path
+    r = roaring_bitmap_of_unsorted(100, vals, NULL);
+    assert_true(roaring_bitmap_get_cardinality(r) <= 100);
+    for (size_t i = 0; i < 100; i++) {
+        assert_true(roaring_bitmap_contains(r, vals[i]));
+    }
+    roaring_bitmap_free(r);
+
+    roaring_bitmap_free(expected);
+    free(vals);
+}
+
+DEFINE_TEST(test_appender) {
+    roaring_bitmap_t *expected = roaring_bitmap_create();
+    roaring_bitmap_t *r = roaring_bitmap_from(5, 70000);
+    roaring_bitmap_add(expected, 5);
+    roaring_bitmap_add(expected, 70000);
+    roaring_bitmap_appender_t *a = roaring_bitmap_appender_create(r);
+    assert_non_null(a);
+    // sparse, dense and run-like keys, then a few out of order values
+    for (uint32_t v = 3; v < 65536; v += 1000) {
+        roaring_bitmap_appender_add(a, v);
+        roaring_bitmap_add(expected, v);
+    }
+    for (uint32_t v = 65536; v < 3 * 65536; v += 3) {
+        roaring_bitmap_appender_add(a, v);
+        roaring_bitmap_add(expected, v);
+    }
+    for (uint32_t v = 5 * 65536; v < 5 * 65536 + 50000; v++) {
+        roaring_bitmap_appender_add(a, v);
+        roaring_bitmap_add(expected, v);
+    }
+    assert_true(roaring_bitmap_appender_flush(a));
+    assert_bitmap_validate(r);
+    assert_true(roaring_bitmap_equals(r, expected));
+    assert_int_equal(r->high_low_container.typecodes[3], RUN_CONTAINER_TYPE);
+
+    const uint32_t late[] = {7, 7, 65537, 0xFFFFFFFF, 100000, 6};
+    for (size_t i = 0; i < sizeof(late) / sizeof(late[0]); i++) {
+        roaring_bitmap_appender_add(a, late[i]);
+        roaring_bitmap_add(expected, late[i]);
+    }
+    roaring_bitmap_appender_free(a);
+    assert_bitmap_validate(r);
+    assert_true(roaring_bitmap_equals(r, expected));
+    roaring_bitmap_free(r);
+    roaring_bitmap_free(expected);
+}
+
+// A bitmap allocator that never has memory to give.
+static void *failing_malloc(void *context, size_t size) {
+    (void)context;
+    (void)size;
+    return NULL;
+}
+
+static void *failing_realloc(void *context, void *p, size_t size) {
+    (void)context;
+    (void)p;
+    (void)size;
+    return NULL;
+}
+
+static void failing_free(void *context, void *p) {
+    (void)context;
+    free(p);
+}
+
+static void *failing_aligned_malloc(void *context, size_t alignment,
+                                    size_t size) {
+    (void)context;
+    (void)alignment;
+    (void)size;
+    return NULL;
+}
+
+DEFINE_TEST(test_appender_allocation_failure) {
+    roaring_allocator_t allocator = {
+        failing_malloc,         failing_realloc, failing_free,
+        failing_aligned_malloc, failing_free,    NULL};
+    roaring_bitmap_t *r = roaring_bitmap_create_with_allocator(&allocator);
+    assert_non_null(r);
+    roaring_bitmap_appender_t *a = roaring_bitmap_appender_create(r);
+    assert_non_null(a);
+    assert_true(roaring_bitmap_appender_flush(a));  // nothing to flush
+    for (uint32_t v = 0; v < 10; v++) {
+        assert_true(roaring_bitmap_appender_add(a, v));
+    }
+    // the container for the values of key 0 cannot be created
+    assert_false(roaring_bitmap_appender_add(a, 65536));
+    assert_false(roaring_bitmap_appender_flush(a));
+    assert_true(roaring_bitmap_appender_flush(a));
+    assert_true(roaring_bitmap_is_empty(r));
+    roaring_bitmap_appender_free(a);
+    roaring_bitmap_free(r);
+}
+
+DEFINE_TEST(test_run_optimize_parallel_serial_fallback) {
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    for (uint32_t k = 0; k < 300; k++) {
+        roaring_bitmap_add_range(r, k * 65536 + 10, k * 65536 + 10000);
+        roaring_bitmap_add(r, k * 65536 + 30000);
+    }
+    roaring_bitmap_t *copy = roaring_bitmap_copy(r);
+    assert_true(roaring_bitmap_remove_run_compression_parallel(r, NULL));
+    assert_true(roaring_bitmap_equals(r, copy));
+    assert_true(roaring_bitmap_run_optimize_parallel(r, NULL));
+    assert_true(roaring_bitmap_shrink_to_fit_parallel(r, NULL) > 0);
+    assert_bitmap_validate(r);
+    assert_true(roaring_bitmap_equals(r, copy));
+    roaring_bitmap_free(r);
+    roaring_bitmap_free(copy);
+}
+
+// Runs the tasks on the calling thread, last one first.
+static void reverse_executor(void *context, size_t num_tasks,
+                             roaring_task_fn task, void *task_arg) {
+    (void)context;
+    for (size_t i = num_tasks; i > 0; i--) {
+        task(task_arg, i - 1);
+    }
+}
+
+DEFINE_TEST(test_portable_serialize_parallel) {
+    roaring_executor_t executor = {reverse_executor, NULL};
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    for (uint32_t k = 0; k < 500; k++) {
+        if (k % 3 == 0) {
+            roaring_bitmap_add_range(r, k * 65536 + 10, k * 65536 + 10000);
+        } else {
+            uint32_t step = (k % 3 == 1) ? 3 : 101;
+            for (uint32_t v = 0; v < 65536; v += step) {
+                roaring_bitmap_add(r, k * 65536 + v);
+            }
+        }
+    }
+    for (int with_runs = 0; with_runs < 2; with_runs++) {
+        if (with_runs) roaring_bitmap_run_optimize(r);
+        size_t size = roaring_bitmap_portable_size_in_bytes(r);
+        char *expected = (char *)malloc(size);
+        char *buf = (char *)malloc(size);
+        assert_int_equal(roaring_bitmap_portable_serialize(r, expected), size);
+        assert_int_equal(
+            roaring_bitmap_portable_serialize_parallel(r, buf, &executor),
+            size);
+        assert_true(memcmp(buf, expected, size) == 0);
+
+        roaring_bitmap_t *back =
+            roaring_bitmap_portable_deserialize_safe_parallel(buf, size,
+                                                              &executor);
+        assert_non_null(back);
+        assert_bitmap_validate(back);
+        assert_true(roaring_bitmap_equals(r, back));
+        roaring_bitmap_free(back);
+        assert_true(roaring_bitmap_portable_deserialize_safe_parallel(
+                        buf, size - 1, &executor) == NULL);
+        back = roaring_bitmap_portable_deserialize_safe_parallel(buf, size,
+                                                                 NULL);
+        assert_non_null(back);
+        assert_true(roaring_bitmap_equals(r, back));
+        roaring_bitmap_free(back);
+        free(buf);
+        free(expected);
+    }
+    roaring_bitmap_free(r);
+}
+
 DEFINE_TEST(test_addremoverun) {
     roaring_bitmap_t *bm = roaring_bitmap_create();
     for (uint32_t value = 33057; value < 147849; value += 8) {
@@ -4588,6 +4791,235 @@ DEFINE_TEST(test_read_ranges_iterator_native) {
     test_read_ranges_iterator(UINT8_MAX);
 }
 
+// Reads the ranges of [start, end) in batches of ${step} with
+// roaring_bitmap_range_runs, comparing against the ranges of the values of
+// ${values} within [start, end).
+static void range_runs_compare(const roaring_bitmap_t *r,
+                               const uint32_t *values, uint32_t count,
+                               uint64_t start, uint64_t end, size_t step) {
+    uint32_t first = 0;
+    while (first < count && values[first] < start) first++;
+    uint32_t last = first;
+    while (last < count && values[last] < end) last++;
+    uint32_t num_ranges;
+    roaring_uint32_range_closed_t *expected =
+        ranges_from_values(values + first, last - first, &num_ranges);
+    roaring_uint32_range_closed_t *buffer =
+        (roaring_uint32_range_closed_t *)malloc(
+            sizeof(roaring_uint32_range_closed_t) * step);
+    uint32_t ranges_read = 0;
+    for (;;) {
+        size_t got = roaring_bitmap_range_runs(r, start, end, buffer, step);
+        assert_true(got <= step);
+        assert_true(ranges_read + got <= num_ranges);
+        for (size_t i = 0; i < got; i++) {
+            assert_int_equal(buffer[i].min, expected[ranges_read + i].min);
+            assert_int_equal(buffer[i].max, expected[ranges_read + i].max);
+        }
+        ranges_read += (uint32_t)got;
+        if (got < step) break;
+        start = (uint64_t)buffer[got - 1].max + 2;
+    }
+    assert_int_equal(ranges_read, num_ranges);
+    free(buffer);
+    free(expected);
+}
+
+static void test_range_runs(uint8_t type) {
+    uint32_t *ref_values;
+    uint32_t ref_count;
+    test_iterator_generate_data(&ref_values, &ref_count);
+
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    roaring_bitmap_add_many(r, ref_count, ref_values);
+    if (type != UINT8_MAX) {
+        convert_all_containers(r, type);
+    }
+    roaring_uint32_range_closed_t buf[1];
+    assert_int_equal(roaring_bitmap_range_runs(r, 0, UINT64_MAX, buf, 0), 0);
+    assert_int_equal(roaring_bitmap_range_runs(r, 10, 10, buf, 1), 0);
+
+    const uint64_t starts[] = {0, ref_values[1], ref_values[3] + 7,
+                               ref_values[ref_count / 3] + 1,
+                               ref_values[ref_count / 2]};
+    const uint64_t ends[] = {ref_values[ref_count / 2] + 3,
+                             ref_values[2 * ref_count / 3],
+                             (uint64_t)UINT32_MAX + 1, UINT64_MAX};
+    for (size_t i = 0; i < sizeof(starts) / sizeof(starts[0]); i++) {
+        for (size_t j = 0; j < sizeof(ends) / sizeof(ends[0]); j++) {
+            range_runs_compare(r, ref_values, ref_count, starts[i], ends[j],
+                               3);
+            range_runs_compare(r, ref_values, ref_count, starts[i], ends[j],
+                               100000);
+        }
+    }
+    roaring_bitmap_free(r);
+    free(ref_values);
+}
+
+DEFINE_TEST(test_range_runs_array) { test_range_runs(ARRAY_CONTAINER_TYPE); }
+DEFINE_TEST(test_range_runs_bitset) { test_range_runs(BITSET_CONTAINER_TYPE); }
+DEFINE_TEST(test_range_runs_run) { test_range_runs(RUN_CONTAINER_TYPE); }
+DEFINE_TEST(test_range_runs_native) { test_range_runs(UINT8_MAX); }
+
+static void to_words_compare(const roaring_bitmap_t *r, uint32_t start,
+                             uint32_t n) {
+    size_t nwords = ((size_t)n + 63) / 64;
+    uint64_t *words = (uint64_t *)malloc(nwords * sizeof(uint64_t));
+    memset(words, 0xAB, nwords * sizeof(uint64_t));
+    roaring_bitmap_to_words(r, start, n, words);
+    for (uint64_t i = 0; i < nwords * 64; i++) {
+        bool expected = i < n && (uint64_t)start + i <= UINT32_MAX &&
+                        roaring_bitmap_contains(r, (uint32_t)(start + i));
+        bool actual = (words[i / 64] >> (i % 64)) & 1;
+        assert_true(expected == actual);
+    }
+    free(words);
+}
+
+static void test_to_words(uint8_t type) {
+    uint32_t *ref_values;
+    uint32_t ref_count;
+    test_iterator_generate_data(&ref_values, &ref_count);
+
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    roaring_bitmap_add_many(r, ref_count, ref_values);
+    if (type != UINT8_MAX) {
+        convert_all_containers(r, type);
+    }
+    for (uint32_t i = 0; i < ref_count; i += ref_count / 23) {
+        to_words_compare(r, ref_values[i], 2048);
+        to_words_compare(r, ref_values[i] - ref_values[i] % 64, 2048);
+        to_words_compare(r, ref_values[i] - 1000, 70000);
+        to_words_compare(r, ref_values[i] + 5, 1);
+    }
+    to_words_compare(r, 0, 200);
+    to_words_compare(r, UINT32_MAX - 100, 1000);
+
+    // consecutive windows through one iterator match independent exports
+    const uint32_t sizes[] = {2048, 1000};
+    // the last value is UINT32_MAX, read separately
+    uint32_t last = ref_values[ref_count - 2];
+    uint64_t words[2048 / 64], expected[2048 / 64];
+    for (size_t k = 0; k < 2; k++) {
+        uint32_t n = sizes[k];
+        roaring_uint32_iterator_t it;
+        roaring_iterator_init(r, &it);
+        uint64_t card = 0;
+        for (uint32_t start = 0; start <= last; start += n) {
+            roaring_uint32_iterator_read_words(&it, start, n, words);
+            roaring_bitmap_to_words(r, start, n, expected);
+            assert_true(memcmp(words, expected,
+                               (n + 63) / 64 * sizeof(uint64_t)) == 0);
+            for (size_t w = 0; w < (n + 63) / 64; w++) {
+                card += roaring_hamming(words[w]);
+            }
+            assert_true(it.has_value);
+            assert_true(it.current_value >= start + n);
+        }
+        assert_false(roaring_uint32_iterator_read_words(&it, UINT32_MAX - 63,
+                                                        n, words));
+        assert_true(words[0] == (UINT64_C(1) << 63));
+        assert_int_equal(card + 1, ref_count);
+    }
+    roaring_bitmap_free(r);
+    free(ref_values);
+}
+
+DEFINE_TEST(test_to_words_array) { test_to_words(ARRAY_CONTAINER_TYPE); }
+DEFINE_TEST(test_to_words_bitset) { test_to_words(BITSET_CONTAINER_TYPE); }
+DEFINE_TEST(test_to_words_run) { test_to_words(RUN_CONTAINER_TYPE); }
+DEFINE_TEST(test_to_words_native) { test_to_words(UINT8_MAX); }
+
+DEFINE_TEST(test_to_words_empty_window) {
+    roaring_bitmap_t *r = roaring_bitmap_from_range(65536, 75536, 1);
+    convert_all_containers(r, BITSET_CONTAINER_TYPE);
+    // nothing may be written, not even for a window starting on a word
+    uint64_t *words = (uint64_t *)malloc(0);
+    roaring_bitmap_to_words(r, 65536 + 128, 0, words);
+    roaring_bitmap_to_words(r, 65536 + 5, 0, words);
+    roaring_bitmap_to_words(r, 0, 0, words);
+    roaring_uint32_iterator_t it;
+    roaring_iterator_init(r, &it);
+    assert_true(roaring_uint32_iterator_read_words(&it, 65536 + 128, 0, words));
+    free(words);
+    roaring_bitmap_free(r);
+}
+
+// Exports [start, start + n) of r to words, reads them back with
+// roaring_bitmap_from_words and roaring_bitmap_or_words, and compares.
+static void from_words_compare(const roaring_bitmap_t *r, uint32_t start,
+                               uint32_t n, const roaring_bitmap_t *other) {
+    size_t nwords = ((size_t)n + 63) / 64;
+    uint64_t *words = (uint64_t *)malloc(nwords * sizeof(uint64_t));
+    roaring_bitmap_to_words(r, start, n, words);
+    uint64_t end = (uint64_t)start + n;
+    if (end > (uint64_t)UINT32_MAX + 1) end = (uint64_t)UINT32_MAX + 1;
+    roaring_bitmap_t *window = roaring_bitmap_create();
+    roaring_bitmap_add_range(window, start, end);
+    roaring_bitmap_and_inplace(window, r);
+
+    roaring_bitmap_t *back = roaring_bitmap_from_words(words, nwords, start);
+    assert_non_null(back);
+    assert_bitmap_validate(back);
+    assert_true(roaring_bitmap_equals(back, window));
+    roaring_bitmap_free(back);
+
+    roaring_bitmap_t *merged = roaring_bitmap_copy(other);
+    assert_true(roaring_bitmap_or_words(merged, words, nwords, start));
+    roaring_bitmap_or_inplace(window, other);
+    assert_bitmap_validate(merged);
+    assert_true(roaring_bitmap_equals(merged, window));
+    roaring_bitmap_free(merged);
+    roaring_bitmap_free(window);
+    free(words);
+}
+
+DEFINE_TEST(test_from_words) {
+    uint32_t *ref_values;
+    uint32_t ref_count;
+    test_iterator_generate_data(&ref_values, &ref_count);
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    roaring_bitmap_add_many(r, ref_count, ref_values);
+
+    roaring_bitmap_t *other = roaring_bitmap_create();
+    for (uint32_t v = 1234 * 65536; v < 1300 * 65536; v += 3) {
+        roaring_bitmap_add(other, v);  // bitset containers
+    }
+    roaring_bitmap_add_range(other, 1250 * 65536, 1251 * 65536 + 5);
+    roaring_bitmap_add(other, 1);
+
+    uint32_t first = 1234 * 65536;
+    from_words_compare(r, first, 70 * 65536, other);
+    from_words_compare(r, first + 64 * 1000, 70 * 65536, other);
+    from_words_compare(r, first - 1000, 70 * 65536 + 3000, other);
+    from_words_compare(r, first + 7, 2048, other);
+    from_words_compare(r, 0, 2048, other);
+    from_words_compare(r, UINT32_MAX - 100, 1000, other);
+    from_words_compare(r, first, 0, other);
+
+    // the chunks get the most compact container types
+    uint64_t *words = (uint64_t *)calloc(3 * 1024, sizeof(uint64_t));
+    for (size_t i = 0; i < 1024; i++) words[i] = UINT64_C(0x5555555555555555);
+    for (size_t i = 1024; i < 1124; i++) words[i] = UINT64_MAX;
+    words[2048] = 1;
+    roaring_bitmap_t *b = roaring_bitmap_from_words(words, 3 * 1024, 65536);
+    assert_int_equal(b->high_low_container.size, 3);
+    assert_int_equal(b->high_low_container.typecodes[0],
+                     BITSET_CONTAINER_TYPE);
+    assert_int_equal(b->high_low_container.typecodes[1], RUN_CONTAINER_TYPE);
+    assert_int_equal(b->high_low_container.typecodes[2],
+                     ARRAY_CONTAINER_TYPE);
+    assert_int_equal(roaring_bitmap_get_cardinality(b), 32768 + 6400 + 1);
+    assert_bitmap_validate(b);
+    roaring_bitmap_free(b);
+    free(words);
+
+    roaring_bitmap_free(other);
+    roaring_bitmap_free(r);
+    free(ref_values);
+}
+
 static void test_read_prev_ranges_iterator(uint8_t type) {
     uint32_t *ref_values;
     uint32_t ref_count;
@@ -5231,6 +5663,443 @@ DEFINE_TEST(test_frozen_serialization_max_containers) {
     frozen_serialization_compare(r);
 }
 
+// Array containers of up to ARRAY_CONTAINER_INLINE_SIZE values store them in
+// the container struct, they must behave as any other array container.
+DEFINE_TEST(test_inline_array_containers) {
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    for (uint32_t k = 0; k < 1000; k++) {
+        for (uint32_t j = 0; j <= k % (ARRAY_CONTAINER_INLINE_SIZE + 2); j++) {
+            roaring_bitmap_add(r, k * 65536 + j * 7);
+        }
+    }
+    roaring_bitmap_shrink_to_fit(r);
+    const roaring_array_t *ra = &r->high_low_container;
+    for (int32_t i = 0; i < ra->size; i++) {
+        const array_container_t *ac = const_CAST_array(ra->containers[i]);
+        assert_int_equal(ra->typecodes[i], ARRAY_CONTAINER_TYPE);
+        assert_true(array_container_is_inline(ac) ==
+                    (ac->cardinality <= ARRAY_CONTAINER_INLINE_SIZE));
+    }
+    roaring_bitmap_t *shifted = roaring_bitmap_add_offset(r, 7);
+    roaring_bitmap_t *both = roaring_bitmap_and(r, shifted);
+    roaring_bitmap_t *either = roaring_bitmap_or(r, shifted);
+    roaring_bitmap_xor_inplace(shifted, r);
+    roaring_bitmap_andnot_inplace(either, both);
+    assert_true(roaring_bitmap_equals(either, shifted));
+    assert_false(roaring_bitmap_is_empty(both));
+    roaring_bitmap_andnot_inplace(both, r);
+    assert_true(roaring_bitmap_is_empty(both));
+
+    size_t size = roaring_bitmap_portable_size_in_bytes(r);
+    char *buf = (char *)roaring_malloc(size);
+    assert_int_equal(roaring_bitmap_portable_serialize(r, buf), size);
+    roaring_bitmap_t *back =
+        roaring_bitmap_portable_deserialize_safe(buf, size);
+    assert_true(back != NULL && roaring_bitmap_equals(r, back));
+    roaring_free(buf);
+
+    roaring_bitmap_free(shifted);
+    roaring_bitmap_free(both);
+    roaring_bitmap_free(either);
+    roaring_bitmap_free(back);
+    frozen_serialization_compare(r);
+}
+
+// Fills an arena bitmap and a heap bitmap the same way.
+static void fill_arena_and_heap(roaring_bitmap_t *in_arena,
+                                roaring_bitmap_t *on_heap, uint32_t shift) {
+    for (uint32_t k = 0; k < 200; k++) {
+        uint32_t base = (k * 3 + shift) * 65536;
+        if (k % 3 == 0) {
+            uint32_t first = base + shift, last = base + 9000;
+            roaring_bitmap_add_range_closed(in_arena, first, last);
+            roaring_bitmap_add_range_closed(on_heap, first, last);
+        } else {
+            for (uint32_t j = 0; j < 20 * (k % 7); j++) {
+                roaring_bitmap_add(in_arena, base + j * 13 + shift);
+                roaring_bitmap_add(on_heap, base + j * 13 + shift);
+            }
+        }
+    }
+}
+
+DEFINE_TEST(test_arena_bitmaps) {
+    roaring_arena_t *arena = roaring_arena_create(4096);
+    assert_non_null(arena);
+    roaring_bitmap_t *a = roaring_bitmap_create_in_arena(arena);
+    roaring_bitmap_t *b = roaring_bitmap_create_in_arena(arena);
+    roaring_bitmap_t *ra = roaring_bitmap_create();
+    roaring_bitmap_t *rb = roaring_bitmap_create();
+    roaring_bitmap_set_copy_on_write(a, true);
+    roaring_bitmap_set_copy_on_write(ra, true);
+    fill_arena_and_heap(a, ra, 0);
+    fill_arena_and_heap(b, rb, 1);
+    assert_true(roaring_bitmap_equals(a, ra));
+    assert_true(roaring_bitmap_equals(b, rb));
+    assert_true(roaring_arena_size_in_bytes(arena) > 0);
+
+    // results are created in the arena of their first operand
+    roaring_bitmap_t *both = roaring_bitmap_or(a, b);
+    roaring_bitmap_t *expected = roaring_bitmap_or(ra, rb);
+    roaring_bitmap_t *copy = roaring_bitmap_copy(a);
+    uint64_t copied = roaring_bitmap_get_cardinality(a);
+    assert_true(roaring_bitmap_equals(both, expected));
+    assert_true(roaring_bitmap_equals(copy, ra));
+
+    // in-place operations mixing arena and heap bitmaps
+    roaring_bitmap_xor_inplace(a, b);
+    roaring_bitmap_xor_inplace(ra, rb);
+    roaring_bitmap_or_inplace(b, ra);
+    roaring_bitmap_or_inplace(rb, ra);
+    roaring_bitmap_andnot_inplace(ra, both);
+    roaring_bitmap_flip_inplace(a, 100, 3000000);
+    roaring_bitmap_flip_inplace(ra, 100, 3000000);
+    roaring_bitmap_andnot_inplace(ra, expected);
+    roaring_bitmap_andnot_inplace(a, both);
+    assert_true(roaring_bitmap_equals(a, ra));
+    assert_true(roaring_bitmap_equals(b, rb));
+    roaring_bitmap_and_inplace(expected, b);
+    assert_true(roaring_bitmap_equals(expected, rb));
+
+    roaring_executor_t executor = {reverse_executor, NULL};
+    roaring_bitmap_run_optimize_parallel(b, &executor);
+    roaring_bitmap_run_optimize(rb);
+    roaring_bitmap_remove_range(b, 70000, 5000000);
+    roaring_bitmap_remove_range(rb, 70000, 5000000);
+    assert_true(roaring_bitmap_equals(b, rb));
+
+    // compaction only happens once a bitmap is alone in its arena
+    assert_int_equal(roaring_bitmap_shrink_to_fit(b), 0);
+    roaring_bitmap_free(a);
+    assert_int_equal(roaring_bitmap_get_cardinality(copy), copied);
+    roaring_bitmap_free(copy);
+    assert_int_equal(roaring_bitmap_shrink_to_fit(b), 0);
+    roaring_bitmap_free(both);
+    size_t before = roaring_arena_size_in_bytes(arena);
+    size_t saved = roaring_bitmap_shrink_to_fit(b);
+    assert_true(saved > 0);
+    assert_int_equal(roaring_arena_size_in_bytes(arena) + saved, before);
+    assert_true(roaring_bitmap_equals(b, rb));
+    roaring_bitmap_add(b, 123);
+    roaring_bitmap_add(rb, 123);
+    assert_true(roaring_bitmap_equals(b, rb));
+
+    // the arena goes with its last bitmap
+    roaring_arena_free(arena);
+    assert_true(roaring_bitmap_equals(b, rb));
+    roaring_bitmap_free(b);
+    roaring_bitmap_free(expected);
+    roaring_bitmap_free(ra);
+    roaring_bitmap_free(rb);
+
+    // an arena freed before it is used is dropped at once
+    roaring_arena_free(roaring_arena_create(0));
+}
+
+DEFINE_TEST(test_arena_unshare) {
+    roaring_arena_t *arena = roaring_arena_create(4096);
+    assert_non_null(arena);
+    roaring_bitmap_t *a = roaring_bitmap_create_in_arena(arena);
+    roaring_bitmap_t *ra = roaring_bitmap_create();
+    roaring_bitmap_set_copy_on_write(a, true);
+    fill_arena_and_heap(a, ra, 0);
+    // the copy shares its containers, which unsharing clones in the arena
+    roaring_bitmap_t *copy = roaring_bitmap_copy(a);
+    assert_true(roaring_contains_shared(copy));
+    roaring_bitmap_set_copy_on_write(copy, false);
+    assert_false(roaring_contains_shared(copy));
+    roaring_bitmap_set_copy_on_write(a, false);
+    assert_true(roaring_bitmap_equals(copy, ra));
+    assert_true(roaring_bitmap_equals(a, ra));
+    roaring_bitmap_free(a);
+    roaring_bitmap_add(copy, 5);
+    roaring_bitmap_add(ra, 5);
+    assert_true(roaring_bitmap_equals(copy, ra));
+    roaring_arena_free(arena);
+    roaring_bitmap_free(copy);
+    roaring_bitmap_free(ra);
+}
+
+// Counts the blocks a bitmap allocator hands out and has not taken back.
+typedef struct counting_allocator_state_s {
+    int64_t live;
+    uint64_t allocations;
+} counting_allocator_state_t;
+
+static void *counting_malloc(void *context, size_t size) {
+    counting_allocator_state_t *state = (counting_allocator_state_t *)context;
+    state->live++;
+    state->allocations++;
+    return malloc(size);
+}
+
+static void counting_free(void *context, void *p) {
+    counting_allocator_state_t *state = (counting_allocator_state_t *)context;
+    if (p != NULL) state->live--;
+    free(p);
+}
+
+static void *counting_realloc(void *context, void *p, size_t size) {
+    counting_allocator_state_t *state = (counting_allocator_state_t *)context;
+    state->allocations++;
+    if (p == NULL) state->live++;
+    if (size == 0) {
+        counting_free(context, p);
+        return NULL;
+    }
+    return realloc(p, size);
+}
+
+// The blocks are over-allocated, the address malloc gave just precedes them.
+static void *counting_aligned_malloc(void *context, size_t alignment,
+                                     size_t size) {
+    size_t padded = size + alignment + sizeof(void *);
+    char *p = (char *)counting_malloc(context, padded);
+    if (p == NULL) return NULL;
+    uintptr_t aligned = ((uintptr_t)(p + sizeof(void *)) + alignment - 1) &
+                        ~(uintptr_t)(alignment - 1);
+    ((void **)aligned)[-1] = p;
+    return (void *)aligned;
+}
+
+static void counting_aligned_free(void *context, void *p) {
+    if (p != NULL) counting_free(context, ((void **)p)[-1]);
+}
+
+DEFINE_TEST(test_allocator_bitmaps) {
+    counting_allocator_state_t state = {0, 0};
+    roaring_allocator_t allocator = {
+        counting_malloc,         counting_realloc,      counting_free,
+        counting_aligned_malloc, counting_aligned_free, &state};
+    roaring_bitmap_t *a = roaring_bitmap_create_with_allocator(&allocator);
+    roaring_bitmap_t *b = roaring_bitmap_create();
+    roaring_bitmap_t *ra = roaring_bitmap_create();
+    roaring_bitmap_set_copy_on_write(a, true);
+    roaring_bitmap_set_copy_on_write(b, true);
+    fill_arena_and_heap(a, ra, 0);
+    fill_arena_and_heap(b, b, 1);
+    assert_true(state.live > 0);
+
+    // the heap bitmap never goes through the allocator, even as a result
+    uint64_t allocations = state.allocations;
+    roaring_bitmap_t *heap_or = roaring_bitmap_or(b, a);
+    roaring_bitmap_or_inplace(b, a);
+    roaring_bitmap_t *heap_copy = roaring_bitmap_copy(b);
+    assert_int_equal(state.allocations, allocations);
+
+    // results computed from the bitmap inherit its allocator
+    const roaring_bitmap_t *operands[] = {a, ra, b};
+    roaring_bitmap_t *results[] = {
+        roaring_bitmap_or(a, ra),     roaring_bitmap_and(a, b),
+        roaring_bitmap_xor(a, b),     roaring_bitmap_andnot(a, ra),
+        roaring_bitmap_copy(a),       roaring_bitmap_flip(a, 0, 1 << 20),
+        roaring_bitmap_add_offset(a, 70000),
+        roaring_bitmap_or_many(3, operands)};
+    size_t n = sizeof(results) / sizeof(results[0]);
+    int64_t live = state.live;
+    for (size_t i = 0; i < n; i++) {
+        assert_true(results[i]->high_low_container.allocator == &allocator);
+    }
+    assert_true(roaring_bitmap_equals(results[0], ra));
+    assert_true(roaring_bitmap_equals(results[4], a));
+    assert_true(roaring_bitmap_equals(results[7], heap_or));
+    assert_true(roaring_bitmap_is_empty(results[3]));
+
+    // an empty first operand still passes its allocator on
+    roaring_bitmap_t *empty = roaring_bitmap_create_with_allocator(&allocator);
+    roaring_bitmap_t *or_empty = roaring_bitmap_or(empty, b);
+    assert_true(or_empty->high_low_container.allocator == &allocator);
+    assert_true(roaring_bitmap_equals(or_empty, b));
+    assert_true(state.live > live);
+    roaring_bitmap_free(or_empty);
+    roaring_bitmap_free(empty);
+    assert_int_equal(state.live, live);
+
+    // unsharing the copy clones its containers with the allocator
+    roaring_bitmap_set_copy_on_write(results[4], false);
+    assert_false(roaring_contains_shared(results[4]));
+    assert_true(state.live > live);
+    assert_true(roaring_bitmap_equals(results[4], a));
+
+    roaring_bitmap_run_optimize(a);
+    roaring_bitmap_shrink_to_fit(a);
+    assert_true(roaring_bitmap_equals(a, ra));
+    for (size_t i = 0; i < n; i++) {
+        roaring_bitmap_free(results[i]);
+    }
+    roaring_bitmap_free(a);
+    assert_int_equal(state.live, 0);
+
+    roaring_bitmap_free(heap_or);
+    roaring_bitmap_free(heap_copy);
+    roaring_bitmap_free(b);
+    roaring_bitmap_free(ra);
+}
+
+// Every chunk of the xor is an array computed through a temporary bitset.
+static void fill_for_workspace(roaring_bitmap_t *r, uint32_t end) {
+    for (uint32_t k = 0; k < 40; k++) {
+        for (uint32_t v = 0; v < end; v += 2) {
+            roaring_bitmap_add(r, (k << 16) + v);
+        }
+    }
+}
+
+DEFINE_TEST(test_workspace) {
+    counting_allocator_state_t state = {0, 0};
+    roaring_allocator_t allocator = {
+        counting_malloc,         counting_realloc,      counting_free,
+        counting_aligned_malloc, counting_aligned_free, &state};
+    roaring_bitmap_t *a = roaring_bitmap_create_with_allocator(&allocator);
+    roaring_bitmap_t *b = roaring_bitmap_create_with_allocator(&allocator);
+    fill_for_workspace(a, 12000);
+    fill_for_workspace(b, 11000);
+    roaring_workspace_t *workspace = roaring_workspace_create(4);
+    assert_non_null(workspace);
+
+    uint64_t allocations = state.allocations;
+    roaring_bitmap_t *expected = roaring_bitmap_xor(a, b);
+    uint64_t without_workspace = state.allocations - allocations;
+    allocations = state.allocations;
+    roaring_bitmap_t *result = roaring_bitmap_xor_ex(a, b, workspace);
+    uint64_t with_workspace = state.allocations - allocations;
+    assert_true(roaring_bitmap_equals(result, expected));
+    assert_int_equal(roaring_bitmap_get_cardinality(result), 40 * 500);
+    // two blocks per bitset, only allocated for the first chunk
+    assert_int_equal(with_workspace + 2 * 39, without_workspace);
+
+    const roaring_bitmap_t *operands[] = {a, b, expected};
+    roaring_bitmap_t *many = roaring_bitmap_or_many_ex(3, operands, workspace);
+    roaring_bitmap_t *many_expected = roaring_bitmap_or_many(3, operands);
+    assert_true(roaring_bitmap_equals(many, many_expected));
+    roaring_bitmap_t *many_xor = roaring_bitmap_xor_many_ex(3, operands, NULL);
+    assert_true(roaring_bitmap_is_empty(many_xor));
+    roaring_bitmap_t *and_result = roaring_bitmap_and_ex(a, b, workspace);
+    roaring_bitmap_t *andnot_result = roaring_bitmap_andnot_ex(a, b, workspace);
+    assert_true(roaring_bitmap_equals(andnot_result, result));
+    roaring_bitmap_or_inplace(and_result, andnot_result);
+    assert_true(roaring_bitmap_equals(and_result, a));
+
+    roaring_bitmap_t *bitmaps[] = {a, b, expected, result, many, many_expected,
+                                   many_xor, and_result, andnot_result};
+    for (size_t i = 0; i < sizeof(bitmaps) / sizeof(bitmaps[0]); i++) {
+        roaring_bitmap_free(bitmaps[i]);
+    }
+    // the workspace keeps bitsets until used for bitmaps of another allocator
+    assert_true(state.live > 0);
+    roaring_bitmap_t *x = roaring_bitmap_create();
+    roaring_bitmap_t *y = roaring_bitmap_create();
+    fill_for_workspace(x, 12000);
+    fill_for_workspace(y, 11000);
+    roaring_bitmap_t *heap_result = roaring_bitmap_xor_ex(x, y, workspace);
+    assert_int_equal(state.live, 0);
+    assert_int_equal(roaring_bitmap_get_cardinality(heap_result), 40 * 500);
+    roaring_bitmap_free(heap_result);
+    roaring_bitmap_free(x);
+    roaring_bitmap_free(y);
+    roaring_workspace_free(workspace);
+}
+
+DEFINE_TEST(test_allocation_stats) {
+    roaring_allocation_stats_t before;
+    if (!roaring_allocation_stats(&before)) {
+        // not built with ROARING_ALLOCATION_STATS
+        assert_int_equal(before.total_bytes, 0);
+        assert_int_equal(before.peak_total_bytes, 0);
+        return;
+    }
+    roaring_bitmap_t *r = roaring_bitmap_create();
+    roaring_bitmap_add_range(r, 0, 100000);  // runs
+    for (uint32_t v = 200000; v < 300000; v += 3) {
+        roaring_bitmap_add(r, v);  // bitsets and arrays
+    }
+    roaring_bitmap_t *copy = roaring_bitmap_copy(r);
+    roaring_allocation_stats_t stats;
+    assert_true(roaring_allocation_stats(&stats));
+    uint64_t total = 0;
+    for (int i = 0; i < ROARING_ALLOCATION_SITE_COUNT; i++) {
+        assert_true(stats.bytes[i] >= before.bytes[i]);
+        assert_true(stats.peak_bytes[i] >= stats.bytes[i]);
+        total += stats.bytes[i];
+    }
+    assert_int_equal(stats.total_bytes, total);
+    assert_true(stats.peak_total_bytes >= total);
+    uint64_t bitsets = 2 * 2 * BITSET_CONTAINER_SIZE_IN_WORDS * 8;
+    assert_true(stats.bytes[ROARING_ALLOCATION_CONTAINERS] >=
+                before.bytes[ROARING_ALLOCATION_CONTAINERS] + bitsets);
+    assert_true(stats.bytes[ROARING_ALLOCATION_ROARING_ARRAY] >
+                before.bytes[ROARING_ALLOCATION_ROARING_ARRAY]);
+    assert_true(stats.allocations[ROARING_ALLOCATION_CONTAINERS] >
+                before.allocations[ROARING_ALLOCATION_CONTAINERS]);
+
+    // everything goes back, the high-water marks stay until reset
+    roaring_bitmap_free(copy);
+    roaring_bitmap_free(r);
+    roaring_allocation_stats_t after;
+    roaring_allocation_stats(&after);
+    for (int i = 0; i < ROARING_ALLOCATION_SITE_COUNT; i++) {
+        assert_int_equal(after.bytes[i], before.bytes[i]);
+        assert_true(after.peak_bytes[i] >= stats.bytes[i]);
+    }
+    roaring_allocation_stats_reset_peaks();
+    roaring_allocation_stats(&after);
+    assert_int_equal(after.peak_total_bytes, after.total_bytes);
+
+    // arena bitmaps are accounted for by their arena
+    roaring_arena_t *arena = roaring_arena_create(0);
+    roaring_bitmap_t *in_arena = roaring_bitmap_create_in_arena(arena);
+    roaring_bitmap_add_range(in_arena, 0, 100000);
+    roaring_allocation_stats(&stats);
+    assert_int_equal(stats.bytes[ROARING_ALLOCATION_CONTAINERS],
+                     before.bytes[ROARING_ALLOCATION_CONTAINERS]);
+    roaring_bitmap_free(in_arena);
+    roaring_arena_free(arena);
+    roaring_allocation_stats(&stats);
+    assert_int_equal(stats.total_bytes, before.total_bytes);
+}
+
+DEFINE_TEST(test_kernel_counters) {
+    roaring_kernel_counters_t counters;
+    if (!roaring_kernel_counters(&counters)) {
+        // not built with ROARING_KERNEL_COUNTERS
+        assert_int_equal(counters.pairs[ROARING_KERNEL_AND][0][0].calls, 0);
+        assert_int_equal(
+            counters.conversions[ROARING_CONVERSION_ARRAY_TO_BITSET].calls, 0);
+        return;
+    }
+    roaring_kernel_counters_reset();
+    roaring_bitmap_t *array = roaring_bitmap_from(1, 5, 9);
+    roaring_bitmap_t *bitset = roaring_bitmap_create();
+    for (uint32_t v = 0; v < 20000; v += 2) {
+        roaring_bitmap_add(bitset, v);
+    }
+    assert_true(roaring_kernel_counters(&counters));
+    assert_int_equal(
+        counters.conversions[ROARING_CONVERSION_ARRAY_TO_BITSET].calls, 1);
+    assert_int_equal(
+        counters.conversions[ROARING_CONVERSION_ARRAY_TO_BITSET].bytes,
+        DEFAULT_MAX_SIZE * sizeof(uint16_t));
+
+    roaring_bitmap_t *both = roaring_bitmap_and(array, bitset);
+    assert_true(roaring_kernel_counters(&counters));
+    // indexed by type code minus one: bitsets, then arrays, then runs
+    roaring_kernel_count_t and_count = counters.pairs[ROARING_KERNEL_AND][1][0];
+    assert_int_equal(and_count.calls, 1);
+    assert_int_equal(and_count.bytes,
+                     3 * sizeof(uint16_t) + BITSET_CONTAINER_SIZE_IN_WORDS * 8);
+    assert_int_equal(counters.pairs[ROARING_KERNEL_AND][0][1].calls, 0);
+    assert_int_equal(counters.pairs[ROARING_KERNEL_OR][1][0].calls, 0);
+
+    roaring_kernel_counters_reset();
+    assert_true(roaring_kernel_counters(&counters));
+    assert_int_equal(counters.pairs[ROARING_KERNEL_AND][1][0].calls, 0);
+    assert_int_equal(
+        counters.conversions[ROARING_CONVERSION_ARRAY_TO_BITSET].bytes, 0);
+    roaring_bitmap_free(both);
+    roaring_bitmap_free(bitset);
+    roaring_bitmap_free(array);
+}
+
 #if ROARING_UNSAFE_FROZEN_TESTS
 // This test is unsafe, as it may trigger unaligned memory access
 // It is only enabled if ROARING_UNSAFE_FROZEN_TESTS is defined.
@@ -5551,6 +6420,11 @@ int main() {
         cmocka_unit_test(test_stats),
         cmocka_unit_test(test_addremove),
         cmocka_unit_test(test_addremove_bulk),
+        cmocka_unit_test(test_add_many_unsorted),
+        cmocka_unit_test(test_appender),
+        cmocka_unit_test(test_appender_allocation_failure),
+        cmocka_unit_test(test_run_optimize_parallel_serial_fallback),
+        cmocka_unit_test(test_portable_serialize_parallel),
         cmocka_unit_test(test_addremoverun),
         cmocka_unit_test(test_basic_add),
         cmocka_unit_test(test_remove_withrun),
@@ -5658,6 +6532,16 @@ int main() {
         cmocka_unit_test(test_read_ranges_iterator_bitset),
         cmocka_unit_test(test_read_ranges_iterator_run),
         cmocka_unit_test(test_read_ranges_iterator_native),
+        cmocka_unit_test(test_range_runs_array),
+        cmocka_unit_test(test_range_runs_bitset),
+        cmocka_unit_test(test_range_runs_run),
+        cmocka_unit_test(test_range_runs_native),
+        cmocka_unit_test(test_to_words_array),
+        cmocka_unit_test(test_to_words_bitset),
+        cmocka_unit_test(test_to_words_run),
+        cmocka_unit_test(test_to_words_native),
+        cmocka_unit_test(test_to_words_empty_window),
+        cmocka_unit_test(test_from_words),
         cmocka_unit_test(test_read_prev_ranges_iterator_array),
         cmocka_unit_test(test_read_prev_ranges_iterator_bitset),
         cmocka_unit_test(test_read_prev_ranges_iterator_run),
@@ -5672,6 +6556,13 @@ int main() {
         cmocka_unit_test(test_range_cardinality),
         cmocka_unit_test(test_frozen_serialization),
         cmocka_unit_test(test_frozen_serialization_max_containers),
+        cmocka_unit_test(test_inline_array_containers),
+        cmocka_unit_test(test_arena_bitmaps),
+        cmocka_unit_test(test_arena_unshare),
+        cmocka_unit_test(test_allocator_bitmaps),
+        cmocka_unit_test(test_workspace),
+        cmocka_unit_test(test_allocation_stats),
+        cmocka_unit_test(test_kernel_counters),
 #if ROARING_UNSAFE_FROZEN_TESTS
         cmocka_unit_test(test_portable_deserialize_frozen),
 #endif  // ROARING_UNSAFE_FROZEN_TESTS